@@ -85,6 +85,12 @@ class NetcodeConnection;
  * class to simplify development.
  */
 class NetcodeChannel {
+public:
+    /** The label of the reliable, ordered data channel between two peers */
+    static constexpr const char* RELIABLE_LABEL = "public";
+    /** The label of the unreliable, unordered data channel between two peers */
+    static constexpr const char* UNRELIABLE_LABEL = "unreliable";
+
 private:
     /** The name of this data channel */
     std::string _label;
@@ -102,6 +108,8 @@ private:
     std::atomic<bool> _debug;
     /** Whether this channel is currently open */
     std::atomic<bool> _open;
+    /** Whether this channel retransmits lost messages and preserves order */
+    std::atomic<bool> _reliable;
     /** Whether this channel is currently active (but not maybe not yet open) */
     std::atomic<bool> _active;
     /** 
@@ -149,12 +157,17 @@ private:
      *
      * This initializer assumes the peer is the offerer of the data channel.
      *
+     * A reliable channel retransmits lost messages and delivers them in order.
+     * An unreliable channel never retransmits and delivers messages as soon as
+     * they arrive, so a lost message never delays the ones after it.
+     *
      * @param parent    The parent RTC peer connection
      * @param label     The unique label for this data channel
+     * @param reliable  Whether the channel is reliable and ordered
      *
      * @return true if initialization was successful
      */
-    bool init(const std::weak_ptr<NetcodePeer>& parent, std::string label);
+    bool init(const std::weak_ptr<NetcodePeer>& parent, std::string label, bool reliable=true);
     
     /**
      * Initializes a new netcode wrapper for the given RTC data channel.
@@ -173,14 +186,20 @@ private:
      *
      * This initializer assumes the peer is the offerer of the data channel.
      *
+     * A reliable channel retransmits lost messages and delivers them in order.
+     * An unreliable channel never retransmits and delivers messages as soon as
+     * they arrive, so a lost message never delays the ones after it.
+     *
      * @param parent    The parent RTC peer connection
      * @param label     The unique label for this data channel
+     * @param reliable  Whether the channel is reliable and ordered
      *
      * @return a newly allocated RTC data channel for the given label.
      */
-    static std::shared_ptr<NetcodeChannel> alloc(const std::weak_ptr<NetcodePeer>& parent, std::string label) {
+    static std::shared_ptr<NetcodeChannel> alloc(const std::weak_ptr<NetcodePeer>& parent, std::string label,
+                                                 bool reliable=true) {
         std::shared_ptr<NetcodeChannel> result = std::make_shared<NetcodeChannel>();
-        return (result->init(parent,label) ? result : nullptr);
+        return (result->init(parent,label,reliable) ? result : nullptr);
     }
 
     /**
@@ -235,6 +254,25 @@ public:
      */
     const std::string getLabel() const { return _label; }
     
+    /**
+     * Returns true if this data channel is open.
+     *
+     * Messages sent on a channel that is not yet open are lost.
+     *
+     * @return true if this data channel is open.
+     */
+    bool isOpen() const { return _open; }
+    
+    /**
+     * Returns true if this data channel is reliable and ordered.
+     *
+     * An unreliable channel never retransmits lost messages, and delivers
+     * messages in the order they arrive.
+     *
+     * @return true if this data channel is reliable and ordered.
+     */
+    bool isReliable() const { return _reliable; }
+    
     /**
      * Returns the parent {@link NetcodePeer} of this data channel
      *
@@ -260,6 +298,19 @@ public:
      */
     const std::shared_ptr<NetcodeConnection> getConnection();
     
+    /**
+     * Returns the number of bytes queued on this channel but not yet sent.
+     *
+     * This is the buffered amount of the underlying data channel. It grows
+     * when messages are sent faster than the network can carry them, so it
+     * is a direct measure of congestion.
+     *
+     * This method is not const because it requires a lock.
+     *
+     * @return the number of bytes queued on this channel but not yet sent.
+     */
+    size_t getBufferedAmount();
+    
 #pragma mark Communication
     /**
      * Closes this data channel
@@ -60,6 +60,7 @@
 #ifndef __CU_NETCODE_CONNECTION_H__
 #define __CU_NETCODE_CONNECTION_H__
 #include <cugl/net/CUNetcodeConfig.h>
+#include <cugl/net/CUNetcodeInbox.h>
 #include <rtc/rtc.hpp>
 #include <unordered_map>
 #include <unordered_set>
@@ -302,66 +303,6 @@ public:
     typedef std::function<void(const std::string source, const std::vector<std::byte>& message)> Dispatcher;
      
 private:
-    /**
-     * A message envelope, storing the message and its receipt
-     *
-     * As messages come from many different peers, it is helpful to know the
-     * sender of each. This information is stored with the message in the ring 
-     * buffer
-     */
-    class Envelope {
-    public:
-        /** The message source */
-        std::string source;
-        /** The message (as a byte vector) */
-        std::vector<std::byte> message;
-        
-        /** Creates an empty message envelope */
-        Envelope() {}
-        
-        /**
-         * Creates a copy of the given message envelope
-         *
-         * @param env the message envelope to copy
-         */
-        Envelope(const Envelope& env) {
-            source  = env.source;
-            message = env.message; 
-        }
-        
-        /**
-         * Creates a message envelope with the resources of the original
-         *
-         * @param env the message envelope to acquire
-         */
-        Envelope(Envelope&& env) {
-            source  = std::move(env.source);
-            message = std::move(env.message); 
-         }
-        
-        /**
-         * Copies the given message envelope
-         *
-         * @param env the message envelope to copy
-         */
-        Envelope& operator=(const Envelope& env) {
-            source  = env.source;
-            message = env.message; 
-            return *this;
-        }
-        
-        /**
-         * Acquires the resources of the given message envelope
-         *
-         * @param env the message envelope to acquire
-         */
-        Envelope& operator=(Envelope&& env) {
-            source  = std::move(env.source);
-            message = std::move(env.message); 
-            return *this;
-        }
-    };
-    
     /** The configuration of this connection */
     NetcodeConfig _config;
     /** The RTC equivalent */
@@ -404,25 +345,24 @@ private:
     /** A counter to indicate when host migration is complete */
     size_t _migration;
 
-    /** 
-     * A data ring buffer for incoming messages
+    /**
+     * The inbox for incoming messages
      *
      * We do not want to process data as soon as it is received, as that is difficult
      * to synchronize with the animation frame. Instead, we would like to call
      * {@link #receive} as the start of each {@link Application#update}. But this means
-     * it is possible to receive multiple network messages before a read. This buffer
+     * it is possible to receive multiple network messages before a read. This inbox
      * stores this messages.
      *
-     * This is a classic ring buffer. It it fills up (because the application is too
-     * slow to read), then the oldest messages are deleted first.
+     * The inbox is lock-free, so the network threads never wait on the main thread
+     * (or vice versa). If it fills up (because the application is too slow to read),
+     * then what happens is determined by its overflow policy.
      */
-    std::vector<Envelope> _buffer;
-    /** The number of messages in the data ring buffer */
-    size_t _buffsize;
-    /** The head of the data ring buffer */
-    size_t _buffhead;
-    /** The tail of the data ring buffer */
-    size_t _bufftail;
+    std::shared_ptr<NetcodeInbox> _inbox;
+    /** Whether the {@link #onReceipt} callback is set (readable from any thread) */
+    std::atomic<bool> _hasReceipt;
+    /** Whether a drain of the inbox is scheduled on the main thread */
+    std::atomic<bool> _drainScheduled;
     
     // To prevent race conditions
     /** Whether this websocket connection prints out debugging information */
@@ -606,9 +546,11 @@ private:
     void handleSignal(const std::shared_ptr<JsonValue>&  json);
 
     /** 
-     * Appends the given data to the ring buffer.
+     * Appends the given data to the message inbox.
      *
      * This method is used to store an incoming message for later consumption.
+     * It is called by the network threads, and never takes a lock unless the
+     * inbox overflows with the GROW policy.
      *
      * @param source    The message source
      * @param data      The message data
@@ -617,6 +559,20 @@ private:
      */
     bool append(const std::string source, const std::vector<std::byte>& data);
     
+    /**
+     * Returns the data channel of the given peer for the given delivery.
+     *
+     * If an unreliable channel is requested but is not yet open, this method
+     * returns the reliable channel instead. It returns nullptr if the peer has
+     * no channel at all. The caller should hold the lock on this connection.
+     *
+     * @param peer      The peer connection
+     * @param reliable  Whether the data requires reliable, ordered delivery
+     *
+     * @return the data channel of the given peer for the given delivery.
+     */
+    std::shared_ptr<NetcodeChannel> pickChannel(const std::shared_ptr<NetcodePeer>& peer, bool reliable);
+    
     /** Allow access to the other netcode classes */
     friend class NetcodeManager;
     friend class NetcodeChannel;
@@ -740,8 +696,6 @@ public:
      * Note that this is NOT the same as the capacity of a single message. That value
      * was set as part of the initial {@link NetcodeConfig}.
      *
-     * This method is not const because it requires a lock.
-     *
      * @return the message buffer capacity.
      */
     size_t getCapacity();
@@ -757,10 +711,43 @@ public:
      * Note that this is NOT the same as the capacity of a single message. That value
      * was set as part of the initial {@link NetcodeConfig}.
      *
+     * The capacity is rounded up to the nearest power of two. It should only be
+     * changed rarely, as a message that arrives during the change may be delivered
+     * out of order.
+     *
      * @param capacity  The new message buffer capacity.
      */
     void setCapacity(size_t capacity);
 
+    /**
+     * Returns the policy for messages that arrive when the buffer is full.
+     *
+     * By default, the oldest message is discarded to make room.
+     *
+     * @return the policy for messages that arrive when the buffer is full.
+     */
+    NetcodeInbox::Overflow getOverflow() const { return _inbox->getOverflow(); }
+    
+    /**
+     * Sets the policy for messages that arrive when the buffer is full.
+     *
+     * By default, the oldest message is discarded to make room. With the
+     * GROW policy no message is ever lost, but the buffer can grow without
+     * bound if the application never calls {@link #receive}.
+     *
+     * @param policy    The overflow policy
+     */
+    void setOverflow(NetcodeInbox::Overflow policy) { _inbox->setOverflow(policy); }
+    
+    /**
+     * Returns the number of incoming messages lost to a full buffer.
+     *
+     * This count is reset each time the connection is opened.
+     *
+     * @return the number of incoming messages lost to a full buffer.
+     */
+    uint64_t getDropCount() const { return _inbox->getDropCount(); }
+
     /**
      * Returns the room ID or empty string.
      *
@@ -812,6 +799,20 @@ public:
      * @return true if the given player UUID is currently connected to the game.
      */
     bool isPlayerActive(const std::string player);
+    
+    /**
+     * Returns the number of bytes queued for the given player but not yet sent.
+     *
+     * This is the sum of the buffered amounts of every data channel to that
+     * player. It returns 0 if there is no direct route to the player.
+     *
+     * This method is not const because it requires a lock.
+     *
+     * @param player    The player to query
+     *
+     * @return the number of bytes queued for the given player but not yet sent.
+     */
+    size_t getBufferedAmount(const std::string player);
 
     /**
      * Returns the number of players currently connected to this game 
@@ -877,10 +878,12 @@ public:
      * way). If the destination is this connection, the message will be immediately
      * appended to the receipt buffer.
      *
-     * Communication from a source is guaranteed to be ordered. So if connection A
-     * sends two messages to connection B, connection B will receive those messages
-     * in the same order. However, there is no relationship between the messages
-     * coming from different sources.
+     * Reliable communication from a source is guaranteed to be ordered. So if
+     * connection A sends two messages to connection B, connection B will receive
+     * those messages in the same order. However, there is no relationship between
+     * the messages coming from different sources. Unreliable messages may be lost
+     * or arrive in any order, but a lost message never delays any other message.
+     * This is appropriate for state that is replaced by the next message anyway.
      *
      * You may choose to either send a byte array directly, or you can use the
      * {@link NetcodeSerializer} and {@link NetcodeDeserializer} classes to encode
@@ -889,13 +892,13 @@ public:
      * This requires a connection be established. Otherwise it will return false. It
      * will also return false if the host is currently migrating.
      *
-     * @param dst   The UUID of the peer to receive the message
-     * @param data  The byte array to send.
+     * @param dst       The UUID of the peer to receive the message
+     * @param data      The byte array to send.
+     * @param reliable  Whether to use the reliable, ordered channel
      *
      * @return true if the message was (apparently) sent
      */
-
-    bool sendTo(const std::string dst, const std::vector<std::byte>& data);
+    bool sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable=true);
 
     /**
      * Sends a byte array to the host player.
@@ -904,10 +907,12 @@ public:
      * the host player. If this connection is the host, the message will be
      * immediately appended to the receipt buffer.
      *
-     * Communication from a source is guaranteed to be ordered. So if connection A
-     * sends two messages to connection B, connection B will receive those messages
-     * in the same order. However, there is no relationship between the messages
-     * coming from different sources.
+     * Reliable communication from a source is guaranteed to be ordered. So if
+     * connection A sends two messages to connection B, connection B will receive
+     * those messages in the same order. However, there is no relationship between
+     * the messages coming from different sources. Unreliable messages may be lost
+     * or arrive in any order, but a lost message never delays any other message.
+     * This is appropriate for state that is replaced by the next message anyway.
      *
      * You may choose to either send a byte array directly, or you can use the
      * {@link NetcodeSerializer} and {@link NetcodeDeserializer} classes to encode
@@ -916,11 +921,12 @@ public:
      * This requires a connection be established. Otherwise it will return false. It
      * will also return false if the host is currently migrating.
      *
-     * @param data  The byte array to send.
+     * @param data      The byte array to send.
+     * @param reliable  Whether to use the reliable, ordered channel
      *
      * @return true if the message was (apparently) sent
      */
-    bool sendToHost(const std::vector<std::byte>& data);
+    bool sendToHost(const std::vector<std::byte>& data, bool reliable=true);
     
     /**
      * Sends a byte array to all other players.
@@ -930,10 +936,11 @@ public:
      * a broadcast message, this player will receive it as well (with the indication
      * of this connection as the sender).
      *
-     * As with {@link #sendTo}, communication from a particular source is guaranteed
-     * to be ordered. So if connection A broadcasts two messages, all other connections
-     * will receive those messages in the same order. However, there is no relationship
-     * between the messages coming from different sources.
+     * As with {@link #sendTo}, reliable communication from a particular source is
+     * guaranteed to be ordered. So if connection A broadcasts two messages, all other
+     * connections will receive those messages in the same order. However, there is no
+     * relationship between the messages coming from different sources. Unreliable
+     * messages may be lost or reordered, but never delay any other message.
      *
      * You may choose to either send a byte array directly, or you can use the
      * {@link NetcodeSerializer} and {@link NetcodeDeserializer} classes to encode
@@ -942,11 +949,12 @@ public:
      * This requires a connection be established. Otherwise it will return false. It
      * will also return false if the host is currently migrating.
      *
-     * @param data The byte array to send.
+     * @param data      The byte array to send.
+     * @param reliable  Whether to use the reliable, ordered channels
      *
      * @return true if the message was (apparently) sent
      */
-    bool broadcast(const std::vector<std::byte>& data);
+    bool broadcast(const std::vector<std::byte>& data, bool reliable=true);
     
     /**
      * Receives incoming network messages.
@@ -959,13 +967,21 @@ public:
      * function should be prepared to be called multiple times a render frame, or even
      * not at all.
      *
+     * No lock is held while the dispatcher runs, so the network threads are free
+     * to buffer new messages in the meantime. Those messages are left for the next
+     * call. The optional limit caps the number of messages processed, leaving the
+     * rest for later. This is useful to bound the time spent in a single frame.
+     *
      * If a dispatcher callback has been registered with {@link #onReceipt}, this
-     * method will never do anything. In that case, messages are not buffered and are
-     * processed as soon as they are received.
+     * method will never do anything. In that case, messages are drained once per
+     * animation frame, as soon as possible after they are received.
      *
      * @param dispatcher    The function to process received data
+     * @param limit         The maximum number of messages to process
+     *
+     * @return the number of messages processed
      */
-    void receive(const Dispatcher& dispatcher);
+    size_t receive(const Dispatcher& dispatcher, size_t limit=SIZE_MAX);
     
     /**
      * Marks the game as started and bans incoming connections.
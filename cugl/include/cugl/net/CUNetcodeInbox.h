@@ -0,0 +1,451 @@
+//
+//  CUNetcodeInbox.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module is part of a Web RTC implementation of the classic CUGL networking
+//  library. That library provided connected to a custom game server for matchmaking,
+//  and used reliable UDP communication. This version replaces the matchmaking server
+//  with a web socket, and uses web socket data channels for communication.
+//
+//  This module specifically supports the hand-off of incoming messages from the
+//  network threads to the main thread. It is a bounded queue that never blocks
+//  either side, so that a slow frame never stalls the network, and a burst of
+//  network traffic never stalls a frame.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Walker White
+//  Version: 1/16/23
+//
+#ifndef __CU_NETCODE_INBOX_H__
+#define __CU_NETCODE_INBOX_H__
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace cugl {
+
+    /**
+     * The CUGL networking classes.
+     *
+     * This internal namespace is for optional networking package. Currently CUGL
+     * supports ad-hoc game lobbies using web-sockets. The sockets must connect
+     * connect to a CUGL game lobby server.
+     */
+    namespace net {
+
+/**
+ * This class is a queue of incoming messages between threads.
+ *
+ * Messages are pushed by the network threads (the producers) and drained by
+ * the main thread (the consumer). The queue is a bounded ring of message
+ * cells. Each cell keeps its buffers between messages, so once the ring is
+ * warmed up, pushing a message only copies its bytes and never allocates.
+ *
+ * Neither side ever takes a lock on the common path. Producers claim a cell
+ * with a compare-and-swap, and the consumer dispatches each message straight
+ * from its cell, releasing the cell afterwards. Hence a dispatcher may take
+ * as long as it likes (and may even push new messages) without blocking the
+ * network threads.
+ *
+ * What happens when the ring is full is determined by the {@link Overflow}
+ * policy. Every message that is lost to overflow is counted.
+ *
+ * There may be any number of producers, but only one consumer. The methods
+ * {@link #drain}, {@link #clear}, and {@link #setCapacity} must only ever be
+ * called from the same thread.
+ */
+class NetcodeInbox {
+public:
+    /**
+     * This enum represents what happens when a message arrives at a full inbox
+     */
+    enum class Overflow : int {
+        /**
+         * The message is stored in a (locked) spill list until the next drain.
+         *
+         * No messages are lost, at the cost of a lock and an allocation per
+         * message while the ring is full. Messages are still delivered in
+         * the order they were pushed.
+         */
+        GROW = 0,
+        /** The oldest message in the inbox is discarded to make room */
+        DROP_OLDEST = 1,
+        /** The new message is discarded */
+        DROP_NEWEST = 2
+    };
+
+private:
+    /**
+     * A single slot of the ring buffer.
+     *
+     * The sequence number determines who may use the cell. It equals the
+     * push position when the cell is free, and the push position plus one
+     * when the cell holds a message.
+     */
+    class Cell {
+    public:
+        /** The sequence number of this cell */
+        std::atomic<size_t> sequence;
+        /** The message source */
+        std::string source;
+        /** The message data */
+        std::vector<std::byte> message;
+    };
+
+    /**
+     * A bounded ring buffer of message cells.
+     *
+     * The capacity is always a power of two. A ring is never resized. To
+     * change the capacity, the inbox replaces the ring instead.
+     */
+    class Ring {
+    public:
+        /** The message cells */
+        std::unique_ptr<Cell[]> cells;
+        /** The capacity minus one (for fast wrap around) */
+        size_t mask;
+        /** The position of the next message to pop */
+        alignas(64) std::atomic<size_t> head;
+        /** The position of the next message to push */
+        alignas(64) std::atomic<size_t> tail;
+
+        /**
+         * Creates a ring buffer with the given capacity.
+         *
+         * @param capacity  The ring capacity (a power of two)
+         */
+        Ring(size_t capacity);
+
+        /**
+         * Returns a free cell to push a message to, or nullptr if full.
+         *
+         * The cell must be published with {@link #publish} once it is filled.
+         *
+         * @param pos   The position of the claimed cell
+         *
+         * @return a free cell to push a message to, or nullptr if full.
+         */
+        Cell* claimPush(size_t& pos);
+
+        /**
+         * Returns the oldest message cell, or nullptr if empty.
+         *
+         * The cell must be released with {@link #release} once it is read.
+         *
+         * @param pos   The position of the claimed cell
+         *
+         * @return the oldest message cell, or nullptr if empty.
+         */
+        Cell* claimPop(size_t& pos);
+
+        /**
+         * Marks a cell claimed by {@link #claimPush} as holding a message.
+         *
+         * @param cell  The filled cell
+         * @param pos   The position of the cell
+         */
+        void publish(Cell* cell, size_t pos) {
+            cell->sequence.store(pos+1, std::memory_order_release);
+        }
+
+        /**
+         * Marks a cell claimed by {@link #claimPop} as free.
+         *
+         * The cell buffers are cleared, but keep their capacity.
+         *
+         * @param cell  The read cell
+         * @param pos   The position of the cell
+         */
+        void release(Cell* cell, size_t pos) {
+            cell->source.clear();
+            cell->message.clear();
+            cell->sequence.store(pos+mask+1, std::memory_order_release);
+        }
+    };
+
+    /** A message that did not fit in the ring (GROW policy only) */
+    class Spill {
+    public:
+        /** The message source */
+        std::string source;
+        /** The message data */
+        std::vector<std::byte> message;
+    };
+
+    /** The ring that new messages are pushed to */
+    std::atomic<Ring*> _ring;
+    /** Every ring allocated, oldest first (the last one is current) */
+    std::vector<std::unique_ptr<Ring>> _rings;
+    /** The overflow policy */
+    std::atomic<Overflow> _policy;
+
+    /** Whether there are messages in the spill list */
+    std::atomic<bool> _spilled;
+    /** The lock for the spill list */
+    mutable std::mutex _spillMutex;
+    /** The messages that overflowed the ring, in order */
+    std::vector<Spill> _spill;
+    /** The spill list being dispatched (kept to reuse its capacity) */
+    std::vector<Spill> _spillOut;
+
+    /** The number of messages pushed */
+    std::atomic<uint64_t> _pushed;
+    /** The number of messages lost to overflow */
+    std::atomic<uint64_t> _dropped;
+    /** The number of messages that overflowed into the spill list */
+    std::atomic<uint64_t> _spills;
+
+    /**
+     * Appends a message to the spill list.
+     *
+     * @param source    The message source
+     * @param data      The message data
+     * @param size      The number of bytes
+     */
+    void spill(const std::string& source, const std::byte* data, size_t size);
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates a degenerate inbox with no capacity.
+     *
+     * This object must be initialized before it can be used.
+     */
+    NetcodeInbox();
+
+    /**
+     * Deletes this inbox, disposing all resources
+     */
+    ~NetcodeInbox() { dispose(); }
+
+    /**
+     * Disposes all of the resources used by this inbox.
+     *
+     * Any undelivered messages are lost. This method must not be called
+     * while any producer may still push a message.
+     */
+    void dispose();
+
+    /**
+     * Initializes an inbox with the given capacity and overflow policy.
+     *
+     * The capacity is rounded up to the nearest power of two.
+     *
+     * @param capacity  The number of messages the ring can hold
+     * @param policy    The overflow policy
+     *
+     * @return true if initialization was successful
+     */
+    bool init(size_t capacity, Overflow policy=Overflow::DROP_OLDEST);
+
+    /**
+     * Returns a newly allocated inbox with the given capacity and policy.
+     *
+     * The capacity is rounded up to the nearest power of two.
+     *
+     * @param capacity  The number of messages the ring can hold
+     * @param policy    The overflow policy
+     *
+     * @return a newly allocated inbox with the given capacity and policy.
+     */
+    static std::shared_ptr<NetcodeInbox> alloc(size_t capacity, Overflow policy=Overflow::DROP_OLDEST) {
+        std::shared_ptr<NetcodeInbox> result = std::make_shared<NetcodeInbox>();
+        return (result->init(capacity,policy) ? result : nullptr);
+    }
+
+#pragma mark Accessors
+    /**
+     * Returns the number of messages the ring can hold.
+     *
+     * @return the number of messages the ring can hold.
+     */
+    size_t getCapacity() const;
+
+    /**
+     * Sets the number of messages the ring can hold.
+     *
+     * The capacity is rounded up to the nearest power of two. As producers
+     * may still be pushing to the old ring, it is retained (and drained
+     * first) until this inbox is disposed. A message pushed to the old ring
+     * during the swap may be delivered after newer messages from the same
+     * source. So this method should be called rarely, ideally when the
+     * network is quiet. This method may only be called by the consumer.
+     *
+     * @param capacity  The number of messages the ring can hold
+     */
+    void setCapacity(size_t capacity);
+
+    /**
+     * Returns the overflow policy.
+     *
+     * @return the overflow policy.
+     */
+    Overflow getOverflow() const { return _policy.load(std::memory_order_relaxed); }
+
+    /**
+     * Sets the overflow policy.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param policy    The overflow policy
+     */
+    void setOverflow(Overflow policy) { _policy.store(policy, std::memory_order_relaxed); }
+
+    /**
+     * Returns the approximate number of undelivered messages.
+     *
+     * The value is only exact if no thread is pushing or draining. This
+     * method may only be called by the consumer.
+     *
+     * @return the approximate number of undelivered messages.
+     */
+    size_t size() const;
+
+    /**
+     * Returns the number of messages pushed to this inbox.
+     *
+     * This includes messages that were later dropped.
+     *
+     * @return the number of messages pushed to this inbox.
+     */
+    uint64_t getPushCount() const { return _pushed.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns the number of messages lost to overflow.
+     *
+     * @return the number of messages lost to overflow.
+     */
+    uint64_t getDropCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns the number of messages that overflowed into the spill list.
+     *
+     * This is only nonzero for the GROW policy. These messages are not lost.
+     *
+     * @return the number of messages that overflowed into the spill list.
+     */
+    uint64_t getSpillCount() const { return _spills.load(std::memory_order_relaxed); }
+
+    /**
+     * Resets the message counters to zero.
+     */
+    void resetCounts();
+
+#pragma mark Messages
+    /**
+     * Pushes a copy of a message to this inbox.
+     *
+     * This method is safe to call from any thread, and only takes a lock if
+     * the ring is full and the policy is GROW.
+     *
+     * @param source    The message source
+     * @param data      The message data
+     * @param size      The number of bytes
+     *
+     * @return true if the message was stored
+     */
+    bool push(const std::string& source, const std::byte* data, size_t size);
+
+    /**
+     * Pushes a copy of a message to this inbox.
+     *
+     * This method is safe to call from any thread, and only takes a lock if
+     * the ring is full and the policy is GROW.
+     *
+     * @param source    The message source
+     * @param message   The message data
+     *
+     * @return true if the message was stored
+     */
+    bool push(const std::string& source, const std::vector<std::byte>& message) {
+        return push(source, message.data(), message.size());
+    }
+
+    /**
+     * Dispatches the messages in this inbox, oldest first.
+     *
+     * The dispatcher is called as `dispatcher(source,message)` and receives
+     * references into the inbox. They are only valid for the duration of
+     * the call. No lock is held while the dispatcher runs, so it may push
+     * new messages. However, messages pushed after this method starts are
+     * left for the next drain.
+     *
+     * Spilled messages are delivered once the ring is empty. They are all
+     * delivered at once, even if that exceeds the limit.
+     *
+     * This method may only be called by the consumer.
+     *
+     * @param dispatcher    The function to call on each message
+     * @param limit         The maximum number of ring messages to dispatch
+     *
+     * @return the number of messages dispatched
+     */
+    template <typename F>
+    size_t drain(F&& dispatcher, size_t limit=SIZE_MAX) {
+        size_t count = 0;
+        bool empty = true;
+        for (auto it = _rings.begin(); it != _rings.end() && count < limit; ++it) {
+            Ring* ring = it->get();
+            size_t end = ring->tail.load(std::memory_order_acquire);
+            size_t pos;
+            Cell* cell;
+            while (count < limit && ring->head.load(std::memory_order_relaxed) < end &&
+                   (cell = ring->claimPop(pos)) != nullptr) {
+                dispatcher(static_cast<const std::string&>(cell->source),
+                           static_cast<const std::vector<std::byte>&>(cell->message));
+                ring->release(cell, pos);
+                count++;
+            }
+            empty = empty && ring->head.load(std::memory_order_relaxed) >= end;
+        }
+
+        if (empty && _spilled.load(std::memory_order_acquire)) {
+            {
+                std::lock_guard<std::mutex> lock(_spillMutex);
+                _spillOut.swap(_spill);
+                _spilled.store(false, std::memory_order_release);
+            }
+            for (auto it = _spillOut.begin(); it != _spillOut.end(); ++it) {
+                dispatcher(static_cast<const std::string&>(it->source),
+                           static_cast<const std::vector<std::byte>&>(it->message));
+            }
+            count += _spillOut.size();
+            _spillOut.clear();
+        }
+        return count;
+    }
+
+    /**
+     * Discards every message in this inbox.
+     *
+     * This method may only be called by the consumer.
+     */
+    void clear();
+};
+
+    }
+}
+
+#endif /* __CU_NETCODE_INBOX_H__ */
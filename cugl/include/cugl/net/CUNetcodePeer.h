@@ -246,6 +246,8 @@ private:
      *
      * In our experiments, it is only safe to open one data channel at a time.
      * This callback informs this peer when it is safe to make a new channel.
+     * Hence the offerer only creates the unreliable channel once the reliable
+     * one is open.
      *
      * @param label The data channel label
      */
@@ -254,11 +256,15 @@ private:
     /**
      * Creates a data channel with the given label
      *
-     * There can only be one data channel of any label.
+     * There can only be one data channel of any label. An unreliable channel
+     * is unordered and never retransmits lost messages.
+     *
+     * @param label     The data channel label
+     * @param reliable  Whether the channel is reliable and ordered
      *
      * @return true if creation was successful.
      */
-    bool createChannel(const std::string label);
+    bool createChannel(const std::string label, bool reliable=true);
     
     /** Allow access to the other netcode classes */
     friend class NetcodeChannel;
@@ -35,6 +35,7 @@
 #include "CUNetcodeConnection.h"
 #include "CUNetcodePeer.h"
 #include "CUNetcodeChannel.h"
+#include "CUNetcodeInbox.h"
 #include "CUNetcodeSerializer.h"
 
 #endif /* __CU_NET_PKG_H__ */
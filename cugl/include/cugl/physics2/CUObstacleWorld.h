@@ -334,7 +334,7 @@ public:
      *
      * @param dt Number of seconds to run the (non-lockstep) simulation
      */
-    void update(float dt);
+    virtual void update(float dt);
     
     /**
      * Returns the bounds for the world controller.
@@ -0,0 +1,254 @@
+//
+//  CUBitDeserializer.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a bit-level deserializer for networked physics. Like
+//  the lightweight deserializer, it relies on the user to know the type of the
+//  data. However, values are read with an explicit bit width instead of a
+//  whole number of bytes, which makes it suitable for quantized snapshots.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_BIT_DESERIALIZER_H__
+#define __CU_BIT_DESERIALIZER_H__
+
+#include <SDL_stdinc.h>
+#include <vector>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A bit-level deserializer for networked physics.
+ *
+ * This class is the compact counterpart of {@link LWDeserializer}. It reads
+ * values with the same bit widths that they were written with, so it is up
+ * to the user to know both the type and the width of the data.
+ *
+ * This class is to be paired with {@link BitSerializer} for serialization.
+ */
+class BitDeserializer{
+private:
+    /** Currently loaded data */
+    std::vector<std::byte> _data;
+    /** Position in the data of next bit to read */
+    size_t _pos;
+
+public:
+    /**
+     * Creates a new BitDeserializer on the stack.
+     *
+     * Deserializers do not have any nontrivial state and so it is unnecessary
+     * to use an init method. However, we do include a static {@link #alloc}
+     * method for creating shared pointers.
+     */
+    BitDeserializer() : _pos(0) {}
+
+    /**
+     * Returns a newly allocated BitDeserializer.
+     *
+     * This method is solely include for convenience purposes.
+     *
+     * @return a newly allocated BitDeserializer.
+     */
+    static std::shared_ptr<BitDeserializer> alloc() {
+        return std::make_shared<BitDeserializer>();
+    }
+
+    /**
+     * Returns the float represented by a quantized value.
+     *
+     * This is the inverse of {@link BitSerializer#quantize}. The result is
+     * only accurate to within the resolution of the quantization.
+     *
+     * @param value The quantized value
+     * @param min   The minimum value of the range
+     * @param max   The maximum value of the range
+     * @param bits  The number of bits in the quantized value (2 to 32)
+     *
+     * @return the float represented by a quantized value.
+     */
+    static float dequantize(Uint32 value, float min, float max, Uint8 bits) {
+        if (max <= min) {
+            return min;
+        }
+        double steps = (double)((((Uint64)1) << bits) - 2);
+        double t = value/steps;
+        t = t > 1 ? 1 : t;
+        return (float)(min+t*((double)max-min));
+    }
+
+    /**
+     * Loads a new message to be read.
+     *
+     * Calling this method will discard any previously loaded messages. The
+     * message must be serialized by {@link BitSerializer}. Otherwise, the
+     * results are unspecified.
+     *
+     * Once loaded, call the various read methods to get the data. It is
+     * up to the user to know the correct methods to be called. The values
+     * are guaranteed to be delievered in the same order they were written.
+     *
+     * @param msg       The byte vector serialized by {@link BitSerializer}
+     * @param offset    The number of leading bytes to skip
+     */
+    void receive(const std::vector<std::byte>& msg, size_t offset=0) {
+        _data = msg;
+        _pos = offset*8;
+    }
+    
+    /**
+     * Loads a new message to be read from a span of bytes.
+     *
+     * This is the same as {@link #receive(const std::vector<std::byte>&,size_t)}
+     * except that the message is not required to be in a vector. The bytes
+     * are copied, so they need not outlive this call.
+     *
+     * @param data      The bytes serialized by {@link BitSerializer}
+     * @param size      The number of bytes
+     * @param offset    The number of leading bytes to skip
+     */
+    void receive(const std::byte* data, size_t size, size_t offset=0) {
+        _data.assign(data, data+size);
+        _pos = offset*8;
+    }
+
+    /**
+     * Returns an unsigned int read from the given number of bits.
+     *
+     * The method advances the read position. Any bits requested beyond the
+     * end of the loaded data are read as 0.
+     *
+     * @param bits  The number of bits to read (at most 32)
+     *
+     * @return an unsigned int read from the given number of bits.
+     */
+    Uint32 readBits(Uint8 bits) {
+        Uint32 result = 0;
+        for (Uint8 ii = 0; ii < bits; ii++) {
+            size_t byte = _pos >> 3;
+            Uint32 bit = 0;
+            if (byte < _data.size()) {
+                bit = ((Uint32)_data[byte] >> (7 - (_pos & 7))) & 1;
+            }
+            result = (result << 1) | bit;
+            _pos++;
+        }
+        return result;
+    }
+
+    /**
+     * Returns a boolean read from a single bit.
+     *
+     * The method advances the read position. If called when no more data is
+     * available, this method will return false.
+     *
+     * @return a boolean read from a single bit.
+     */
+    bool readBool() {
+        return readBits(1) == 1;
+    }
+
+    /**
+     * Returns a variable length unsigned int.
+     *
+     * This is the counterpart of {@link BitSerializer#writeVarUint}, and the
+     * group size must match the one used when writing. The method advances
+     * the read position. If called when no more data is available, this
+     * method will return 0.
+     *
+     * @param group The number of value bits in each group
+     *
+     * @return a variable length unsigned int.
+     */
+    Uint64 readVarUint(Uint8 group=7) {
+        Uint64 result = 0;
+        Uint8 shift = 0;
+        bool more = true;
+        while (more && shift < 64) {
+            more = readBool();
+            result |= ((Uint64)readBits(group)) << shift;
+            shift += group;
+        }
+        return result;
+    }
+
+    /**
+     * Returns a float read from a quantized value.
+     *
+     * This is the counterpart of {@link BitSerializer#writeQuantized}, and the
+     * range and bit width must match the ones used when writing. The method
+     * advances the read position.
+     *
+     * @param min   The minimum value of the range
+     * @param max   The maximum value of the range
+     * @param bits  The number of bits to read (2 to 32)
+     *
+     * @return a float read from a quantized value.
+     */
+    float readQuantized(float min, float max, Uint8 bits) {
+        return dequantize(readBits(bits), min, max, bits);
+    }
+
+    /**
+     * Returns true if every loaded bit has been read.
+     *
+     * Note that trailing padding bits count as unread data.
+     *
+     * @return true if every loaded bit has been read.
+     */
+    bool isEmpty() const {
+        return _pos >= _data.size()*8;
+    }
+
+    /**
+     * Resets the deserializer and clears the loaded byte vector.
+     */
+    void reset() {
+        _pos = 0;
+        _data.clear();
+    }
+};
+
+        }
+    }
+}
+
+#endif /* __CU_BIT_DESERIALIZER_H__ */
@@ -0,0 +1,257 @@
+//
+//  CUBitSerializer.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a bit-level serializer for networked physics. Like
+//  the lightweight serializer, it relies on the user to know the type of the
+//  data. However, values are packed with an explicit bit width instead of a
+//  whole number of bytes, which makes it suitable for quantized snapshots.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_BIT_SERIALIZER_H__
+#define __CU_BIT_SERIALIZER_H__
+
+#include <SDL_stdinc.h>
+#include <vector>
+#include <memory>
+#include <cmath>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A bit-level serializer for networked physics.
+ *
+ * This class is the compact counterpart of {@link LWSerializer}. Every value
+ * is written with an explicit bit width, and values are packed back to back
+ * with no byte alignment. Bits are written most significant first. The final
+ * byte is padded with zeros when the data is serialized.
+ *
+ * This class is to be paired with {@link BitDeserializer} for deserialization.
+ */
+class BitSerializer{
+private:
+    /** The buffered serialized data (whole bytes only) */
+    std::vector<std::byte> _data;
+    /** The pending bits that do not yet form a whole byte */
+    Uint64 _scratch;
+    /** The number of pending bits in the scratch word */
+    Uint8 _bits;
+
+public:
+    /**
+     * Creates a new BitSerializer on the stack.
+     *
+     * Serializers do not have any nontrivial state and so it is unnecessary
+     * to use an init method. However, we do include a static {@link #alloc}
+     * method for creating shared pointers.
+     */
+    BitSerializer() : _scratch(0), _bits(0) {}
+
+    /**
+     * Returns a newly allocated BitSerializer.
+     *
+     * This method is solely include for convenience purposes.
+     *
+     * @return a newly allocated BitSerializer.
+     */
+    static std::shared_ptr<BitSerializer> alloc() {
+        return std::make_shared<BitSerializer>();
+    }
+
+    /**
+     * Returns the quantized value of a float in the given range.
+     *
+     * The value is clamped to the range [min,max], which is then divided into
+     * an even number of intervals. Hence the midpoint of the range (such as
+     * 0 for a symmetric range) is represented exactly. The result fits in the
+     * given number of bits.
+     *
+     * @param value The value to quantize
+     * @param min   The minimum value of the range
+     * @param max   The maximum value of the range
+     * @param bits  The number of bits in the result (2 to 32)
+     *
+     * @return the quantized value of a float in the given range.
+     */
+    static Uint32 quantize(float value, float min, float max, Uint8 bits) {
+        if (max <= min) {
+            return 0;
+        }
+        double steps = (double)((((Uint64)1) << bits) - 2);
+        double t = ((double)value-min)/((double)max-min);
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+        return (Uint32)std::llround(t*steps);
+    }
+
+    /**
+     * Writes the lowest bits of an unsigned int to the buffer.
+     *
+     * Values will be deserialized on other machines in the same order they were
+     * written in.
+     *
+     * @param value The value to write
+     * @param bits  The number of bits to write (at most 32)
+     */
+    void writeBits(Uint32 value, Uint8 bits) {
+        if (bits == 0) {
+            return;
+        }
+        Uint64 mask = (((Uint64)1) << bits) - 1;
+        _scratch = (_scratch << bits) | (value & mask);
+        _bits += bits;
+        while (_bits >= 8) {
+            _bits -= 8;
+            _data.push_back(std::byte((_scratch >> _bits) & 0xff));
+        }
+    }
+
+    /**
+     * Writes a single boolean value to the buffer.
+     *
+     * A boolean costs exactly one bit. Values will be deserialized on other
+     * machines in the same order they were written in.
+     *
+     * @param b The value to write
+     */
+    void writeBool(bool b) {
+        writeBits(b ? 1 : 0, 1);
+    }
+
+    /**
+     * Writes a variable length unsigned int to the buffer.
+     *
+     * The value is written in groups of the given number of bits, least
+     * significant first, with each group preceded by a continuation bit. Small
+     * values therefore cost only a single group. Values will be deserialized on
+     * other machines in the same order they were written in.
+     *
+     * @param value The value to write
+     * @param group The number of value bits in each group
+     */
+    void writeVarUint(Uint64 value, Uint8 group=7) {
+        Uint64 mask = (((Uint64)1) << group) - 1;
+        do {
+            Uint64 chunk = value & mask;
+            value >>= group;
+            writeBool(value != 0);
+            writeBits((Uint32)chunk, group);
+        } while (value != 0);
+    }
+
+    /**
+     * Writes a float quantized to the given range and bit width.
+     *
+     * See {@link #quantize} for the details of the quantization. Values will
+     * be deserialized on other machines in the same order they were written in.
+     *
+     * @param value The value to write
+     * @param min   The minimum value of the range
+     * @param max   The maximum value of the range
+     * @param bits  The number of bits to write (2 to 32)
+     */
+    void writeQuantized(float value, float min, float max, Uint8 bits) {
+        writeBits(quantize(value, min, max, bits), bits);
+    }
+
+    /**
+     * Returns the number of bits written so far.
+     *
+     * @return the number of bits written so far.
+     */
+    size_t bitSize() const {
+        return _data.size()*8+_bits;
+    }
+
+    /**
+     * Pads the buffer with zeros up to the next byte boundary.
+     *
+     * Once aligned, {@link #bytes} holds every bit written so far.
+     */
+    void align() {
+        if (_bits > 0) {
+            writeBits(0, 8-_bits);
+        }
+    }
+    
+    /**
+     * Returns a reference to the whole bytes written so far.
+     *
+     * This is a non-copying alternative to {@link #serialize}. Any pending
+     * bits that do not form a whole byte are not included, so call
+     * {@link #align} first. The reference is invalidated by further writes.
+     *
+     * @return a reference to the whole bytes written so far.
+     */
+    const std::vector<std::byte>& bytes() const {
+        return _data;
+    }
+
+    /**
+     * Returns the serialized data.
+     *
+     * Any trailing partial byte is padded with zeros. The serializer is not
+     * modified, so it is safe to continue writing afterwards.
+     *
+     * @return the serialized data.
+     */
+    std::vector<std::byte> serialize() const {
+        std::vector<std::byte> result = _data;
+        if (_bits > 0) {
+            result.push_back(std::byte((_scratch << (8-_bits)) & 0xff));
+        }
+        return result;
+    }
+
+    /**
+     * Clears the input buffer.
+     */
+    void reset() {
+        _data.clear();
+        _scratch = 0;
+        _bits = 0;
+    }
+};
+
+        }
+    }
+}
+
+#endif /* __CU_BIT_SERIALIZER_H__ */
@@ -32,6 +32,7 @@
 
 #include <cugl/physics2/net/CUNetEvent.h>
 #include <cugl/util/CUDebug.h>
+#include <cugl/math/CURect.h>
 namespace cugl {
     /**
      * The classes to represent 2-d physics.
@@ -72,7 +73,19 @@ public:
         /** Pausing the game */
         GAME_PAUSE = 104, // Not used
         /** Resuming the game */
-        GAME_RESUME = 105 // Not used
+        GAME_RESUME = 105, // Not used
+        /** Acknowledging a compact physics snapshot */
+        SYNC_ACK = 106,
+        /** Announcing the interest region of a peer */
+        INTEREST = 107,
+        /** Announcing that a peer predicts an obstacle locally */
+        PREDICT = 108,
+        /** The authoritative state of a predicted obstacle */
+        PREDICT_STATE = 109,
+        /** Requesting a clock sample from the host */
+        CLOCK_PING = 110,
+        /** Replying to a clock sample request */
+        CLOCK_PONG = 111
     };
     
 protected:
@@ -80,13 +93,32 @@ protected:
     EventType _type;
     /** The shortUID of the associated physics world */
     Uint32 _shortUID;
+    /** The acknowledged snapshot sequence number */
+    Uint32 _sequence;
+    /** The obstacle at the center of the interest region (0 for none) */
+    Uint64 _obsId;
+    /** The interest region (only the size is used if centered on an obstacle) */
+    Rect _region;
+    /** The last input tick applied to the authoritative state */
+    Uint64 _tick;
+    /** The authoritative position of a predicted obstacle */
+    Vec2 _position;
+    /** The authoritative linear velocity of a predicted obstacle */
+    Vec2 _velocity;
+    /** The time the clock ping was sent (sender clock, in microseconds) */
+    Uint64 _pingTime;
+    /** The time the clock ping was received (host clock, in microseconds) */
+    Uint64 _receiveTime;
+    /** The time the clock pong was sent (host clock, in microseconds) */
+    Uint64 _replyTime;
     
 #pragma mark Constructors
 public:
     /**
      *  Constructs an event with default values.
      */
-    GameStateEvent() : _shortUID(0) {
+    GameStateEvent() : _shortUID(0), _sequence(0), _obsId(0), _tick(0),
+    _pingTime(0), _receiveTime(0), _replyTime(0) {
         _type = EventType::GAME_START;
     }
     
@@ -95,7 +127,8 @@ public:
      *
      *  @param t The type of the event
      */
-    GameStateEvent(EventType t) : _shortUID(0) {
+    GameStateEvent(EventType t) : _shortUID(0), _sequence(0), _obsId(0), _tick(0),
+    _pingTime(0), _receiveTime(0), _replyTime(0) {
         _type = t;
     }
 
@@ -130,11 +163,18 @@ public:
     /**
      * Returns a newly allocated event for broadcasting the game start
      *
+     * The start tick is the host fixed update count at which the game starts.
+     * Combined with clock synchronization, it allows every peer to agree on
+     * the current game tick, regardless of when it received this event.
+     *
+     * @param start The host fixed update count at game start
+     *
      * @return a newly allocated event for broadcasting the game start
      */
-    static std::shared_ptr<NetEvent> allocGameStart() {
+    static std::shared_ptr<NetEvent> allocGameStart(Uint64 start) {
         std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
         ptr->setType(EventType::GAME_START);
+        ptr->_tick = start;
         return ptr;
     }
     
@@ -164,6 +204,118 @@ public:
         return ptr;
     }
     
+    /**
+     * Returns a newly allocated event for acknowledging a physics snapshot
+     *
+     * Compact {@link PhysSyncEvent}s are delta encoded against the last
+     * snapshot acknowledged by every peer. This event is broadcast, and only
+     * the physics world with the given shortUID acts upon it.
+     *
+     * @param sid   The shortUID of the physics world that sent the snapshot
+     * @param seq   The sequence number of the snapshot
+     */
+    static std::shared_ptr<NetEvent> allocSyncAck(Uint32 sid, Uint32 seq) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::SYNC_ACK);
+        ptr->_shortUID = sid;
+        ptr->_sequence = seq;
+        return ptr;
+    }
+    
+    /**
+     * Returns a newly allocated event for announcing an interest region
+     *
+     * Peers use the interest region to decide which obstacles to synchronize
+     * with this machine at full rate. If the obstacle id is nonzero, the
+     * region is centered on that obstacle, and only its size is used. An
+     * empty region clears the interest, so that everything is synchronized.
+     *
+     * @param obsId     The obstacle at the center of the region (0 for none)
+     * @param region    The interest region
+     */
+    static std::shared_ptr<NetEvent> allocInterest(Uint64 obsId, const Rect region) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::INTEREST);
+        ptr->_obsId = obsId;
+        ptr->_region = region;
+        return ptr;
+    }
+    
+    /**
+     * Returns a newly allocated event for announcing a predicted obstacle
+     *
+     * A peer that predicts an obstacle moves it locally from its own input,
+     * but leaves the host authoritative. The host replies to this event with
+     * a stream of {@link EventType#PREDICT_STATE} events for the obstacle.
+     *
+     * @param obsId     The predicted obstacle
+     */
+    static std::shared_ptr<NetEvent> allocPredict(Uint64 obsId) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::PREDICT);
+        ptr->_obsId = obsId;
+        return ptr;
+    }
+    
+    /**
+     * Returns a newly allocated event for the state of a predicted obstacle
+     *
+     * This is the authoritative state of the obstacle after applying every
+     * input of the predicting peer up to (and including) the given tick.
+     *
+     * @param obsId     The predicted obstacle
+     * @param tick      The last input tick applied to the state
+     * @param pos       The authoritative position
+     * @param vel       The authoritative linear velocity
+     */
+    static std::shared_ptr<NetEvent> allocPredictState(Uint64 obsId, Uint64 tick,
+                                                       const Vec2 pos, const Vec2 vel) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::PREDICT_STATE);
+        ptr->_obsId = obsId;
+        ptr->_tick = tick;
+        ptr->_position = pos;
+        ptr->_velocity = vel;
+        return ptr;
+    }
+    
+    /**
+     * Returns a newly allocated event for requesting a clock sample
+     *
+     * This event is sent to the host only. The host replies with a
+     * {@link EventType#CLOCK_PONG} event.
+     *
+     * @param sent  The time the ping is sent (in local microseconds)
+     */
+    static std::shared_ptr<NetEvent> allocClockPing(Uint64 sent) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::CLOCK_PING);
+        ptr->_pingTime = sent;
+        return ptr;
+    }
+    
+    /**
+     * Returns a newly allocated event for replying to a clock sample request
+     *
+     * This event is sent only to the peer that sent the ping. The tick is
+     * the host fixed update count at the time of the reply.
+     *
+     * @param sent      The time the ping was sent (in pinging peer microseconds)
+     * @param received  The time the ping was received (in host microseconds)
+     * @param replied   The time the reply is sent (in host microseconds)
+     * @param tick      The host fixed update count when the reply is sent
+     */
+    static std::shared_ptr<NetEvent> allocClockPong(Uint64 sent, Uint64 received,
+                                                    Uint64 replied, Uint64 tick) {
+        std::shared_ptr<GameStateEvent> ptr = std::make_shared<GameStateEvent>();
+        ptr->setType(EventType::CLOCK_PONG);
+        ptr->_pingTime = sent;
+        ptr->_receiveTime = received;
+        ptr->_replyTime = replied;
+        ptr->_tick = tick;
+        return ptr;
+    }
+    
 #pragma mark Event Attributes
     /**
      * Returns the event type
@@ -186,15 +338,129 @@ public:
     /**
      * Returns the shortUID of the event
      *
-     * If the event is not {@link EventType#UID_ASSIGN}, this method returns 0.
-     * Valid shortUIDs are guaranteed to be greater than 0.
+     * If the event is not {@link EventType#UID_ASSIGN} or
+     * {@link EventType#SYNC_ACK}, this method returns 0. Valid shortUIDs are
+     * guaranteed to be greater than 0.
      *
      * @return the shortUID of the event
      */
-    Uint8 getShortUID() const {
+    Uint32 getShortUID() const {
         return _shortUID;
     }
     
+    /**
+     * Returns the acknowledged snapshot sequence number
+     *
+     * If the event is not {@link EventType#SYNC_ACK}, this method returns 0.
+     *
+     * @return the acknowledged snapshot sequence number
+     */
+    Uint32 getSequence() const {
+        return _sequence;
+    }
+    
+    /**
+     * Returns the obstacle associated with this event
+     *
+     * This is the obstacle at the center of an {@link EventType#INTEREST}
+     * region, or the obstacle of a {@link EventType#PREDICT} or
+     * {@link EventType#PREDICT_STATE} event. Otherwise, or if the interest
+     * region is not centered on an obstacle, this method returns 0.
+     *
+     * @return the obstacle associated with this event
+     */
+    Uint64 getObstacleId() const {
+        return _obsId;
+    }
+    
+    /**
+     * Returns the interest region
+     *
+     * If the event is not {@link EventType#INTEREST}, this method returns an
+     * empty rectangle.
+     *
+     * @return the interest region
+     */
+    const Rect& getRegion() const {
+        return _region;
+    }
+    
+    /**
+     * Returns the tick associated with this event
+     *
+     * This is the last input tick applied to the authoritative state of a
+     * {@link EventType#PREDICT_STATE} event, the host fixed update count at
+     * the start of a {@link EventType#GAME_START} event, or the host fixed
+     * update count at the reply of a {@link EventType#CLOCK_PONG} event.
+     * Otherwise, this method returns 0.
+     *
+     * @return the tick associated with this event
+     */
+    Uint64 getTick() const {
+        return _tick;
+    }
+    
+    /**
+     * Returns the authoritative position of a predicted obstacle
+     *
+     * If the event is not {@link EventType#PREDICT_STATE}, this method
+     * returns the origin.
+     *
+     * @return the authoritative position of a predicted obstacle
+     */
+    const Vec2& getPosition() const {
+        return _position;
+    }
+    
+    /**
+     * Returns the authoritative linear velocity of a predicted obstacle
+     *
+     * If the event is not {@link EventType#PREDICT_STATE}, this method
+     * returns the zero vector.
+     *
+     * @return the authoritative linear velocity of a predicted obstacle
+     */
+    const Vec2& getVelocity() const {
+        return _velocity;
+    }
+    
+    /**
+     * Returns the time the clock ping was sent
+     *
+     * This time is in microseconds on the clock of the pinging peer. If the
+     * event is not {@link EventType#CLOCK_PING} or {@link EventType#CLOCK_PONG},
+     * this method returns 0.
+     *
+     * @return the time the clock ping was sent
+     */
+    Uint64 getPingTime() const {
+        return _pingTime;
+    }
+    
+    /**
+     * Returns the time the clock ping was received
+     *
+     * This time is in microseconds on the host clock. If the event is not
+     * {@link EventType#CLOCK_PONG}, this method returns 0.
+     *
+     * @return the time the clock ping was received
+     */
+    Uint64 getReceiveTime() const {
+        return _receiveTime;
+    }
+    
+    /**
+     * Returns the time the clock pong was sent
+     *
+     * This time is in microseconds on the host clock. If the event is not
+     * {@link EventType#CLOCK_PONG}, this method returns 0.
+     *
+     * @return the time the clock pong was sent
+     */
+    Uint64 getReplyTime() const {
+        return _replyTime;
+    }
+    
 #pragma mark Serialization/Deserialization 
     /**
      * Returns a byte vector serializing this event
@@ -210,6 +476,27 @@ public:
      */
     void deserialize(const std::vector<std::byte>& data) override;
     
+    /**
+     * Writes this event to the end of the given serializer.
+     *
+     * The output is the same as {@link #serialize()}, but no intermediate
+     * byte vector is allocated.
+     *
+     * @param out   The serializer to write to
+     */
+    void serializeTo(LWSerializer& out) override;
+    
+    /**
+     * Deserializes this event from a span of bytes.
+     *
+     * The bytes are read in place and are not retained. This method will set
+     * the type of the event and all relevant fields.
+     *
+     * @param data  The bytes to deserialize
+     * @param size  The number of bytes
+     */
+    void deserializeFrom(const std::byte* data, size_t size) override;
+    
 };
         }
     }
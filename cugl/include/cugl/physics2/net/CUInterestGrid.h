@@ -0,0 +1,206 @@
+//
+//  CUInterestGrid.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a uniform spatial grid over a networked physics world.
+//  It is used by the physics controller for interest management, so that each
+//  peer is only sent frequent updates for the obstacles near it.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_INTEREST_GRID_H__
+#define __CU_INTEREST_GRID_H__
+
+#include <cugl/math/CURect.h>
+#include <SDL_stdinc.h>
+#include <vector>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A uniform spatial grid of obstacle ids.
+ *
+ * The grid divides the bounds of the world into square cells, and buckets
+ * each obstacle id by its position. Positions outside of the bounds are
+ * clamped to the nearest cell. A query returns every id in a cell that
+ * overlaps the query region, so the results also include obstacles that are
+ * near (within one cell of) the region.
+ *
+ * The grid does not track obstacle movement. It is meant to be cleared and
+ * refilled whenever it is used.
+ */
+class InterestGrid {
+protected:
+    /** The bounds covered by this grid */
+    Rect _bounds;
+    /** The width and height of each cell */
+    float _cellSize;
+    /** The number of columns in the grid */
+    int _cols;
+    /** The number of rows in the grid */
+    int _rows;
+    /** The obstacle ids in each cell, in row-major order */
+    std::vector<std::vector<Uint64>> _cells;
+    
+    /**
+     * Returns the column containing the given x-coordinate.
+     *
+     * @param x The x-coordinate
+     *
+     * @return the column containing the given x-coordinate.
+     */
+    int getColumn(float x) const;
+    
+    /**
+     * Returns the row containing the given y-coordinate.
+     *
+     * @param y The y-coordinate
+     *
+     * @return the row containing the given y-coordinate.
+     */
+    int getRow(float y) const;
+    
+#pragma mark Constructors
+public:
+    /**
+     * Creates a degenerate grid with no cells.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     */
+    InterestGrid();
+    
+    /**
+     * Deletes this grid, disposing of all resources.
+     */
+    ~InterestGrid() { dispose(); }
+    
+    /**
+     * Disposes the grid, releasing all resources.
+     *
+     * This grid can be safely reinitialized
+     */
+    void dispose();
+    
+    /**
+     * Initializes a grid over the given bounds.
+     *
+     * @param bounds    The bounds to cover (typically the world bounds)
+     * @param cellSize  The width and height of each cell
+     *
+     * @return true if the grid was initialized successfully
+     */
+    bool init(const Rect bounds, float cellSize);
+    
+    /**
+     * Returns a newly allocated grid over the given bounds.
+     *
+     * @param bounds    The bounds to cover (typically the world bounds)
+     * @param cellSize  The width and height of each cell
+     *
+     * @return a newly allocated grid over the given bounds.
+     */
+    static std::shared_ptr<InterestGrid> alloc(const Rect bounds, float cellSize) {
+        std::shared_ptr<InterestGrid> result = std::make_shared<InterestGrid>();
+        return (result->init(bounds,cellSize) ? result : nullptr);
+    }
+    
+#pragma mark Attributes
+    /**
+     * Returns the bounds covered by this grid.
+     *
+     * @return the bounds covered by this grid.
+     */
+    const Rect& getBounds() const { return _bounds; }
+    
+    /**
+     * Returns the width and height of each cell.
+     *
+     * @return the width and height of each cell.
+     */
+    float getCellSize() const { return _cellSize; }
+    
+#pragma mark Queries
+    /**
+     * Removes all obstacle ids from the grid.
+     *
+     * The cells keep their capacity, so refilling the grid every frame does
+     * not reallocate memory.
+     */
+    void clear();
+    
+    /**
+     * Adds an obstacle id at the given position.
+     *
+     * @param id    The obstacle id
+     * @param pos   The obstacle position
+     */
+    void insert(Uint64 id, const Vec2 pos);
+    
+    /**
+     * Appends the ids of all obstacles in or near the given region.
+     *
+     * This method appends every id in a cell that overlaps the region. The
+     * ids are not sorted, but each id appears at most once (provided it was
+     * only inserted once).
+     *
+     * @param region    The region to query
+     * @param result    The vector to append the ids to
+     */
+    void query(const Rect region, std::vector<Uint64>& result) const;
+};
+
+        }
+    }
+}
+
+#endif /* __CU_INTEREST_GRID_H__ */
@@ -32,7 +32,11 @@
 #ifndef __CU_LW_DESERIALIZER_H__
 #define __CU_LW_DESERIALIZER_H__
 
+#include <cugl/base/CUEndian.h>
 #include <vector>
+#include <memory>
+#include <cstring>
+#include <algorithm>
 #include <SDL_stdinc.h>
 
 namespace cugl {
@@ -65,11 +69,39 @@ namespace cugl {
  */
 class LWDeserializer{
 private:
+    /** The copy of the loaded data (if it was loaded by copy) */
+    std::vector<std::byte> _owned;
     /** Currently loaded data */
-    std::vector<std::byte> _data;
+    const std::byte* _data;
+    /** The number of bytes of loaded data */
+    size_t _size;
     /** Position in the data of next byte to read */
     size_t _pos;
     
+    /**
+     * Reads an array of values in network order.
+     *
+     * If there are fewer than count values remaining, the missing values
+     * are set to 0.
+     *
+     * @param values    The array to store the values
+     * @param count     The number of values
+     */
+    template <typename T>
+    void readArray(T* values, size_t count) {
+        for (size_t ii = 0; ii < count; ii++) {
+            if (_pos+sizeof(T) > _size) {
+                values[ii] = 0;
+                continue;
+            }
+            decltype(marshall(T())) value;
+            static_assert(sizeof(value) == sizeof(T), "Unsupported type");
+            std::memcpy(&value, _data+_pos, sizeof(T));
+            values[ii] = (T)marshall(value);
+            _pos += sizeof(T);
+        }
+    }
+    
 public:
     /**
      * Creates a new Deserializer on the stack.
@@ -78,7 +110,38 @@ public:
      * to use an init method. However, we do include a static {@link #alloc}
      * method for creating shared pointers.
      */
-    LWDeserializer() : _pos(0) {}
+    LWDeserializer() : _data(nullptr), _size(0), _pos(0) {}
+    
+    /**
+     * Creates a copy of the given deserializer.
+     *
+     * If the deserializer owns its data, the copy has its own copy of the
+     * data. Otherwise, the copy refers to the same data.
+     *
+     * @param other The deserializer to copy
+     */
+    LWDeserializer(const LWDeserializer& other) {
+        *this = other;
+    }
+    
+    /**
+     * Assigns this deserializer to be a copy of the given one.
+     *
+     * If the deserializer owns its data, this deserializer gets its own copy
+     * of the data. Otherwise, it refers to the same data.
+     *
+     * @param other The deserializer to copy
+     *
+     * @return a reference to this deserializer
+     */
+    LWDeserializer& operator=(const LWDeserializer& other) {
+        bool owns = !other._owned.empty() && other._data == other._owned.data();
+        _owned = owns ? other._owned : std::vector<std::byte>();
+        _data = owns ? _owned.data() : other._data;
+        _size = other._size;
+        _pos = other._pos;
+        return *this;
+    }
     
     /**
      * Returns a newly allocated LWDeserializer.
@@ -105,7 +168,27 @@ public:
      * @param msg The byte vector serialized by {@link LWSerializer}
      */
     void receive(const std::vector<std::byte>& msg){
-        _data = msg;
+        _owned = msg;
+        _data = _owned.data();
+        _size = _owned.size();
+        _pos = 0;
+    }
+    
+    /**
+     * Loads a new message to be read, without copying it.
+     *
+     * This is the same as {@link #receive(const std::vector<std::byte>&)},
+     * except that the deserializer only refers to the data. The data must
+     * remain valid (and unchanged) until this deserializer is reset or
+     * another message is loaded.
+     *
+     * @param data  The bytes serialized by {@link LWSerializer}
+     * @param size  The number of bytes
+     */
+    void receive(const std::byte* data, size_t size) {
+        _owned.clear();
+        _data = data;
+        _size = data ? size : 0;
         _pos = 0;
     }
     
@@ -118,7 +201,7 @@ public:
      * @return a boolean read from the loaded byte vector.
      */
     bool readBool(){
-        if (_pos >= _data.size()) {
+        if (_pos >= _size) {
             return false;
         }
         uint8_t value = static_cast<uint8_t>(_data[_pos++]);
@@ -134,7 +217,7 @@ public:
      * @return a byte from the loaded byte vector.
      */
     std::byte readByte(){
-        if (_pos >= _data.size()) {
+        if (_pos >= _size) {
             return std::byte(0);
         }
         const std::byte b = _data[_pos++];
@@ -150,12 +233,9 @@ public:
      * @return a float from the loaded byte vector.
      */
     float readFloat(){
-        if (_pos >= _data.size()) {
-            return 0.0f;
-        }
-        const float* r = reinterpret_cast<const float*>(_data.data() + _pos);
-        _pos += sizeof(float);
-        return marshall(*r);
+        float result;
+        readArray(&result, 1);
+        return result;
     }
     
     /**
@@ -167,12 +247,9 @@ public:
      * @return a signed (32 bit) int from the loaded byte vector.
      */
     Sint32 readSint32(){
-        if (_pos >= _data.size()) {
-            return 0;
-        }
-        const Sint32* r = reinterpret_cast<const Sint32*>(_data.data() + _pos);
-        _pos += sizeof(Sint32);
-        return marshall(*r);
+        Sint32 result;
+        readArray(&result, 1);
+        return result;
     }
     
     /**
@@ -184,12 +261,9 @@ public:
      * @return an unsigned short from the loaded byte vector.
      */
     Uint16 readUint16(){
-        if (_pos >= _data.size()) {
-            return 0;
-        }
-        const Uint16* r = reinterpret_cast<const Uint16*>(_data.data() + _pos);
-        _pos += sizeof(Uint16);
-        return marshall(*r);
+        Uint16 result;
+        readArray(&result, 1);
+        return result;
     }
     
     /**
@@ -201,12 +275,9 @@ public:
      * @return an unsigned (32 bit) int from the loaded byte vector.
      */
     Uint32 readUint32(){
-        if (_pos >= _data.size()) {
-            return 0;
-        }
-        const Uint32* r = reinterpret_cast<const Uint32*>(_data.data() + _pos);
-        _pos += sizeof(Uint32);
-        return marshall(*r);
+        Uint32 result;
+        readArray(&result, 1);
+        return result;
     }
     
     /**
@@ -218,20 +289,85 @@ public:
      * @return an unsigned (64 bit) long from the loaded byte vector.
      */
     Uint64 readUint64(){
-        if (_pos >= _data.size()) {
-            return 0;
+        Uint64 result;
+        readArray(&result, 1);
+        return result;
+    }
+    
+    /**
+     * Reads an array of floats from the loaded byte vector.
+     *
+     * This is the counterpart of {@link LWSerializer#writeFloats}. The method
+     * advances the read position. If there are fewer floats available than
+     * requested, the missing values are set to 0.
+     *
+     * @param values    The array to store the floats
+     * @param count     The number of floats
+     */
+    void readFloats(float* values, size_t count) {
+        readArray(values, count);
+    }
+    
+    /**
+     * Returns a byte vector of the given length from the loaded byte vector.
+     *
+     * This is the counterpart of {@link LWSerializer#writeByteVector}. As the
+     * written vector carries no length, it is up to the user to know it. The
+     * method advances the read position. If there is less data available than
+     * requested, this method will return only the remaining bytes.
+     *
+     * @param length    The number of bytes to read
+     *
+     * @return a byte vector of the given length from the loaded byte vector.
+     */
+    std::vector<std::byte> readByteVector(size_t length) {
+        size_t end = std::min(_pos+length, _size);
+        if (_pos >= end) {
+            return std::vector<std::byte>();
+        }
+        std::vector<std::byte> result(_data+_pos, _data+end);
+        _pos = end;
+        return result;
+    }
+    
+    /**
+     * Returns a pointer to the next bytes of the loaded byte vector.
+     *
+     * This is a non-copying alternative to {@link #readByteVector}. The
+     * pointer is only valid as long as the loaded data. The method advances
+     * the read position. If there is less data available than requested,
+     * this method will return nullptr and not advance.
+     *
+     * @param length    The number of bytes to read
+     *
+     * @return a pointer to the next bytes of the loaded byte vector.
+     */
+    const std::byte* readBytes(size_t length) {
+        if (_pos+length > _size) {
+            return nullptr;
         }
-        const Uint64* r = reinterpret_cast<const Uint64*>(_data.data() + _pos);
-        _pos += sizeof(Uint64);
-        return marshall(*r);
+        const std::byte* result = _data+_pos;
+        _pos += length;
+        return result;
     }
     
+    /**
+     * Returns the number of bytes that have not been read.
+     *
+     * @return the number of bytes that have not been read.
+     */
+    size_t remaining() const {
+        return _pos < _size ? _size-_pos : 0;
+    }
+
     /**
      * Resets the deserializer and clears the loaded byte vector.
      */
     void reset(){
         _pos = 0;
-        _data.clear();
+        _size = 0;
+        _data = nullptr;
+        _owned.clear();
     }
     
 };
@@ -36,6 +36,7 @@
 #include <SDL_stdinc.h>
 #include <vector>
 #include <memory>
+#include <cstring>
 
 namespace cugl {
     /**
@@ -70,6 +71,26 @@ private:
     /** The buffered serialized data */
     std::vector<std::byte> _data;
     
+    /**
+     * Writes an array of values in network order.
+     *
+     * The buffer is grown once, and each value is converted as it is copied.
+     *
+     * @param values    The values to write
+     * @param count     The number of values
+     */
+    template <typename T>
+    void writeArray(const T* values, size_t count) {
+        size_t pos = _data.size();
+        _data.resize(pos+count*sizeof(T));
+        std::byte* dst = _data.data()+pos;
+        for (size_t ii = 0; ii < count; ii++) {
+            auto value = marshall(values[ii]);
+            static_assert(sizeof(value) == sizeof(T), "Unsupported type");
+            std::memcpy(dst+ii*sizeof(T), &value, sizeof(T));
+        }
+    }
+    
 public:
     /**
      * Creates a new LWSerializer on the stack.
@@ -124,11 +145,7 @@ public:
      * @param f The float to write
      */
     void writeFloat(float f) {
-        float ii = marshall(f);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(float); j++) {
-            _data.push_back(bytes[j]);
-        }
+        writeArray(&f, 1);
     }
     
     /**
@@ -140,11 +157,7 @@ public:
      * @param i The Sint32 to write
      */
     void writeSint32(Sint32 i){
-        Sint32 ii = marshall(i);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(Sint32); j++) {
-            _data.push_back(bytes[j]);
-        }
+        writeArray(&i, 1);
     }
     
     /**
@@ -156,11 +169,7 @@ public:
      * @param i The Uint16 to write
      */
     void writeUint16(Uint16 i){
-        Uint16 ii = marshall(i);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(Uint16); j++) {
-            _data.push_back(bytes[j]);
-        }
+        writeArray(&i, 1);
     }
     
     /**
@@ -172,11 +181,7 @@ public:
      * @param i the unsigned Uint32 to write
      */
     void writeUint32(Uint32 i){
-        Uint32 ii = marshall(i);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(Uint32); j++) {
-            _data.push_back(bytes[j]);
-        }
+        writeArray(&i, 1);
     }
     
     /**
@@ -188,11 +193,21 @@ public:
      * @param i the unsigned Uint64 to write
      */
     void writeUint64(Uint64 i){
-        Uint64 ii = marshall(i);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(Uint64); j++) {
-            _data.push_back(bytes[j]);
-        }
+        writeArray(&i, 1);
+    }
+    
+    /**
+     * Writes an array of floats to the input buffer.
+     *
+     * The buffer is grown once, and the values are converted to network
+     * order in a single pass. This is the counterpart of
+     * {@link LWDeserializer#readFloats}, and carries no length.
+     *
+     * @param values    The floats to write
+     * @param count     The number of floats
+     */
+    void writeFloats(const float* values, size_t count) {
+        writeArray(values, count);
     }
     
     /**
@@ -204,7 +219,25 @@ public:
      * @param v The byte vector to write
      */
     void writeByteVector(const std::vector<std::byte>& v){
-        _data.insert(_data.end(), v.begin(), v.end());
+        writeBytes(v.data(), v.size());
+    }
+    
+    /**
+     * Writes a block of raw bytes to the buffer.
+     *
+     * The bytes are copied as is. Values will be deserialized on other machines
+     * in the same order they were written in.
+     *
+     * @param bytes     The bytes to write
+     * @param length    The number of bytes
+     */
+    void writeBytes(const std::byte* bytes, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        size_t pos = _data.size();
+        _data.resize(pos+length);
+        std::memcpy(_data.data()+pos, bytes, length);
     }
     
     /**
@@ -217,10 +250,52 @@ public:
      * @param i The new header
      */
     void rewriteFirstUint32(Uint32 i) {
+        rewriteUint32(0, i);
+    }
+    
+    /**
+     * Rewrites four bytes of the buffer at the given position.
+     *
+     * This method requires that the input buffer has at least four bytes
+     * after the position. It can be used to fill in a length once the data
+     * that follows it has been written.
+     *
+     * @param pos   The position in the buffer
+     * @param i     The new value
+     */
+    void rewriteUint32(size_t pos, Uint32 i) {
         Uint32 ii = marshall(i);
-        const std::byte* bytes = reinterpret_cast<const std::byte*>(&ii);
-        for (size_t j = 0; j < sizeof(Uint32); j++) {
-            _data[j] = bytes[j];
+        std::memcpy(_data.data()+pos, &ii, sizeof(Uint32));
+    }
+    
+    /**
+     * Returns the number of bytes written so far.
+     *
+     * @return the number of bytes written so far.
+     */
+    size_t size() const {
+        return _data.size();
+    }
+    
+    /**
+     * Reserves space for the given number of bytes.
+     *
+     * @param capacity  The number of bytes to reserve
+     */
+    void reserve(size_t capacity) {
+        _data.reserve(capacity);
+    }
+    
+    /**
+     * Discards every byte after the given size.
+     *
+     * This has no effect if the buffer is not larger than the given size.
+     *
+     * @param size  The number of bytes to keep
+     */
+    void truncate(size_t size) {
+        if (size < _data.size()) {
+            _data.resize(size);
         }
     }
     
@@ -236,7 +311,8 @@ public:
     /**
      * Clears the input buffer.
      *
-     * Note that this will make previous serialize() returns invalid.
+     * The allocated capacity is kept, so a serializer can be reused without
+     * allocating. Note that this will make previous serialize() returns invalid.
      */
     void reset() {
         _data.clear();
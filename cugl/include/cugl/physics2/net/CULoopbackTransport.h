@@ -0,0 +1,690 @@
+//
+//  CULoopbackTransport.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides an in-process transport for networked physics. It
+//  connects any number of NetEventControllers in a single process, with no
+//  lobby server and no WebRTC. Each link between two peers simulates latency,
+//  jitter, loss, duplication, reordering and a bandwidth cap. All randomness
+//  comes from a seed and time is virtual, so a run can be reproduced exactly.
+//  This makes it possible to measure synchronization quality headlessly.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_LOOPBACK_TRANSPORT_H__
+#define __CU_LOOPBACK_TRANSPORT_H__
+
+#include <cugl/physics2/net/CUNetTransport.h>
+#include <SDL_stdinc.h>
+#include <unordered_map>
+#include <random>
+#include <queue>
+#include <map>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+class LoopbackTransport;
+
+/**
+ * An in-process network connecting several loopback transports.
+ *
+ * This class plays the role of both the lobby server and the internet.
+ * Transports created by {@link #getFactory} (or {@link LoopbackTransport#alloc})
+ * host and join rooms on this network exactly as a
+ * {@link cugl::net::NetcodeConnection} would, except that every connection
+ * succeeds immediately. Every pair of peers is connected directly.
+ *
+ * Each direction of each link has its own {@link LinkConfig}. A message sent
+ * on a link is delayed by the one-way latency plus a random jitter, and is
+ * further delayed by the bandwidth cap if the link is busy. Unreliable
+ * messages may also be lost, duplicated or held back (reordered). Reliable
+ * messages are never lost or reordered. Instead, a lost reliable message is
+ * retransmitted after a round trip, holding back every message behind it.
+ *
+ * Time on this network is virtual. A message is only received once the
+ * network time (see {@link #advance}) reaches its delivery time. All random
+ * choices are drawn from a generator per link, seeded from the network seed
+ * and the link endpoints. Hence, given the same seed and the same sequence
+ * of calls, a run is completely deterministic.
+ *
+ * This class is not thread safe. It is intended to be used from a single
+ * thread, typically with several controllers in one process.
+ */
+class LoopbackNetwork : public std::enable_shared_from_this<LoopbackNetwork> {
+public:
+    /** The distribution of the jitter added to the link latency */
+    enum class Distribution : int {
+        /** Jitter is uniform in [-jitter,jitter] */
+        UNIFORM = 0,
+        /** Jitter is normal, with standard deviation jitter */
+        NORMAL = 1,
+        /** Jitter is exponential, with mean jitter (a long tail of delays) */
+        EXPONENTIAL = 2
+    };
+
+    /**
+     * The simulated conditions of one direction of a link.
+     *
+     * All times are in microseconds, and all probabilities are in [0,1].
+     */
+    class LinkConfig {
+    public:
+        /** The base one-way delay */
+        Uint64 latency;
+        /** The spread of the delay about the latency */
+        Uint64 jitter;
+        /** The distribution of the delay spread */
+        Distribution distribution;
+        /** The probability that a message is lost */
+        float loss;
+        /** The probability that an unreliable message is delivered twice */
+        float duplicate;
+        /** The probability that an unreliable message is held back */
+        float reorder;
+        /** The additional delay of a held back message */
+        Uint64 reorderDelay;
+        /** The link capacity in bytes per second (0 for unlimited) */
+        Uint64 bandwidth;
+        /** The longest an unreliable message may wait for bandwidth (0 for unlimited) */
+        Uint64 queueLimit;
+
+        /** Creates a perfect link with no delay, loss or bandwidth cap */
+        LinkConfig();
+    };
+
+    /**
+     * The statistics for one direction of a link.
+     *
+     * Counts include duplicates, so more messages may be delivered than sent.
+     */
+    class LinkStats {
+    public:
+        /** The number of messages sent */
+        Uint64 sent;
+        /** The number of bytes sent */
+        Uint64 bytes;
+        /** The number of messages received */
+        Uint64 delivered;
+        /** The number of messages lost (or retransmitted, if reliable) */
+        Uint64 lost;
+        /** The number of messages duplicated */
+        Uint64 duplicated;
+        /** The number of messages held back */
+        Uint64 reordered;
+        /** The number of messages dropped waiting for bandwidth */
+        Uint64 dropped;
+        /** The sum of the one-way delays of every message received */
+        Uint64 totalDelay;
+
+        /** Creates a new statistics record with all counts zero */
+        LinkStats();
+    };
+
+private:
+    /** A message in flight */
+    class Packet {
+    public:
+        /** The delivery time */
+        Uint64 time;
+        /** The order the packet was scheduled (to break ties) */
+        Uint64 order;
+        /** The send time */
+        Uint64 sent;
+        /** The UUID of the sender ("" if the sender is the receiver) */
+        std::string source;
+        /** The message */
+        std::shared_ptr<std::vector<std::byte>> message;
+
+        /**
+         * Returns true if this packet is delivered after the other one.
+         *
+         * @param other The packet to compare
+         *
+         * @return true if this packet is delivered after the other one.
+         */
+        bool operator>(const Packet& other) const {
+            return time > other.time || (time == other.time && order > other.order);
+        }
+    };
+
+    /** One direction of a link between two peers */
+    class Link {
+    public:
+        /** The link conditions */
+        LinkConfig config;
+        /** Whether the conditions were set explicitly (not the default) */
+        bool custom;
+        /** The random generator for this link */
+        std::mt19937_64 random;
+        /** The time the link finishes sending its queued bytes */
+        Uint64 busy;
+        /** The delivery time of the last reliable message */
+        Uint64 reliable;
+        /** The link statistics */
+        LinkStats stats;
+    };
+
+    /** A peer on this network */
+    class Endpoint {
+    public:
+        /** The current connection state */
+        NetTransport::State state;
+        /** The room of this peer */
+        std::string room;
+        /** The messages in flight to this peer, by delivery time */
+        std::priority_queue<Packet,std::vector<Packet>,std::greater<Packet>> inbox;
+    };
+
+    /** A game lobby */
+    class Room {
+    public:
+        /** The UUID of the host */
+        std::string host;
+        /** The UUIDs of the active players, in order of joining */
+        std::vector<std::string> players;
+        /** The maximum number of players */
+        size_t capacity;
+        /** Whether the host has started the session */
+        bool started;
+    };
+
+    /** The current network time in microseconds */
+    Uint64 _time;
+    /** The seed for the link generators */
+    Uint64 _seed;
+    /** The number of packets scheduled (to order packets) */
+    Uint64 _order;
+    /** The number of peers created (to assign UUIDs) */
+    Uint64 _peerCount;
+    /** The number of rooms created (to assign room IDs) */
+    Uint64 _roomCount;
+    /** The conditions of every link without explicit conditions */
+    LinkConfig _default;
+    /** The peers of this network, by UUID */
+    std::unordered_map<std::string,Endpoint> _endpoints;
+    /** The rooms of this network, by room ID */
+    std::unordered_map<std::string,Room> _rooms;
+    /** The links of this network, by source and destination UUID */
+    std::map<std::pair<std::string,std::string>,Link> _links;
+
+    /**
+     * Returns the link from source to destination, creating it if necessary.
+     *
+     * @param src   The source UUID
+     * @param dst   The destination UUID
+     *
+     * @return the link from source to destination
+     */
+    Link& acquireLink(const std::string& src, const std::string& dst);
+
+    /**
+     * Returns a uniform random number in [0,1) from the given generator.
+     *
+     * @param random    The generator
+     *
+     * @return a uniform random number in [0,1)
+     */
+    static double uniform(std::mt19937_64& random);
+
+    /**
+     * Returns a random one-way delay for the given link.
+     *
+     * @param link  The link
+     *
+     * @return a random one-way delay for the given link.
+     */
+    Uint64 sampleDelay(Link& link);
+
+    /**
+     * Schedules a message on the link from source to destination.
+     *
+     * @param src       The source UUID
+     * @param dst       The destination UUID
+     * @param message   The message
+     * @param reliable  Whether to use the reliable, ordered channel
+     */
+    void schedule(const std::string& src, const std::string& dst,
+                  const std::shared_ptr<std::vector<std::byte>>& message, bool reliable);
+
+    /**
+     * Delivers a message from a peer to itself.
+     *
+     * @param uuid      The peer UUID
+     * @param message   The message
+     */
+    void deliverSelf(const std::string& uuid, const std::shared_ptr<std::vector<std::byte>>& message);
+
+    /** Allow the transports access to the peer methods */
+    friend class LoopbackTransport;
+
+#pragma mark Peer Methods
+    /**
+     * Returns the UUID of a newly created peer.
+     *
+     * The peer is not in any room and has state INACTIVE.
+     *
+     * @return the UUID of a newly created peer.
+     */
+    std::string createPeer();
+
+    /**
+     * Opens the connection of the given peer.
+     *
+     * If the room is empty, the peer will host a new room. Otherwise it
+     * will join the given room.
+     *
+     * @param uuid      The peer UUID
+     * @param room      The room to join ("" to host)
+     * @param capacity  The maximum number of players in a new room
+     */
+    void openPeer(const std::string& uuid, const std::string& room, size_t capacity);
+
+    /**
+     * Closes the connection of the given peer.
+     *
+     * Any messages in flight to this peer are lost.
+     *
+     * @param uuid  The peer UUID
+     */
+    void closePeer(const std::string& uuid);
+
+    /**
+     * Removes the given peer from this network.
+     *
+     * @param uuid  The peer UUID
+     */
+    void removePeer(const std::string& uuid);
+
+    /**
+     * Returns the endpoint for the given peer (or nullptr if none)
+     *
+     * @param uuid  The peer UUID
+     *
+     * @return the endpoint for the given peer (or nullptr if none)
+     */
+    Endpoint* getEndpoint(const std::string& uuid);
+
+    /**
+     * Returns the room of the given peer (or nullptr if none)
+     *
+     * @param uuid  The peer UUID
+     *
+     * @return the room of the given peer (or nullptr if none)
+     */
+    Room* getRoom(const std::string& uuid);
+
+    /**
+     * Returns the number of bytes waiting for bandwidth on the given link.
+     *
+     * @param src   The source UUID
+     * @param dst   The destination UUID
+     *
+     * @return the number of bytes waiting for bandwidth on the given link.
+     */
+    size_t getBacklog(const std::string& src, const std::string& dst) const;
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates a new network with the given seed.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     *
+     * @param seed  The seed for all random choices
+     */
+    LoopbackNetwork(Uint64 seed=0);
+
+    /**
+     * Returns a newly allocated network with the given seed.
+     *
+     * @param seed  The seed for all random choices
+     *
+     * @return a newly allocated network with the given seed.
+     */
+    static std::shared_ptr<LoopbackNetwork> alloc(Uint64 seed=0) {
+        return std::make_shared<LoopbackNetwork>(seed);
+    }
+
+    /**
+     * Returns a factory for transports on this network.
+     *
+     * This factory can be passed to {@link NetEventController#setTransportFactory}.
+     * The factory retains this network.
+     *
+     * @return a factory for transports on this network.
+     */
+    NetTransport::Factory getFactory();
+
+#pragma mark Time
+    /**
+     * Returns the current network time in microseconds.
+     *
+     * @return the current network time in microseconds.
+     */
+    Uint64 getTime() const { return _time; }
+
+    /**
+     * Advances the network time by the given number of microseconds.
+     *
+     * Messages are only received once the network time reaches their
+     * delivery time. A simulation should typically advance the network by
+     * the fixed step once per fixed update.
+     *
+     * @param micros    The number of microseconds to advance
+     */
+    void advance(Uint64 micros) { _time += micros; }
+
+    /**
+     * Sets the current network time in microseconds.
+     *
+     * The network time never decreases, so an earlier time is ignored.
+     *
+     * @param micros    The network time in microseconds
+     */
+    void setTime(Uint64 micros) { _time = SDL_max(_time, micros); }
+
+#pragma mark Link Conditions
+    /**
+     * Returns the seed for all random choices.
+     *
+     * @return the seed for all random choices.
+     */
+    Uint64 getSeed() const { return _seed; }
+
+    /**
+     * Returns the conditions of every link without explicit conditions.
+     *
+     * @return the conditions of every link without explicit conditions.
+     */
+    const LinkConfig& getDefaultConfig() const { return _default; }
+
+    /**
+     * Sets the conditions of every link without explicit conditions.
+     *
+     * @param config    The link conditions
+     */
+    void setDefaultConfig(const LinkConfig& config);
+
+    /**
+     * Returns the conditions of the link from source to destination.
+     *
+     * @param src   The source UUID
+     * @param dst   The destination UUID
+     *
+     * @return the conditions of the link from source to destination.
+     */
+    const LinkConfig& getLinkConfig(const std::string& src, const std::string& dst) const;
+
+    /**
+     * Sets the conditions of the link from source to destination.
+     *
+     * This only affects one direction of the link. Messages already in
+     * flight are not affected.
+     *
+     * @param src       The source UUID
+     * @param dst       The destination UUID
+     * @param config    The link conditions
+     */
+    void setLinkConfig(const std::string& src, const std::string& dst, const LinkConfig& config);
+
+    /**
+     * Returns the statistics of the link from source to destination.
+     *
+     * @param src   The source UUID
+     * @param dst   The destination UUID
+     *
+     * @return the statistics of the link from source to destination.
+     */
+    LinkStats getLinkStats(const std::string& src, const std::string& dst) const;
+
+    /**
+     * Returns the total statistics of every link in this network.
+     *
+     * @return the total statistics of every link in this network.
+     */
+    LinkStats getTotalStats() const;
+
+    /**
+     * Resets the statistics of every link to zero.
+     */
+    void resetStats();
+};
+
+/**
+ * A transport connected to a {@link LoopbackNetwork}.
+ *
+ * This transport behaves as a {@link cugl::net::NetcodeConnection} with the
+ * link conditions of its network. Peers are assigned deterministic UUIDs in
+ * order of creation. Host migration is not simulated; if the host closes,
+ * the other players simply see it leave.
+ */
+class LoopbackTransport : public NetTransport {
+protected:
+    /** The network for this transport */
+    std::shared_ptr<LoopbackNetwork> _network;
+    /** The UUID of this peer */
+    std::string _uuid;
+    /** The room to join ("" to host) */
+    std::string _room;
+    /** The maximum number of players in a hosted room */
+    size_t _capacity;
+
+public:
+    /**
+     * Creates a transport on the given network.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     *
+     * @param network   The loopback network
+     * @param room      The room to join ("" to host)
+     * @param capacity  The maximum number of players in a hosted room
+     */
+    LoopbackTransport(const std::shared_ptr<LoopbackNetwork>& network,
+                      const std::string room, size_t capacity);
+
+    /**
+     * Deletes this transport, removing it from the network.
+     */
+    ~LoopbackTransport();
+
+    /**
+     * Returns a newly allocated transport on the given network.
+     *
+     * If the room is empty, the transport will host a new room. Otherwise
+     * it will join the given room. The capacity is ignored when joining a
+     * room.
+     *
+     * @param network   The loopback network
+     * @param room      The room to join ("" to host)
+     * @param capacity  The maximum number of players in a hosted room
+     *
+     * @return a newly allocated transport on the given network.
+     */
+    static std::shared_ptr<LoopbackTransport> alloc(const std::shared_ptr<LoopbackNetwork>& network,
+                                                    const std::string room="", size_t capacity=0) {
+        return network == nullptr ? nullptr : std::make_shared<LoopbackTransport>(network, room, capacity);
+    }
+
+    /**
+     * Returns the network for this transport.
+     *
+     * @return the network for this transport.
+     */
+    const std::shared_ptr<LoopbackNetwork>& getNetwork() const { return _network; }
+
+#pragma mark Accessors
+    /**
+     * Returns the current state of this transport.
+     *
+     * @return the current state of this transport.
+     */
+    State getState() const override;
+
+    /**
+     * Returns true if this transport is open.
+     *
+     * @return true if this transport is open.
+     */
+    bool isOpen() const override;
+
+    /**
+     * Returns the UUID for this transport.
+     *
+     * Loopback UUIDs are assigned on creation, not on connection.
+     *
+     * @return the UUID for this transport.
+     */
+    std::string getUUID() override { return _uuid; }
+
+    /**
+     * Returns the UUID of the host player.
+     *
+     * @return the UUID of the host player.
+     */
+    const std::string getHost() override;
+
+    /**
+     * Returns the room ID of the connected lobby.
+     *
+     * @return the room ID of the connected lobby.
+     */
+    const std::string getRoom() const override;
+
+    /**
+     * Returns the UUIDs of the active players (including this one)
+     *
+     * @return the UUIDs of the active players (including this one)
+     */
+    const std::unordered_set<std::string> getPlayers() override;
+
+    /**
+     * Returns true if the given player is currently connected to the game.
+     *
+     * @param player    The player to test for connection
+     *
+     * @return true if the given player is currently connected to the game.
+     */
+    bool isPlayerActive(const std::string player) override;
+
+    /**
+     * Returns the number of players currently connected to this game
+     *
+     * @return the number of players currently connected to this game
+     */
+    size_t getNumPlayers() override;
+
+    /**
+     * Returns the number of bytes queued for the given player but not yet sent.
+     *
+     * These are the bytes still waiting for the bandwidth cap of the link
+     * to the player. It is always 0 on links without a bandwidth cap.
+     *
+     * @param player    The player to query
+     *
+     * @return the number of bytes queued for the given player but not yet sent.
+     */
+    size_t getBufferedAmount(const std::string player) override;
+
+#pragma mark Communication
+    /**
+     * Opens the connection to the lobby.
+     *
+     * The connection succeeds immediately, unless the room to join does not
+     * exist (INVALID), or is full or in session (DENIED).
+     */
+    void open() override;
+
+    /**
+     * Closes the connection to the lobby.
+     *
+     * Any messages in flight to this peer are lost.
+     */
+    void close() override;
+
+    /**
+     * Marks the game as started and bans incoming connections.
+     *
+     * Every player in the room moves to state INSESSION. This can only be
+     * called by the host.
+     */
+    void startSession() override;
+
+    /**
+     * Sends a byte array to the specified player.
+     *
+     * @param dst       The UUID of the receiving player
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    bool sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable=true) override;
+
+    /**
+     * Sends a byte array to all other players (and this one).
+     *
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    bool broadcast(const std::vector<std::byte>& data, bool reliable=true) override;
+
+    /**
+     * Receives incoming network messages.
+     *
+     * The dispatcher is called on every message whose delivery time has
+     * been reached, in order of delivery, up to the given limit.
+     *
+     * @param dispatcher    The function to process received data
+     * @param limit         The maximum number of messages to process
+     *
+     * @return the number of messages processed
+     */
+    size_t receive(const Dispatcher& dispatcher, size_t limit=SIZE_MAX) override;
+};
+
+        }
+    }
+}
+
+#endif /* __CU_LOOPBACK_TRANSPORT_H__ */
@@ -0,0 +1,219 @@
+//
+//  CUNetClock.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a clock synchronization filter for networked physics.
+//  It estimates the offset and drift between the clock of this machine and the
+//  clock of a remote machine from NTP-style ping exchanges. It also tracks the
+//  round trip time and jitter of the connection.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_NET_CLOCK_H__
+#define __CU_NET_CLOCK_H__
+
+#include <SDL_stdinc.h>
+#include <vector>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A clock synchronization filter for networked physics.
+ *
+ * Each sample is an NTP-style exchange. This machine sends a ping at local
+ * time t0, the remote machine receives it at remote time t1 and replies at
+ * remote time t2, and this machine receives the reply at local time t3. The
+ * sample round trip time is (t3-t0)-(t2-t1), and the sample offset (remote
+ * minus local) is ((t1-t0)+(t2-t3))/2. All times are in microseconds.
+ *
+ * A single sample is only accurate if the two legs of the trip took the same
+ * time. Queuing delays make this unlikely, but they only ever add to the
+ * round trip. So the filter keeps a window of recent samples, and takes the
+ * offset from the sample with the smallest round trip. The drift between the
+ * two clocks is the slope of a least squares fit to the least delayed
+ * quarter of the window. The round trip time and jitter are smoothed in the
+ * same way as TCP retransmission timers.
+ */
+class NetClock {
+private:
+    /** A single ping exchange */
+    class Sample {
+    public:
+        /** The local time at the middle of the exchange */
+        double local;
+        /** The estimated offset (remote minus local) */
+        double offset;
+        /** The round trip time */
+        double rtt;
+    };
+
+    /** The most recent samples, as a circular buffer */
+    std::vector<Sample> _samples;
+    /** The position of the next sample in the buffer */
+    size_t _next;
+    /** The total number of samples received */
+    Uint64 _count;
+
+    /** The offset of the best sample in the window */
+    double _offset;
+    /** The local time of the best sample in the window */
+    double _reference;
+    /** The drift of the remote clock relative to this one */
+    double _skew;
+    /** The smoothed round trip time */
+    double _rtt;
+    /** The smoothed round trip time variation */
+    double _jitter;
+
+    /**
+     * Recomputes the offset and drift from the sample window.
+     */
+    void refilter();
+
+public:
+    /**
+     * Creates a new clock filter on the stack.
+     *
+     * Clock filters do not have any nontrivial state and so it is unnecessary
+     * to use an init method. However, we do include a static {@link #alloc}
+     * method for creating shared pointers.
+     */
+    NetClock();
+
+    /**
+     * Returns a newly allocated clock filter.
+     *
+     * This method is solely include for convenience purposes.
+     *
+     * @return a newly allocated clock filter.
+     */
+    static std::shared_ptr<NetClock> alloc() {
+        return std::make_shared<NetClock>();
+    }
+
+    /**
+     * Discards all samples, returning the filter to its initial state.
+     */
+    void reset();
+
+    /**
+     * Adds the result of a ping exchange to the filter.
+     *
+     * Samples with a negative round trip time (which can only occur with
+     * corrupt data) are ignored.
+     *
+     * @param t0    The local time the ping was sent
+     * @param t1    The remote time the ping was received
+     * @param t2    The remote time the reply was sent
+     * @param t3    The local time the reply was received
+     *
+     * @return true if the sample was accepted
+     */
+    bool addSample(Uint64 t0, Uint64 t1, Uint64 t2, Uint64 t3);
+
+    /**
+     * Returns true if the filter has received at least one sample.
+     *
+     * @return true if the filter has received at least one sample.
+     */
+    bool isSynchronized() const { return _count > 0; }
+
+    /**
+     * Returns the total number of samples received.
+     *
+     * @return the total number of samples received.
+     */
+    Uint64 getSampleCount() const { return _count; }
+
+    /**
+     * Returns the estimated offset (remote minus local) at the given time.
+     *
+     * The offset includes the drift correction since the best sample.
+     *
+     * @param local The local time in microseconds
+     *
+     * @return the estimated offset (remote minus local) at the given time.
+     */
+    double getOffset(Uint64 local) const {
+        return _offset+_skew*((double)local-_reference);
+    }
+
+    /**
+     * Returns the estimated remote time for the given local time.
+     *
+     * @param local The local time in microseconds
+     *
+     * @return the estimated remote time for the given local time.
+     */
+    double toRemote(Uint64 local) const {
+        return (double)local+getOffset(local);
+    }
+
+    /**
+     * Returns the drift of the remote clock relative to this one.
+     *
+     * This is the number of microseconds the offset changes per microsecond
+     * of local time. It is 0 until the window spans enough time to measure.
+     *
+     * @return the drift of the remote clock relative to this one.
+     */
+    double getSkew() const { return _skew; }
+
+    /**
+     * Returns the smoothed round trip time in microseconds.
+     *
+     * @return the smoothed round trip time in microseconds.
+     */
+    double getRoundTripTime() const { return _rtt; }
+
+    /**
+     * Returns the smoothed round trip time variation in microseconds.
+     *
+     * @return the smoothed round trip time variation in microseconds.
+     */
+    double getJitter() const { return _jitter; }
+};
+
+        }
+    }
+}
+
+#endif /* __CU_NET_CLOCK_H__ */
@@ -82,6 +82,8 @@ private:
     Uint64 _receiveTimeStamp;
     /** The ID of the sender. */
     std::string _sourceID;
+    /** The type id of this event, as assigned by the controller. */
+    Uint8 _eventType;
     
     //==============================META DATA================================
     
@@ -94,11 +96,14 @@ private:
      * @param eventTimeStamp    the timestamp of the event from the sender
      * @param receiveTimeStamp  the timestamp when the event was received
      * @param sourceID          the ID of the sender
+     * @param eventType         the type id of the event
      */
-    void setMetaData(Uint64 eventTimeStamp, Uint64 receiveTimeStamp, const std::string sourceID) {
+    void setMetaData(Uint64 eventTimeStamp, Uint64 receiveTimeStamp, const std::string sourceID,
+                     Uint8 eventType) {
         _eventTimeStamp = eventTimeStamp;
         _receiveTimeStamp = receiveTimeStamp;
         _sourceID = sourceID;
+        _eventType = eventType;
     }
     
     // Allow NetEventController access to the method above.
@@ -139,6 +144,36 @@ public:
      */
     virtual void deserialize(const std::vector<std::byte>& data) { }
     
+    /**
+     * Serializes this event directly into the given frame serializer.
+     *
+     * This is the allocation free alternative to {@link #serialize}. The
+     * controller calls this method with a reusable frame buffer, and the
+     * event should append its attributes to it. Events should override both
+     * this method and {@link #deserializeFrom} for best performance. The
+     * default implementation appends the result of {@link #serialize}.
+     *
+     * @param out   The serializer for the current frame
+     */
+    virtual void serializeTo(LWSerializer& out) {
+        out.writeByteVector(serialize());
+    }
+    
+    /**
+     * Deserializes this event from a non-owning block of bytes.
+     *
+     * This is the counterpart of {@link #serializeTo}, and receives exactly
+     * the bytes written by that method. The bytes belong to the received
+     * frame, and are only valid for the duration of this call. The default
+     * implementation copies them and calls {@link #deserialize}.
+     *
+     * @param data  The serialized bytes
+     * @param size  The number of bytes
+     */
+    virtual void deserializeFrom(const std::byte* data, size_t size) {
+        deserialize(std::vector<std::byte>(data, data+size));
+    }
+    
     /**
      * Returns the timestamp of the event set by the sender.
      *
@@ -49,6 +49,11 @@
 // TODO: Some of these can be removed with forward declarations
 #include <cugl/physics2/net/CUNetWorld.h>
 #include <cugl/physics2/net/CUNetEvent.h>
+#include <cugl/physics2/net/CULWSerializer.h>
+#include <cugl/physics2/net/CUNetMetrics.h>
+#include <cugl/physics2/net/CUNetClock.h>
+#include <cugl/physics2/net/CUNetRateController.h>
+#include <cugl/physics2/net/CUNetTransport.h>
 #include <cugl/physics2/net/CUNetPhysicsController.h>
 #include <cugl/assets/CUAssetManager.h>
 #include <cugl/base/CUApplication.h>
@@ -60,7 +65,9 @@
 #include <typeindex>
 #include <vector>
 #include <queue>
+#include <map>
 #include <memory>
+#include <functional>
 
 namespace cugl {
     /**
@@ -84,8 +91,8 @@ namespace cugl {
 /**
  * This class is a network controller for multiplayer physics based game.
  *
- * This class holds a {@link cugl::net::NetcodeConnection} and is an extension
- * of the original network controller. It is built around an event-based system
+ * This class holds a {@link NetTransport} and is an extension of the original
+ * network controller. It is built around an event-based system
  * that fully encapsulates the network connection. Events across the network
  * are automatically serialized and deserialized.
  *
@@ -102,6 +109,11 @@ namespace cugl {
  * created to handle physics synchronization. For fine-tuning and more info,
  * see {@link NetPhysicsController}.
  *
+ * Clients keep their game tick in step with the host through periodic clock
+ * pings to the host (see {@link NetClock}). Hence peers agree on the current
+ * game tick to within a fraction of a tick, regardless of latency. Inbound
+ * events are released in order of the game tick they were sent at.
+ *
  * There are three built-in event types: {@link GameStateEvent},
  * {@link PhysSyncEvent}, and {@link PhysObstEvent}. See the {@link NetEvent}
  * class and {@link #attachEventType} for how to add and setup custom events.
@@ -126,14 +138,70 @@ public:
         NETERROR = 6
     };
     
+    /** This enum represents how the events of an attached type are delivered */
+    enum class Delivery : int {
+        /** Events are retransmitted if lost, and arrive in the order sent */
+        RELIABLE = 0,
+        /**
+         * Events are never retransmitted, and may arrive in any order
+         *
+         * This is appropriate for state snapshots, which are superseded by
+         * the next snapshot anyway. A lost event never delays later events.
+         */
+        UNRELIABLE = 1
+    };
+    
 protected:
+    /** An inbound event, ordered by its game tick and then by arrival */
+    class InEvent {
+    public:
+        /** The game tick the event was sent at */
+        Uint64 tick;
+        /** The arrival order of the event */
+        Uint64 order;
+        /** The event itself */
+        std::shared_ptr<NetEvent> event;
+        
+        /**
+         * Returns true if this event should be released after the other one.
+         *
+         * @param other The event to compare against
+         *
+         * @return true if this event should be released after the other one.
+         */
+        bool operator>(const InEvent& other) const {
+            return tick != other.tick ? tick > other.tick : order > other.order;
+        }
+    };
+    
     /** The App fixed-time stamp when the game starts */
     Uint64 _startGameTimeStamp;
+    /** The host fixed-time stamp when the game starts */
+    Uint64 _hostStartTimeStamp;
+    /** The correction (in ticks) from the local tick count to the host game tick */
+    double _tickOffset;
+    /** The last game tick reported (so that the game tick never decreases) */
+    mutable Uint64 _lastGameTick;
+    
+    /** The clock synchronization filter against the host (CLIENT ONLY) */
+    NetClock _clock;
+    /** The host fixed-time stamp of the most recent clock sample */
+    Uint64 _clockSampleTick;
+    /** The host time (in microseconds) of the most recent clock sample */
+    Uint64 _clockSampleTime;
+    /** The App fixed-time stamp of the most recent clock ping */
+    Uint64 _clockPingTimeStamp;
+    /** The scheduler deciding when physics snapshots are sent */
+    NetRateController _sendRate;
     
     /** The network configuration */
     cugl::net::NetcodeConfig _config;
     /** The network connection */
-    std::shared_ptr<cugl::net::NetcodeConnection> _network;
+    std::shared_ptr<NetTransport> _network;
+    /** The function to create a network connection */
+    NetTransport::Factory _transportFactory;
+    /** The telemetry of this controller (and its physics controller) */
+    std::shared_ptr<NetMetrics> _metrics;
     
     /** The network controller status */
     Status _status;
@@ -148,13 +216,51 @@ protected:
     std::unordered_map<std::type_index, Uint8> _eventTypeMap;
     /** Vector of NetEvents instances for constructing new events */
     std::vector<std::shared_ptr<NetEvent>> _newEventVector;
-    
-    /** Queue for all received custom events. Preserved across updates.*/
-    std::queue<std::shared_ptr<NetEvent>> _inEventQueue;
+    /** The delivery class of each attached event type, by type id */
+    std::vector<Delivery> _deliveries;
+    /** Vector of handlers for inbound custom events, by type id */
+    std::vector<std::function<void(const NetEvent&)>> _handlers;
+    /** The type id of GameStateEvent */
+    Uint8 _gameStateType;
+    /** The type id of PhysSyncEvent (only valid if physics is enabled) */
+    Uint8 _physSyncType;
+    /** The type id of PhysObstEvent (only valid if physics is enabled) */
+    Uint8 _physObstType;
+    
+    /** Min-heap of all received custom events, by game tick. Preserved across updates.*/
+    std::priority_queue<InEvent,std::vector<InEvent>,std::greater<InEvent>> _inEventQueue;
+    /** The number of events ever added to the inbound queue (for stable ordering) */
+    Uint64 _inEventCount;
     /** Queue reserved for built-in events */
     std::queue<std::shared_ptr<NetEvent>> _reservedInEventQueue;
     /** Queue for all outbound events. Cleared every update */
     std::vector<std::shared_ptr<NetEvent>> _outEventQueue;
+    /** Queues for outbound events to a single peer, by UUID. Cleared every update */
+    std::unordered_map<std::string,std::vector<std::shared_ptr<NetEvent>>> _directOutQueue;
+    /** Interest regions received before physics was enabled, by UUID */
+    std::unordered_map<std::string,std::shared_ptr<GameStateEvent>> _pendingInterests;
+    /** Predicted obstacles announced before physics was enabled, by obstacle id */
+    std::unordered_map<Uint64,std::string> _pendingPredictions;
+    
+    /** The maximum size in bytes of a single outbound frame */
+    size_t _maxFrameSize;
+    /** The reusable buffer that outbound frames are written into */
+    LWSerializer _frameSerializer;
+    /** Scratch space for an event that overflows the current frame */
+    std::vector<std::byte> _frameOverflow;
+    
+    /** Whether the game advances in lockstep */
+    bool _lockstep;
+    /** The number of ticks between sending an event and simulating it */
+    Uint32 _inputDelay;
+    /** The lockstep tick currently being simulated */
+    Uint64 _lockstepTick;
+    /** Whether the events for the current lockstep tick have been released */
+    bool _lockstepReady;
+    /** The number of complete lockstep ticks received from each peer, by UUID */
+    std::unordered_map<std::string,Uint64> _peerTicks;
+    /** Received events by target lockstep tick, then by sender UUID */
+    std::map<Uint64,std::map<std::string,std::vector<std::shared_ptr<NetEvent>>>> _lockstepEvents;
     
     /** Short user id assigned by the host during session */
     Uint32 _shortUID;
@@ -171,28 +277,42 @@ protected:
     
 #pragma mark Networking Internals
     /**
-     * Unwraps the a byte vector data into a NetEvent.
+     * Unwraps a network frame into the NetEvents that it contains.
      *
-     * The controller automatically detects the type of event, spawns a new
-     * empty instance of that event, and calls the event's
-     * {@link NetEvent#deserialize} method. This method is only called on
-     * outbound events.
+     * A frame is a single network message holding every event sent by a
+     * peer during one tick. It starts with the shared tick timestamp, which
+     * is followed by each event as a type byte, a payload length, and the
+     * payload itself.
      *
-     * @param data      The message received
+     * The controller automatically detects the type of each event, spawns a
+     * new empty instance of that event, and calls the event's
+     * {@link NetEvent#deserializeFrom} method. The payloads are read in place
+     * from the frame, so no event bytes are copied. This method is only called
+     * on inbound frames.
+     *
+     * @param data      The frame received
      * @param source    The UUID of the sender
+     *
+     * @return the events in the frame, in the order they were sent
      */
-    std::shared_ptr<NetEvent> unwrap(const std::vector<std::byte>& data,std::string source);
+    std::vector<std::shared_ptr<NetEvent>> unwrap(const std::vector<std::byte>& data,std::string source);
     
     /**
-     * Wraps a NetEvent into a byte vector.
+     * Wraps a list of NetEvents into network frames.
      *
-     * The controller calls the event's {@link NetEvent#serialize()} method
-     * and packs the event into byte data. This method is only on inbound
-     * events.
+     * The controller calls each event's {@link NetEvent#serializeTo} method
+     * so that the payload is written directly into a reusable frame buffer,
+     * behind a single tick header. Events are batched into as few frames as
+     * possible; a new frame is only started when the next event would push the
+     * current one past {@link #getMaxFrameSize}. An event that is larger than
+     * the limit on its own is sent in a frame by itself. This method is only
+     * called on outbound events.
      *
-     * @param e The event to wrap
+     * @param events    The events to wrap
+     *
+     * @return the frames containing the events
      */
-    const std::vector<std::byte> wrap(const std::shared_ptr<NetEvent>& e);
+    std::vector<std::vector<std::byte>> wrap(const std::vector<std::shared_ptr<NetEvent>>& events);
     
     /**
      * Processes all received packets received during the last update.
@@ -206,7 +326,9 @@ protected:
      * Processes all events received during the last update.
      *
      * This method either processes events internally if it is a built-in event
-     * and adds them to the inbound event queue otherwise.
+     * and adds them to the inbound event queue otherwise. Events are identified
+     * by their type id, and custom events with a registered handler bypass the
+     * queue whenever possible.
      *
      * @param e The received event
      */
@@ -221,6 +343,36 @@ protected:
      */
     void processGameStateEvent(const std::shared_ptr<GameStateEvent>& e);
     
+    /**
+     * Adds a custom event to the inbound queue.
+     *
+     * The queue is ordered by the game tick each event was sent at. Events
+     * sent at the same tick are released in the order they arrived.
+     *
+     * @param e The received event
+     */
+    void queueInEvent(const std::shared_ptr<NetEvent>& e);
+    
+    /**
+     * Updates the clock synchronization with the host.
+     *
+     * Clients ping the host periodically (more often until the clock filter
+     * has warmed up) and correct their game tick towards the host estimate.
+     * This method does nothing on the host, whose clock is the reference.
+     */
+    void updateClock();
+    
+    /**
+     * Corrects the game tick towards the estimate of the host game tick.
+     *
+     * Small errors are slewed away over several updates so that the game
+     * tick advances smoothly. Large errors (or any error if snap is true)
+     * are corrected at once.
+     *
+     * @param snap  Whether to correct the error at once
+     */
+    void correctTick(bool snap);
+    
     /**
      * Returns true if the connection is still active after a status check
      *
@@ -231,10 +383,48 @@ protected:
     bool checkConnection();
     
     /**
-     * Broadcasts all queued outbound events.
+     * Sends all queued outbound events.
+     *
+     * The events are batched into frames with {@link #wrap}, so a typical
+     * tick results in a single broadcast message per delivery class. Events
+     * queued for a single peer are batched separately, and sent after the
+     * broadcast.
      */
     void sendQueuedOutData();
     
+    /**
+     * Sends a list of outbound events to one or all peers.
+     *
+     * The events are split by the delivery class of their type. Reliable
+     * events are wrapped and sent on the reliable channel, and unreliable
+     * events on the unreliable channel, each in their original order.
+     *
+     * @param dst       The UUID of the receiving peer ("" to broadcast)
+     * @param events    The events to send
+     */
+    void sendEvents(const std::string dst, const std::vector<std::shared_ptr<NetEvent>>& events);
+    
+    /**
+     * Updates the send scheduler with the current state of the transport.
+     *
+     * This method refreshes the peers and their send buffers, and then
+     * advances the scheduler to the current time. The physics controller
+     * receives the same peers, so that peers joining or leaving mid-game
+     * are synchronized.
+     */
+    void updateSendRate();
+    
+    /**
+     * Releases the events for the current lockstep tick, if possible.
+     *
+     * The events are released once every active peer has finished sending
+     * its events for this tick. They are moved to the inbound queue in a
+     * deterministic order (by sender UUID, then by order sent).
+     *
+     * @return true if the events for the current lockstep tick are released
+     */
+    bool releaseLockstep();
+    
     /**
      * Returns the type id of a NetEvent.
      *
@@ -244,6 +434,28 @@ protected:
         return _eventTypeMap.at(std::type_index(typeid(e)));
     }
     
+    /**
+     * Returns true if an inbound event may be processed by the game.
+     *
+     * Events stamped with a tick ahead of this machine are held back until
+     * this machine reaches that tick.
+     *
+     * @param e The inbound event
+     *
+     * @return true if an inbound event may be processed by the game.
+     */
+    bool isDue(const NetEvent& e) const;
+    
+    /**
+     * Records the latency of an inbound event released to the game.
+     *
+     * The latency is the number of ticks between the tick the event was
+     * sent at and the current game tick.
+     *
+     * @param e The inbound event
+     */
+    void recordLatency(const NetEvent& e);
+    
 #pragma mark Constructors
 public:
     /**
@@ -282,6 +494,18 @@ public:
      */
     bool init(const std::shared_ptr<AssetManager>& assets);
     
+    /**
+     * Initializes the controller for the given network configuration.
+     *
+     * This initializer does not require any assets. Together with a
+     * {@link LoopbackNetwork}, it allows a controller to run headless.
+     *
+     * @param config    The network configuration
+     *
+     * @return true if the network controller was successfully initialized
+     */
+    bool init(const cugl::net::NetcodeConfig& config);
+    
     /**
      * Returns a newly allocated controller for the given asset manager.
      *
@@ -298,6 +522,21 @@ public:
         return (result->init(assets) ? result : nullptr);
     }
     
+    /**
+     * Returns a newly allocated controller for the given network configuration.
+     *
+     * This allocator does not require any assets. Together with a
+     * {@link LoopbackNetwork}, it allows a controller to run headless.
+     *
+     * @param config    The network configuration
+     *
+     * @return a newly allocated controller for the given network configuration.
+     */
+    static std::shared_ptr<NetEventController> alloc(const cugl::net::NetcodeConfig& config) {
+        std::shared_ptr<NetEventController> result = std::make_shared<NetEventController>();
+        return (result->init(config) ? result : nullptr);
+    }
+    
 #pragma mark Controller Attributes
     /**
      * Returns whether this device is host.
@@ -348,8 +587,70 @@ public:
      * @return the current status of the controller.
      */
     Status getStatus() const { return _status; }
+    
+    /**
+     * Returns the maximum size in bytes of a single outbound frame.
+     *
+     * All events queued during a tick are batched into one network message.
+     * That message is only split when it would exceed this size. By default
+     * this is the "max message" value of the network configuration, or the
+     * WebRTC default of 64KB if that value is not set.
+     *
+     * @return the maximum size in bytes of a single outbound frame.
+     */
+    size_t getMaxFrameSize() const { return _maxFrameSize; }
+    
+    /**
+     * Sets the maximum size in bytes of a single outbound frame.
+     *
+     * All events queued during a tick are batched into one network message.
+     * That message is only split when it would exceed this size. This value
+     * should never exceed the maximum message size of the data channel.
+     *
+     * @param size  The maximum size in bytes of a single outbound frame.
+     */
+    void setMaxFrameSize(size_t size) { _maxFrameSize = size; }
+    
+    /**
+     * Returns the telemetry of this controller.
+     *
+     * The telemetry is shared with the physics controller, and persists
+     * across connections. It counts the events and bytes sent and received
+     * for each event type, the size of every physics correction, and the
+     * latency of every inbound event. Call {@link NetMetrics#sample}
+     * periodically to compute rates.
+     *
+     * @return the telemetry of this controller.
+     */
+    const std::shared_ptr<NetMetrics>& getMetrics() const { return _metrics; }
             
 #pragma mark Connection Management
+    /**
+     * Returns the current network connection.
+     *
+     * This value is nullptr if there is no connection.
+     *
+     * @return the current network connection.
+     */
+    const std::shared_ptr<NetTransport>& getTransport() const { return _network; }
+    
+    /**
+     * Sets the function to create a network connection.
+     *
+     * This function is called on {@link #connectAsHost} and
+     * {@link #connectAsClient}. By default, it creates a WebRTC
+     * {@link NetcodeTransport}. Use {@link LoopbackNetwork#getFactory} to
+     * connect controllers in a single process instead. Setting this to
+     * nullptr restores the default.
+     *
+     * This method has no effect on an existing connection.
+     *
+     * @param factory   The function to create a network connection
+     */
+    void setTransportFactory(NetTransport::Factory factory) {
+        _transportFactory = factory ? factory : NetcodeTransport::alloc;
+    }
+    
     /**
      * Connects to a new lobby as host.
      *
@@ -404,12 +705,38 @@ public:
      * Returns the discrete timestamp since the game started.
      *
      * Peers should have similar timestamps regardless of when their app was
-     * launched, although peer gameticks might fluctuate due to network
-     * latency.
+     * launched. The host game tick is the reference, and clients correct
+     * their own towards it with clock synchronization. The game tick never
+     * decreases during a game.
      *
      * @return the discrete timestamp since the game started.
      */
     Uint64 getGameTick() const;
+    
+    /**
+     * Returns the clock synchronization filter against the host.
+     *
+     * The filter provides the round trip time and jitter of the connection
+     * to the host, which are useful to tune interpolation delays. It has no
+     * samples on the host itself.
+     *
+     * @return the clock synchronization filter against the host.
+     */
+    const NetClock& getClock() const { return _clock; }
+    
+    /**
+     * Returns the scheduler deciding when physics snapshots are sent.
+     *
+     * Snapshots are sent at most once per call to {@link #updateNet}, but
+     * the scheduler sends them less often when the connection is congested.
+     * Game events are always sent immediately. The scheduler can be used to
+     * set the range of snapshot rates and the congestion thresholds. It
+     * persists across connections.
+     *
+     * @return the scheduler deciding when physics snapshots are sent.
+     */
+    NetRateController& getSendRate() { return _sendRate; }
+    
     /**
      * Enables physics synchronization.
      *
@@ -442,6 +769,97 @@ public:
      */
     void disablePhysics();
     
+    /**
+     * Requests a complete snapshot of the physics world from the host.
+     *
+     * This should be called by a client that joins (or rejoins) a game that
+     * is already in progress. The host streams the snapshot in chunks while
+     * live updates keep flowing, and the snapshot is applied all at once when
+     * it is complete. See {@link NetPhysicsController#requestWorld}.
+     *
+     * This method does nothing on the host, or if physics is not enabled.
+     */
+    void requestWorld() {
+        if (_physEnabled && !_isHost) {
+            _physController->requestWorld();
+        }
+    }
+    
+#pragma mark Lockstep
+    /**
+     * Enables lockstep mode with the given input delay.
+     *
+     * In lockstep mode, physics state is never synchronized. Instead, every
+     * event pushed during lockstep tick T is delivered to every peer
+     * (including this one) at tick T+delay. Each peer only advances to a
+     * tick once all peers have sent their events for it, so all peers see
+     * the same events at the same tick. If the simulation is deterministic
+     * (see {@link NetWorld#setDeterministic}), all peers stay in sync with
+     * network cost independent of the number of obstacles.
+     *
+     * All peers must enable lockstep with the same delay before the game
+     * starts. The delay must be at least 1, and should cover the round trip
+     * time to avoid stalls.
+     *
+     * @param delay The number of ticks between sending and simulating events
+     */
+    void enableLockstep(Uint32 delay);
+    
+    /**
+     * Disables lockstep mode.
+     *
+     * Physics synchronization (if enabled) resumes on the next update.
+     */
+    void disableLockstep();
+    
+    /**
+     * Returns true if the game advances in lockstep.
+     *
+     * @return true if the game advances in lockstep.
+     */
+    bool isLockstep() const { return _lockstep; }
+    
+    /**
+     * Returns the number of ticks between sending an event and simulating it.
+     *
+     * @return the number of ticks between sending an event and simulating it.
+     */
+    Uint32 getInputDelay() const { return _inputDelay; }
+    
+    /**
+     * Returns the lockstep tick currently being simulated.
+     *
+     * Events pushed during this tick will be simulated by every peer at
+     * this tick plus {@link #getInputDelay}.
+     *
+     * @return the lockstep tick currently being simulated.
+     */
+    Uint64 getLockstepTick() const { return _lockstepTick; }
+    
+    /**
+     * Returns true if the current lockstep tick can be simulated.
+     *
+     * When this is true, the inbound queue holds every event for this tick.
+     * The game should then process those events, push its own events (such
+     * as local input), step the physics world once, and finally call
+     * {@link #advanceLockstep}. When this is false, the game should stall.
+     *
+     * @return true if the current lockstep tick can be simulated.
+     */
+    bool isLockstepReady() const { return _lockstep && _status == Status::INGAME && _lockstepReady; }
+    
+    /**
+     * Completes the current lockstep tick.
+     *
+     * This method sends the queued outbound events, stamped with the current
+     * tick, followed by a marker that this peer has finished the tick. It
+     * then moves on to the next tick. This method has no effect unless
+     * {@link #isLockstepReady} is true.
+     *
+     * @return true if the lockstep tick was completed
+     */
+    bool advanceLockstep();
+    
 #pragma mark Event Management
     /**
      * Attaches a new NetEvent type to the controller.
@@ -449,22 +867,99 @@ public:
      * This method allows the controller the receive and send custom NetEvent
      * classes. The template type T must be a subclass of NetEvent.
      *
+     * The delivery class should be {@link Delivery#UNRELIABLE} only for
+     * events that carry state which the next event of the same type replaces,
+     * and whose handlers tolerate loss and reordering. Attaching a type that
+     * is already attached has no effect, so its delivery class is unchanged.
+     * Lockstep games always deliver every event reliably.
+     *
      * @tparam T The event type to be attached
+     *
+     * @param delivery  How the events of this type are delivered
+     *
+     * @return the type id of the attached event type
      */
     template <typename T>
-    void attachEventType() {
-        if (!_eventTypeMap.count(std::type_index(typeid(T)))) {
-            _eventTypeMap.insert(std::make_pair(std::type_index(typeid(T)), _newEventVector.size()));
-            _newEventVector.push_back(std::make_shared<T>());
+    Uint8 attachEventType(Delivery delivery=Delivery::RELIABLE) {
+        auto it = _eventTypeMap.find(std::type_index(typeid(T)));
+        if (it != _eventTypeMap.end()) {
+            return it->second;
         }
+        Uint8 type = (Uint8)_newEventVector.size();
+        _eventTypeMap.insert(std::make_pair(std::type_index(typeid(T)), type));
+        _newEventVector.push_back(std::make_shared<T>());
+        _deliveries.push_back(delivery);
+        return type;
+    }
+    
+    /**
+     * Returns the delivery class of an attached event type.
+     *
+     * @param type  The event type id
+     *
+     * @return the delivery class of an attached event type.
+     */
+    Delivery getDelivery(Uint8 type) const {
+        return type < _deliveries.size() ? _deliveries[type] : Delivery::RELIABLE;
     }
     
+    /**
+     * Registers a handler for inbound events of a custom NetEvent type.
+     *
+     * The type is attached (see {@link #attachEventType}) if it is not
+     * already. Inbound events of this type are then dispatched to the
+     * handler by type id, without any RTTI casts. Events that are due are
+     * dispatched as soon as they are received, provided that no earlier
+     * event is still waiting in the inbound queue. Otherwise they are queued
+     * and dispatched by {@link #dispatchInEvents}.
+     *
+     * The event reference is only valid for the duration of the call. A
+     * later registration for the same type replaces the handler.
+     *
+     * @tparam T The event type to handle
+     *
+     * @param handler   The function to call on each inbound event of type T
+     */
+    template <typename T>
+    void registerHandler(std::function<void(const T&)> handler) {
+        Uint8 type = attachEventType<T>();
+        if (_handlers.size() <= type) {
+            _handlers.resize(type+1);
+        }
+        _handlers[type] = [handler](const NetEvent& e) {
+            handler(static_cast<const T&>(e));
+        };
+    }
+    
+    /**
+     * Removes all handlers registered with {@link #registerHandler}.
+     *
+     * This should be called when the objects referenced by the handlers
+     * are disposed. The event types remain attached.
+     */
+    void clearHandlers() {
+        _handlers.clear();
+    }
+    
+    /**
+     * Dispatches every available inbound event to its handler.
+     *
+     * This method pops events for as long as {@link #isInAvailable} is true.
+     * Events without a registered handler are discarded, so this method
+     * should not be combined with {@link #popInEvent} unless every custom
+     * type has a handler.
+     *
+     * @return the number of events dispatched to a handler
+     */
+    size_t dispatchInEvents();
+    
     /**
      * Returns true if there are remaining custom inbound events.
      *
      * Thhe events in this queue is to be polled and processed by outside
      * classes. Inbound events are preserved acrossupdates, and only cleared
-     * by {@link #popInEvent}.
+     * by {@link #popInEvent}. The queue is ordered by game tick, so this is
+     * true whenever the earliest event is due, regardless of arrival order.
      *
      * @return true if there are remaining custom inbound events.
      */
@@ -490,6 +985,18 @@ public:
      */
     void pushOutEvent(const std::shared_ptr<NetEvent>& e);
     
+    /**
+     * Queues an outbound event to be sent to a single peer.
+     *
+     * Queued events are sent when {@link #updateNet} is called. and cleared
+     * after sending. Unlike {@link #pushOutEvent}, this machine does not
+     * receive a copy of the event.
+     *
+     * @param dst   The UUID of the peer to receive the event
+     * @param e     The event to send
+     */
+    void pushOutEventTo(const std::string dst, const std::shared_ptr<NetEvent>& e);
+    
     /**
      * Updates the network controller.
      *
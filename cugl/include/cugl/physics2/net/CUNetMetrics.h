@@ -0,0 +1,539 @@
+//
+//  CUNetMetrics.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides the telemetry for networked physics. It collects the
+//  traffic of every event type, the size of every synchronization correction,
+//  the depth of the interpolation buffers and the latency of inbound events.
+//  All readings are lock-free counters, so they can be recorded from any
+//  thread, and sampled by the game or exported as JSON or CSV.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_NET_METRICS_H__
+#define __CU_NET_METRICS_H__
+
+#include <cugl/assets/CUJsonValue.h>
+#include <SDL_stdinc.h>
+#include <atomic>
+#include <string>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * The telemetry of a networked physics session.
+ *
+ * A single instance is shared by a {@link NetEventController} and its
+ * {@link NetPhysicsController}. It records four kinds of readings:
+ *
+ * - Counters, which only ever increase (e.g. the number of corrections)
+ * - Traffic, which counts the events and bytes of each event type
+ * - Gauges, which hold the most recent value of a quantity
+ * - Histograms, which hold the distribution of a quantity
+ *
+ * Every reading is a relaxed atomic, so recording never blocks and is safe
+ * from any thread. Rates are computed by {@link #sample}, which the game
+ * should call periodically (e.g. once a second). Sampling, resetting and
+ * exporting are not safe to call from more than one thread at a time.
+ *
+ * Traffic is counted once per event handed to the transport, regardless of
+ * the number of peers it is sent to. Messages a peer sends to itself are
+ * not counted as received.
+ */
+class NetMetrics {
+public:
+    /** The maximum number of event types */
+    static const size_t MAX_TYPES = 256;
+
+    /** The readings that only ever increase */
+    enum class Counter : int {
+        /** The number of frames handed to the transport */
+        FRAMES_SENT = 0,
+        /** The number of frame bytes handed to the transport */
+        FRAME_BYTES_SENT = 1,
+        /** The number of frames received from other peers */
+        FRAMES_RECEIVED = 2,
+        /** The number of frame bytes received from other peers */
+        FRAME_BYTES_RECEIVED = 3,
+        /** The number of obstacle corrections from synchronization */
+        CORRECTIONS = 4,
+        /** The number of corrections that snapped to the target */
+        SNAP_OVERRIDES = 5,
+        /** The number of prediction corrections from the host */
+        PREDICTION_CORRECTIONS = 6,
+        /** The number of buffered updates that ran past the newest state */
+        BUFFER_UNDERRUNS = 7,
+        /** The number of synchronizations dropped as stale or undecodable */
+        STALE_SNAPSHOTS = 8,
+        /** The number of obstacles left out of a synchronization as at rest */
+        SUPPRESSED_SYNCS = 9,
+        /** The number of regions found to disagree with a peer's state digest */
+        DIVERGED_REGIONS = 10,
+        /** The number of counters (not a valid counter) */
+        COUNT = 11
+    };
+
+    /** The per-type traffic readings */
+    enum class Traffic : int {
+        /** The number of events sent */
+        EVENTS_SENT = 0,
+        /** The number of event bytes sent (including the event header) */
+        BYTES_SENT = 1,
+        /** The number of events received */
+        EVENTS_RECEIVED = 2,
+        /** The number of event bytes received (including the event header) */
+        BYTES_RECEIVED = 3,
+        /** The number of traffic readings (not a valid reading) */
+        COUNT = 4
+    };
+
+    /** The readings that hold the most recent value */
+    enum class Gauge : int {
+        /** The number of obstacles currently being interpolated */
+        INTERPOLATING = 0,
+        /** The number of custom events waiting in the inbound queue */
+        INBOUND_QUEUE = 1,
+        /** The number of gauges (not a valid gauge) */
+        COUNT = 2
+    };
+
+    /** The readings that hold a distribution */
+    enum class Metric : int {
+        /** The position error of an obstacle when corrected (in world units) */
+        POSITION_ERROR = 0,
+        /** The angle error of an obstacle when corrected (in radians) */
+        ANGLE_ERROR = 1,
+        /** The number of states in a snapshot buffer on each update */
+        QUEUE_DEPTH = 2,
+        /** The ticks between sending an event and releasing it to the game */
+        INBOUND_LATENCY = 3,
+        /** The number of histograms (not a valid histogram) */
+        COUNT = 4
+    };
+
+    /**
+     * A lock-free histogram with exponentially growing buckets.
+     *
+     * The first bucket holds the values below the base. Each later bucket
+     * holds the values up to twice the bound of the previous one. The last
+     * bucket holds every value beyond that. Negative values count as 0.
+     */
+    class Histogram {
+    public:
+        /** The number of buckets */
+        static const size_t BUCKETS = 24;
+
+    private:
+        /** The upper bound of the first bucket */
+        double _base;
+        /** The count of each bucket */
+        std::atomic<Uint64> _counts[BUCKETS];
+        /** The total number of values */
+        std::atomic<Uint64> _total;
+        /** The sum of all values, in fixed point units of the base */
+        std::atomic<Uint64> _sum;
+        /** The largest value, in fixed point units of the base */
+        std::atomic<Uint64> _max;
+
+    public:
+        /**
+         * Creates an empty histogram with the given base.
+         *
+         * @param base  The upper bound of the first bucket
+         */
+        Histogram(double base=1);
+
+        /**
+         * Returns the upper bound of the first bucket.
+         *
+         * @return the upper bound of the first bucket.
+         */
+        double getBase() const { return _base; }
+
+        /**
+         * Sets the upper bound of the first bucket.
+         *
+         * This resets the histogram.
+         *
+         * @param base  The upper bound of the first bucket
+         */
+        void setBase(double base);
+
+        /**
+         * Adds a value to this histogram.
+         *
+         * This method is safe to call from any thread.
+         *
+         * @param value The value to add
+         */
+        void record(double value);
+
+        /**
+         * Removes every value from this histogram.
+         */
+        void reset();
+
+        /**
+         * Returns the number of values in this histogram.
+         *
+         * @return the number of values in this histogram.
+         */
+        Uint64 getCount() const { return _total.load(std::memory_order_relaxed); }
+
+        /**
+         * Returns the mean of the values in this histogram.
+         *
+         * @return the mean of the values in this histogram.
+         */
+        double getMean() const;
+
+        /**
+         * Returns the largest value in this histogram.
+         *
+         * @return the largest value in this histogram.
+         */
+        double getMax() const;
+
+        /**
+         * Returns an estimate of the given percentile.
+         *
+         * The estimate is the upper bound of the bucket containing the
+         * percentile, so it is accurate to within a factor of two.
+         *
+         * @param percent   The percentile in [0,100]
+         *
+         * @return an estimate of the given percentile.
+         */
+        double getPercentile(double percent) const;
+
+        /**
+         * Returns the number of values in the given bucket.
+         *
+         * @param bucket    The bucket index
+         *
+         * @return the number of values in the given bucket.
+         */
+        Uint64 getBucketCount(size_t bucket) const {
+            return bucket < BUCKETS ? _counts[bucket].load(std::memory_order_relaxed) : 0;
+        }
+
+        /**
+         * Returns the upper bound of the given bucket.
+         *
+         * The last bucket has no upper bound, and returns infinity.
+         *
+         * @param bucket    The bucket index
+         *
+         * @return the upper bound of the given bucket.
+         */
+        double getBucketBound(size_t bucket) const;
+    };
+
+private:
+    /** The counters */
+    std::atomic<Uint64> _counters[(int)Counter::COUNT];
+    /** The traffic of each event type */
+    std::atomic<Uint64> _traffic[(int)Traffic::COUNT][MAX_TYPES];
+    /** The gauges */
+    std::atomic<Sint64> _gauges[(int)Gauge::COUNT];
+    /** The histograms */
+    Histogram _histograms[(int)Metric::COUNT];
+    /** The name of each event type */
+    std::string _names[MAX_TYPES];
+
+    /** The time of the most recent sample in microseconds */
+    Uint64 _sampleTime;
+    /** The length of the most recent sample interval in seconds */
+    double _interval;
+    /** The counters at the most recent sample */
+    Uint64 _lastCounters[(int)Counter::COUNT];
+    /** The traffic at the most recent sample */
+    Uint64 _lastTraffic[(int)Traffic::COUNT][MAX_TYPES];
+    /** The per second rate of each counter over the most recent interval */
+    double _counterRates[(int)Counter::COUNT];
+    /** The per second rate of each traffic reading over the most recent interval */
+    double _trafficRates[(int)Traffic::COUNT][MAX_TYPES];
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates a new metrics record with every reading zero.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     */
+    NetMetrics();
+
+    /**
+     * Returns a newly allocated metrics record with every reading zero.
+     *
+     * @return a newly allocated metrics record with every reading zero.
+     */
+    static std::shared_ptr<NetMetrics> alloc() {
+        return std::make_shared<NetMetrics>();
+    }
+
+    /**
+     * Resets every reading (and rate) to zero.
+     *
+     * The event type names are retained.
+     */
+    void reset();
+
+#pragma mark Recording
+    /**
+     * Adds the given amount to a counter.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param counter   The counter
+     * @param amount    The amount to add
+     */
+    void add(Counter counter, Uint64 amount=1) {
+        _counters[(int)counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records an outbound event of the given type.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param type  The event type id
+     * @param bytes The size of the event (including the event header)
+     */
+    void recordSent(Uint8 type, size_t bytes) {
+        _traffic[(int)Traffic::EVENTS_SENT][type].fetch_add(1, std::memory_order_relaxed);
+        _traffic[(int)Traffic::BYTES_SENT][type].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * Records an inbound event of the given type.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param type  The event type id
+     * @param bytes The size of the event (including the event header)
+     */
+    void recordReceived(Uint8 type, size_t bytes) {
+        _traffic[(int)Traffic::EVENTS_RECEIVED][type].fetch_add(1, std::memory_order_relaxed);
+        _traffic[(int)Traffic::BYTES_RECEIVED][type].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * Sets the value of a gauge.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param gauge The gauge
+     * @param value The current value
+     */
+    void set(Gauge gauge, Sint64 value) {
+        _gauges[(int)gauge].store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds a value to a histogram.
+     *
+     * This method is safe to call from any thread.
+     *
+     * @param metric    The histogram
+     * @param value     The value to add
+     */
+    void record(Metric metric, double value) {
+        _histograms[(int)metric].record(value);
+    }
+
+#pragma mark Readings
+    /**
+     * Returns the total of a counter.
+     *
+     * @param counter   The counter
+     *
+     * @return the total of a counter.
+     */
+    Uint64 get(Counter counter) const {
+        return _counters[(int)counter].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the total of a traffic reading for the given event type.
+     *
+     * @param reading   The traffic reading
+     * @param type      The event type id
+     *
+     * @return the total of a traffic reading for the given event type.
+     */
+    Uint64 get(Traffic reading, Uint8 type) const {
+        return _traffic[(int)reading][type].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the current value of a gauge.
+     *
+     * @param gauge The gauge
+     *
+     * @return the current value of a gauge.
+     */
+    Sint64 get(Gauge gauge) const {
+        return _gauges[(int)gauge].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the given histogram.
+     *
+     * @param metric    The histogram
+     *
+     * @return the given histogram.
+     */
+    const Histogram& get(Metric metric) const {
+        return _histograms[(int)metric];
+    }
+
+    /**
+     * Returns the name of the given event type.
+     *
+     * If the type has no name, this is "type" followed by the id.
+     *
+     * @param type  The event type id
+     *
+     * @return the name of the given event type.
+     */
+    std::string getTypeName(Uint8 type) const;
+
+    /**
+     * Sets the name of the given event type.
+     *
+     * Only named types are exported as CSV. This method should be called
+     * before sampling begins.
+     *
+     * @param type  The event type id
+     * @param name  The event type name
+     */
+    void setTypeName(Uint8 type, const std::string name) {
+        _names[type] = name;
+    }
+
+#pragma mark Sampling
+    /**
+     * Computes the rate of every counter since the previous sample.
+     *
+     * The rates are per second of the given clock. Typically this is the
+     * elapsed time of the application, but a simulation may use any clock.
+     * The first sample only establishes the start of the interval.
+     *
+     * @param micros    The current time in microseconds
+     */
+    void sample(Uint64 micros);
+
+    /**
+     * Returns the time of the most recent sample in microseconds.
+     *
+     * @return the time of the most recent sample in microseconds.
+     */
+    Uint64 getSampleTime() const { return _sampleTime; }
+
+    /**
+     * Returns the length of the most recent sample interval in seconds.
+     *
+     * @return the length of the most recent sample interval in seconds.
+     */
+    double getSampleInterval() const { return _interval; }
+
+    /**
+     * Returns the per second rate of a counter over the most recent interval.
+     *
+     * @param counter   The counter
+     *
+     * @return the per second rate of a counter over the most recent interval.
+     */
+    double getRate(Counter counter) const {
+        return _counterRates[(int)counter];
+    }
+
+    /**
+     * Returns the per second rate of a traffic reading over the most recent interval.
+     *
+     * @param reading   The traffic reading
+     * @param type      The event type id
+     *
+     * @return the per second rate of a traffic reading over the most recent interval.
+     */
+    double getRate(Traffic reading, Uint8 type) const {
+        return _trafficRates[(int)reading][type];
+    }
+
+#pragma mark Export
+    /**
+     * Returns a JSON object with every reading.
+     *
+     * Only event types with traffic (or a name) are included.
+     *
+     * @return a JSON object with every reading.
+     */
+    std::shared_ptr<JsonValue> toJson() const;
+
+    /**
+     * Returns the header row for {@link #toCSV}.
+     *
+     * The columns depend on the named event types, so the header should
+     * be written after every type is attached.
+     *
+     * @return the header row for {@link #toCSV}.
+     */
+    std::string getCSVHeader() const;
+
+    /**
+     * Returns a CSV row with the most recent sample.
+     *
+     * The row has the time, the rate of every counter and of the traffic
+     * of every named event type, every gauge, and a summary of every
+     * histogram. It does not include a line terminator.
+     *
+     * @return a CSV row with the most recent sample.
+     */
+    std::string toCSV() const;
+};
+
+        }
+    }
+}
+
+#endif /* __CU_NET_METRICS_H__ */
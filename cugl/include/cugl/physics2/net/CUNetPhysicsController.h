@@ -47,7 +47,14 @@
 #include "CUPhysSyncEvent.h"
 #include "CUGameStateEvent.h"
 #include "CUObstacleFactory.h"
+#include "CUInterestGrid.h"
+#include "CUSyncScheduler.h"
+#include "CUNetMetrics.h"
 #include <queue>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_set>
 
 namespace cugl {
     /**
@@ -140,6 +147,258 @@ public:
         PRIO_SYNC
     };
     
+    /**
+     * The methods for smoothing synchronized objects.
+     */
+    enum class ItprMethod : int {
+        /** Ease linearly toward the latest synchronization */
+        LINEAR = 0,
+        /** Ease along a Bezier curve toward the latest synchronization */
+        BEZIER = 1,
+        /** Ease along a Hermite curve toward the latest synchronization */
+        HERMITE = 2,
+        /** Steer the velocity toward the latest synchronization */
+        PID = 3,
+        /**
+         * Interpolate between buffered synchronizations.
+         *
+         * Objects are displayed a small, adaptive delay behind the sender,
+         * so that there are (usually) two snapshots bracketing the display
+         * time. This trades latency for robustness to network jitter.
+         */
+        BUFFERED = 4
+    };
+    
+    /**
+     * A single synchronized state in a snapshot buffer.
+     */
+    class BufferedState {
+    public:
+        /** The sender tick of this state */
+        Uint64 tick;
+        /** The position */
+        Vec2 pos;
+        /** The linear velocity */
+        Vec2 vel;
+        /** The angle (unwrapped relative to the previous state) */
+        float angle;
+        /** The angular velocity */
+        float angV;
+        /** The change in position per tick since the previous state */
+        Vec2 rate;
+        /** The change in angle per tick since the previous state */
+        float angRate;
+    };
+    
+    /**
+     * The buffered synchronizations of a single obstacle.
+     */
+    class SnapshotBuffer {
+    public:
+        /** The UUID of the sender of these states */
+        std::string source;
+        /** The states in increasing tick order */
+        std::deque<BufferedState> states;
+        /** The average number of ticks between states */
+        float interval;
+        
+        /** Creates an empty snapshot buffer */
+        SnapshotBuffer() : interval(1) {}
+    };
+    
+    /**
+     * A single locally predicted step of an obstacle.
+     */
+    class PredictedState {
+    public:
+        /** The game tick of this step */
+        Uint64 tick;
+        /** The input velocity of this step (sent to the host) */
+        Vec2 input;
+        /** The predicted position after this step */
+        Vec2 pos;
+        /** The predicted change in position during this step */
+        Vec2 delta;
+    };
+    
+    /**
+     * The ring buffer of predicted steps for a locally predicted obstacle.
+     */
+    class PredictionBuffer {
+    public:
+        /** The predicted steps, as a ring buffer */
+        std::vector<PredictedState> ring;
+        /** The position of the oldest step in the ring */
+        size_t head;
+        /** The number of steps in the ring */
+        size_t count;
+        
+        /** Creates an empty prediction buffer */
+        PredictionBuffer() : head(0), count(0) {}
+    };
+    
+    /**
+     * An obstacle predicted by a remote peer (host only).
+     */
+    class RemotePrediction {
+    public:
+        /** The UUID of the predicting peer */
+        std::string source;
+        /** The last input tick of the predicting peer applied to the obstacle */
+        Uint64 tick;
+        
+        /** Creates a remote prediction with no applied input */
+        RemotePrediction() : tick(0) {}
+    };
+    
+    /**
+     * The estimated clock of a peer sending synchronizations.
+     */
+    class ClockEstimate {
+    public:
+        /** The average difference between the local tick and the sender tick */
+        float offset;
+        /** The average variation of that difference (jitter) */
+        float jitter;
+        /** The most recent difference between the local and sender tick */
+        float last;
+        
+        /** Creates a clock estimate with no samples */
+        ClockEstimate() : offset(0), jitter(0), last(0) {}
+    };
+    
+    /**
+     * The history of a stream of compact snapshots.
+     *
+     * A stream is either the broadcast snapshots of a machine, or the direct
+     * snapshots between a pair of machines. Snapshots are only delta encoded
+     * against earlier snapshots in the same stream.
+     */
+    class SyncStream {
+    public:
+        /** The snapshots that may still serve as a baseline, by sequence */
+        std::map<Uint32,std::shared_ptr<PhysSyncEvent::Snapshot>> snapshots;
+        /** The retained sequences acknowledged by each receiving peer (sender only) */
+        std::unordered_map<std::string,std::set<Uint32>> acks;
+        /** The sequence of the latest snapshot applied (receiver only) */
+        Uint32 latest;
+        
+        /** Creates an empty stream */
+        SyncStream() : latest(0) {}
+    };
+    
+    /**
+     * The last state of an obstacle sent in a synchronization.
+     *
+     * This is the state that peers extrapolate from until the next update.
+     */
+    class RestState {
+    public:
+        /** The local tick this state was sent at */
+        Uint64 tick;
+        /** The position */
+        Vec2 pos;
+        /** The linear velocity */
+        Vec2 vel;
+        /** The angle */
+        float angle;
+        /** The angular velocity */
+        float angV;
+    };
+    
+    /**
+     * The interest region of a peer.
+     *
+     * Obstacles in or near this region are synchronized with the peer at full
+     * rate, while all others only get a periodic refresh.
+     */
+    class InterestRegion {
+    public:
+        /** The obstacle at the center of the region (0 for none) */
+        Uint64 obsId;
+        /** The region (only the size is used if centered on an obstacle) */
+        Rect region;
+        
+        /** Creates an empty interest region */
+        InterestRegion() : obsId(0) {}
+    };
+    
+    /**
+     * The world snapshot requests of a peer.
+     *
+     * Requests are coalesced until the host is ready to take a snapshot, so
+     * that a burst of requests for missing obstacles costs a single snapshot.
+     */
+    class ImageRequest {
+    public:
+        /** Whether the peer asked for the entire world */
+        bool complete;
+        /** The requested obstacles (ignored if complete) */
+        std::unordered_set<Uint64> obsIds;
+        
+        /** Creates an empty request */
+        ImageRequest() : complete(false) {}
+    };
+    
+    /**
+     * A world snapshot being streamed to a peer.
+     *
+     * The encoded snapshot is sent a few chunks per tick, so that it does not
+     * crowd out the live updates that keep flowing in the meantime.
+     */
+    class ImageStream {
+    public:
+        /** The snapshot id */
+        Uint32 imageId;
+        /** The game tick at which the snapshot was taken */
+        Uint64 tick;
+        /** The encoded snapshot */
+        std::vector<std::byte> bytes;
+        /** The number of bytes in each chunk */
+        size_t chunkSize;
+        /** The index of the next chunk to send */
+        Uint32 next;
+        /** The number of chunks in the snapshot */
+        Uint32 count;
+        
+        /** Creates an empty stream */
+        ImageStream() : imageId(0), tick(0), chunkSize(0), next(0), count(0) {}
+    };
+    
+    /**
+     * A world snapshot being reassembled from its chunks.
+     */
+    class ImageAssembly {
+    public:
+        /** The UUID of the peer sending the snapshot */
+        std::string source;
+        /** The snapshot id */
+        Uint32 imageId;
+        /** The game tick at which the snapshot was taken */
+        Uint64 tick;
+        /** The chunks received so far, by index */
+        std::vector<std::shared_ptr<std::vector<std::byte>>> chunks;
+        /** The number of chunks received so far */
+        Uint32 received;
+        
+        /** Creates an empty assembly */
+        ImageAssembly() : imageId(0), tick(0), received(0) {}
+    };
+    
+    /**
+     * An obstacle referenced by a peer that does not exist locally.
+     */
+    class MissingObstacle {
+    public:
+        /** The local tick the obstacle was noticed or last requested */
+        Uint64 tick;
+        /** The number of times the obstacle was requested */
+        Uint32 attempts;
+        
+        /** Creates a record for a newly noticed obstacle */
+        MissingObstacle() : tick(0), attempts(0) {}
+    };
+    
     
 #pragma mark PhysicsController Stats
 protected:
@@ -153,6 +412,16 @@ protected:
     long _ovrdCount;
     /** Total number of steps interpolated */
     long _stepSum;
+    /** Total number of buffered updates that ran past the newest state */
+    long _bufferUnderruns;
+    /** Total number of buffered states over all buffered updates */
+    long _bufferDepthSum;
+    /** Total number of buffered updates */
+    long _bufferSamples;
+    /** The most recent display delay of buffered interpolation in ticks */
+    float _bufferDelay;
+    /** The telemetry for this controller (may be nullptr) */
+    std::shared_ptr<NetMetrics> _metrics;
     /** Whether this instance acts as host. */
     bool _isHost;
     
@@ -165,6 +434,28 @@ protected:
     /** Temporary cache for removal after traversal */
     std::vector<std::shared_ptr<physics2::Obstacle>> _deleteCache;
     
+    /** The number of simulation updates (the local tick) */
+    Uint64 _itprTick;
+    /** The snapshot buffers for buffered interpolation */
+    std::unordered_map<std::shared_ptr<physics2::Obstacle>,SnapshotBuffer> _itprBuffers;
+    /** The clock estimates of each sender, by UUID */
+    std::unordered_map<std::string,ClockEstimate> _itprClocks;
+    /** The minimum display delay of buffered interpolation in ticks */
+    float _itprMinDelay;
+    /** The maximum display delay of buffered interpolation in ticks */
+    float _itprMaxDelay;
+    /** The maximum number of ticks to extrapolate past the newest state */
+    float _itprMaxExtrap;
+    
+    /** The current game tick (shared by all peers) */
+    Uint64 _gameTick;
+    /** The predicted steps of each locally predicted obstacle */
+    std::unordered_map<std::shared_ptr<physics2::Obstacle>,PredictionBuffer> _predictions;
+    /** The obstacles predicted by remote peers, by obstacle id (host only) */
+    std::unordered_map<Uint64,RemotePrediction> _remotePredictions;
+    /** The size of the most recent prediction correction */
+    float _predictError;
+    
     /** Vector of attached obstacle factories for obstacle creation */
     std::vector<std::shared_ptr<ObstacleFactory>> _obstacleFacts;
     /** Function for linking newly added obstacle to a scene node */
@@ -176,6 +467,76 @@ protected:
     /** Vector of generated events to be sent */
     std::vector<std::shared_ptr<NetEvent>> _outEvents;
     
+    /** Whether to send physics synchronizations in the compact encoding */
+    bool _compactSync;
+    /** The bit budgets for compact physics synchronizations */
+    PhysSyncEvent::Quantization _syncQuant;
+    /** The sequence number of the last compact snapshot sent */
+    Uint32 _syncSequence;
+    /** The peers that receive physics synchronizations */
+    std::unordered_set<std::string> _syncPeers;
+    /** The compact snapshot streams sent, by destination ("" for broadcast) */
+    std::unordered_map<std::string,SyncStream> _sentStreams;
+    /** The compact snapshot streams received, by source and directness */
+    std::map<std::pair<std::string,bool>,SyncStream> _recvStreams;
+    /** The tick of the latest raw snapshot received, by source */
+    std::unordered_map<std::string,Uint64> _recvSyncTicks;
+    
+    /** The uniform grid for interest management */
+    std::shared_ptr<InterestGrid> _interestGrid;
+    /** The interest regions of the peers, by UUID */
+    std::unordered_map<std::string,InterestRegion> _interests;
+    /** The number of synchronizations between refreshes of far obstacles */
+    Uint32 _farRefreshRate;
+    /** The number of full synchronizations packed so far */
+    Uint64 _syncCount;
+    /** Generated events to be sent to a single peer, by UUID */
+    std::unordered_map<std::string,std::vector<std::shared_ptr<NetEvent>>> _directEvents;
+    
+    /** The priority accumulator for prioritized synchronizations */
+    std::shared_ptr<SyncScheduler> _syncScheduler;
+    /** The number of bytes available to each prioritized synchronization */
+    size_t _syncBudget;
+    
+    /** Whether to leave obstacles at rest out of full synchronizations */
+    bool _restSuppress;
+    /** The position error (from extrapolation) tolerated by rest suppression */
+    float _restPosTolerance;
+    /** The angle error (from extrapolation) tolerated by rest suppression */
+    float _restAngleTolerance;
+    /** The maximum number of ticks an obstacle may go without a keyframe */
+    Uint32 _restRefreshRate;
+    /** The last state sent for each obstacle, by obstacle id */
+    std::unordered_map<Uint64,RestState> _restStates;
+    
+    /** The factory call of every obstacle created at runtime, by obstacle id */
+    std::unordered_map<Uint64,PhysObstEvent::Record> _creations;
+    /** The pending world snapshot requests, by peer UUID (host only) */
+    std::unordered_map<std::string,ImageRequest> _imageRequests;
+    /** The world snapshots being streamed, by peer UUID (host only) */
+    std::unordered_map<std::string,ImageStream> _imageStreams;
+    /** The id of the last world snapshot taken */
+    Uint32 _imageSequence;
+    /** The maximum number of bytes in one snapshot chunk */
+    size_t _imageChunkSize;
+    /** The maximum number of snapshot chunks sent to a peer each tick */
+    Uint32 _imageChunkRate;
+    /** The world snapshot being reassembled */
+    ImageAssembly _imageAssembly;
+    /** Whether we are waiting on a complete world snapshot */
+    bool _imageLoading;
+    /** The obstacle events received while waiting on a complete world snapshot */
+    std::vector<std::shared_ptr<PhysObstEvent>> _imageBacklog;
+    /** The shared obstacles that existed when the complete snapshot was requested */
+    std::unordered_set<Uint64> _imageKnown;
+    /** The obstacles referenced by peers that do not exist locally, by id */
+    std::unordered_map<Uint64,MissingObstacle> _missingObs;
+    
+    /** The number of ticks between world state digests (0 to disable) */
+    Uint32 _digestInterval;
+    /** The number of consecutive world state digests that disagreed with ours */
+    Uint32 _digestMismatches;
+    
     /**
      * Returns the result of linear object interpolation.
      *
@@ -185,6 +546,258 @@ protected:
      */
     float interpolate(int stepsLeft, float target, float source);
     
+    /**
+     * Returns the baseline for the next compact snapshot to a destination.
+     *
+     * This is the latest retained snapshot in that stream acknowledged by
+     * every peer receiving it. Snapshots are sent unreliably, so a peer that
+     * acknowledged a later snapshot may never have received an earlier one.
+     * If no retained snapshot was acknowledged by every peer, this method
+     * returns 0, and the next snapshot is sent in full.
+     *
+     * @param dest  The destination UUID ("" for broadcast)
+     *
+     * @return the baseline for the next compact snapshot to a destination.
+     */
+    Uint32 getSyncBaseline(const std::string dest) const;
+    
+    /**
+     * Switches an outbound event to the compact encoding (if enabled).
+     *
+     * This method assigns the event a sequence number and a baseline in the
+     * stream for the given destination, and records its snapshot.
+     *
+     * @param event The event to encode
+     * @param dest  The destination UUID ("" for broadcast)
+     */
+    void encodeSync(const std::shared_ptr<PhysSyncEvent>& event, const std::string dest);
+    
+    /**
+     * Packs a full synchronization for each peer based on its interest.
+     *
+     * Each peer receives the obstacles in or near its interest region, plus
+     * a rotating slice of the remaining obstacles. Peers without an interest
+     * region receive every obstacle.
+     */
+    void packInterestSync();
+    
+    /**
+     * Returns true if a peer can extrapolate the state of an obstacle.
+     *
+     * This is the case if the current state is within tolerance of the last
+     * state sent, extrapolated to the current tick. A sleeping obstacle is
+     * suppressed once a resting state has been sent. Every obstacle is still
+     * sent once every {@link #getRestRefreshRate} ticks as a keyframe.
+     *
+     * @param obsId The obstacle id
+     * @param obs   The obstacle
+     *
+     * @return true if a peer can extrapolate the state of an obstacle.
+     */
+    bool isSyncRedundant(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obs);
+    
+    /**
+     * Records the state of an obstacle added to a synchronization.
+     *
+     * @param obsId The obstacle id
+     * @param obs   The obstacle
+     */
+    void recordSyncState(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obs);
+    
+    /**
+     * Updates the clock estimate of a sender of synchronizations.
+     *
+     * This method is used for buffered interpolation, and should be called
+     * once for each synchronization received.
+     *
+     * @param source    The UUID of the sender
+     * @param tick      The sender tick of the synchronization
+     */
+    void updateClock(const std::string source, Uint64 tick);
+    
+    /**
+     * Adds a synchronized state to the snapshot buffer of an obstacle.
+     *
+     * This method is used for buffered interpolation. The clock estimate of
+     * the sender should be updated first.
+     *
+     * @param obj       The synchronized obstacle
+     * @param source    The UUID of the sender
+     * @param tick      The sender tick of the state
+     * @param param     The synchronized state
+     */
+    void bufferSyncObject(const std::shared_ptr<physics2::Obstacle>& obj, const std::string source,
+                          Uint64 tick, const PhysSyncEvent::Parameters& param);
+    
+    /**
+     * Updates every buffered obstacle to the current display time.
+     *
+     * Each obstacle is interpolated between the two states bracketing the
+     * display time. If there is no newer state, the obstacle is extrapolated
+     * for a bounded number of ticks, and the update counts as an underrun
+     * (unless the obstacle is at rest). After that, the obstacle is left to
+     * the local simulation until the next synchronization arrives.
+     */
+    void updateBuffered();
+    
+    /**
+     * Records the current step of every locally predicted obstacle.
+     *
+     * Each step is recorded once per game tick. Recording the same tick
+     * again overwrites the previous record. The input of each new step is
+     * sent to the host, even if it is unchanged, so that the host can tag
+     * its authoritative state with the last applied input.
+     */
+    void recordPredictions();
+    
+    /**
+     * Packs the authoritative state of every remotely predicted obstacle.
+     *
+     * Each state is sent directly to the predicting peer, and is tagged with
+     * the last input tick of that peer applied to the obstacle.
+     */
+    void packPredictStates();
+    
+    /**
+     * Applies a single obstacle delta record to the simulation.
+     *
+     * Every field present in the record is applied in one pass, with
+     * sharing disabled. Records for unknown obstacles are ignored.
+     *
+     * @param delta     The record to apply
+     * @param source    The UUID of the peer that sent the record
+     * @param tick      The game tick the record was sent on
+     */
+    void applyObstDelta(const PhysObstEvent::Delta& delta, const std::string& source, Uint64 tick);
+    
+    /**
+     * Returns the estimated size in bytes of one obstacle in a synchronization.
+     *
+     * This is a conservative estimate that does not account for delta
+     * encoding. It is used to fill the budget of prioritized synchronizations.
+     *
+     * @return the estimated size in bytes of one obstacle in a synchronization.
+     */
+    size_t getSyncEntryCost() const;
+    
+    /**
+     * Creates an obstacle announced by a peer.
+     *
+     * The obstacle is created with the given factory and activated under the
+     * given id. If an obstacle with this id already exists, it is returned
+     * instead, so that a creation may safely be applied twice (once from a
+     * snapshot and once from the live event).
+     *
+     * @param obsId     The obstacle global id
+     * @param factoryId The obstacle factory id
+     * @param params    The packed parameters for the factory
+     *
+     * @return the created obstacle
+     */
+    std::shared_ptr<physics2::Obstacle> createRemoteObstacle(Uint64 obsId, Uint32 factoryId,
+                                                             const std::shared_ptr<std::vector<std::byte>>& params);
+    
+    /**
+     * Removes an obstacle deleted by a peer.
+     *
+     * This removes the obstacle from the world and the scene graph, and
+     * clears any synchronization state kept for it.
+     *
+     * @param obsId The obstacle global id
+     * @param obj   The obstacle to remove
+     */
+    void removeRemoteObstacle(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obj);
+    
+    /**
+     * Records that a peer referenced an obstacle that does not exist locally.
+     *
+     * The obstacle will be requested from the host in a later call to
+     * {@link #packImageRequests}.
+     *
+     * @param obsId The obstacle global id
+     */
+    void noteMissing(Uint64 obsId);
+    
+    /**
+     * Requests a snapshot of the missing obstacles from the host.
+     *
+     * All obstacles due for a request are coalesced into a single
+     * {@link PhysObstEvent::EventType::WORLD_REQUEST} event. An obstacle is
+     * only requested a few times before it is given up on.
+     */
+    void packImageRequests();
+    
+    /**
+     * Streams the requested world snapshots to their peers.
+     *
+     * A snapshot is taken for a peer whenever it has pending requests and is
+     * not already receiving one. Each stream sends at most
+     * {@link #getImageChunkRate} chunks per call (host only).
+     */
+    void packImageChunks();
+    
+    /**
+     * Returns a snapshot of the requested obstacles, encoded as bytes.
+     *
+     * @param request   The obstacles to include
+     *
+     * @return a snapshot of the requested obstacles, encoded as bytes.
+     */
+    std::vector<std::byte> captureImage(const ImageRequest& request);
+    
+    /**
+     * Adds a chunk to the world snapshot being reassembled.
+     *
+     * When the last chunk arrives, the snapshot is applied with
+     * {@link #applyImage}. A chunk from a newer snapshot discards any
+     * older snapshot still being reassembled.
+     *
+     * @param event The chunk to add
+     */
+    void receiveImageChunk(const std::shared_ptr<PhysObstEvent>& event);
+    
+    /**
+     * Applies a world snapshot to the simulation.
+     *
+     * The snapshot is applied in a single pass. Missing obstacles are created,
+     * and every obstacle in it is set to its recorded state. A complete
+     * snapshot also removes the shared obstacles that were deleted before it
+     * was taken. Finally, any obstacle events held back while waiting on a
+     * complete snapshot are replayed if they are not older than it.
+     *
+     * @param records   The obstacles in the snapshot
+     * @param complete  Whether the snapshot contains the entire world
+     * @param source    The UUID of the peer that sent the snapshot
+     * @param tick      The game tick at which the snapshot was taken
+     */
+    void applyImage(const std::vector<PhysObstEvent::Record>& records, bool complete,
+                    const std::string& source, Uint64 tick);
+    
+    /**
+     * Compares the world state digest of the host with our own.
+     *
+     * If the digests disagree twice in a row, we send our region digests to
+     * the host, so that it can repair the regions that have diverged. A
+     * single disagreement is ignored, as it is often an obstacle that is
+     * just coming to rest on one machine before the other.
+     *
+     * @param source    The UUID of the host
+     * @param digest    The world state digest of the host
+     * @param regions   The number of digest regions of the host
+     */
+    void processWorldDigest(const std::string& source, Uint64 digest, Uint32 regions);
+    
+    /**
+     * Repairs the regions where a peer disagrees with our state digests.
+     *
+     * The settled obstacles in every region that disagrees are sent to the
+     * peer as a world snapshot (host only).
+     *
+     * @param source    The UUID of the peer
+     * @param digests   The region state digests of the peer
+     */
+    void processRegionDigests(const std::string& source, const std::vector<Uint64>& digests);
+    
     
 #pragma mark Constructors
 public:
@@ -345,7 +958,7 @@ public:
      * @return true if the given obstacle is being interpolated.
      */
     bool isInSync(std::shared_ptr<physics2::Obstacle> obs) {
-        return _cache.count(obs) > 0;
+        return _cache.count(obs) > 0 || _itprBuffers.count(obs) > 0;
     }
     
     /**
@@ -359,6 +972,622 @@ public:
     void addSyncObject(std::shared_ptr<physics2::Obstacle> obj,
                        const std::shared_ptr<TargetParams>& param);
     
+#pragma mark Interpolation
+    /**
+     * Returns the method for smoothing synchronized objects.
+     *
+     * @return the method for smoothing synchronized objects.
+     */
+    ItprMethod getInterpolation() const {
+        return (ItprMethod)_itprMethod;
+    }
+    
+    /**
+     * Sets the method for smoothing synchronized objects.
+     *
+     * Switching methods discards any interpolation in progress.
+     *
+     * @param method    The method for smoothing synchronized objects
+     */
+    void setInterpolation(ItprMethod method);
+    
+    /**
+     * Sets the range of the display delay for buffered interpolation.
+     *
+     * The delay adapts to the measured jitter and the rate of snapshots, but
+     * it is always clamped to this range. The delay is measured in ticks.
+     *
+     * @param min   The minimum delay in ticks
+     * @param max   The maximum delay in ticks
+     */
+    void setBufferDelayRange(float min, float max) {
+        _itprMinDelay = SDL_max(min,0.0f);
+        _itprMaxDelay = SDL_max(max,_itprMinDelay);
+    }
+    
+    /**
+     * Returns the maximum number of ticks to extrapolate a buffered obstacle.
+     *
+     * When buffered interpolation runs past the newest snapshot of an
+     * obstacle, it is extrapolated for at most this many ticks. It then
+     * holds still until the next snapshot arrives.
+     *
+     * @return the maximum number of ticks to extrapolate a buffered obstacle.
+     */
+    float getMaxExtrapolation() const {
+        return _itprMaxExtrap;
+    }
+    
+    /**
+     * Sets the maximum number of ticks to extrapolate a buffered obstacle.
+     *
+     * When buffered interpolation runs past the newest snapshot of an
+     * obstacle, it is extrapolated for at most this many ticks. It then
+     * holds still until the next snapshot arrives.
+     *
+     * @param ticks The maximum number of ticks to extrapolate
+     */
+    void setMaxExtrapolation(float ticks) {
+        _itprMaxExtrap = SDL_max(ticks,0.0f);
+    }
+    
+    /**
+     * Returns the most recent display delay of buffered interpolation.
+     *
+     * The delay is measured in ticks behind the newest expected snapshot.
+     *
+     * @return the most recent display delay of buffered interpolation.
+     */
+    float getBufferDelay() const {
+        return _bufferDelay;
+    }
+    
+    /**
+     * Returns the average number of states in a snapshot buffer.
+     *
+     * This average is taken over every buffered update since the stats
+     * were last reset.
+     *
+     * @return the average number of states in a snapshot buffer.
+     */
+    float getAverageBufferDepth() const {
+        return _bufferSamples ? ((float)_bufferDepthSum)/_bufferSamples : 0.0f;
+    }
+    
+    /**
+     * Returns the number of buffered updates that ran past the newest state.
+     *
+     * Each of these updates was extrapolated (or held still), and indicates
+     * that the display delay was too small for the network conditions.
+     *
+     * @return the number of buffered updates that ran past the newest state.
+     */
+    long getBufferUnderruns() const {
+        return _bufferUnderruns;
+    }
+    
+    /**
+     * Resets the buffered interpolation statistics.
+     */
+    void resetBufferStats() {
+        _bufferUnderruns = 0;
+        _bufferDepthSum = 0;
+        _bufferSamples = 0;
+    }
+    
+    /**
+     * Returns the telemetry for this controller.
+     *
+     * This value is nullptr if there is no telemetry.
+     *
+     * @return the telemetry for this controller.
+     */
+    const std::shared_ptr<NetMetrics>& getMetrics() const {
+        return _metrics;
+    }
+    
+    /**
+     * Sets the telemetry for this controller.
+     *
+     * The controller records the size of every correction, the depth of
+     * every snapshot buffer, and the number of snap overrides, underruns
+     * and stale snapshots. Setting this to nullptr disables telemetry.
+     *
+     * @param metrics   The telemetry for this controller
+     */
+    void setMetrics(const std::shared_ptr<NetMetrics>& metrics) {
+        _metrics = metrics;
+    }
+    
+#pragma mark Snapshot Compression
+    /**
+     * Returns true if physics synchronizations use the compact encoding.
+     *
+     * In the compact encoding, every {@link PhysSyncEvent} is quantized and
+     * delta encoded against the last snapshot acknowledged by every peer.
+     * This is enabled by default.
+     *
+     * @return true if physics synchronizations use the compact encoding.
+     */
+    bool isCompactSync() const {
+        return _compactSync;
+    }
+    
+    /**
+     * Sets whether physics synchronizations use the compact encoding.
+     *
+     * In the compact encoding, every {@link PhysSyncEvent} is quantized and
+     * delta encoded against the last snapshot acknowledged by every peer.
+     * Receivers decode either encoding, so this is safe to toggle at any time.
+     *
+     * @param value Whether to use the compact encoding
+     */
+    void setCompactSync(bool value) {
+        _compactSync = value;
+    }
+    
+    /**
+     * Returns the bit budgets for compact physics synchronizations.
+     *
+     * By default, positions are quantized against the world bounds.
+     *
+     * @return the bit budgets for compact physics synchronizations.
+     */
+    const PhysSyncEvent::Quantization& getSyncQuantization() const {
+        return _syncQuant;
+    }
+    
+    /**
+     * Sets the bit budgets for compact physics synchronizations.
+     *
+     * All peers must use the same bit budgets. Hence this should be set
+     * before the game starts, and never changed during a session.
+     *
+     * @param quant The bit budgets for compact physics synchronizations
+     */
+    void setSyncQuantization(const PhysSyncEvent::Quantization& quant) {
+        _syncQuant = quant;
+    }
+    
+    /**
+     * Sets the peers that receive physics synchronizations.
+     *
+     * A broadcast snapshot is only used as a delta baseline once all of these
+     * peers have acknowledged it. They are also the recipients of per-peer
+     * synchronizations for interest management. Acknowledgements and interest
+     * regions of peers that have left are discarded. This method is called automatically by
+     * the {@link NetEventController} every tick, so peers may join or leave
+     * at any time.
+     *
+     * @param peers The UUIDs of the peers (not including this machine)
+     */
+    void setSyncPeers(const std::unordered_set<std::string>& peers);
+    
+    /**
+     * Processes the acknowledgement of a compact snapshot.
+     *
+     * This method is called automatically by the NetEventController. It is
+     * ignored if the snapshot was not sent by this physics world.
+     *
+     * @param source    The UUID of the acknowledging peer
+     * @param shortUID  The shortUID of the world that sent the snapshot
+     * @param sequence  The sequence number of the acknowledged snapshot
+     */
+    void processSyncAck(const std::string source, Uint32 shortUID, Uint32 sequence);
+    
+#pragma mark Interest Management
+    /**
+     * Sets the interest region of this machine, centered on an obstacle.
+     *
+     * Peers synchronize the obstacles in or near this region at full rate,
+     * and only periodically refresh the others. The region follows the
+     * obstacle (typically the player avatar). The region is announced to all
+     * peers with a {@link GameStateEvent}.
+     *
+     * @param obs   The obstacle at the center of the region
+     * @param size  The size of the region
+     */
+    void setInterest(const std::shared_ptr<physics2::Obstacle>& obs, const Size size);
+    
+    /**
+     * Sets the interest region of this machine.
+     *
+     * Peers synchronize the obstacles in or near this region at full rate,
+     * and only periodically refresh the others. An empty region clears the
+     * interest, so that peers synchronize everything at full rate. The region
+     * is announced to all peers with a {@link GameStateEvent}.
+     *
+     * @param region    The interest region
+     */
+    void setInterest(const Rect region);
+    
+    /**
+     * Processes the interest region announced by a peer.
+     *
+     * This method is called automatically by the NetEventController.
+     *
+     * @param source    The UUID of the peer
+     * @param obsId     The obstacle at the center of the region (0 for none)
+     * @param region    The interest region
+     */
+    void processInterest(const std::string source, Uint64 obsId, const Rect region);
+    
+    /**
+     * Returns the number of synchronizations between far obstacle refreshes.
+     *
+     * Obstacles outside the interest region of a peer are refreshed in a
+     * rotating slice, so each one is sent once every this many full
+     * synchronizations.
+     *
+     * @return the number of synchronizations between far obstacle refreshes.
+     */
+    Uint32 getFarRefreshRate() const {
+        return _farRefreshRate;
+    }
+    
+    /**
+     * Sets the number of synchronizations between far obstacle refreshes.
+     *
+     * Obstacles outside the interest region of a peer are refreshed in a
+     * rotating slice, so each one is sent once every this many full
+     * synchronizations.
+     *
+     * @param rate  The number of synchronizations between refreshes
+     */
+    void setFarRefreshRate(Uint32 rate) {
+        _farRefreshRate = SDL_max(rate,1);
+    }
+    
+    /**
+     * Sets the cell size of the interest management grid.
+     *
+     * Obstacles in any cell overlapping the interest region of a peer are
+     * synchronized at full rate. So larger cells include more nearby
+     * obstacles, at a lower cost per query.
+     *
+     * @param size  The width and height of each cell
+     */
+    void setInterestCellSize(float size);
+    
+    /**
+     * Returns the priority accumulator for prioritized synchronizations.
+     *
+     * The scheduler can be used to tune the weights of the priority of each
+     * obstacle. See {@link SyncScheduler} for details.
+     *
+     * @return the priority accumulator for prioritized synchronizations.
+     */
+    std::shared_ptr<SyncScheduler> getSyncScheduler() const {
+        return _syncScheduler;
+    }
+    
+    /**
+     * Returns the number of bytes available to each prioritized synchronization.
+     *
+     * Every call to {@link #packPhysSync} with {@link SyncType#PRIO_SYNC}
+     * sends the obstacles with the highest priority that fit in this budget.
+     *
+     * @return the number of bytes available to each prioritized synchronization.
+     */
+    size_t getSyncBudget() const {
+        return _syncBudget;
+    }
+    
+    /**
+     * Sets the number of bytes available to each prioritized synchronization.
+     *
+     * Every call to {@link #packPhysSync} with {@link SyncType#PRIO_SYNC}
+     * sends the obstacles with the highest priority that fit in this budget.
+     *
+     * @param budget    The number of bytes for each synchronization
+     */
+    void setSyncBudget(size_t budget) {
+        _syncBudget = budget;
+    }
+    
+#pragma mark Rest Suppression
+    /**
+     * Returns true if full synchronizations leave out obstacles at rest.
+     *
+     * An obstacle is at rest if it is asleep, or if its state is within
+     * tolerance of the last state sent, extrapolated by its velocity. Peers
+     * keep extrapolating such an obstacle (or leave it at rest) until the
+     * next update. This does not apply to {@link SyncType#OVERRIDE_FULL_SYNC}.
+     *
+     * @return true if full synchronizations leave out obstacles at rest.
+     */
+    bool isRestSuppressed() const {
+        return _restSuppress;
+    }
+    
+    /**
+     * Sets whether full synchronizations leave out obstacles at rest.
+     *
+     * An obstacle is at rest if it is asleep, or if its state is within
+     * tolerance of the last state sent, extrapolated by its velocity. Peers
+     * keep extrapolating such an obstacle (or leave it at rest) until the
+     * next update. This does not apply to {@link SyncType#OVERRIDE_FULL_SYNC}.
+     *
+     * @param value Whether to leave out obstacles at rest
+     */
+    void setRestSuppressed(bool value) {
+        _restSuppress = value;
+        _restStates.clear();
+    }
+    
+    /**
+     * Returns the position error tolerated by rest suppression.
+     *
+     * This is the distance between the current position and the position
+     * a peer extrapolates from the last synchronization. The same tolerance
+     * applies to the linear velocity.
+     *
+     * @return the position error tolerated by rest suppression.
+     */
+    float getRestPositionTolerance() const {
+        return _restPosTolerance;
+    }
+    
+    /**
+     * Sets the position error tolerated by rest suppression.
+     *
+     * This is the distance between the current position and the position
+     * a peer extrapolates from the last synchronization. The same tolerance
+     * applies to the linear velocity.
+     *
+     * @param tolerance The position error tolerated
+     */
+    void setRestPositionTolerance(float tolerance) {
+        _restPosTolerance = SDL_max(tolerance,0.0f);
+    }
+    
+    /**
+     * Returns the angle error (in radians) tolerated by rest suppression.
+     *
+     * This is the difference between the current angle and the angle a peer
+     * extrapolates from the last synchronization. The same tolerance applies
+     * to the angular velocity.
+     *
+     * @return the angle error (in radians) tolerated by rest suppression.
+     */
+    float getRestAngleTolerance() const {
+        return _restAngleTolerance;
+    }
+    
+    /**
+     * Sets the angle error (in radians) tolerated by rest suppression.
+     *
+     * This is the difference between the current angle and the angle a peer
+     * extrapolates from the last synchronization. The same tolerance applies
+     * to the angular velocity.
+     *
+     * @param tolerance The angle error tolerated
+     */
+    void setRestAngleTolerance(float tolerance) {
+        _restAngleTolerance = SDL_max(tolerance,0.0f);
+    }
+    
+    /**
+     * Returns the maximum number of ticks an obstacle may go without a keyframe.
+     *
+     * Obstacles at rest are still sent this often, in case an earlier
+     * synchronization was lost.
+     *
+     * @return the maximum number of ticks an obstacle may go without a keyframe.
+     */
+    Uint32 getRestRefreshRate() const {
+        return _restRefreshRate;
+    }
+    
+    /**
+     * Sets the maximum number of ticks an obstacle may go without a keyframe.
+     *
+     * Obstacles at rest are still sent this often, in case an earlier
+     * synchronization was lost.
+     *
+     * @param rate  The number of ticks between keyframes
+     */
+    void setRestRefreshRate(Uint32 rate) {
+        _restRefreshRate = SDL_max(rate,1);
+    }
+    
+#pragma mark World Snapshots
+    /**
+     * Requests a complete snapshot of the world from the host.
+     *
+     * This should be called by a client that joins (or rejoins) a game in
+     * progress. The host streams the snapshot in chunks, while live updates
+     * keep flowing. Until the snapshot is complete, obstacle events are held
+     * back, and are replayed once the snapshot has been applied.
+     *
+     * This method does nothing on the host.
+     */
+    void requestWorld();
+    
+    /**
+     * Returns true if this controller is waiting on a complete world snapshot.
+     *
+     * @return true if this controller is waiting on a complete world snapshot.
+     */
+    bool isLoadingWorld() const {
+        return _imageLoading;
+    }
+    
+    /**
+     * Returns the maximum number of bytes in one world snapshot chunk.
+     *
+     * @return the maximum number of bytes in one world snapshot chunk.
+     */
+    size_t getImageChunkSize() const {
+        return _imageChunkSize;
+    }
+    
+    /**
+     * Sets the maximum number of bytes in one world snapshot chunk.
+     *
+     * This only affects snapshots taken after this call.
+     *
+     * @param size  The maximum number of bytes in one chunk
+     */
+    void setImageChunkSize(size_t size) {
+        _imageChunkSize = SDL_max(size,(size_t)1);
+    }
+    
+    /**
+     * Returns the maximum number of world snapshot chunks sent to a peer each tick.
+     *
+     * Together with {@link #getImageChunkSize}, this limits the bandwidth
+     * used by snapshots, leaving room for the live updates.
+     *
+     * @return the maximum number of world snapshot chunks sent to a peer each tick.
+     */
+    Uint32 getImageChunkRate() const {
+        return _imageChunkRate;
+    }
+    
+    /**
+     * Sets the maximum number of world snapshot chunks sent to a peer each tick.
+     *
+     * Together with {@link #getImageChunkSize}, this limits the bandwidth
+     * used by snapshots, leaving room for the live updates.
+     *
+     * @param rate  The maximum number of chunks per tick
+     */
+    void setImageChunkRate(Uint32 rate) {
+        _imageChunkRate = SDL_max(rate,1);
+    }
+    
+#pragma mark State Digests
+    /**
+     * Returns the number of ticks between world state digests.
+     *
+     * The host periodically broadcasts a digest of the settled obstacles in
+     * the world (see {@link NetWorld#computeDigests}). Clients that disagree
+     * reply with a digest per region, and the host repairs only those
+     * regions. This lets the host leave sleeping obstacles out of
+     * synchronization entirely, instead of refreshing them blindly every
+     * {@link #getRestRefreshRate} ticks.
+     *
+     * A value of 0 disables digests.
+     *
+     * @return the number of ticks between world state digests.
+     */
+    Uint32 getDigestInterval() const {
+        return _digestInterval;
+    }
+    
+    /**
+     * Sets the number of ticks between world state digests.
+     *
+     * The host periodically broadcasts a digest of the settled obstacles in
+     * the world (see {@link NetWorld#computeDigests}). Clients that disagree
+     * reply with a digest per region, and the host repairs only those
+     * regions. This lets the host leave sleeping obstacles out of
+     * synchronization entirely, instead of refreshing them blindly every
+     * {@link #getRestRefreshRate} ticks.
+     *
+     * A value of 0 disables digests.
+     *
+     * @param ticks The number of ticks between digests
+     */
+    void setDigestInterval(Uint32 ticks) {
+        _digestInterval = ticks;
+        _digestMismatches = 0;
+    }
+    
+#pragma mark Prediction
+    /**
+     * Returns the current game tick.
+     *
+     * This tick is shared by all peers, and is used to match local
+     * predictions with authoritative states from the host.
+     *
+     * @return the current game tick.
+     */
+    Uint64 getGameTick() const {
+        return _gameTick;
+    }
+    
+    /**
+     * Sets the current game tick.
+     *
+     * This tick is shared by all peers, and is used to match local
+     * predictions with authoritative states from the host. This method is
+     * called automatically by the {@link NetEventController}.
+     *
+     * @param tick  The current game tick
+     */
+    void setGameTick(Uint64 tick) {
+        _gameTick = tick;
+    }
+    
+    /**
+     * Predicts an obstacle locally, leaving the host authoritative.
+     *
+     * This is an alternative to {@link #acquireObs} for obstacles controlled
+     * by the input of this client. The client moves the obstacle immediately,
+     * and only its changes in velocity (the inputs) are sent to the host. The
+     * host replies with its authoritative state, tagged with the last input
+     * it applied. The client then rewinds to that state and replays the steps
+     * predicted since, instead of easing toward a stale position.
+     *
+     * This method has no effect on the host.
+     *
+     * @param obs   the obstacle to predict
+     */
+    void predictObs(std::shared_ptr<physics2::Obstacle> obs);
+    
+    /**
+     * Returns true if the given obstacle is predicted locally.
+     *
+     * @param obs   the obstacle to query
+     *
+     * @return true if the given obstacle is predicted locally.
+     */
+    bool isPredicted(std::shared_ptr<physics2::Obstacle> obs) const {
+        return _predictions.count(obs) > 0;
+    }
+    
+    /**
+     * Returns the size of the most recent prediction correction.
+     *
+     * This is the distance between the authoritative position and the local
+     * prediction for the same tick. It should be near zero when the client
+     * and the host agree.
+     *
+     * @return the size of the most recent prediction correction.
+     */
+    float getPredictionError() const {
+        return _predictError;
+    }
+    
+    /**
+     * Processes the announcement of a remotely predicted obstacle.
+     *
+     * This method is called automatically by the NetEventController. It
+     * is ignored if this controller is not the host.
+     *
+     * @param source    The UUID of the predicting peer
+     * @param obsId     The predicted obstacle
+     */
+    void processPredict(const std::string source, Uint64 obsId);
+    
+    /**
+     * Processes the authoritative state of a locally predicted obstacle.
+     *
+     * The obstacle is corrected by the difference between the authoritative
+     * state and the prediction for the given tick, and the steps predicted
+     * after that tick are replayed from the corrected state.
+     *
+     * This method is called automatically by the NetEventController.
+     *
+     * @param obsId The predicted obstacle
+     * @param tick  The last input tick applied to the authoritative state
+     * @param pos   The authoritative position
+     * @param vel   The authoritative linear velocity
+     */
+    void processPredictState(Uint64 obsId, Uint64 tick, const Vec2 pos, const Vec2 vel);
+    
 #pragma mark World Synchronization
     /**
      * Returns the vector of generated events to be sent.
@@ -369,6 +1598,19 @@ public:
         return _outEvents;
     }
     
+    /**
+     * Returns the generated events to be sent to a single peer.
+     *
+     * These events are keyed by the UUID of the peer. They are produced by
+     * interest management, and should be sent with
+     * {@link cugl::net::NetcodeConnection#sendTo}.
+     *
+     * @return the generated events to be sent to a single peer.
+     */
+    std::unordered_map<std::string,std::vector<std::shared_ptr<NetEvent>>>& getDirectOutEvents() {
+        return _directEvents;
+    }
+    
     /**
      * Updates the physics controller.
      */
@@ -377,6 +1619,10 @@ public:
     /**
      * Processes a physics object synchronization event.
      *
+     * Events that reference an unknown obstacle are dropped, but the
+     * obstacle is requested from the host. While waiting on a complete world
+     * snapshot, events are held back and replayed once it has been applied.
+     *
      * This method is called automatically by the NetEventController.
      *
      * @param event The event to be processed
@@ -385,14 +1631,30 @@ public:
     
     /**
      * Processes a physics synchronization event.
+     *
+     * Compact events are first decoded against the snapshot they were delta
+     * encoded from. An event that cannot be decoded (because the baseline is
+     * no longer retained) is dropped.
+     *
+     * Synchronization events are delivered unreliably, and may arrive out of
+     * order. An event older than one already applied from the same stream is
+     * stale, and is also dropped.
+     *
+     * This method is called automatically by the NetEventController.
+     *
+     * @param event The event to be processed
+     *
+     * @return true if the event was applied to the simulation
      */
-    void processPhysSyncEvent(const std::shared_ptr<PhysSyncEvent>& event);
+    bool processPhysSyncEvent(const std::shared_ptr<PhysSyncEvent>& event);
 
     /**
      * Packs object data for synchronization.
      *
      * This data will be added to {@link #getOutEvents}, which is the queue
-     * of information to be sent over the network.
+     * of information to be sent over the network. If any peer has announced
+     * an interest region, a full synchronization is instead split into one
+     * event per peer in {@link #getDirectOutEvents}.
      *
      * This method can be used to prompt the physics controller to synchronize
      * objects. It is called automatically by {@link NetEventController}, but
@@ -408,7 +1670,9 @@ public:
      * This method checks the world for any dirty objects (e.g. objects that
      * have changed state outside of the simulation). If so, it packages
      * that information as an event to send out to other machines on the
-     * network.
+     * network. All of the changes are packed into a single
+     * {@link PhysObstEvent::EventType::DELTA} event, with one record per
+     * dirty obstacle holding only the changed fields.
      */
     void packPhysObj();
     
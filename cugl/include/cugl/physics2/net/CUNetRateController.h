@@ -0,0 +1,439 @@
+//
+//  CUNetRateController.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a congestion-aware send scheduler for networked
+//  physics. It estimates the round trip time and available bandwidth of each
+//  peer from snapshot acknowledgements, and watches the send buffers of the
+//  transport. From these it adapts how often physics snapshots are sent, and
+//  how many bytes each one may use.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_NET_RATE_CONTROLLER_H__
+#define __CU_NET_RATE_CONTROLLER_H__
+
+#include <SDL_stdinc.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <memory>
+#include <map>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A congestion-aware send scheduler for physics snapshots.
+ *
+ * Game events must always be sent, but physics snapshots are superseded by
+ * the next one. So when the network cannot keep up, it is the snapshots that
+ * should give way. This class decides when the next snapshot is due.
+ *
+ * For each peer, the scheduler measures the round trip time from snapshot
+ * acknowledgements (or clock pings), and the delivery rate from the bytes
+ * acknowledged per unit of time. It also samples the number of bytes queued
+ * in the send buffers of the transport. The connection is congested if those
+ * buffers are large or growing, or if the round trip time has risen well
+ * above its minimum (a sign of queuing in the network).
+ *
+ * The snapshot rate follows an additive increase, multiplicative decrease
+ * rule between a minimum and maximum rate. In addition, every peer with a
+ * bandwidth estimate has a token bucket, filled slightly faster than the
+ * estimate when the connection is clear (to probe for more), and slightly
+ * slower when congested (to drain the queues). Every byte sent, including
+ * game events, is charged to the bucket, and snapshots wait for the bucket
+ * to refill. Snapshots are never held back longer than the minimum rate.
+ *
+ * All times are in microseconds.
+ */
+class NetRateController {
+private:
+    /** A snapshot awaiting acknowledgement */
+    class Pending {
+    public:
+        /** The time the snapshot was sent */
+        Uint64 time;
+        /** The total bytes sent to the peer up to and including the snapshot */
+        Uint64 sent;
+    };
+
+    /** The connection to a single peer */
+    class Peer {
+    public:
+        /** The smoothed round trip time (0 if no samples) */
+        double rtt;
+        /** The smoothed round trip time variation */
+        double rttVar;
+        /** The minimum round trip time in the current window */
+        double minRtt;
+        /** The time the minimum round trip time was measured */
+        Uint64 minRttTime;
+        /** The estimated bandwidth in bytes per second (0 if unknown) */
+        double bandwidth;
+        /** The total bytes sent to this peer */
+        Uint64 sent;
+        /** The total bytes sent as of the last acknowledged snapshot */
+        Uint64 ackSent;
+        /** The time of the last acknowledgement */
+        Uint64 ackTime;
+        /** The bytes queued in the send buffers */
+        size_t buffered;
+        /** The bytes queued in the send buffers at the previous update */
+        size_t lastBuffered;
+        /** The bytes that may still be sent (if the bandwidth is known) */
+        double tokens;
+        /** The snapshots awaiting acknowledgement, by sequence */
+        std::map<Uint32,Pending> pending;
+
+        /** Creates a peer with no measurements */
+        Peer();
+    };
+
+    /** The peers, by UUID */
+    std::unordered_map<std::string,Peer> _peers;
+
+    /** The minimum snapshot rate (per second) */
+    double _minRate;
+    /** The maximum snapshot rate (per second) */
+    double _maxRate;
+    /** The current snapshot rate (per second) */
+    double _rate;
+    /** The increase of the snapshot rate per second while clear */
+    double _increase;
+    /** The factor to multiply the snapshot rate by when congested */
+    double _decrease;
+    /** The send buffer size (in bytes) that signals congestion */
+    size_t _bufferLimit;
+    /** The rise in round trip time over its minimum that signals congestion */
+    double _rttTolerance;
+    /** The largest snapshot budget in bytes */
+    size_t _maxBudget;
+
+    /** Whether the connection is currently congested */
+    bool _congested;
+    /** The snapshots accumulated by the current rate (1 means one is due) */
+    double _credit;
+    /** The time since the last snapshot in seconds */
+    double _idle;
+    /** The time of the last update (0 if none) */
+    Uint64 _lastTime;
+    /** The time of the last rate decrease */
+    Uint64 _lastDecrease;
+
+    /**
+     * Adds a round trip time sample for the given peer.
+     *
+     * @param peer  The peer connection
+     * @param rtt   The round trip time
+     * @param now   The current time
+     */
+    void addRoundTrip(Peer& peer, double rtt, Uint64 now);
+
+    /**
+     * Records a snapshot sent to the given peer connection.
+     *
+     * @param peer      The peer connection
+     * @param sequence  The sequence number of the snapshot
+     * @param now       The current time
+     */
+    void addSnapshot(Peer& peer, Uint32 sequence, Uint64 now);
+
+public:
+#pragma mark Constructors
+    /**
+     * Creates a new send scheduler on the stack.
+     *
+     * Send schedulers do not have any nontrivial state and so it is
+     * unnecessary to use an init method. However, we do include a static
+     * {@link #alloc} method for creating shared pointers.
+     */
+    NetRateController();
+
+    /**
+     * Returns a newly allocated send scheduler.
+     *
+     * This method is solely include for convenience purposes.
+     *
+     * @return a newly allocated send scheduler.
+     */
+    static std::shared_ptr<NetRateController> alloc() {
+        return std::make_shared<NetRateController>();
+    }
+
+    /**
+     * Discards all measurements and peers, keeping the settings.
+     *
+     * The snapshot rate starts again at the maximum.
+     */
+    void reset();
+
+#pragma mark Settings
+    /**
+     * Returns the minimum snapshot rate (per second).
+     *
+     * Snapshots are never held back longer than the inverse of this rate.
+     *
+     * @return the minimum snapshot rate (per second).
+     */
+    double getMinRate() const { return _minRate; }
+
+    /**
+     * Returns the maximum snapshot rate (per second).
+     *
+     * This should be no more than the fixed update rate, as at most one
+     * snapshot is sent per update.
+     *
+     * @return the maximum snapshot rate (per second).
+     */
+    double getMaxRate() const { return _maxRate; }
+
+    /**
+     * Sets the range of the snapshot rate (per second).
+     *
+     * The maximum should be no more than the fixed update rate, as at most
+     * one snapshot is sent per update.
+     *
+     * @param minRate   The minimum snapshot rate
+     * @param maxRate   The maximum snapshot rate
+     */
+    void setRateRange(double minRate, double maxRate);
+
+    /**
+     * Returns the send buffer size (in bytes) that signals congestion.
+     *
+     * Buffers that are growing signal congestion at a quarter of this size.
+     *
+     * @return the send buffer size (in bytes) that signals congestion.
+     */
+    size_t getBufferLimit() const { return _bufferLimit; }
+
+    /**
+     * Sets the send buffer size (in bytes) that signals congestion.
+     *
+     * Buffers that are growing signal congestion at a quarter of this size.
+     *
+     * @param limit The send buffer size that signals congestion
+     */
+    void setBufferLimit(size_t limit) { _bufferLimit = limit; }
+
+    /**
+     * Returns the rise in round trip time that signals congestion.
+     *
+     * This is measured over the minimum round trip time in the last few
+     * seconds. A value of 0 disables this signal.
+     *
+     * @return the rise in round trip time that signals congestion.
+     */
+    double getRoundTripTolerance() const { return _rttTolerance; }
+
+    /**
+     * Sets the rise in round trip time that signals congestion.
+     *
+     * This is measured over the minimum round trip time in the last few
+     * seconds. A value of 0 disables this signal.
+     *
+     * @param tolerance The rise in round trip time that signals congestion
+     */
+    void setRoundTripTolerance(double tolerance) { _rttTolerance = tolerance; }
+
+    /**
+     * Returns the largest snapshot budget in bytes.
+     *
+     * This is the budget when no peer has a bandwidth estimate.
+     *
+     * @return the largest snapshot budget in bytes.
+     */
+    size_t getMaxBudget() const { return _maxBudget; }
+
+    /**
+     * Sets the largest snapshot budget in bytes.
+     *
+     * This is the budget when no peer has a bandwidth estimate.
+     *
+     * @param budget    The largest snapshot budget in bytes
+     */
+    void setMaxBudget(size_t budget) { _maxBudget = budget; }
+
+#pragma mark Measurements
+    /**
+     * Sets the peers that this machine sends to.
+     *
+     * Measurements are kept for peers already present, and discarded for
+     * peers that are no longer present.
+     *
+     * @param peers The UUIDs of the peers (not including this machine)
+     */
+    void setPeers(const std::unordered_set<std::string>& peers);
+
+    /**
+     * Records bytes sent to the given peer.
+     *
+     * Every message should be recorded, including game events, so that
+     * snapshots only use the bandwidth that is left. An empty UUID records
+     * a broadcast to every peer.
+     *
+     * @param peer  The UUID of the peer ("" for all)
+     * @param bytes The number of bytes sent
+     */
+    void recordSent(const std::string& peer, size_t bytes);
+
+    /**
+     * Records a snapshot sent to the given peer.
+     *
+     * This should be called after the bytes of the snapshot are recorded.
+     * An empty UUID records a broadcast to every peer.
+     *
+     * @param peer      The UUID of the peer ("" for all)
+     * @param sequence  The sequence number of the snapshot
+     * @param now       The current time
+     */
+    void recordSnapshot(const std::string& peer, Uint32 sequence, Uint64 now);
+
+    /**
+     * Records the acknowledgement of a snapshot by the given peer.
+     *
+     * This measures both the round trip time and the delivery rate. It is
+     * ignored if the snapshot is unknown (or was already acknowledged).
+     *
+     * @param peer      The UUID of the peer
+     * @param sequence  The sequence number of the snapshot
+     * @param now       The current time
+     */
+    void recordAck(const std::string& peer, Uint32 sequence, Uint64 now);
+
+    /**
+     * Records a round trip time measured by other means (e.g. clock pings).
+     *
+     * @param peer  The UUID of the peer
+     * @param rtt   The round trip time
+     * @param now   The current time
+     */
+    void recordRoundTrip(const std::string& peer, double rtt, Uint64 now);
+
+    /**
+     * Records the bytes queued in the send buffers to the given peer.
+     *
+     * @param peer  The UUID of the peer
+     * @param bytes The number of bytes queued
+     */
+    void recordBuffered(const std::string& peer, size_t bytes);
+
+#pragma mark Scheduling
+    /**
+     * Updates the snapshot rate and budgets to the current time.
+     *
+     * This should be called once per fixed update, after the buffers have
+     * been recorded, and before {@link #isSnapshotDue}.
+     *
+     * @param now   The current time
+     */
+    void update(Uint64 now);
+
+    /**
+     * Returns true if a snapshot should be sent in this update.
+     *
+     * If so, this method assumes that the snapshot will be sent, and
+     * schedules the next one.
+     *
+     * @return true if a snapshot should be sent in this update.
+     */
+    bool isSnapshotDue();
+
+    /**
+     * Returns the number of bytes a snapshot may use right now.
+     *
+     * This is the smallest token bucket of any peer with a bandwidth
+     * estimate, but never more than {@link #getMaxBudget}.
+     *
+     * @return the number of bytes a snapshot may use right now.
+     */
+    size_t getBudget() const;
+
+    /**
+     * Returns the current snapshot rate (per second).
+     *
+     * @return the current snapshot rate (per second).
+     */
+    double getRate() const { return _rate; }
+
+    /**
+     * Returns true if the connection is currently congested.
+     *
+     * @return true if the connection is currently congested.
+     */
+    bool isCongested() const { return _congested; }
+
+    /**
+     * Returns the smoothed round trip time to the given peer.
+     *
+     * This value is 0 if there are no measurements.
+     *
+     * @param peer  The UUID of the peer
+     *
+     * @return the smoothed round trip time to the given peer.
+     */
+    double getRoundTripTime(const std::string& peer) const;
+
+    /**
+     * Returns the estimated bandwidth to the given peer in bytes per second.
+     *
+     * This value is 0 if there are no measurements.
+     *
+     * @param peer  The UUID of the peer
+     *
+     * @return the estimated bandwidth to the given peer in bytes per second.
+     */
+    double getBandwidth(const std::string& peer) const;
+
+    /**
+     * Returns the bytes queued in the send buffers to the given peer.
+     *
+     * @param peer  The UUID of the peer
+     *
+     * @return the bytes queued in the send buffers to the given peer.
+     */
+    size_t getBuffered(const std::string& peer) const;
+};
+
+        }
+    }
+}
+
+#endif /* __CU_NET_RATE_CONTROLLER_H__ */
@@ -0,0 +1,414 @@
+//
+//  CUNetTransport.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides the transport interface for networked physics. The
+//  NetEventController does not talk to a NetcodeConnection directly. Instead
+//  it talks to a transport, which makes it possible to replace the WebRTC
+//  connection with an in-process one for testing and benchmarking.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_NET_TRANSPORT_H__
+#define __CU_NET_TRANSPORT_H__
+
+#include <cugl/net/CUNetcodeConfig.h>
+#include <cugl/net/CUNetcodeConnection.h>
+#include <unordered_set>
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * The interface for a connection to a game lobby.
+ *
+ * This is the subset of {@link cugl::net::NetcodeConnection} that is used
+ * by {@link NetEventController}. The states and the message semantics are
+ * the same as that class. In particular, reliable messages from a source
+ * arrive in order, unreliable messages may be lost or reordered, and a
+ * broadcast is also delivered to the sender (with an empty source).
+ *
+ * The default transport is {@link NetcodeTransport}, which wraps a WebRTC
+ * connection. See {@link LoopbackNetwork} for an in-process alternative.
+ */
+class NetTransport {
+public:
+    /** The connection state (identical to that of a NetcodeConnection) */
+    typedef cugl::net::NetcodeConnection::State State;
+
+    /** The function to process received messages */
+    typedef cugl::net::NetcodeConnection::Dispatcher Dispatcher;
+
+    /**
+     * @typedef Factory
+     *
+     * This type represents a function to create a new transport.
+     *
+     * The function is given the network configuration, and the room to join.
+     * If the room is empty, the transport should connect as host. The
+     * transport returned should not yet be open.
+     *
+     * The function type is equivalent to
+     *
+     *      std::function<std::shared_ptr<NetTransport>(const cugl::net::NetcodeConfig& config,
+     *                                                   const std::string room)>
+     */
+    typedef std::function<std::shared_ptr<NetTransport>(const cugl::net::NetcodeConfig& config,
+                                                        const std::string room)> Factory;
+
+    /**
+     * Deletes this transport, disposing all resources
+     */
+    virtual ~NetTransport() {}
+
+#pragma mark Accessors
+    /**
+     * Returns the current state of this transport.
+     *
+     * @return the current state of this transport.
+     */
+    virtual State getState() const = 0;
+
+    /**
+     * Returns true if this transport is open.
+     *
+     * @return true if this transport is open.
+     */
+    virtual bool isOpen() const = 0;
+
+    /**
+     * Returns the UUID for this transport.
+     *
+     * This value is not assigned until the transport is connected.
+     *
+     * @return the UUID for this transport.
+     */
+    virtual std::string getUUID() = 0;
+
+    /**
+     * Returns the UUID of the host player.
+     *
+     * @return the UUID of the host player.
+     */
+    virtual const std::string getHost() = 0;
+
+    /**
+     * Returns the room ID of the connected lobby.
+     *
+     * @return the room ID of the connected lobby.
+     */
+    virtual const std::string getRoom() const = 0;
+
+    /**
+     * Returns the UUIDs of the active players (including this one)
+     *
+     * @return the UUIDs of the active players (including this one)
+     */
+    virtual const std::unordered_set<std::string> getPlayers() = 0;
+
+    /**
+     * Returns true if the given player is currently connected to the game.
+     *
+     * @param player    The player to test for connection
+     *
+     * @return true if the given player is currently connected to the game.
+     */
+    virtual bool isPlayerActive(const std::string player) = 0;
+
+    /**
+     * Returns the number of players currently connected to this game
+     *
+     * @return the number of players currently connected to this game
+     */
+    virtual size_t getNumPlayers() = 0;
+
+    /**
+     * Returns the number of bytes queued for the given player but not yet sent.
+     *
+     * This is used to detect congestion. A transport that cannot measure
+     * its send buffers returns 0.
+     *
+     * @param player    The player to query
+     *
+     * @return the number of bytes queued for the given player but not yet sent.
+     */
+    virtual size_t getBufferedAmount(const std::string /*player*/) { return 0; }
+
+#pragma mark Communication
+    /**
+     * Opens the connection to the lobby.
+     */
+    virtual void open() = 0;
+
+    /**
+     * Closes the connection to the lobby.
+     */
+    virtual void close() = 0;
+
+    /**
+     * Marks the game as started and bans incoming connections.
+     *
+     * This can only be called by the host.
+     */
+    virtual void startSession() = 0;
+
+    /**
+     * Sends a byte array to the specified player.
+     *
+     * @param dst       The UUID of the receiving player
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    virtual bool sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable=true) = 0;
+
+    /**
+     * Sends a byte array to all other players (and this one).
+     *
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    virtual bool broadcast(const std::vector<std::byte>& data, bool reliable=true) = 0;
+
+    /**
+     * Receives incoming network messages.
+     *
+     * The dispatcher is called on every message received since the last
+     * call, up to the given limit.
+     *
+     * @param dispatcher    The function to process received data
+     * @param limit         The maximum number of messages to process
+     *
+     * @return the number of messages processed
+     */
+    virtual size_t receive(const Dispatcher& dispatcher, size_t limit=SIZE_MAX) = 0;
+};
+
+/**
+ * A transport backed by a WebRTC {@link cugl::net::NetcodeConnection}.
+ *
+ * This is the default transport of a {@link NetEventController}. Every
+ * method simply forwards to the connection.
+ */
+class NetcodeTransport : public NetTransport {
+protected:
+    /** The WebRTC connection */
+    std::shared_ptr<cugl::net::NetcodeConnection> _connection;
+
+public:
+    /**
+     * Creates a transport for the given connection.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     *
+     * @param connection    The WebRTC connection
+     */
+    NetcodeTransport(const std::shared_ptr<cugl::net::NetcodeConnection>& connection) :
+    _connection(connection) {}
+
+    /**
+     * Returns a newly allocated transport for the given configuration.
+     *
+     * If the room is empty, the transport will connect as host. Otherwise
+     * it will connect as a client to the given room.
+     *
+     * @param config    The network configuration
+     * @param room      The room to join ("" to host)
+     *
+     * @return a newly allocated transport for the given configuration.
+     */
+    static std::shared_ptr<NetTransport> alloc(const cugl::net::NetcodeConfig& config,
+                                               const std::string room) {
+        auto connection = room.empty() ? cugl::net::NetcodeConnection::alloc(config)
+                                       : cugl::net::NetcodeConnection::alloc(config, room);
+        return connection == nullptr ? nullptr : std::make_shared<NetcodeTransport>(connection);
+    }
+
+    /**
+     * Returns the underlying WebRTC connection.
+     *
+     * @return the underlying WebRTC connection.
+     */
+    const std::shared_ptr<cugl::net::NetcodeConnection>& getConnection() const {
+        return _connection;
+    }
+
+#pragma mark Accessors
+    /**
+     * Returns the current state of this transport.
+     *
+     * @return the current state of this transport.
+     */
+    State getState() const override { return _connection->getState(); }
+
+    /**
+     * Returns true if this transport is open.
+     *
+     * @return true if this transport is open.
+     */
+    bool isOpen() const override { return _connection->isOpen(); }
+
+    /**
+     * Returns the UUID for this transport.
+     *
+     * @return the UUID for this transport.
+     */
+    std::string getUUID() override { return _connection->getUUID(); }
+
+    /**
+     * Returns the UUID of the host player.
+     *
+     * @return the UUID of the host player.
+     */
+    const std::string getHost() override { return _connection->getHost(); }
+
+    /**
+     * Returns the room ID of the connected lobby.
+     *
+     * @return the room ID of the connected lobby.
+     */
+    const std::string getRoom() const override { return _connection->getRoom(); }
+
+    /**
+     * Returns the UUIDs of the active players (including this one)
+     *
+     * @return the UUIDs of the active players (including this one)
+     */
+    const std::unordered_set<std::string> getPlayers() override {
+        return _connection->getPlayers();
+    }
+
+    /**
+     * Returns true if the given player is currently connected to the game.
+     *
+     * @param player    The player to test for connection
+     *
+     * @return true if the given player is currently connected to the game.
+     */
+    bool isPlayerActive(const std::string player) override {
+        return _connection->isPlayerActive(player);
+    }
+
+    /**
+     * Returns the number of players currently connected to this game
+     *
+     * @return the number of players currently connected to this game
+     */
+    size_t getNumPlayers() override { return _connection->getNumPlayers(); }
+
+    /**
+     * Returns the number of bytes queued for the given player but not yet sent.
+     *
+     * @param player    The player to query
+     *
+     * @return the number of bytes queued for the given player but not yet sent.
+     */
+    size_t getBufferedAmount(const std::string player) override {
+        return _connection->getBufferedAmount(player);
+    }
+
+#pragma mark Communication
+    /**
+     * Opens the connection to the lobby.
+     */
+    void open() override { _connection->open(); }
+
+    /**
+     * Closes the connection to the lobby.
+     */
+    void close() override { _connection->close(); }
+
+    /**
+     * Marks the game as started and bans incoming connections.
+     *
+     * This can only be called by the host.
+     */
+    void startSession() override { _connection->startSession(); }
+
+    /**
+     * Sends a byte array to the specified player.
+     *
+     * @param dst       The UUID of the receiving player
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    bool sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable=true) override {
+        return _connection->sendTo(dst, data, reliable);
+    }
+
+    /**
+     * Sends a byte array to all other players (and this one).
+     *
+     * @param data      The byte array to send
+     * @param reliable  Whether to use the reliable, ordered channel
+     *
+     * @return true if the message was (apparently) sent
+     */
+    bool broadcast(const std::vector<std::byte>& data, bool reliable=true) override {
+        return _connection->broadcast(data, reliable);
+    }
+
+    /**
+     * Receives incoming network messages.
+     *
+     * @param dispatcher    The function to process received data
+     * @param limit         The maximum number of messages to process
+     *
+     * @return the number of messages processed
+     */
+    size_t receive(const Dispatcher& dispatcher, size_t limit=SIZE_MAX) override {
+        return _connection->receive(dispatcher, limit);
+    }
+};
+
+        }
+    }
+}
+
+#endif /* __CU_NET_TRANSPORT_H__ */
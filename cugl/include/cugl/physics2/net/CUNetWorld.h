@@ -46,7 +46,7 @@
 #include <cugl/physics2/CUObstacle.h>
 #include <cugl/physics2/CUJoint.h>
 #include <cugl/physics2/CUObstacleWorld.h>
-#include <unordered_map>
+#include <cugl/physics2/net/CUSlotRegistry.h>
 
 namespace cugl {
     /**
@@ -76,27 +76,27 @@ namespace cugl {
  * synchronize objects across the network. That is done by other classes.
  */
 class NetWorld : public ObstacleWorld {
+public:
+    /** A handle to a registered obstacle */
+    typedef SlotRegistry<Obstacle>::Handle ObstacleHandle;
+    /** A view of a range of registered obstacles */
+    typedef SlotRegistry<Obstacle>::View ObstacleView;
+    /** A view of a range of registered joints */
+    typedef SlotRegistry<Joint>::View JointView;
+    
 protected:
     /** UUID of the NetcodeConnection that established this world */
     std::string _uuid;
     /** A shortened version of the identifer for this session */
     Uint32 _shortUID;
     
-    /** Map from obstacle pointers to ids (for pointer swizzling) */
-    std::unordered_map<std::shared_ptr<physics2::Obstacle>,Uint64>  _obsToId;
-    /** Map from ids to obstacle pointers (for pointer swizzling) */
-    std::unordered_map<Uint64, std::shared_ptr<physics2::Obstacle>> _idToObs;
-    /** A reference counter to the number of obstacle owners */
-    std::unordered_map<std::shared_ptr<physics2::Obstacle>,Uint64> _ownedObs;
+    /** The registry of obstacle ids and ownership (for pointer swizzling) */
+    SlotRegistry<physics2::Obstacle> _obsRegistry;
     /** An iterator to keep track of obstacles for queueing purposes */
     std::unordered_set<std::shared_ptr<physics2::Obstacle>>::iterator _nextObstacle;
     
-    /** Map from joint pointers to ids (for pointer swizzling) */
-    std::unordered_map<std::shared_ptr<physics2::Joint>,Uint64>  _jntToId;
-    /** Map from ids to joint pointers (for pointer swizzling) */
-    std::unordered_map<Uint64, std::shared_ptr<physics2::Joint>> _idToJnt;
-    /** A reference counter to the number of joint owners */
-    std::unordered_map<std::shared_ptr<physics2::Joint>,Uint64> _ownedJoints;
+    /** The registry of joint ids and ownership (for pointer swizzling) */
+    SlotRegistry<physics2::Joint> _jntRegistry;
 
     /** The next available id for initial objects */
     Uint32 _nextInitObj;
@@ -107,6 +107,20 @@ protected:
     /** The next available id for shared joints */
     Uint32 _nextSharedJoint;
     
+    /** Whether this world is configured for deterministic simulation */
+    bool _deterministic;
+    /** The obstacles in increasing id order (for deterministic updates) */
+    std::vector<std::shared_ptr<Obstacle>> _updateOrder;
+    /** Whether the update order must be rebuilt */
+    bool _orderDirty;
+    
+    /** The width and height of each state digest region */
+    float _digestSize;
+    /** The position quantum of state digests */
+    float _digestPosQuant;
+    /** The angle quantum of state digests */
+    float _digestAngleQuant;
+    
     /**
      * Activates this obstacle in the shared physics world
      *
@@ -443,6 +457,163 @@ public:
      */
     virtual void removeJoint(const std::shared_ptr<Joint>& joint) override;
 
+#pragma mark -
+#pragma mark Deterministic Simulation
+    /**
+     * Configures this world for deterministic simulation.
+     *
+     * This is required for lockstep networking, where every peer simulates
+     * the world independently from the same inputs. The world is set to
+     * lockstep with the given step size, Box2d sub-stepping is disabled, and
+     * obstacles are updated in increasing id order (instead of hash order).
+     * Obstacle ids, and hence this order, are the same on every peer.
+     *
+     * Bitwise identical results also require every peer to run the same
+     * build, compiled without fast floating point math (e.g. -ffast-math
+     * or /fp:fast), and to create obstacles in the same order.
+     *
+     * @param step  The fixed step size in seconds
+     */
+    void setDeterministic(float step);
+    
+    /**
+     * Returns true if this world is configured for deterministic simulation.
+     *
+     * @return true if this world is configured for deterministic simulation.
+     */
+    bool isDeterministic() const { return _deterministic; }
+    
+    /**
+     * Executes a single step of the physics engine.
+     *
+     * If {@link #isLockStep} is true, then this method will run the physics
+     * simulation for {@link #getStepsize} time, no matter the value of dt.
+     * Otherwise, it will run the simulation for dt seconds. If the world is
+     * deterministic, obstacles and joints are updated in increasing id order.
+     *
+     * @param dt Number of seconds to run the (non-lockstep) simulation
+     */
+    void update(float dt) override;
+    
+#pragma mark -
+#pragma mark State Digests
+    /**
+     * Returns the width and height of each state digest region.
+     *
+     * The world bounds are divided into square regions, and a digest is
+     * computed for each one. Peers compare the digests to find the regions
+     * where their simulations have diverged.
+     *
+     * @return the width and height of each state digest region.
+     */
+    float getDigestRegionSize() const { return _digestSize; }
+    
+    /**
+     * Sets the width and height of each state digest region.
+     *
+     * Every peer must use the same region size, or their digests will never
+     * agree.
+     *
+     * @param size  The width and height of each region
+     */
+    void setDigestRegionSize(float size);
+    
+    /**
+     * Returns the number of state digest regions.
+     *
+     * Positions outside of the world bounds are clamped to the nearest region.
+     *
+     * @return the number of state digest regions.
+     */
+    Uint32 getDigestRegionCount() const;
+    
+    /**
+     * Returns the state digest region containing the given position.
+     *
+     * Regions are numbered in row-major order. Positions outside of the world
+     * bounds are clamped to the nearest region.
+     *
+     * @param pos   The position in Box2d coordinates
+     *
+     * @return the state digest region containing the given position.
+     */
+    Uint32 getDigestRegion(const Vec2 pos) const;
+    
+    /**
+     * Returns the position quantum of state digests.
+     *
+     * Positions are rounded to a multiple of this value before hashing, so
+     * that floating point noise does not make peers disagree.
+     *
+     * @return the position quantum of state digests.
+     */
+    float getDigestPositionQuantum() const { return _digestPosQuant; }
+    
+    /**
+     * Returns the angle quantum of state digests.
+     *
+     * Angles are rounded to a multiple of this value (in radians) before
+     * hashing, so that floating point noise does not make peers disagree.
+     *
+     * @return the angle quantum of state digests.
+     */
+    float getDigestAngleQuantum() const { return _digestAngleQuant; }
+    
+    /**
+     * Sets the precision of state digests.
+     *
+     * Positions and angles are rounded to a multiple of these values before
+     * hashing. Coarser values tolerate more drift between peers before a
+     * repair is requested. Every peer must use the same precision.
+     *
+     * @param position  The position quantum
+     * @param angle     The angle quantum in radians
+     */
+    void setDigestPrecision(float position, float angle);
+    
+    /**
+     * Returns true if the given obstacle contributes to the state digests.
+     *
+     * Only settled obstacles contribute. An obstacle is settled if it is
+     * asleep, or if it moves less than one quantum per second. Moving
+     * obstacles are already covered by the regular synchronization, and peers
+     * never see them at quite the same time.
+     *
+     * @param obs   The obstacle to check
+     *
+     * @return true if the given obstacle contributes to the state digests.
+     */
+    bool isDigestSettled(const std::shared_ptr<Obstacle>& obs) const;
+    
+    /**
+     * Returns the quantized hash of an obstacle state.
+     *
+     * The hash covers the obstacle id, its position and angle (quantized),
+     * its body type, and whether it is enabled. It is the same on every peer
+     * that agrees on this state, regardless of platform.
+     *
+     * @param oid   The obstacle id
+     * @param obs   The obstacle
+     *
+     * @return the quantized hash of an obstacle state.
+     */
+    Uint64 hashObstacle(Uint64 oid, const std::shared_ptr<Obstacle>& obs) const;
+    
+    /**
+     * Computes the state digest of every region, returning the world digest.
+     *
+     * The digest of a region is the sum of the hashes of the settled
+     * obstacles in it. As a sum, it does not depend on the order of the
+     * obstacles, and can be updated one obstacle at a time. The world digest
+     * is a hash of the region digests in order, so that peers only have to
+     * compare the region digests when their world digests disagree.
+     *
+     * @param regions   The vector to store the region digests
+     *
+     * @return the world state digest
+     */
+    Uint64 computeDigests(std::vector<Uint64>& regions) const;
+    
 #pragma mark -
 #pragma mark Id Management
     /**
@@ -457,14 +628,14 @@ public:
     /**
      * Returns the obstacle for the given id.
      *
-     * This method returns nullptr if there is no such joint.
+     * This method returns nullptr if there is no such obstacle.
      *
      * @param oid   The obstacle id
      *
      * @return the obstacle for the given id.
      */
-    std::shared_ptr<Obstacle> getObstacle(Uint64 oid) {
-        return _idToObs.at(oid);
+    std::shared_ptr<Obstacle> getObstacle(Uint64 oid) const {
+        return _obsRegistry.get(_obsRegistry.find(oid));
     }
     
     /**
@@ -476,8 +647,51 @@ public:
      *
      * @return id for the given obstacle.
      */
-    Sint64 getObstacleId(const std::shared_ptr<Obstacle>& obs) {
-        return _obsToId.at(obs);
+    Sint64 getObstacleId(const std::shared_ptr<Obstacle>& obs) const {
+        return (Sint64)_obsRegistry.getId(_obsRegistry.find(obs.get()), (Uint64)-1);
+    }
+    
+    /**
+     * Returns the handle for the given obstacle id.
+     *
+     * Handles remain valid as long as the obstacle is in this world, and
+     * are resolved without hashing. This method returns
+     * {@link SlotRegistry#INVALID_HANDLE} if there is no such obstacle.
+     *
+     * @param oid   The obstacle id
+     *
+     * @return the handle for the given obstacle id.
+     */
+    ObstacleHandle getObstacleHandle(Uint64 oid) const {
+        return _obsRegistry.find(oid);
+    }
+    
+    /**
+     * Returns the handle for the given obstacle.
+     *
+     * Handles remain valid as long as the obstacle is in this world, and
+     * are resolved without hashing. This method returns
+     * {@link SlotRegistry#INVALID_HANDLE} if there is no such obstacle.
+     *
+     * @param obs   The obstacle to query
+     *
+     * @return the handle for the given obstacle.
+     */
+    ObstacleHandle getObstacleHandle(const std::shared_ptr<Obstacle>& obs) const {
+        return _obsRegistry.find(obs.get());
+    }
+    
+    /**
+     * Returns the obstacle for the given handle.
+     *
+     * This method returns nullptr if the obstacle has since been removed.
+     *
+     * @param handle    The obstacle handle
+     *
+     * @return the obstacle for the given handle.
+     */
+    const std::shared_ptr<Obstacle>& resolveObstacle(ObstacleHandle handle) const {
+        return _obsRegistry.get(handle);
     }
     
     /**
@@ -489,8 +703,8 @@ public:
      *
      * @return the joint for the given id.
      */
-    std::shared_ptr<Joint> getJoint(Uint64 jid) {
-        return _idToJnt.at(jid);
+    std::shared_ptr<Joint> getJoint(Uint64 jid) const {
+        return _jntRegistry.get(_jntRegistry.find(jid));
     }
     
     /**
@@ -502,70 +716,144 @@ public:
      *
      * @return id for the given joint.
      */
-    Sint64 getJointId(const std::shared_ptr<Joint>& joint) {
-        return _jntToId.at(joint);
+    Sint64 getJointId(const std::shared_ptr<Joint>& joint) const {
+        return (Sint64)_jntRegistry.getId(_jntRegistry.find(joint.get()), (Uint64)-1);
     }
     
     /**
-     * Returns the map from obstacle ids to the objects
+     * Returns a view of every obstacle with an id in this world.
      *
-     * @return the map from obstacle ids to the objects
+     * Iterating over the view yields the obstacles, and the id of the
+     * obstacle at each position is available from {@link ObstacleView#getId}.
+     * The view is invalidated by adding or removing obstacles, or by any
+     * change in ownership.
+     *
+     * @return a view of every obstacle with an id in this world.
      */
-    const std::unordered_map<Uint64, std::shared_ptr<physics2::Obstacle>>& getObstacleMap() {
-        return _idToObs;
+    ObstacleView getObstacleView() const {
+        return _obsRegistry.all();
     }
-
+    
     /**
-     * Returns the map from obstacles to their ids
+     * Returns a view of the obstacles owned by this shared physics world.
+     *
+     * The duration at each position of the view is the ownership duration.
+     * If the value is 0, then this obstacle is permanently owned by this
+     * copy of the world. The view is invalidated by adding or removing
+     * obstacles, or by any change in ownership.
      *
-     * @return the map from obstacles to their ids
+     * @return a view of the obstacles owned by this shared physics world.
      */
-    const std::unordered_map<std::shared_ptr<physics2::Obstacle>,Uint64>& getObstacleIds() {
-        return _obsToId;
+    ObstacleView getOwnedObstacles() const {
+        return _obsRegistry.owned();
     }
     
     /**
-     * Returns the map of obstacles owned by this shared physics world.
+     * Returns a view of the obstacles owned by other copies of this world.
      *
-     * The keys are the obstacle pointers, while the values are the ownership
-     * duration. If the value is 0, then this obstacle is permanently owned by
-     * this copy of the world.
+     * These are the obstacles that this world receives from its peers. The
+     * view is invalidated by adding or removing obstacles, or by any change
+     * in ownership.
      *
-     * @return the map of obstacles owned by this shared physics world.
+     * @return a view of the obstacles owned by other copies of this world.
      */
-    std::unordered_map<std::shared_ptr<physics2::Obstacle>,Uint64>& getOwnedObstacles() {
-        return _ownedObs;
+    ObstacleView getRemoteObstacles() const {
+        return _obsRegistry.remote();
     }
     
     /**
-     * Returns the map from joint ids to the objects
+     * Returns true if this shared physics world owns the given obstacle.
      *
-     * @return the map from joint ids to the objects
+     * @param obs   The obstacle to query
+     *
+     * @return true if this shared physics world owns the given obstacle.
      */
-    const std::unordered_map<Uint64, std::shared_ptr<physics2::Joint>>& getJointMap() {
-        return _idToJnt;
+    bool isOwned(const std::shared_ptr<Obstacle>& obs) const {
+        return _obsRegistry.isOwned(_obsRegistry.find(obs.get()));
     }
-
+    
+    /**
+     * Makes this shared physics world the owner of the given obstacle.
+     *
+     * The duration is the number of physics steps to hold ownership. If it
+     * is 0, this obstacle is permanently owned by this copy of the world.
+     * If the obstacle is already owned, only the duration is changed.
+     *
+     * This method does not send any information to other machines.
+     *
+     * @param obs       The obstacle to own
+     * @param duration  The ownership duration
+     */
+    void ownObstacle(const std::shared_ptr<Obstacle>& obs, Uint64 duration=0) {
+        _obsRegistry.own(_obsRegistry.find(obs.get()), duration);
+    }
+    
+    /**
+     * Makes this shared physics world the permanent owner of every obstacle.
+     *
+     * This method does not send any information to other machines.
+     */
+    void ownAllObstacles() {
+        _obsRegistry.ownAll();
+    }
+    
+    /**
+     * Releases the ownership of the given obstacle.
+     *
+     * This method does not send any information to other machines.
+     *
+     * @param obs   The obstacle to release
+     */
+    void disownObstacle(const std::shared_ptr<Obstacle>& obs) {
+        _obsRegistry.disown(_obsRegistry.find(obs.get()));
+    }
+    
     /**
-     * Returns the map from joints to their ids
+     * Returns a view of every joint with an id in this world.
      *
-     * @return the map from joints to their ids
+     * The view is invalidated by adding or removing joints, or by any
+     * change in ownership.
+     *
+     * @return a view of every joint with an id in this world.
      */
-    const std::unordered_map<std::shared_ptr<physics2::Joint>,Uint64>& getJointIds() {
-        return _jntToId;
+    JointView getJointView() const {
+        return _jntRegistry.all();
     }
     
     /**
-     * Returns the map of joints owned by this shared physics world.
+     * Returns a view of the joints owned by this shared physics world.
+     *
+     * The duration at each position of the view is the ownership duration.
+     * If the value is 0, then this joint is permanently owned by this copy
+     * of the world. The view is invalidated by adding or removing joints,
+     * or by any change in ownership.
      *
-     * The keys are the joints pointers, while the values are the ownership
-     * duration. If the value is 0, then this joint is permanently owned by
-     * this copy of the world.
+     * @return a view of the joints owned by this shared physics world.
+     */
+    JointView getOwnedJoints() const {
+        return _jntRegistry.owned();
+    }
+    
+    /**
+     * Makes this shared physics world the owner of the given joint.
+     *
+     * The duration is the number of physics steps to hold ownership. If it
+     * is 0, this joint is permanently owned by this copy of the world.
+     *
+     * @param joint     The joint to own
+     * @param duration  The ownership duration
+     */
+    void ownJoint(const std::shared_ptr<Joint>& joint, Uint64 duration=0) {
+        _jntRegistry.own(_jntRegistry.find(joint.get()), duration);
+    }
+    
+    /**
+     * Releases the ownership of the given joint.
      *
-     * @return the map of joints owned by this shared physics world.
+     * @param joint The joint to release
      */
-    std::unordered_map<std::shared_ptr<physics2::Joint>,Uint64>& getOwnedJoints() {
-        return _ownedJoints;
+    void disownJoint(const std::shared_ptr<Joint>& joint) {
+        _jntRegistry.disown(_jntRegistry.find(joint.get()));
     }
     
 #pragma mark -
@@ -92,7 +92,17 @@ public:
         /** A new owner acquiring this object */
         OWNER_ACQUIRE = 10,
         /** An owner releasing this object */
-        OWNER_RELEASE = 11
+        OWNER_RELEASE = 11,
+        /** The changed state of several obstacles, packed as deltas */
+        DELTA = 12,
+        /** A request for a snapshot of the world (or of some obstacles) */
+        WORLD_REQUEST = 13,
+        /** A single piece of a streamed world snapshot */
+        WORLD_CHUNK = 14,
+        /** The state digest of the entire world */
+        WORLD_DIGEST = 15,
+        /** The state digests of every region of the world */
+        REGION_DIGESTS = 16
     };
     
     /**
@@ -153,6 +163,92 @@ public:
         FloatConsts();
     };
 
+    /**
+     * A class representing the changed state of a single obstacle.
+     *
+     * A delta record carries a presence mask followed by only those fields
+     * whose bits are set. This allows us to send every change to an obstacle
+     * in a tick as one record, instead of one event per property. The boolean
+     * constants are packed into a single byte on the wire, and the float
+     * constants are only sent when they have changed.
+     */
+    class Delta {
+    public:
+        /** The bits of the presence mask */
+        enum Field : Uint8 {
+            /** The record contains a position */
+            POSITION     = 0x01,
+            /** The record contains a linear velocity */
+            VELOCITY     = 0x02,
+            /** The record contains an angle */
+            ANGLE        = 0x04,
+            /** The record contains an angular velocity */
+            ANGULAR_VEL  = 0x08,
+            /** The record contains a body type */
+            BODY_TYPE    = 0x10,
+            /** The record contains the boolean constants */
+            BOOL_CONSTS  = 0x20,
+            /** The record contains the float constants */
+            FLOAT_CONSTS = 0x40
+        };
+
+        /** The obstacle global id */
+        Uint64 obstacleId;
+        /** The presence mask of this record */
+        Uint8 mask;
+        /** The obstacle position */
+        Vec2 pos;
+        /** The obstacle linear velocity */
+        Vec2 vel;
+        /** The obstacle angle */
+        float angle;
+        /** The obstacle angular velocity */
+        float angularVel;
+        /** The obstacle body type */
+        b2BodyType bodyType;
+        /** The obstacle boolean constants */
+        BoolConsts bools;
+        /** The obstacle float constants */
+        FloatConsts floats;
+
+        /** Creates a new delta record with no fields present */
+        Delta();
+
+        /**
+         * Returns true if this record contains the given field.
+         *
+         * @param field The field to check
+         *
+         * @return true if this record contains the given field.
+         */
+        bool has(Field field) const { return (mask & field) != 0; }
+    };
+
+    /**
+     * A class representing a single obstacle in a world snapshot.
+     *
+     * A world snapshot is everything a peer needs to rebuild the shared
+     * obstacles from scratch. Each record pairs the factory call that created
+     * the obstacle with a delta record containing its full state. Obstacles
+     * that were not created by a factory (such as the initial obstacles of a
+     * level) have no factory, and can only be updated, not rebuilt.
+     */
+    class Record {
+    public:
+        /** The factory id for obstacles not created by a factory */
+        static constexpr Uint32 NO_FACTORY = 0xFFFFFFFF;
+        
+        /** The obstacle factory id, or {@link #NO_FACTORY} */
+        Uint32 factoryId;
+        /** The packed parameters for the factory (nullptr if none) */
+        std::shared_ptr<std::vector<std::byte>> packedParam;
+        /** The full state of the obstacle */
+        Delta state;
+        
+        /** Creates a new record with no factory */
+        Record() : factoryId(NO_FACTORY) {}
+    };
+
     
 protected:
     /** The type of the event. */
@@ -221,6 +317,29 @@ protected:
     /** The field for OBJ_OWNER_ACQUIRE */
     Uint64 _duration;
     
+    /** The records for EventType::DELTA */
+    std::vector<Delta> _deltas;
+    
+    /** The requested obstacles for EventType::WORLD_REQUEST (empty for all) */
+    std::vector<Uint64> _requestIds;
+    
+    // Fields for EventType::WORLD_CHUNK
+    /** The snapshot this chunk belongs to */
+    Uint32 _imageId;
+    /** The position of this chunk in the snapshot */
+    Uint32 _chunkIndex;
+    /** The number of chunks in the snapshot */
+    Uint32 _chunkCount;
+    /** The game tick at which the snapshot was taken */
+    Uint64 _imageTick;
+    
+    /** The world state digest for EventType::WORLD_DIGEST */
+    Uint64 _digest;
+    /** The number of digest regions for EventType::WORLD_DIGEST */
+    Uint32 _regionCount;
+    /** The region state digests for EventType::REGION_DIGESTS */
+    std::vector<Uint64> _digests;
+    
     /** A serializer for packing data */
     LWSerializer _serializer;
     /** A deserializer for unpacking data */
@@ -434,6 +553,87 @@ public:
         _obstacleId = obsId;
     }
     
+    /**
+     * Initializes an empty event to {@link EventType::DELTA}.
+     *
+     * This event packs the changed state of several obstacles. It starts
+     * with no records; use {@link #addDelta} to add them.
+     */
+    void initDelta() {
+        _type = EventType::DELTA;
+        _obstacleId = 0;
+        _deltas.clear();
+    }
+    
+    /**
+     * Initializes an empty event to {@link EventType::WORLD_REQUEST}.
+     *
+     * This event asks the host for a snapshot of the given obstacles. If the
+     * list is empty, it asks for a snapshot of the entire world, which also
+     * tells the receiver to remove any shared obstacle not in the snapshot.
+     *
+     * @param obsIds    The requested obstacle global ids (empty for all)
+     */
+    void initWorldRequest(const std::vector<Uint64>& obsIds) {
+        _type = EventType::WORLD_REQUEST;
+        _obstacleId = 0;
+        _requestIds = obsIds;
+    }
+    
+    /**
+     * Initializes an empty event to {@link EventType::WORLD_CHUNK}.
+     *
+     * This event carries a single piece of an encoded world snapshot. The
+     * snapshot may only be decoded once all of its chunks have arrived.
+     *
+     * @param imageId   The snapshot id
+     * @param index     The position of this chunk in the snapshot
+     * @param count     The number of chunks in the snapshot
+     * @param tick      The game tick at which the snapshot was taken
+     * @param bytes     The bytes of this chunk
+     */
+    void initWorldChunk(Uint32 imageId, Uint32 index, Uint32 count, Uint64 tick,
+                        std::shared_ptr<std::vector<std::byte>> bytes) {
+        _type = EventType::WORLD_CHUNK;
+        _obstacleId = 0;
+        _imageId = imageId;
+        _chunkIndex = index;
+        _chunkCount = count;
+        _imageTick = tick;
+        _packedParam = bytes;
+    }
+    
+    /**
+     * Initializes an empty event to {@link EventType::WORLD_DIGEST}.
+     *
+     * This event carries the state digest of the entire world (see
+     * {@link NetWorld#computeDigests}). A peer that disagrees with it
+     * replies with its region digests.
+     *
+     * @param digest    The world state digest
+     * @param regions   The number of digest regions
+     */
+    void initWorldDigest(Uint64 digest, Uint32 regions) {
+        _type = EventType::WORLD_DIGEST;
+        _obstacleId = 0;
+        _digest = digest;
+        _regionCount = regions;
+    }
+    
+    /**
+     * Initializes an empty event to {@link EventType::REGION_DIGESTS}.
+     *
+     * This event carries the state digest of every region of the world, in
+     * order. The receiver repairs the regions that disagree with its own.
+     *
+     * @param digests   The region state digests
+     */
+    void initRegionDigests(const std::vector<Uint64>& digests) {
+        _type = EventType::REGION_DIGESTS;
+        _obstacleId = 0;
+        _digests = digests;
+    }
+    
     
 #pragma Event Allocators
     /**
@@ -636,6 +836,203 @@ public:
         e->initOwnerRelease(obsId);
         return e;
     }
+    
+    /**
+     * Returns a newly created {@link EventType::DELTA} event.
+     *
+     * This method is a shortcut for creating a shared object on
+     * {@link #initDelta}.
+     *
+     * @return a newly created {@link EventType::DELTA} event.
+     */
+    static std::shared_ptr<PhysObstEvent> allocDelta() {
+        auto e = std::make_shared<PhysObstEvent>();
+        e->initDelta();
+        return e;
+    }
+    
+    /**
+     * Returns a newly created {@link EventType::WORLD_REQUEST} event.
+     *
+     * This method is a shortcut for creating a shared object on
+     * {@link #initWorldRequest}.
+     *
+     * @param obsIds    The requested obstacle global ids (empty for all)
+     *
+     * @return a newly created {@link EventType::WORLD_REQUEST} event.
+     */
+    static std::shared_ptr<PhysObstEvent> allocWorldRequest(const std::vector<Uint64>& obsIds) {
+        auto e = std::make_shared<PhysObstEvent>();
+        e->initWorldRequest(obsIds);
+        return e;
+    }
+    
+    /**
+     * Returns a newly created {@link EventType::WORLD_CHUNK} event.
+     *
+     * This method is a shortcut for creating a shared object on
+     * {@link #initWorldChunk}.
+     *
+     * @param imageId   The snapshot id
+     * @param index     The position of this chunk in the snapshot
+     * @param count     The number of chunks in the snapshot
+     * @param tick      The game tick at which the snapshot was taken
+     * @param bytes     The bytes of this chunk
+     *
+     * @return a newly created {@link EventType::WORLD_CHUNK} event.
+     */
+    static std::shared_ptr<PhysObstEvent> allocWorldChunk(Uint32 imageId, Uint32 index,
+                                                         Uint32 count, Uint64 tick,
+                                                         std::shared_ptr<std::vector<std::byte>> bytes) {
+        auto e = std::make_shared<PhysObstEvent>();
+        e->initWorldChunk(imageId, index, count, tick, bytes);
+        return e;
+    }
+    
+    /**
+     * Returns a newly created {@link EventType::WORLD_DIGEST} event.
+     *
+     * This method is a shortcut for creating a shared object on
+     * {@link #initWorldDigest}.
+     *
+     * @param digest    The world state digest
+     * @param regions   The number of digest regions
+     *
+     * @return a newly created {@link EventType::WORLD_DIGEST} event.
+     */
+    static std::shared_ptr<PhysObstEvent> allocWorldDigest(Uint64 digest, Uint32 regions) {
+        auto e = std::make_shared<PhysObstEvent>();
+        e->initWorldDigest(digest, regions);
+        return e;
+    }
+    
+    /**
+     * Returns a newly created {@link EventType::REGION_DIGESTS} event.
+     *
+     * This method is a shortcut for creating a shared object on
+     * {@link #initRegionDigests}.
+     *
+     * @param digests   The region state digests
+     *
+     * @return a newly created {@link EventType::REGION_DIGESTS} event.
+     */
+    static std::shared_ptr<PhysObstEvent> allocRegionDigests(const std::vector<Uint64>& digests) {
+        auto e = std::make_shared<PhysObstEvent>();
+        e->initRegionDigests(digests);
+        return e;
+    }
+    
+#pragma mark Delta Records
+    /**
+     * Returns a new record with no fields for the given obstacle.
+     *
+     * The record is appended to this {@link EventType::DELTA} event. The
+     * reference is only valid until the next record is added.
+     *
+     * @param obsId The obstacle global id
+     *
+     * @return a new record with no fields for the given obstacle.
+     */
+    Delta& addDelta(Uint64 obsId) {
+        _deltas.emplace_back();
+        _deltas.back().obstacleId = obsId;
+        return _deltas.back();
+    }
+    
+    /**
+     * Returns the records of this {@link EventType::DELTA} event.
+     *
+     * @return the records of this {@link EventType::DELTA} event.
+     */
+    const std::vector<Delta>& getDeltas() const { return _deltas; }
+
+#pragma mark World Snapshots
+    /**
+     * Returns the obstacles requested by this {@link EventType::WORLD_REQUEST} event.
+     *
+     * An empty list is a request for the entire world.
+     *
+     * @return the obstacles requested by this {@link EventType::WORLD_REQUEST} event.
+     */
+    const std::vector<Uint64>& getRequestIds() const { return _requestIds; }
+    
+    /**
+     * Returns the snapshot id of this {@link EventType::WORLD_CHUNK} event.
+     *
+     * @return the snapshot id of this {@link EventType::WORLD_CHUNK} event.
+     */
+    Uint32 getImageId() const { return _imageId; }
+    
+    /**
+     * Returns the position of this {@link EventType::WORLD_CHUNK} event in its snapshot.
+     *
+     * @return the position of this {@link EventType::WORLD_CHUNK} event in its snapshot.
+     */
+    Uint32 getChunkIndex() const { return _chunkIndex; }
+    
+    /**
+     * Returns the number of chunks in the snapshot of this {@link EventType::WORLD_CHUNK} event.
+     *
+     * @return the number of chunks in the snapshot of this {@link EventType::WORLD_CHUNK} event.
+     */
+    Uint32 getChunkCount() const { return _chunkCount; }
+    
+    /**
+     * Returns the game tick at which the snapshot of this chunk was taken.
+     *
+     * @return the game tick at which the snapshot of this chunk was taken.
+     */
+    Uint64 getImageTick() const { return _imageTick; }
+    
+    /**
+     * Returns the world state digest of this {@link EventType::WORLD_DIGEST} event.
+     *
+     * @return the world state digest of this {@link EventType::WORLD_DIGEST} event.
+     */
+    Uint64 getDigest() const { return _digest; }
+    
+    /**
+     * Returns the number of digest regions of this {@link EventType::WORLD_DIGEST} event.
+     *
+     * @return the number of digest regions of this {@link EventType::WORLD_DIGEST} event.
+     */
+    Uint32 getRegionCount() const { return _regionCount; }
+    
+    /**
+     * Returns the region digests of this {@link EventType::REGION_DIGESTS} event.
+     *
+     * @return the region digests of this {@link EventType::REGION_DIGESTS} event.
+     */
+    const std::vector<Uint64>& getDigests() const { return _digests; }
+    
+    /**
+     * Encodes a world snapshot as a sequence of bytes.
+     *
+     * The bytes are meant to be split into {@link EventType::WORLD_CHUNK}
+     * events. A complete snapshot contains every shared obstacle in the world,
+     * while a partial one only contains the obstacles that were requested.
+     *
+     * @param records   The obstacles in the snapshot
+     * @param complete  Whether the snapshot contains the entire world
+     *
+     * @return the encoded world snapshot
+     */
+    static std::vector<std::byte> encodeImage(const std::vector<Record>& records, bool complete);
+    
+    /**
+     * Decodes a world snapshot from a sequence of bytes.
+     *
+     * This is the counterpart of {@link #encodeImage}. If the bytes are
+     * truncated, this method decodes what it can and returns false.
+     *
+     * @param data      The encoded world snapshot
+     * @param records   The vector to store the obstacles in
+     * @param complete  Whether the snapshot contains the entire world
+     *
+     * @return true if the snapshot was decoded in full
+     */
+    static bool decodeImage(const std::vector<std::byte>& data,
+                            std::vector<Record>& records, bool& complete);
 
 #pragma mark Attributes
     /**
@@ -815,6 +1212,27 @@ public:
      */
     void deserialize(const std::vector<std::byte>& data) override;
     
+    /**
+     * Writes this event to the end of the given serializer.
+     *
+     * The output is the same as {@link #serialize()}, but no intermediate
+     * byte vector is allocated.
+     *
+     * @param out   The serializer to write to
+     */
+    void serializeTo(LWSerializer& out) override;
+    
+    /**
+     * Deserializes this event from a span of bytes.
+     *
+     * The bytes are read in place and are not retained. This method will set
+     * the type of the event and all relevant fields.
+     *
+     * @param data  The bytes to deserialize
+     * @param size  The number of bytes
+     */
+    void deserializeFrom(const std::byte* data, size_t size) override;
+    
 };
 
         }
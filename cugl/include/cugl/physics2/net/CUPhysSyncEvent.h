@@ -31,11 +31,14 @@
 #ifndef __CU_PHYS_SYNC_EVENT_H__
 #define __CU_PHYS_SYNC_EVENT_H__
 
-#include <cugl/net/CUNetcodeSerializer.h>
 #include <cugl/physics2/CUObstacle.h>
 #include <cugl/physics2/net/CUNetEvent.h>
+#include <cugl/physics2/net/CUBitSerializer.h>
+#include <cugl/physics2/net/CUBitDeserializer.h>
 #include <SDL_stdinc.h>
 #include <unordered_set>
+#include <unordered_map>
+#include <array>
 
 namespace cugl {
     /**
@@ -90,22 +93,124 @@ public:
         /** Creates a new parameter set with default values */
         Parameters();
     };
+    
+    /**
+     * The bit budgets for compact snapshots.
+     *
+     * Positions are quantized against the bounds of the physics world, while
+     * velocities are quantized against a symmetric range. Angles are always
+     * wrapped to [-pi,pi] before quantization. Values outside of their range
+     * are clamped. All peers must agree on these settings.
+     */
+    class Quantization {
+    public:
+        /** The bounds for quantizing positions (typically the world bounds) */
+        Rect bounds;
+        /** The number of bits for each position coordinate */
+        Uint8 posBits;
+        /** The number of bits for each velocity coordinate */
+        Uint8 velBits;
+        /** The maximum magnitude of each velocity coordinate */
+        float maxVel;
+        /** The number of bits for the angle */
+        Uint8 angleBits;
+        /** The number of bits for the angular velocity */
+        Uint8 angVelBits;
+        /** The maximum magnitude of the angular velocity */
+        float maxAngVel;
+        
+        /** Creates a new quantization with default values */
+        Quantization();
+    };
+    
+    /**
+     * The quantized fields of an object snapshot.
+     *
+     * The fields are in the same order as {@link Parameters}, namely x, y,
+     * vx, vy, angle, and vAngular.
+     */
+    typedef std::array<Uint32,6> Quantized;
+    
+    /**
+     * A quantized snapshot of every object in a compact event.
+     *
+     * Snapshots are kept by both sides of a connection, and serve as the
+     * baseline for delta encoding future events.
+     */
+    typedef std::unordered_map<Uint64,Quantized> Snapshot;
 
 protected:
     /** The vector of added object snapshots. */
     std::vector<Parameters> _syncList;
+    /** Whether this event uses the compact encoding */
+    bool _compact;
+    /** The sequence number of this snapshot (compact encoding only) */
+    Uint32 _sequence;
+    /** The sequence number of the delta baseline, or 0 for none */
+    Uint32 _baseline;
+    /** The shortUID of the physics world that sent this snapshot */
+    Uint32 _shortUID;
+    /** Whether this snapshot was sent to a single peer */
+    bool _direct;
+    /** The bit budgets of the compact encoding */
+    Quantization _quant;
+    /** The quantized snapshot of this event */
+    std::shared_ptr<Snapshot> _snapshot;
+    /** The baseline snapshot to delta encode against */
+    std::shared_ptr<Snapshot> _baseSnapshot;
 
 private:
     /** The set of ids of all obstacles added to be serialized. */
     std::unordered_set<Uint64> _obsSet;
-    // TODO: Is there a reason we are not using lightweights?
-    /** The serializer for converting basic types to byte vectors. */
-    cugl::net::NetcodeSerializer _serializer;
-    /** The deserializer for converting byte vectors to basic types. */
-    cugl::net::NetcodeDeserializer _deserializer;
+    /** The serializer for the compact encoding */
+    BitSerializer _bitSerializer;
+    /** The deserializer for the compact encoding (holds undecoded events) */
+    BitDeserializer _bitDeserializer;
+    
+    /**
+     * Returns the quantized fields of an object snapshot.
+     *
+     * @param param The object snapshot
+     *
+     * @return the quantized fields of an object snapshot.
+     */
+    Quantized quantize(const Parameters& param) const;
+    
+    /**
+     * Returns the object snapshot represented by the quantized fields.
+     *
+     * @param id    The obstacle id
+     * @param q     The quantized fields
+     *
+     * @return the object snapshot represented by the quantized fields.
+     */
+    Parameters dequantize(Uint64 id, const Quantized& q) const;
+    
+    /**
+     * Returns the range and bit width of the given quantized field.
+     *
+     * @param field The field index (in the order of {@link Parameters})
+     * @param min   The minimum value of the range
+     * @param max   The maximum value of the range
+     *
+     * @return the bit width of the given quantized field.
+     */
+    Uint8 getFieldRange(size_t field, float& min, float& max) const;
+    
+    /**
+     * Writes the snapshots in the compact encoding to the given serializer.
+     *
+     * @param out   The serializer to write to
+     */
+    void serializeCompact(LWSerializer& out);
     
 #pragma mark Constructors
 public:
+    /**
+     * Creates a new event with no snapshots and the raw encoding.
+     */
+    PhysSyncEvent() : _compact(false), _sequence(0), _baseline(0), _shortUID(0), _direct(false) {}
+    
     /**
      * Returns a newly allocated event of this type.
      *
@@ -170,6 +275,133 @@ public:
      */
     void deserialize(const std::vector<std::byte>& data) override;
     
+    /**
+     * Writes the current list of snapshots to the end of the given serializer.
+     *
+     * The output is the same as {@link #serialize()}, but no intermediate
+     * byte vector is allocated for the raw encoding.
+     *
+     * @param out   The serializer to write to
+     */
+    void serializeTo(LWSerializer& out) override;
+    
+    /**
+     * Unpacks a span of bytes into a list of snapshots.
+     *
+     * Raw snapshots are read in place. Compact snapshots are copied, as they
+     * are not decoded until {@link #decode} is called.
+     *
+     * @param data  The bytes to deserialize
+     * @param size  The number of bytes
+     */
+    void deserializeFrom(const std::byte* data, size_t size) override;
+    
+#pragma mark Compact Encoding
+    /**
+     * Switches this event to the compact encoding.
+     *
+     * In the compact encoding, every field is quantized with the given bit
+     * budgets and obstacle ids are written relative to the given shortUID.
+     * The event is also delta encoded against the baseline (if any), so that
+     * unchanged fields only cost a single bit.
+     *
+     * This method may be called before or after the obstacles are added.
+     *
+     * Snapshots sent to a single peer are direct. Direct and broadcast
+     * snapshots form separate streams, each with their own baselines.
+     *
+     * @param sequence  The sequence number of this snapshot (must be nonzero)
+     * @param shortUID  The shortUID of the sending physics world
+     * @param quant     The bit budgets for quantization
+     * @param direct    Whether this snapshot is sent to a single peer
+     */
+    void setCompact(Uint32 sequence, Uint32 shortUID, const Quantization& quant, bool direct=false);
+    
+    /**
+     * Sets the snapshot that this event is delta encoded against.
+     *
+     * The baseline must be a snapshot that every receiver has acknowledged.
+     * A baseline sequence of 0 means that the event is sent in full.
+     *
+     * @param sequence  The sequence number of the baseline
+     * @param snapshot  The quantized baseline snapshot
+     */
+    void setBaseline(Uint32 sequence, const std::shared_ptr<Snapshot>& snapshot) {
+        _baseline = snapshot ? sequence : 0;
+        _baseSnapshot = snapshot;
+    }
+    
+    /**
+     * Returns true if this event uses the compact encoding.
+     *
+     * @return true if this event uses the compact encoding.
+     */
+    bool isCompact() const { return _compact; }
+    
+    /**
+     * Returns the sequence number of this snapshot.
+     *
+     * This value is 0 if the event does not use the compact encoding.
+     *
+     * @return the sequence number of this snapshot.
+     */
+    Uint32 getSequence() const { return _sequence; }
+    
+    /**
+     * Returns the sequence number of the delta baseline.
+     *
+     * This value is 0 if the event is not delta encoded.
+     *
+     * @return the sequence number of the delta baseline.
+     */
+    Uint32 getBaseline() const { return _baseline; }
+    
+    /**
+     * Returns the shortUID of the physics world that sent this snapshot.
+     *
+     * This value is 0 if the event does not use the compact encoding.
+     *
+     * @return the shortUID of the physics world that sent this snapshot.
+     */
+    Uint32 getShortUID() const { return _shortUID; }
+    
+    /**
+     * Returns true if this snapshot was sent to a single peer.
+     *
+     * Direct and broadcast snapshots form separate streams, each with their
+     * own baselines.
+     *
+     * @return true if this snapshot was sent to a single peer.
+     */
+    bool isDirect() const { return _direct; }
+    
+    /**
+     * Returns the quantized snapshot of this event.
+     *
+     * For outbound events, this is the snapshot that peers will reconstruct.
+     * For inbound events, it is only available after {@link #decode}. This
+     * value is nullptr if the event does not use the compact encoding.
+     *
+     * @return the quantized snapshot of this event.
+     */
+    const std::shared_ptr<Snapshot>& getSnapshot() const { return _snapshot; }
+    
+    /**
+     * Decodes a received compact event against its baseline.
+     *
+     * Compact events cannot be fully deserialized on their own, as both the
+     * bit budgets and the baseline are local to the receiver. This method
+     * populates {@link #getSyncList} and {@link #getSnapshot}. The baseline
+     * must be the snapshot with sequence number {@link #getBaseline}, and
+     * should be nullptr if that number is 0.
+     *
+     * @param quant     The bit budgets for quantization
+     * @param baseline  The quantized baseline snapshot
+     *
+     * @return true if the event was successfully decoded
+     */
+    bool decode(const Quantization& quant, const std::shared_ptr<Snapshot>& baseline);
+    
 };
 
         }
@@ -0,0 +1,549 @@
+//
+//  CUSlotRegistry.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a dense, handle-based registry for networked physics.
+//  It stores objects (obstacles or joints) alongside their network ids and
+//  ownership counters in contiguous arrays, so that the physics controller
+//  can iterate over them without hashing or copying shared pointers.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_SLOT_REGISTRY_H__
+#define __CU_SLOT_REGISTRY_H__
+
+#include <SDL_stdinc.h>
+#include <cugl/util/CUDebug.h>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <utility>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A dense, handle-based registry of networked objects.
+ *
+ * This class is a slot map. Every object is stored in a set of contiguous
+ * (dense) arrays, together with its network id and its ownership counter.
+ * The dense arrays are partitioned so that the objects owned by this machine
+ * come first, and the objects owned by other machines (the remote objects)
+ * come after. Hence iterating over either subset is a linear scan with no
+ * lookups. See {@link View}.
+ *
+ * Objects are referenced by generational 32-bit handles. The low bits of a
+ * handle are the index of a slot, which records the current dense position
+ * of the object. The high bits are the generation of that slot, which is
+ * incremented whenever the object is removed. So a handle to a removed
+ * object is detected as stale, even if its slot has been reused. A handle
+ * of 0 is never valid.
+ *
+ * Objects may also be looked up by id or by pointer in constant time. In
+ * either case the result is a handle.
+ *
+ * Adding, removing, or changing the ownership of an object moves other
+ * objects in the dense arrays. Hence any views are invalidated by these
+ * operations, while handles are not.
+ */
+template <typename T>
+class SlotRegistry {
+public:
+    /** A generational handle to an object in the registry */
+    typedef Uint32 Handle;
+    
+    /** The handle that never refers to an object */
+    static constexpr Handle INVALID_HANDLE = 0;
+    /** The number of bits in a handle for the slot index */
+    static constexpr Uint32 INDEX_BITS = 20;
+    /** The mask for the slot index of a handle */
+    static constexpr Uint32 INDEX_MASK = (((Uint32)1) << INDEX_BITS)-1;
+    /** The mask for the generation of a handle (after shifting) */
+    static constexpr Uint32 GENERATION_MASK = (((Uint32)1) << (32-INDEX_BITS))-1;
+    
+    /**
+     * A read-only view of a contiguous range of the registry.
+     *
+     * A view does not own any data. It simply refers to a range of the dense
+     * arrays, and so it is cheap to copy. Iterating over a view yields the
+     * objects, while the ids and ownership counters may be accessed by
+     * position with {@link #getId} and {@link #getDuration}.
+     *
+     * A view is invalidated by any change to the registry, with the exception
+     * of the ownership duration of an already owned object.
+     */
+    class View {
+    private:
+        /** The first object in the range */
+        const std::shared_ptr<T>* _objects;
+        /** The first id in the range */
+        const Uint64* _ids;
+        /** The first ownership counter in the range */
+        const Uint64* _durations;
+        /** The number of objects in the range */
+        size_t _size;
+        
+    public:
+        /**
+         * Creates a view of the given range of the dense arrays.
+         *
+         * @param objects   The first object in the range
+         * @param ids       The first id in the range
+         * @param durations The first ownership counter in the range
+         * @param size      The number of objects in the range
+         */
+        View(const std::shared_ptr<T>* objects, const Uint64* ids,
+             const Uint64* durations, size_t size) :
+        _objects(objects), _ids(ids), _durations(durations), _size(size) {}
+        
+        /**
+         * Returns the number of objects in this view.
+         *
+         * @return the number of objects in this view.
+         */
+        size_t size() const { return _size; }
+        
+        /**
+         * Returns true if this view has no objects.
+         *
+         * @return true if this view has no objects.
+         */
+        bool empty() const { return _size == 0; }
+        
+        /**
+         * Returns the object at the given position in this view.
+         *
+         * @param index The position in this view
+         *
+         * @return the object at the given position in this view.
+         */
+        const std::shared_ptr<T>& operator[](size_t index) const {
+            return _objects[index];
+        }
+        
+        /**
+         * Returns the id of the object at the given position in this view.
+         *
+         * @param index The position in this view
+         *
+         * @return the id of the object at the given position in this view.
+         */
+        Uint64 getId(size_t index) const { return _ids[index]; }
+        
+        /**
+         * Returns the ownership duration at the given position in this view.
+         *
+         * The duration is the number of physics steps remaining before the
+         * ownership is released. If it is 0, the ownership is permanent (or
+         * the object is not owned).
+         *
+         * @param index The position in this view
+         *
+         * @return the ownership duration at the given position in this view.
+         */
+        Uint64 getDuration(size_t index) const { return _durations[index]; }
+        
+        /**
+         * Returns an iterator to the first object in this view.
+         *
+         * @return an iterator to the first object in this view.
+         */
+        const std::shared_ptr<T>* begin() const { return _objects; }
+        
+        /**
+         * Returns an iterator past the last object in this view.
+         *
+         * @return an iterator past the last object in this view.
+         */
+        const std::shared_ptr<T>* end() const { return _objects+_size; }
+    };
+    
+private:
+    /**
+     * The indirection from a handle to the dense arrays.
+     */
+    class Slot {
+    public:
+        /** The position of the object in the dense arrays */
+        Uint32 dense;
+        /** The current generation of this slot */
+        Uint32 generation;
+    };
+    
+    /** The objects (owned objects first) */
+    std::vector<std::shared_ptr<T>> _objects;
+    /** The network ids, parallel to the objects */
+    std::vector<Uint64> _ids;
+    /** The ownership counters, parallel to the objects */
+    std::vector<Uint64> _durations;
+    /** The slot of each object, parallel to the objects */
+    std::vector<Uint32> _owners;
+    /** The slots referenced by the handles */
+    std::vector<Slot> _slots;
+    /** The slots available for reuse */
+    std::vector<Uint32> _free;
+    /** The number of owned objects (at the start of the dense arrays) */
+    size_t _owned;
+    /** The slot for each id */
+    std::unordered_map<Uint64,Uint32> _byId;
+    /** The slot for each object */
+    std::unordered_map<const T*,Uint32> _byPtr;
+    /** The result of a failed lookup */
+    std::shared_ptr<T> _none;
+    
+    /**
+     * Returns the handle for the given slot.
+     *
+     * @param slot  The slot index
+     *
+     * @return the handle for the given slot.
+     */
+    Handle toHandle(Uint32 slot) const {
+        return (_slots[slot].generation << INDEX_BITS) | slot;
+    }
+    
+    /**
+     * Returns the dense position for a handle, or -1 if it is stale.
+     *
+     * @param handle    The object handle
+     *
+     * @return the dense position for a handle, or -1 if it is stale.
+     */
+    Sint64 toDense(Handle handle) const {
+        Uint32 slot = handle & INDEX_MASK;
+        if (handle == INVALID_HANDLE || slot >= _slots.size() ||
+            _slots[slot].generation != (handle >> INDEX_BITS)) {
+            return -1;
+        }
+        return _slots[slot].dense;
+    }
+    
+    /**
+     * Swaps two objects in the dense arrays.
+     *
+     * @param a The dense position of the first object
+     * @param b The dense position of the second object
+     */
+    void swapDense(size_t a, size_t b) {
+        if (a == b) {
+            return;
+        }
+        std::swap(_objects[a], _objects[b]);
+        std::swap(_ids[a], _ids[b]);
+        std::swap(_durations[a], _durations[b]);
+        std::swap(_owners[a], _owners[b]);
+        _slots[_owners[a]].dense = (Uint32)a;
+        _slots[_owners[b]].dense = (Uint32)b;
+    }
+    
+public:
+    /**
+     * Creates a new empty registry.
+     */
+    SlotRegistry() : _owned(0) {}
+    
+    /**
+     * Adds an object to this registry.
+     *
+     * The object is not owned by this machine. This method fails if either
+     * the id or the object is already in the registry.
+     *
+     * @param id    The network id of the object
+     * @param obj   The object to add
+     *
+     * @return the handle of the object, or {@link #INVALID_HANDLE} on failure
+     */
+    Handle insert(Uint64 id, const std::shared_ptr<T>& obj) {
+        if (obj == nullptr || _byId.count(id) || _byPtr.count(obj.get())) {
+            return INVALID_HANDLE;
+        }
+        Uint32 slot;
+        if (_free.empty()) {
+            CUAssertLog(_slots.size() <= INDEX_MASK, "Registry capacity exceeded");
+            slot = (Uint32)_slots.size();
+            Slot entry;
+            entry.generation = 1;
+            _slots.push_back(entry);
+        } else {
+            slot = _free.back();
+            _free.pop_back();
+        }
+        _slots[slot].dense = (Uint32)_objects.size();
+        _objects.push_back(obj);
+        _ids.push_back(id);
+        _durations.push_back(0);
+        _owners.push_back(slot);
+        _byId[id] = slot;
+        _byPtr[obj.get()] = slot;
+        return toHandle(slot);
+    }
+    
+    /**
+     * Removes an object from this registry.
+     *
+     * The handle, and any copies of it, are stale after this call.
+     *
+     * @param handle    The object handle
+     *
+     * @return true if the object was removed
+     */
+    bool erase(Handle handle) {
+        Sint64 pos = toDense(handle);
+        if (pos < 0) {
+            return false;
+        }
+        size_t dense = (size_t)pos;
+        if (dense < _owned) {
+            swapDense(dense, _owned-1);
+            dense = --_owned;
+        }
+        swapDense(dense, _objects.size()-1);
+        
+        Uint32 slot = _owners.back();
+        _byId.erase(_ids.back());
+        _byPtr.erase(_objects.back().get());
+        _objects.pop_back();
+        _ids.pop_back();
+        _durations.pop_back();
+        _owners.pop_back();
+        
+        Uint32 generation = (_slots[slot].generation+1) & GENERATION_MASK;
+        _slots[slot].generation = generation ? generation : 1;
+        _free.push_back(slot);
+        return true;
+    }
+    
+    /**
+     * Removes all objects from this registry.
+     *
+     * All outstanding handles are stale after this call.
+     */
+    void clear() {
+        for(auto it = _owners.begin(); it != _owners.end(); ++it) {
+            Uint32 generation = (_slots[*it].generation+1) & GENERATION_MASK;
+            _slots[*it].generation = generation ? generation : 1;
+            _free.push_back(*it);
+        }
+        _objects.clear();
+        _ids.clear();
+        _durations.clear();
+        _owners.clear();
+        _byId.clear();
+        _byPtr.clear();
+        _owned = 0;
+    }
+    
+    /**
+     * Returns the number of objects in this registry.
+     *
+     * @return the number of objects in this registry.
+     */
+    size_t size() const { return _objects.size(); }
+    
+#pragma mark Lookup
+    /**
+     * Returns the handle for the given id.
+     *
+     * @param id    The network id
+     *
+     * @return the handle for the given id, or {@link #INVALID_HANDLE} if none
+     */
+    Handle find(Uint64 id) const {
+        auto it = _byId.find(id);
+        return it == _byId.end() ? INVALID_HANDLE : toHandle(it->second);
+    }
+    
+    /**
+     * Returns the handle for the given object.
+     *
+     * @param obj   The object to query
+     *
+     * @return the handle for the given object, or {@link #INVALID_HANDLE} if none
+     */
+    Handle find(const T* obj) const {
+        auto it = _byPtr.find(obj);
+        return it == _byPtr.end() ? INVALID_HANDLE : toHandle(it->second);
+    }
+    
+    /**
+     * Returns true if the handle refers to an object in this registry.
+     *
+     * @param handle    The object handle
+     *
+     * @return true if the handle refers to an object in this registry.
+     */
+    bool isValid(Handle handle) const {
+        return toDense(handle) >= 0;
+    }
+    
+    /**
+     * Returns the object for the given handle.
+     *
+     * @param handle    The object handle
+     *
+     * @return the object for the given handle, or nullptr if it is stale
+     */
+    const std::shared_ptr<T>& get(Handle handle) const {
+        Sint64 pos = toDense(handle);
+        return pos < 0 ? _none : _objects[pos];
+    }
+    
+    /**
+     * Returns the id for the given handle.
+     *
+     * @param handle    The object handle
+     * @param fallback  The value to return if the handle is stale
+     *
+     * @return the id for the given handle, or the fallback if it is stale
+     */
+    Uint64 getId(Handle handle, Uint64 fallback=0) const {
+        Sint64 pos = toDense(handle);
+        return pos < 0 ? fallback : _ids[pos];
+    }
+    
+#pragma mark Ownership
+    /**
+     * Returns true if the object for the given handle is owned.
+     *
+     * @param handle    The object handle
+     *
+     * @return true if the object for the given handle is owned.
+     */
+    bool isOwned(Handle handle) const {
+        Sint64 pos = toDense(handle);
+        return pos >= 0 && (size_t)pos < _owned;
+    }
+    
+    /**
+     * Returns the ownership duration for the given handle.
+     *
+     * If the value is 0, then the object is permanently owned (or is not
+     * owned at all).
+     *
+     * @param handle    The object handle
+     *
+     * @return the ownership duration for the given handle.
+     */
+    Uint64 getDuration(Handle handle) const {
+        Sint64 pos = toDense(handle);
+        return pos < 0 ? 0 : _durations[pos];
+    }
+    
+    /**
+     * Makes the object for the given handle owned by this machine.
+     *
+     * If the object is already owned, this only changes the duration, and
+     * does not invalidate any views.
+     *
+     * @param handle    The object handle
+     * @param duration  The number of steps to own the object (0 is permanent)
+     */
+    void own(Handle handle, Uint64 duration=0) {
+        Sint64 pos = toDense(handle);
+        if (pos < 0) {
+            return;
+        } else if ((size_t)pos >= _owned) {
+            swapDense(pos, _owned);
+            pos = _owned++;
+        }
+        _durations[pos] = duration;
+    }
+    
+    /**
+     * Makes this machine the permanent owner of every object.
+     */
+    void ownAll() {
+        for(size_t ii = _owned; ii < _durations.size(); ii++) {
+            _durations[ii] = 0;
+        }
+        _owned = _objects.size();
+    }
+    
+    /**
+     * Releases the ownership of the object for the given handle.
+     *
+     * @param handle    The object handle
+     */
+    void disown(Handle handle) {
+        Sint64 pos = toDense(handle);
+        if (pos < 0 || (size_t)pos >= _owned) {
+            return;
+        }
+        swapDense(pos, --_owned);
+        _durations[_owned] = 0;
+    }
+    
+#pragma mark Views
+    /**
+     * Returns a view of every object in this registry.
+     *
+     * @return a view of every object in this registry.
+     */
+    View all() const {
+        return View(_objects.data(), _ids.data(), _durations.data(), _objects.size());
+    }
+    
+    /**
+     * Returns a view of the objects owned by this machine.
+     *
+     * @return a view of the objects owned by this machine.
+     */
+    View owned() const {
+        return View(_objects.data(), _ids.data(), _durations.data(), _owned);
+    }
+    
+    /**
+     * Returns a view of the objects owned by other machines.
+     *
+     * @return a view of the objects owned by other machines.
+     */
+    View remote() const {
+        return View(_objects.data()+_owned, _ids.data()+_owned,
+                    _durations.data()+_owned, _objects.size()-_owned);
+    }
+};
+
+        }
+    }
+}
+
+#endif /* __CU_SLOT_REGISTRY_H__ */
@@ -0,0 +1,334 @@
+//
+//  CUSyncScheduler.h
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a priority accumulator for physics synchronization.
+//  Every obstacle accumulates priority each tick, and the physics controller
+//  sends the obstacles with the highest priority that fit in its budget.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#ifndef __CU_SYNC_SCHEDULER_H__
+#define __CU_SYNC_SCHEDULER_H__
+
+#include <cugl/physics2/CUObstacle.h>
+#include <SDL_stdinc.h>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+namespace cugl {
+    /**
+     * The classes to represent 2-d physics.
+     *
+     * This namespace was chosen to future-proof the game engine. We will
+     * eventually want to add a 3-d physics engine as well, and this namespace
+     * will prevent any collisions with those scene graph nodes.
+     */
+    namespace physics2 {
+
+        /**
+         * The classes to implement networked physics.
+         *
+         * This namespace represents an extension of our 2-d physics engine
+         * to support networking. This package provides automatic synchronization
+         * of physics objects across devices.
+         */
+        namespace net {
+
+/**
+ * A priority accumulator for physics synchronization.
+ *
+ * Each tick, every shared obstacle gains priority from its speed, the error
+ * that peers would see if they extrapolated its last sent state, and its
+ * proximity to the players. It also gains a constant amount, so that the
+ * priority of an obstacle grows with the time since it was last sent. As a
+ * result, slow obstacles are never starved.
+ *
+ * The obstacles are kept in an indexed max-heap that is updated in place,
+ * so each tick only costs a logarithmic update per obstacle. Sending an
+ * obstacle resets its priority to zero.
+ */
+class SyncScheduler {
+protected:
+    /** The scheduling state of a single obstacle */
+    class Entry {
+    public:
+        /** The obstacle id */
+        Uint64 id;
+        /** The accumulated priority */
+        float priority;
+        /** The position at the last update */
+        Vec2 pos;
+        /** The linear velocity at the last update */
+        Vec2 vel;
+        /** The position when last sent */
+        Vec2 sentPos;
+        /** The linear velocity when last sent */
+        Vec2 sentVel;
+        /** The time elapsed since last sent */
+        float elapsed;
+        /** The tick of the last update */
+        Uint64 seen;
+    };
+    
+    /** The entries, arranged as a max-heap on priority */
+    std::vector<Entry> _heap;
+    /** The position of each obstacle id in the heap */
+    std::unordered_map<Uint64,size_t> _index;
+    /** The current tick */
+    Uint64 _tick;
+    /** The number of obstacles updated this tick */
+    size_t _seenCount;
+    /** The duration of the current tick in seconds */
+    float _dt;
+    
+    /** The priority weight of the obstacle speed */
+    float _velWeight;
+    /** The priority weight of the extrapolation error */
+    float _errorWeight;
+    /** The priority weight of the proximity to the players */
+    float _distWeight;
+    /** The priority gained by every obstacle each tick */
+    float _ageWeight;
+    
+    /**
+     * Swaps two heap entries, updating the index.
+     *
+     * @param a The position of the first entry
+     * @param b The position of the second entry
+     */
+    void swapEntries(size_t a, size_t b);
+    
+    /**
+     * Moves an entry up the heap until its parent has higher priority.
+     *
+     * @param pos   The position of the entry
+     */
+    void siftUp(size_t pos);
+    
+    /**
+     * Moves an entry down the heap until its children have lower priority.
+     *
+     * @param pos   The position of the entry
+     */
+    void siftDown(size_t pos);
+    
+    /**
+     * Removes the entry at the given heap position.
+     *
+     * @param pos   The position of the entry
+     */
+    void removeAt(size_t pos);
+    
+#pragma mark Constructors
+public:
+    /**
+     * Creates an empty scheduler with default weights.
+     *
+     * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+     * the heap, use one of the static constructors instead.
+     */
+    SyncScheduler();
+    
+    /**
+     * Deletes this scheduler, disposing of all resources.
+     */
+    ~SyncScheduler() { dispose(); }
+    
+    /**
+     * Disposes the scheduler, releasing all resources.
+     *
+     * This scheduler can be safely reinitialized
+     */
+    void dispose();
+    
+    /**
+     * Initializes an empty scheduler with default weights.
+     *
+     * @return true if the scheduler was initialized successfully
+     */
+    bool init();
+    
+    /**
+     * Returns a newly allocated scheduler with default weights.
+     *
+     * @return a newly allocated scheduler with default weights.
+     */
+    static std::shared_ptr<SyncScheduler> alloc() {
+        std::shared_ptr<SyncScheduler> result = std::make_shared<SyncScheduler>();
+        return (result->init() ? result : nullptr);
+    }
+    
+#pragma mark Weights
+    /**
+     * Returns the priority weight of the obstacle speed.
+     *
+     * @return the priority weight of the obstacle speed.
+     */
+    float getVelocityWeight() const { return _velWeight; }
+    
+    /**
+     * Sets the priority weight of the obstacle speed.
+     *
+     * @param weight    The priority weight of the obstacle speed
+     */
+    void setVelocityWeight(float weight) { _velWeight = weight; }
+    
+    /**
+     * Returns the priority weight of the extrapolation error.
+     *
+     * The error is the distance between the current position of an obstacle
+     * and its last sent position, extrapolated by its last sent velocity.
+     *
+     * @return the priority weight of the extrapolation error.
+     */
+    float getErrorWeight() const { return _errorWeight; }
+    
+    /**
+     * Sets the priority weight of the extrapolation error.
+     *
+     * The error is the distance between the current position of an obstacle
+     * and its last sent position, extrapolated by its last sent velocity.
+     *
+     * @param weight    The priority weight of the extrapolation error
+     */
+    void setErrorWeight(float weight) { _errorWeight = weight; }
+    
+    /**
+     * Returns the priority weight of the proximity to the players.
+     *
+     * The proximity is 1/(1+d), where d is the distance to the nearest
+     * player focus point.
+     *
+     * @return the priority weight of the proximity to the players.
+     */
+    float getDistanceWeight() const { return _distWeight; }
+    
+    /**
+     * Sets the priority weight of the proximity to the players.
+     *
+     * The proximity is 1/(1+d), where d is the distance to the nearest
+     * player focus point.
+     *
+     * @param weight    The priority weight of the proximity to the players
+     */
+    void setDistanceWeight(float weight) { _distWeight = weight; }
+    
+    /**
+     * Returns the priority gained by every obstacle each tick.
+     *
+     * This guarantees that every obstacle is eventually sent.
+     *
+     * @return the priority gained by every obstacle each tick.
+     */
+    float getAgeWeight() const { return _ageWeight; }
+    
+    /**
+     * Sets the priority gained by every obstacle each tick.
+     *
+     * This guarantees that every obstacle is eventually sent. It should be
+     * positive.
+     *
+     * @param weight    The priority gained by every obstacle each tick
+     */
+    void setAgeWeight(float weight) { _ageWeight = weight; }
+    
+#pragma mark Scheduling
+    /**
+     * Returns the number of obstacles tracked by this scheduler.
+     *
+     * @return the number of obstacles tracked by this scheduler.
+     */
+    size_t size() const { return _heap.size(); }
+    
+    /**
+     * Starts a new scheduling tick.
+     *
+     * This should be followed by a call to {@link #update} for each obstacle
+     * that may be sent, and then by {@link #endTick}.
+     *
+     * @param dt    The time since the previous tick in seconds
+     */
+    void beginTick(float dt);
+    
+    /**
+     * Accumulates priority for an obstacle.
+     *
+     * The obstacle is added to the scheduler if it is not already present.
+     *
+     * @param id    The obstacle id
+     * @param obs   The obstacle
+     * @param focus The positions of the players
+     */
+    void update(Uint64 id, const std::shared_ptr<physics2::Obstacle>& obs,
+                const std::vector<Vec2>& focus);
+    
+    /**
+     * Ends the current scheduling tick.
+     *
+     * Any obstacle that was not updated this tick is assumed to be removed
+     * from the world, and is dropped from the scheduler.
+     */
+    void endTick();
+    
+    /**
+     * Appends the ids of the obstacles with the highest priority.
+     *
+     * These obstacles are marked as sent, so their priority is reset to zero
+     * and their current state becomes the basis of the extrapolation error.
+     *
+     * @param count     The maximum number of obstacles to schedule
+     * @param result    The vector to append the ids to
+     */
+    void schedule(size_t count, std::vector<Uint64>& result);
+    
+    /**
+     * Removes an obstacle from the scheduler.
+     *
+     * @param id    The obstacle id
+     */
+    void remove(Uint64 id);
+    
+    /**
+     * Removes all obstacles from the scheduler.
+     */
+    void clear();
+};
+
+        }
+    }
+}
+
+#endif /* __CU_SYNC_SCHEDULER_H__ */
@@ -28,9 +28,19 @@
 #ifndef __CU_NET_PHYSICS_PKGS_H__
 #define __CU_NET_PHYSICS_PKGS_H__
 
+#include "CUSlotRegistry.h"
 #include "CUNetWorld.h"
 #include "CULWDeserializer.h"
 #include "CULWSerializer.h"
+#include "CUBitDeserializer.h"
+#include "CUBitSerializer.h"
+#include "CUInterestGrid.h"
+#include "CUSyncScheduler.h"
+#include "CUNetClock.h"
+#include "CUNetRateController.h"
+#include "CUNetTransport.h"
+#include "CULoopbackTransport.h"
+#include "CUNetMetrics.h"
 #include "CUObstacleFactory.h"
 #include "CUNetPhysicsController.h"
 #include "CUNetEventController.h"
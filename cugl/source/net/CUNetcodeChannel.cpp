@@ -71,7 +71,8 @@ NetcodeChannel::NetcodeChannel() :
 	_channel(nullptr), 
 	_debug(false),
 	_active(false),
-	_open(false) {
+	_open(false),
+	_reliable(true) {
 }
 
 /**
@@ -114,12 +115,17 @@ void NetcodeChannel::dispose() {
  *
  * This initializer assumes the peer is the offerer of the data channel.
  *
+ * A reliable channel retransmits lost messages and delivers them in order.
+ * An unreliable channel never retransmits and delivers messages as soon as
+ * they arrive, so a lost message never delays the ones after it.
+ *
  * @param parent    The parent RTC peer connection
  * @param label     The unique label for this data channel
+ * @param reliable  Whether the channel is reliable and ordered
  *
  * @return true if initialization was successful
  */
-bool NetcodeChannel::init(const std::weak_ptr<NetcodePeer>& parent, std::string label) {
+bool NetcodeChannel::init(const std::weak_ptr<NetcodePeer>& parent, std::string label, bool reliable) {
 	auto p = parent.lock();
 	if (p == nullptr) {
 		return false;
@@ -145,12 +151,18 @@ bool NetcodeChannel::init(const std::weak_ptr<NetcodePeer>& parent, std::string
 	
 	_label = label;
 	_active = true;
+	_reliable = reliable;
 
     if (_debug) {
         CULog("NETCODE: Offered data channel '%s' from %s",_label.c_str(),_uuid.c_str());
     }
 	try {
-		_channel = connection->createDataChannel(label);
+		rtc::DataChannelInit config;
+		if (!reliable) {
+			config.reliability.unordered = true;
+			config.reliability.maxRetransmits = 0;
+		}
+		_channel = connection->createDataChannel(label,config);
 		_channel->onOpen([this]() { onOpen(); });
 		_channel->onClosed([this]() { onClosed(); });
 		_channel->onMessage([this](auto data) { onMessage(data); });
@@ -195,6 +207,8 @@ bool NetcodeChannel::init(const std::weak_ptr<NetcodePeer>& parent, const std::s
 	}
 	_label = dc->label();
     _active = true;
+	rtc::Reliability reliability = dc->reliability();
+	_reliable = !reliability.unordered && !reliability.maxRetransmits && !reliability.maxPacketLifeTime;
 	if (_debug) {
 		CULog("NETCODE: Received data channel '%s' from %s",_label.c_str(),_uuid.c_str());
 	}
@@ -219,6 +233,7 @@ void NetcodeChannel::onOpen() {
 		if (_debug) {
 			CULog("NETCODE: Data channel '%s' to %s successfully opened.",_label.c_str(),_uuid.c_str());
 		}
+		_open  = _active.load();
 		parent = _parent.lock();
 		label  = _label;
 	}
@@ -300,6 +315,22 @@ const std::shared_ptr<NetcodeConnection> NetcodeChannel::getConnection() {
     return _grandparent.lock();
 }
 
+/**
+ * Returns the number of bytes queued on this channel but not yet sent.
+ *
+ * This is the buffered amount of the underlying data channel. It grows
+ * when messages are sent faster than the network can carry them, so it
+ * is a direct measure of congestion.
+ *
+ * This method is not const because it requires a lock.
+ *
+ * @return the number of bytes queued on this channel but not yet sent.
+ */
+size_t NetcodeChannel::getBufferedAmount() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    return (_active && _channel) ? _channel->bufferedAmount() : 0;
+}
+
 /**
  * Closes this data channel
  *
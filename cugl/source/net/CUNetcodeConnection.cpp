@@ -133,14 +133,15 @@ NetcodeConnection::NetcodeConnection() :
 	_ishost(false), 
 	_initialPlayers(0),
 	_migration(0),
-	_buffsize(0),
-	_buffhead(0),
-	_bufftail(0),
+	_hasReceipt(false),
+	_drainScheduled(false),
 	_debug(false),
 	_open(false),
 	_active(false),
 	_state(State::INACTIVE),
-	_previous(State::INACTIVE) {}
+	_previous(State::INACTIVE) {
+	_inbox = NetcodeInbox::alloc(DEFAULT_BUFFER);
+}
 
 /**
  * Deletes this websocket connection, disposing all resources
@@ -190,7 +191,6 @@ void NetcodeConnection::dispose() {
 			_room = "";
 			_ishost = false;
 			
-			_buffer.clear();
 			_players.clear();
 			_rtcconfig.iceServers.clear();
 			
@@ -481,7 +481,7 @@ bool NetcodeConnection::offerPeer(const std::string uuid) {
 		}
 
         // We are the offerer, so create a data channel to initiate the process
-        peer->createChannel("public");
+        peer->createChannel(NetcodeChannel::RELIABLE_LABEL);
         return true;
 	} catch (const std::exception &e) {
 		CULogError("NETCODE ERROR: %s", e.what());
@@ -923,9 +923,11 @@ void NetcodeConnection::handleSignal(const std::shared_ptr<JsonValue>&  json) {
 }
 
 /** 
- * Appends the given data to the ring buffer.
+ * Appends the given data to the message inbox.
  *
  * This method is used to store an incoming message for later consumption.
+ * It is called by the network threads, and never takes a lock unless the
+ * inbox overflows with the GROW policy.
  *
  * @param source    The message source
  * @param data      The message data
@@ -933,43 +935,56 @@ void NetcodeConnection::handleSignal(const std::shared_ptr<JsonValue>&  json) {
  * @return if the message was successfully added to the buffer.
  */
 bool NetcodeConnection::append(const std::string source, const std::vector<std::byte>& data) {
- 	std::function<bool()> callback;
-	bool success = false;
-	
-	{
-		std::lock_guard<std::recursive_mutex> lock(_mutex);
-		if (_active) {
-			if (_onReceipt) {
-				callback = [=]() {
-					_onReceipt(source,data);
-					return false;
-				};
-			} else {
-				// Buffer it
-				if (_buffsize == _buffer.size()) {
-					// Drops the oldest message
-					_buffhead = ((_buffhead + 1) % _buffer.size());
-					_buffsize--;
-				}
-		
-				Envelope* env = &(_buffer[_bufftail]);
-				env->source  = source;
-				env->message = data;
-
-				_bufftail = ((_bufftail + 1) % _buffer.size());
-				_buffsize++;
-			}		
-			success = true;
-		}
+	if (!_active) {
+		return false;
 	}
 	
-	if (callback) {
-        Application::get()->schedule(callback);
+	bool success = _inbox->push(source,data);
+	
+	// Schedule at most one drain per frame, rather than one callback per message
+	if (_hasReceipt && !_drainScheduled.exchange(true)) {
+		Application::get()->schedule([this]() {
+			_drainScheduled = false;
+			Dispatcher callback;
+			{
+				std::lock_guard<std::recursive_mutex> lock(_mutex);
+				callback = _onReceipt;
+			}
+			if (callback) {
+				_inbox->drain(callback);
+			}
+			return false;
+		});
 	}
 	
 	return success;
 }
 
+/**
+ * Returns the data channel of the given peer for the given delivery.
+ *
+ * If an unreliable channel is requested but is not yet open, this method
+ * returns the reliable channel instead. It returns nullptr if the peer has
+ * no channel at all. The caller should hold the lock on this connection.
+ *
+ * @param peer      The peer connection
+ * @param reliable  Whether the data requires reliable, ordered delivery
+ *
+ * @return the data channel of the given peer for the given delivery.
+ */
+std::shared_ptr<NetcodeChannel> NetcodeConnection::pickChannel(const std::shared_ptr<NetcodePeer>& peer, bool reliable) {
+    // Locking downwards is allowed
+    std::lock_guard<std::recursive_mutex> sublock(peer->_mutex);
+    if (!reliable) {
+        auto jt = peer->_channels.find(NetcodeChannel::UNRELIABLE_LABEL);
+        if (jt != peer->_channels.end() && jt->second->isOpen()) {
+            return jt->second;
+        }
+    }
+    auto jt = peer->_channels.find(NetcodeChannel::RELIABLE_LABEL);
+    return jt == peer->_channels.end() ? nullptr : jt->second;
+}
+
 #pragma mark -
 #pragma mark Accessors
 /**
@@ -1016,13 +1031,10 @@ const std::string NetcodeConnection::getHost() {
  * Note that this is NOT the same as the capacity of a single message. That value
  * was set as part of the initial {@link NetcodeConfig}.
  *
- * This method is not const because it requires a lock.
- *
  * @return the message buffer capacity.
  */
 size_t NetcodeConnection::getCapacity() {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	return _buffer.size();
+	return _inbox->getCapacity();
 }
 
 /**
@@ -1036,23 +1048,14 @@ size_t NetcodeConnection::getCapacity() {
  * Note that this is NOT the same as the capacity of a single message. That value
  * was set as part of the initial {@link NetcodeConfig}.
  *
+ * The capacity is rounded up to the nearest power of two. It should only be
+ * changed rarely, as a message that arrives during the change may be delivered
+ * out of order.
+ *
  * @paran capacity  The new message buffer capacity.
  */
 void NetcodeConnection::setCapacity(size_t capacity) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	
-	// Rotate to correct position
-	size_t pos = _buffhead;
-	if (capacity < _buffsize) {
-		pos = ((_buffhead + (_buffsize-capacity)) % _buffer.size());
-		_buffsize = capacity;
-	}
-	if (pos != 0) {
-		std::rotate(_buffer.begin(), _buffer.begin() + pos, _buffer.end());
-	}
-	_buffhead = 0;
-	_bufftail = ((_bufftail + (_buffer.size()-pos)) % _buffer.size());
-	_buffer.resize(capacity);
+	_inbox->setCapacity(capacity);
 }
     
 /**
@@ -1103,6 +1106,42 @@ bool NetcodeConnection::isPlayerActive(const std::string player) {
 	return it != _players.end();
 }
 
+/**
+ * Returns the number of bytes queued for the given player but not yet sent.
+ *
+ * This is the sum of the buffered amounts of every data channel to that
+ * player. It returns 0 if there is no direct route to the player.
+ *
+ * This method is not const because it requires a lock.
+ *
+ * @param player    The player to query
+ *
+ * @return the number of bytes queued for the given player but not yet sent.
+ */
+size_t NetcodeConnection::getBufferedAmount(const std::string player) {
+    std::vector<std::shared_ptr<NetcodeChannel>> channels;
+    
+    // Critical section
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        auto it = _peers.find(player);
+        if (it == _peers.end()) {
+            return 0;
+        }
+        // Locking downwards is allowed
+        std::lock_guard<std::recursive_mutex> sublock(it->second->_mutex);
+        for(auto jt = it->second->_channels.begin(); jt != it->second->_channels.end(); ++jt) {
+            channels.push_back(jt->second);
+        }
+    }
+    
+    size_t total = 0;
+    for(auto it = channels.begin(); it != channels.end(); ++it) {
+        total += (*it)->getBufferedAmount();
+    }
+    return total;
+}
+
 /**
  * Returns the number of players currently connected to this game 
  *
@@ -1174,7 +1213,9 @@ void NetcodeConnection::open() {
 	_socket->onClosed([this]() { onClosed(); });
 	_socket->onMessage([this](auto data) { onMessage(data); });
 	
-	_buffer.resize(DEFAULT_BUFFER);
+	// No producers until active, so this is safe
+	_inbox->clear();
+	_inbox->resetCounts();
 	
 	// Start the connection
 	_active = true;
@@ -1222,10 +1263,12 @@ void NetcodeConnection::close() {
  * regardless of host status (e.g. two non-host players can communicate this
  * way).
  *
- * Communication from a source is guaranteed to be ordered. So if connection A
- * sends two messages to connection B, connection B will receive those messages
- * in the same order. However, there is no relationship between the messages
- * coming from different sources.
+ * Reliable communication from a source is guaranteed to be ordered. So if
+ * connection A sends two messages to connection B, connection B will receive
+ * those messages in the same order. However, there is no relationship between
+ * the messages coming from different sources. Unreliable messages may be lost
+ * or arrive in any order, but a lost message never delays any other message.
+ * This is appropriate for state that is replaced by the next message anyway.
  *
  * You may choose to either send a byte array directly, or you can use the
  * {@link NetworkSerializer} and {@link NetworkDeserializer} classes to encode
@@ -1234,12 +1277,13 @@ void NetcodeConnection::close() {
  * This requires a connection be established. Otherwise it will return false. It
  * will also return false if the host is currently migrating.
  *
- * @param dst The UUID of the peer to receive the message
- * @param msg The byte array to send.
+ * @param dst       The UUID of the peer to receive the message
+ * @param data      The byte array to send.
+ * @param reliable  Whether to use the reliable, ordered channel
  *
  * @return true if the message was (apparently) sent
  */
-bool NetcodeConnection::sendTo(const std::string dst, const std::vector<std::byte>& data) {
+bool NetcodeConnection::sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable) {
 	std::shared_ptr<NetcodeChannel> channel;
     bool self = false;
 	
@@ -1257,15 +1301,7 @@ bool NetcodeConnection::sendTo(const std::string dst, const std::vector<std::byt
                     return false;
                 }
                 
-                // Locking downwards is allowed
-                auto peer = find->second;
-                std::lock_guard<std::recursive_mutex> sublock(peer->_mutex);
-                for(auto jt = peer->_channels.begin();
-                    channel == nullptr && jt != peer->_channels.end(); ++jt) {
-                    if (jt->first == "public") {
-                        channel = jt->second;
-                    }
-                }
+                channel = pickChannel(find->second, reliable);
             }
         }
 	}
@@ -1288,10 +1324,12 @@ bool NetcodeConnection::sendTo(const std::string dst, const std::vector<std::byt
  * the host player. If this connection is the host, the message will be
  * immediately appended to the receipt buffer.
  *
- * Communication from a source is guaranteed to be ordered. So if connection A
- * sends two messages to connection B, connection B will receive those messages
- * in the same order. However, there is no relationship between the messages
- * coming from different sources.
+ * Reliable communication from a source is guaranteed to be ordered. So if
+ * connection A sends two messages to connection B, connection B will receive
+ * those messages in the same order. However, there is no relationship between
+ * the messages coming from different sources. Unreliable messages may be lost
+ * or arrive in any order, but a lost message never delays any other message.
+ * This is appropriate for state that is replaced by the next message anyway.
  *
  * You may choose to either send a byte array directly, or you can use the
  * {@link NetworkSerializer} and {@link NetworkDeserializer} classes to encode
@@ -1300,12 +1338,12 @@ bool NetcodeConnection::sendTo(const std::string dst, const std::vector<std::byt
  * This requires a connection be established. Otherwise it will return false. It
  * will also return false if the host is currently migrating.
  *
- * @param dst The UUID of the peer to receive the message
- * @param msg The byte array to send.
+ * @param data      The byte array to send.
+ * @param reliable  Whether to use the reliable, ordered channel
  *
  * @return true if the message was (apparently) sent
  */
-bool NetcodeConnection::sendToHost(const std::vector<std::byte>& data) {
+bool NetcodeConnection::sendToHost(const std::vector<std::byte>& data, bool reliable) {
     std::shared_ptr<NetcodeChannel> channel;
     bool self = false;
     std::string uuid;
@@ -1325,15 +1363,7 @@ bool NetcodeConnection::sendToHost(const std::vector<std::byte>& data) {
                     return false;
                 }
                 
-                // Locking downwards is allowed
-                auto peer = find->second;
-                std::lock_guard<std::recursive_mutex> sublock(peer->_mutex);
-                for(auto jt = peer->_channels.begin();
-                    channel == nullptr && jt != peer->_channels.end(); ++jt) {
-                    if (jt->first == "public") {
-                        channel = jt->second;
-                    }
-                }
+                channel = pickChannel(find->second, reliable);
             }
         }
     }
@@ -1357,10 +1387,11 @@ bool NetcodeConnection::sendToHost(const std::vector<std::byte>& data) {
  * a broadcast message, this player will receive it as well (with the indication
  * of this connection as the sender).
  *
- * As with {@link #sendTo}, communication from a particular source is guaranteed
- * to be ordered. So if connection A broadcasts two messages, all other connections
- * will receive those messages in the same order. However, there is no relationship
- * between the messages coming from different sources.
+ * As with {@link #sendTo}, reliable communication from a particular source is
+ * guaranteed to be ordered. So if connection A broadcasts two messages, all other
+ * connections will receive those messages in the same order. However, there is no
+ * relationship between the messages coming from different sources. Unreliable
+ * messages may be lost or reordered, but never delay any other message.
  *
  * You may choose to either send a byte array directly, or you can use the
  * {@link NetworkSerializer} and {@link NetworkDeserializer} classes to encode
@@ -1369,11 +1400,12 @@ bool NetcodeConnection::sendToHost(const std::vector<std::byte>& data) {
  * This requires a connection be established. Otherwise it will return false. It
  * will also return false if the host is currently migrating.
  *
- * @param msg The byte array to send.
+ * @param data      The byte array to send.
+ * @param reliable  Whether to use the reliable, ordered channels
  *
  * @return true if the message was (apparently) sent
  */
-bool NetcodeConnection::broadcast(const std::vector<std::byte>& data) {
+bool NetcodeConnection::broadcast(const std::vector<std::byte>& data, bool reliable) {
     std::vector<std::shared_ptr<NetcodeChannel>> channels;
     bool success = true;
     std::string uuid;
@@ -1382,13 +1414,9 @@ bool NetcodeConnection::broadcast(const std::vector<std::byte>& data) {
         std::lock_guard<std::recursive_mutex> lock(_mutex);
         if (_active && _state != State::MIGRATING) {
             for(auto it = _peers.begin(); it != _peers.end(); ++it) {
-                // Locking downwards is allowed
-                auto peer = it->second;
-                std::lock_guard<std::recursive_mutex> sublock(peer->_mutex);
-                for(auto jt = peer->_channels.begin(); jt != peer->_channels.end(); ++jt) {
-                    if (jt->first == "public") {
-                        channels.push_back(jt->second);
-                    }
+                auto channel = pickChannel(it->second, reliable);
+                if (channel != nullptr) {
+                    channels.push_back(channel);
                 }
             }
         } else {
@@ -1416,33 +1444,25 @@ bool NetcodeConnection::broadcast(const std::vector<std::byte>& data) {
  * function should be prepared to be called multiple times a render frame, or even
  * not at all.
  *
+ * No lock is held while the dispatcher runs, so the network threads are free
+ * to buffer new messages in the meantime. Those messages are left for the next
+ * call. The optional limit caps the number of messages processed, leaving the
+ * rest for later. This is useful to bound the time spent in a single frame.
+ *
  * If a dispatcher callback has been registered with {@link #onReceipt}, this
- * method will never do anything. In that case, messages are not buffered and are
- * processed as soon as they are received.
+ * method will never do anything. In that case, messages are drained once per
+ * animation frame, as soon as possible after they are received.
  *
  * @param dispatcher    The function to process received data
+ * @param limit         The maximum number of messages to process
+ *
+ * @return the number of messages processed
  */
-void NetcodeConnection::receive(const Dispatcher& dispatcher) {
-	if (dispatcher == nullptr || _socket == nullptr) {
-		return;
-	}
-	
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	size_t off = 0;
-	for (auto it = _buffer.begin()+_buffhead; it != _buffer.end() && off < _buffsize; off++, ++it) {
-		dispatcher(it->source,it->message);
-		it->source.clear();
-		it->message.clear();
+size_t NetcodeConnection::receive(const Dispatcher& dispatcher, size_t limit) {
+	if (dispatcher == nullptr || _socket == nullptr || _hasReceipt) {
+		return 0;
 	}
-	// Wrap around ring buffer
-	for (auto it = _buffer.begin(); it != _buffer.end() && off < _buffsize; off++, ++it) {
-		dispatcher(it->source,it->message);
-		it->source.clear();
-		it->message.clear();
-	}
-	
-	_buffhead = ((_buffhead + off) % _buffer.size());
-	_buffsize -= off;
+	return _inbox->drain(dispatcher, limit);
 }
 
 /**
@@ -1506,6 +1526,7 @@ void NetcodeConnection::endSession() {
 void NetcodeConnection::onReceipt(Dispatcher callback) {
     std::lock_guard<std::recursive_mutex> lock(_mutex);
     _onReceipt = callback;
+    _hasReceipt = (callback != nullptr);
 }
 
 /**
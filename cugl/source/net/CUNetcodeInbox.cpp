@@ -0,0 +1,337 @@
+//
+//  CUNetcodeInbox.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module is part of a Web RTC implementation of the classic CUGL networking
+//  library. That library provided connected to a custom game server for matchmaking,
+//  and used reliable UDP communication. This version replaces the matchmaking server
+//  with a web socket, and uses web socket data channels for communication.
+//
+//  This module specifically supports the hand-off of incoming messages from the
+//  network threads to the main thread. It is a bounded queue that never blocks
+//  either side, so that a slow frame never stalls the network, and a burst of
+//  network traffic never stalls a frame.
+//
+//  The ring buffer is the classic bounded queue of Dmitry Vyukov, where each cell
+//  carries a sequence number that tells producers and consumers whether it is
+//  theirs to use.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Walker White
+//  Version: 1/16/23
+//
+#include <cugl/net/CUNetcodeInbox.h>
+
+using namespace cugl::net;
+using namespace std;
+
+/** The number of times a DROP_OLDEST push will evict before giving up */
+#define EVICT_ATTEMPTS  4
+
+/**
+ * Returns the smallest power of two that is at least the given value.
+ *
+ * @param value The value to round up
+ *
+ * @return the smallest power of two that is at least the given value.
+ */
+static size_t next_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+#pragma mark -
+#pragma mark Ring Buffer
+/**
+ * Creates a ring buffer with the given capacity.
+ *
+ * @param capacity  The ring capacity (a power of two)
+ */
+NetcodeInbox::Ring::Ring(size_t capacity) :
+    cells(new Cell[capacity]),
+    mask(capacity-1),
+    head(0),
+    tail(0) {
+    for(size_t ii = 0; ii < capacity; ii++) {
+        cells[ii].sequence.store(ii, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Returns a free cell to push a message to, or nullptr if full.
+ *
+ * The cell must be published with {@link #publish} once it is filled.
+ *
+ * @param pos   The position of the claimed cell
+ *
+ * @return a free cell to push a message to, or nullptr if full.
+ */
+NetcodeInbox::Cell* NetcodeInbox::Ring::claimPush(size_t& pos) {
+    pos = tail.load(std::memory_order_relaxed);
+    while (true) {
+        Cell* cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+                return cell;
+            }
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Returns the oldest message cell, or nullptr if empty.
+ *
+ * The cell must be released with {@link #release} once it is read.
+ *
+ * @param pos   The position of the claimed cell
+ *
+ * @return the oldest message cell, or nullptr if empty.
+ */
+NetcodeInbox::Cell* NetcodeInbox::Ring::claimPop(size_t& pos) {
+    pos = head.load(std::memory_order_relaxed);
+    while (true) {
+        Cell* cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos+1);
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+                return cell;
+            }
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark Constructors
+/**
+ * Creates a degenerate inbox with no capacity.
+ *
+ * This object must be initialized before it can be used.
+ */
+NetcodeInbox::NetcodeInbox() :
+    _ring(nullptr),
+    _policy(Overflow::DROP_OLDEST),
+    _spilled(false),
+    _pushed(0),
+    _dropped(0),
+    _spills(0) {
+}
+
+/**
+ * Disposes all of the resources used by this inbox.
+ *
+ * Any undelivered messages are lost. This method must not be called
+ * while any producer may still push a message.
+ */
+void NetcodeInbox::dispose() {
+    _ring.store(nullptr, std::memory_order_release);
+    _rings.clear();
+    _spill.clear();
+    _spillOut.clear();
+    _spilled.store(false, std::memory_order_relaxed);
+    resetCounts();
+}
+
+/**
+ * Initializes an inbox with the given capacity and overflow policy.
+ *
+ * The capacity is rounded up to the nearest power of two.
+ *
+ * @param capacity  The number of messages the ring can hold
+ * @param policy    The overflow policy
+ *
+ * @return true if initialization was successful
+ */
+bool NetcodeInbox::init(size_t capacity, Overflow policy) {
+    if (_ring.load(std::memory_order_relaxed) != nullptr) {
+        return false;
+    }
+    _policy.store(policy, std::memory_order_relaxed);
+    setCapacity(capacity);
+    return true;
+}
+
+#pragma mark -
+#pragma mark Accessors
+/**
+ * Returns the number of messages the ring can hold.
+ *
+ * @return the number of messages the ring can hold.
+ */
+size_t NetcodeInbox::getCapacity() const {
+    Ring* ring = _ring.load(std::memory_order_acquire);
+    return ring == nullptr ? 0 : ring->mask+1;
+}
+
+/**
+ * Sets the number of messages the ring can hold.
+ *
+ * The capacity is rounded up to the nearest power of two. As producers
+ * may still be pushing to the old ring, it is retained (and drained
+ * first) until this inbox is disposed. A message pushed to the old ring
+ * during the swap may be delivered after newer messages from the same
+ * source. So this method should be called rarely, ideally when the
+ * network is quiet. This method may only be called by the consumer.
+ *
+ * @param capacity  The number of messages the ring can hold
+ */
+void NetcodeInbox::setCapacity(size_t capacity) {
+    capacity = next_pow2(capacity < 2 ? 2 : capacity);
+    if (capacity == getCapacity()) {
+        return;
+    }
+
+    _rings.push_back(std::make_unique<Ring>(capacity));
+    _ring.store(_rings.back().get(), std::memory_order_release);
+}
+
+/**
+ * Returns the approximate number of undelivered messages.
+ *
+ * The value is only exact if no thread is pushing or draining. This
+ * method may only be called by the consumer.
+ *
+ * @return the approximate number of undelivered messages.
+ */
+size_t NetcodeInbox::size() const {
+    size_t result = 0;
+    for(auto it = _rings.begin(); it != _rings.end(); ++it) {
+        size_t tail = (*it)->tail.load(std::memory_order_relaxed);
+        size_t head = (*it)->head.load(std::memory_order_relaxed);
+        result += tail > head ? tail-head : 0;
+    }
+    if (_spilled.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(_spillMutex);
+        result += _spill.size();
+    }
+    return result;
+}
+
+/**
+ * Resets the message counters to zero.
+ */
+void NetcodeInbox::resetCounts() {
+    _pushed.store(0, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _spills.store(0, std::memory_order_relaxed);
+}
+
+#pragma mark -
+#pragma mark Messages
+/**
+ * Appends a message to the spill list.
+ *
+ * @param source    The message source
+ * @param data      The message data
+ * @param size      The number of bytes
+ */
+void NetcodeInbox::spill(const std::string& source, const std::byte* data, size_t size) {
+    std::lock_guard<std::mutex> lock(_spillMutex);
+    _spill.emplace_back();
+    _spill.back().source = source;
+    _spill.back().message.assign(data, data+size);
+    _spilled.store(true, std::memory_order_release);
+    _spills.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Pushes a copy of a message to this inbox.
+ *
+ * This method is safe to call from any thread, and only takes a lock if
+ * the ring is full and the policy is GROW.
+ *
+ * @param source    The message source
+ * @param data      The message data
+ * @param size      The number of bytes
+ *
+ * @return true if the message was stored
+ */
+bool NetcodeInbox::push(const std::string& source, const std::byte* data, size_t size) {
+    Ring* ring = _ring.load(std::memory_order_acquire);
+    if (ring == nullptr) {
+        return false;
+    }
+
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    Overflow policy = _policy.load(std::memory_order_relaxed);
+
+    // Once spilling, keep spilling until drained so order is preserved
+    if (policy == Overflow::GROW && _spilled.load(std::memory_order_acquire)) {
+        spill(source, data, size);
+        return true;
+    }
+
+    for(int attempt = 0; ; attempt++) {
+        size_t pos;
+        Cell* cell = ring->claimPush(pos);
+        if (cell != nullptr) {
+            cell->source.assign(source);
+            cell->message.assign(data, data+size);
+            ring->publish(cell, pos);
+            return true;
+        }
+
+        switch (policy) {
+            case Overflow::GROW:
+                spill(source, data, size);
+                return true;
+            case Overflow::DROP_NEWEST:
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case Overflow::DROP_OLDEST:
+            {
+                if (attempt >= EVICT_ATTEMPTS) {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                Cell* oldest = ring->claimPop(pos);
+                if (oldest != nullptr) {
+                    ring->release(oldest, pos);
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * Discards every message in this inbox.
+ *
+ * This method may only be called by the consumer.
+ */
+void NetcodeInbox::clear() {
+    drain([](const std::string&, const std::vector<std::byte>&) {});
+}
@@ -367,6 +367,8 @@ void NetcodePeer::onChannelClosed(const std::string label) {
  *
  * In our experiments, it is only safe to open one data channel at a time.
  * This callback informs this peer when it is safe to make a new channel.
+ * Hence the offerer only creates the unreliable channel once the reliable
+ * one is open.
  *
  * @param label The data channel label
  */
@@ -386,23 +388,33 @@ void NetcodePeer::onChannelOpened(const std::string label) {
 			uuid = _uuid;
 		}
 	}
-	if (label == "public") {
-		parent->onPeerEstablished(uuid);
+	if (label == NetcodeChannel::RELIABLE_LABEL) {
+		// Now it is safe to offer the channel for unreliable data
+		if (offered) {
+			createChannel(NetcodeChannel::UNRELIABLE_LABEL,false);
+		}
+		if (parent != nullptr) {
+			parent->onPeerEstablished(uuid);
+		}
 	}
 }
 
 /**
  * Creates a data channel with the given label
  *
- * There can only be one data channel of any label.
+ * There can only be one data channel of any label. An unreliable channel
+ * is unordered and never retransmits lost messages.
+ *
+ * @param label     The data channel label
+ * @param reliable  Whether the channel is reliable and ordered
  *
  * @return true if creation was successful.
  */
-bool NetcodePeer::createChannel(const std::string label) {
+bool NetcodePeer::createChannel(const std::string label, bool reliable) {
 	std::weak_ptr<NetcodePeer> wp = shared_from_this();
     
     // DO NOT HOLD LOCK HERE
-    std::shared_ptr<NetcodeChannel> channel = NetcodeChannel::alloc(wp,label);
+    std::shared_ptr<NetcodeChannel> channel = NetcodeChannel::alloc(wp,label,reliable);
 	
 	// Critical section
 	{
@@ -28,6 +28,8 @@
 //  Version: 11/13/23
 //
 #include <cugl/physics2/net/CUGameStateEvent.h>
+#include <cugl/physics2/net/CULWSerializer.h>
+#include <cugl/physics2/net/CULWDeserializer.h>
 
 using namespace cugl;
 using namespace cugl::physics2;
@@ -39,59 +41,146 @@ using namespace cugl::physics2::net;
  * @return a byte vector serializing this event
  */
 std::vector<std::byte> GameStateEvent::serialize() {
-    std::vector<std::byte> data;
+    LWSerializer serializer;
+    serializeTo(serializer);
+    return serializer.serialize();
+}
+
+/**
+ * Deserializes this event from a byte vector.
+ *
+ * This method will set the type of the event and all relevant fields.
+ */
+void GameStateEvent::deserialize(const std::vector<std::byte>& data) {
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Writes this event to the end of the given serializer.
+ *
+ * The output is the same as {@link #serialize()}, but no intermediate
+ * byte vector is allocated.
+ *
+ * @param out   The serializer to write to
+ */
+void GameStateEvent::serializeTo(LWSerializer& out) {
+    out.writeByte(std::byte(_type));
     switch (_type) {
         case EventType::GAME_START:
-            data.push_back(std::byte(EventType::GAME_START));
+            out.writeUint64(_tick);
             break;
         case EventType::GAME_RESET:
-            data.push_back(std::byte(EventType::GAME_RESET));
-            break;
         case EventType::GAME_PAUSE:
-            data.push_back(std::byte(EventType::GAME_PAUSE));
-            break;
         case EventType::GAME_RESUME:
-            data.push_back(std::byte(EventType::GAME_RESUME));
-            break;
         case EventType::CLIENT_RDY:
-            data.push_back(std::byte(EventType::CLIENT_RDY));
             break;
         case EventType::UID_ASSIGN:
-            data.push_back(std::byte(EventType::UID_ASSIGN));
-            data.push_back(std::byte(_shortUID));
+            out.writeByte(std::byte(_shortUID));
+            break;
+        case EventType::SYNC_ACK:
+            out.writeUint32(_shortUID);
+            out.writeUint32(_sequence);
+            break;
+        case EventType::INTEREST:
+        {
+            out.writeUint64(_obsId);
+            float region[4] = { _region.origin.x, _region.origin.y,
+                                _region.size.width, _region.size.height };
+            out.writeFloats(region, 4);
+        }
+            break;
+        case EventType::PREDICT:
+            out.writeUint64(_obsId);
+            break;
+        case EventType::PREDICT_STATE:
+        {
+            out.writeUint64(_obsId);
+            out.writeUint64(_tick);
+            float state[4] = { _position.x, _position.y, _velocity.x, _velocity.y };
+            out.writeFloats(state, 4);
+        }
+            break;
+        case EventType::CLOCK_PING:
+            out.writeUint64(_pingTime);
+            break;
+        case EventType::CLOCK_PONG:
+            out.writeUint64(_pingTime);
+            out.writeUint64(_receiveTime);
+            out.writeUint64(_replyTime);
+            out.writeUint64(_tick);
             break;
         default:
             CUAssertLog(false, "Serializing invalid game state event type");
     }
-    return data;
 }
 
 /**
- * Deserializes this event from a byte vector.
+ * Deserializes this event from a span of bytes.
  *
- * This method will set the type of the event and all relevant fields.
+ * The bytes are read in place and are not retained. This method will set
+ * the type of the event and all relevant fields.
+ *
+ * @param data  The bytes to deserialize
+ * @param size  The number of bytes
  */
-void GameStateEvent::deserialize(const std::vector<std::byte>& data) {
-    EventType flag = (EventType)data[0];
+void GameStateEvent::deserializeFrom(const std::byte* data, size_t size) {
+    LWDeserializer deserializer;
+    deserializer.receive(data, size);
+    EventType flag = (EventType)deserializer.readByte();
     switch (flag) {
         case EventType::GAME_START:
             _type = EventType::GAME_START;
+            _tick = deserializer.readUint64();
             break;
         case EventType::GAME_RESET:
-            _type = EventType::GAME_RESET;
-            break;
         case EventType::GAME_PAUSE:
-            _type = EventType::GAME_PAUSE;
-            break;
         case EventType::GAME_RESUME:
-            _type = EventType::GAME_RESUME;
-            break;
         case EventType::CLIENT_RDY:
-            _type = EventType::CLIENT_RDY;
+            _type = flag;
             break;
         case EventType::UID_ASSIGN:
             _type = EventType::UID_ASSIGN;
-            _shortUID = (Uint8)data[1];
+            _shortUID = (Uint8)deserializer.readByte();
+            break;
+        case EventType::SYNC_ACK:
+            _type = EventType::SYNC_ACK;
+            _shortUID = deserializer.readUint32();
+            _sequence = deserializer.readUint32();
+            break;
+        case EventType::INTEREST:
+        {
+            _type = EventType::INTEREST;
+            _obsId = deserializer.readUint64();
+            float region[4];
+            deserializer.readFloats(region, 4);
+            _region.set(region[0], region[1], region[2], region[3]);
+        }
+            break;
+        case EventType::PREDICT:
+            _type = EventType::PREDICT;
+            _obsId = deserializer.readUint64();
+            break;
+        case EventType::PREDICT_STATE:
+        {
+            _type = EventType::PREDICT_STATE;
+            _obsId = deserializer.readUint64();
+            _tick = deserializer.readUint64();
+            float state[4];
+            deserializer.readFloats(state, 4);
+            _position.set(state[0], state[1]);
+            _velocity.set(state[2], state[3]);
+        }
+            break;
+        case EventType::CLOCK_PING:
+            _type = EventType::CLOCK_PING;
+            _pingTime = deserializer.readUint64();
+            break;
+        case EventType::CLOCK_PONG:
+            _type = EventType::CLOCK_PONG;
+            _pingTime = deserializer.readUint64();
+            _receiveTime = deserializer.readUint64();
+            _replyTime = deserializer.readUint64();
+            _tick = deserializer.readUint64();
             break;
         default:
             CUAssertLog(false, "Deserializing game state event type");
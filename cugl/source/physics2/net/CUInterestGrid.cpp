@@ -0,0 +1,173 @@
+//
+//  CUInterestGrid.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a uniform spatial grid over a networked physics world.
+//  It is used by the physics controller for interest management, so that each
+//  peer is only sent frequent updates for the obstacles near it.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CUInterestGrid.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+#pragma mark -
+#pragma mark Constructors
+/**
+ * Creates a degenerate grid with no cells.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ */
+InterestGrid::InterestGrid() :
+_cellSize(0),
+_cols(0),
+_rows(0) {
+}
+
+/**
+ * Disposes the grid, releasing all resources.
+ *
+ * This grid can be safely reinitialized
+ */
+void InterestGrid::dispose() {
+    _cells.clear();
+    _bounds = Rect::ZERO;
+    _cellSize = 0;
+    _cols = 0;
+    _rows = 0;
+}
+
+/**
+ * Initializes a grid over the given bounds.
+ *
+ * @param bounds    The bounds to cover (typically the world bounds)
+ * @param cellSize  The width and height of each cell
+ *
+ * @return true if the grid was initialized successfully
+ */
+bool InterestGrid::init(const Rect bounds, float cellSize) {
+    if (cellSize <= 0 || bounds.size.width <= 0 || bounds.size.height <= 0) {
+        return false;
+    }
+    _bounds = bounds;
+    _cellSize = cellSize;
+    _cols = std::max(1,(int)std::ceil(bounds.size.width/cellSize));
+    _rows = std::max(1,(int)std::ceil(bounds.size.height/cellSize));
+    _cells.clear();
+    _cells.resize(_cols*_rows);
+    return true;
+}
+
+#pragma mark -
+#pragma mark Queries
+/**
+ * Returns the column containing the given x-coordinate.
+ *
+ * @param x The x-coordinate
+ *
+ * @return the column containing the given x-coordinate.
+ */
+int InterestGrid::getColumn(float x) const {
+    int col = (int)std::floor((x-_bounds.origin.x)/_cellSize);
+    return std::min(std::max(col,0),_cols-1);
+}
+
+/**
+ * Returns the row containing the given y-coordinate.
+ *
+ * @param y The y-coordinate
+ *
+ * @return the row containing the given y-coordinate.
+ */
+int InterestGrid::getRow(float y) const {
+    int row = (int)std::floor((y-_bounds.origin.y)/_cellSize);
+    return std::min(std::max(row,0),_rows-1);
+}
+
+/**
+ * Removes all obstacle ids from the grid.
+ *
+ * The cells keep their capacity, so refilling the grid every frame does
+ * not reallocate memory.
+ */
+void InterestGrid::clear() {
+    for(auto it = _cells.begin(); it != _cells.end(); ++it) {
+        it->clear();
+    }
+}
+
+/**
+ * Adds an obstacle id at the given position.
+ *
+ * @param id    The obstacle id
+ * @param pos   The obstacle position
+ */
+void InterestGrid::insert(Uint64 id, const Vec2 pos) {
+    if (_cells.empty()) {
+        return;
+    }
+    _cells[getRow(pos.y)*_cols+getColumn(pos.x)].push_back(id);
+}
+
+/**
+ * Appends the ids of all obstacles in or near the given region.
+ *
+ * This method appends every id in a cell that overlaps the region. The
+ * ids are not sorted, but each id appears at most once (provided it was
+ * only inserted once).
+ *
+ * @param region    The region to query
+ * @param result    The vector to append the ids to
+ */
+void InterestGrid::query(const Rect region, std::vector<Uint64>& result) const {
+    if (_cells.empty()) {
+        return;
+    }
+    int col0 = getColumn(region.origin.x);
+    int col1 = getColumn(region.origin.x+region.size.width);
+    int row0 = getRow(region.origin.y);
+    int row1 = getRow(region.origin.y+region.size.height);
+    for(int row = row0; row <= row1; row++) {
+        for(int col = col0; col <= col1; col++) {
+            const std::vector<Uint64>& cell = _cells[row*_cols+col];
+            result.insert(result.end(), cell.begin(), cell.end());
+        }
+    }
+}
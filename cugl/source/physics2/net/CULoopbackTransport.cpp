@@ -0,0 +1,755 @@
+//
+//  CULoopbackTransport.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides an in-process transport for networked physics. It
+//  connects any number of NetEventControllers in a single process, with no
+//  lobby server and no WebRTC. Each link between two peers simulates latency,
+//  jitter, loss, duplication, reordering and a bandwidth cap. All randomness
+//  comes from a seed and time is virtual, so a run can be reproduced exactly.
+//  This makes it possible to measure synchronization quality headlessly.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CULoopbackTransport.h>
+#include <cugl/util/CUDebug.h>
+#include <algorithm>
+#include <cmath>
+
+/** The default number of players in a hosted room */
+#define DEFAULT_CAPACITY    16
+/** The maximum number of times a reliable message is retransmitted */
+#define MAX_RETRANSMITS     8
+/** The minimum retransmission timeout in microseconds */
+#define MIN_RETRANSMIT      1000
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+/**
+ * Returns a 64 bit hash of the given string.
+ *
+ * This is FNV-1a, which (unlike std::hash) is the same on every platform.
+ *
+ * @param value The string to hash
+ * @param hash  The initial hash value
+ *
+ * @return a 64 bit hash of the given string.
+ */
+static Uint64 fnv_hash(const std::string& value, Uint64 hash=0xcbf29ce484222325ULL) {
+    for(auto it = value.begin(); it != value.end(); ++it) {
+        hash ^= (Uint8)(*it);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/** Creates a perfect link with no delay, loss or bandwidth cap */
+LoopbackNetwork::LinkConfig::LinkConfig() :
+    latency(0),
+    jitter(0),
+    distribution(Distribution::UNIFORM),
+    loss(0),
+    duplicate(0),
+    reorder(0),
+    reorderDelay(0),
+    bandwidth(0),
+    queueLimit(0) {
+}
+
+/** Creates a new statistics record with all counts zero */
+LoopbackNetwork::LinkStats::LinkStats() :
+    sent(0),
+    bytes(0),
+    delivered(0),
+    lost(0),
+    duplicated(0),
+    reordered(0),
+    dropped(0),
+    totalDelay(0) {
+}
+
+#pragma mark -
+#pragma mark Loopback Network
+/**
+ * Creates a new network with the given seed.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ *
+ * @param seed  The seed for all random choices
+ */
+LoopbackNetwork::LoopbackNetwork(Uint64 seed) :
+    _time(0),
+    _seed(seed),
+    _order(0),
+    _peerCount(0),
+    _roomCount(0) {
+}
+
+/**
+ * Returns a factory for transports on this network.
+ *
+ * This factory can be passed to {@link NetEventController#setTransportFactory}.
+ * The factory retains this network.
+ *
+ * @return a factory for transports on this network.
+ */
+NetTransport::Factory LoopbackNetwork::getFactory() {
+    std::shared_ptr<LoopbackNetwork> network = shared_from_this();
+    return [=](const cugl::net::NetcodeConfig& config, const std::string room) {
+        return LoopbackTransport::alloc(network, room, config.maxPlayers);
+    };
+}
+
+/**
+ * Returns the link from source to destination, creating it if necessary.
+ *
+ * @param src   The source UUID
+ * @param dst   The destination UUID
+ *
+ * @return the link from source to destination
+ */
+LoopbackNetwork::Link& LoopbackNetwork::acquireLink(const std::string& src, const std::string& dst) {
+    auto key = std::make_pair(src, dst);
+    auto it = _links.find(key);
+    if (it == _links.end()) {
+        Link& link = _links[key];
+        link.config = _default;
+        link.custom = false;
+        link.random.seed(fnv_hash(dst, fnv_hash(src, fnv_hash(std::to_string(_seed)))));
+        link.busy = 0;
+        link.reliable = 0;
+        return link;
+    }
+    return it->second;
+}
+
+/**
+ * Returns a uniform random number in [0,1) from the given generator.
+ *
+ * We do not use the standard distributions, as their output is not the
+ * same on every platform.
+ *
+ * @param random    The generator
+ *
+ * @return a uniform random number in [0,1)
+ */
+double LoopbackNetwork::uniform(std::mt19937_64& random) {
+    return (double)(random() >> 11)*(1.0/9007199254740992.0);
+}
+
+/**
+ * Returns a random one-way delay for the given link.
+ *
+ * @param link  The link
+ *
+ * @return a random one-way delay for the given link.
+ */
+Uint64 LoopbackNetwork::sampleDelay(Link& link) {
+    const LinkConfig& config = link.config;
+    double spread = 0;
+    if (config.jitter > 0) {
+        switch (config.distribution) {
+            case Distribution::UNIFORM:
+                spread = (2*uniform(link.random)-1)*config.jitter;
+                break;
+            case Distribution::NORMAL:
+            {
+                // Box-Muller transform
+                double u1 = 1-uniform(link.random);
+                double u2 = uniform(link.random);
+                spread = std::sqrt(-2*std::log(u1))*std::cos(2*M_PI*u2)*config.jitter;
+            }
+                break;
+            case Distribution::EXPONENTIAL:
+                spread = -std::log(1-uniform(link.random))*config.jitter;
+                break;
+        }
+    }
+    double delay = (double)config.latency+spread;
+    return delay > 0 ? (Uint64)std::llround(delay) : 0;
+}
+
+/**
+ * Schedules a message on the link from source to destination.
+ *
+ * @param src       The source UUID
+ * @param dst       The destination UUID
+ * @param message   The message
+ * @param reliable  Whether to use the reliable, ordered channel
+ */
+void LoopbackNetwork::schedule(const std::string& src, const std::string& dst,
+                               const std::shared_ptr<std::vector<std::byte>>& message,
+                               bool reliable) {
+    Endpoint* target = getEndpoint(dst);
+    if (target == nullptr || (target->state != NetTransport::State::CONNECTED &&
+                              target->state != NetTransport::State::INSESSION)) {
+        return;
+    }
+
+    Link& link = acquireLink(src, dst);
+    const LinkConfig& config = link.config;
+    link.stats.sent++;
+    link.stats.bytes += message->size();
+
+    // Wait for the link to finish sending earlier messages
+    Uint64 start = SDL_max(_time, link.busy);
+    if (!reliable && config.queueLimit > 0 && start-_time > config.queueLimit) {
+        link.stats.dropped++;
+        return;
+    }
+    if (config.bandwidth > 0) {
+        link.busy = start+(Uint64)(message->size()*1000000/config.bandwidth);
+        start = link.busy;
+    }
+
+    Packet packet;
+    packet.sent = _time;
+    packet.source = src;
+    packet.message = message;
+
+    if (reliable) {
+        // A lost message is resent after a round trip
+        Uint64 time = start+sampleDelay(link);
+        Uint64 timeout = SDL_max((Uint64)MIN_RETRANSMIT, 2*config.latency+config.jitter);
+        for(int ii = 0; ii < MAX_RETRANSMITS && uniform(link.random) < config.loss; ii++) {
+            link.stats.lost++;
+            time += timeout;
+        }
+        // Nothing overtakes a reliable message
+        link.reliable = SDL_max(link.reliable, time);
+        packet.time = link.reliable;
+        packet.order = _order++;
+        target->inbox.push(packet);
+        return;
+    }
+
+    if (uniform(link.random) < config.loss) {
+        link.stats.lost++;
+        return;
+    }
+    int copies = uniform(link.random) < config.duplicate ? 2 : 1;
+    if (copies > 1) {
+        link.stats.duplicated++;
+    }
+    for(int ii = 0; ii < copies; ii++) {
+        packet.time = start+sampleDelay(link);
+        if (uniform(link.random) < config.reorder) {
+            link.stats.reordered++;
+            packet.time += config.reorderDelay;
+        }
+        packet.order = _order++;
+        target->inbox.push(packet);
+    }
+}
+
+/**
+ * Delivers a message from a peer to itself.
+ *
+ * @param uuid      The peer UUID
+ * @param message   The message
+ */
+void LoopbackNetwork::deliverSelf(const std::string& uuid,
+                                  const std::shared_ptr<std::vector<std::byte>>& message) {
+    Endpoint* endpoint = getEndpoint(uuid);
+    if (endpoint == nullptr) {
+        return;
+    }
+    Packet packet;
+    packet.time = _time;
+    packet.sent = _time;
+    packet.order = _order++;
+    packet.message = message;
+    endpoint->inbox.push(packet);
+}
+
+#pragma mark Peer Methods
+/**
+ * Returns the UUID of a newly created peer.
+ *
+ * The peer is not in any room and has state INACTIVE.
+ *
+ * @return the UUID of a newly created peer.
+ */
+std::string LoopbackNetwork::createPeer() {
+    std::string uuid = "loopback-"+std::to_string(++_peerCount);
+    Endpoint& endpoint = _endpoints[uuid];
+    endpoint.state = NetTransport::State::INACTIVE;
+    return uuid;
+}
+
+/**
+ * Opens the connection of the given peer.
+ *
+ * If the room is empty, the peer will host a new room. Otherwise it
+ * will join the given room.
+ *
+ * @param uuid      The peer UUID
+ * @param room      The room to join ("" to host)
+ * @param capacity  The maximum number of players in a new room
+ */
+void LoopbackNetwork::openPeer(const std::string& uuid, const std::string& room, size_t capacity) {
+    Endpoint* endpoint = getEndpoint(uuid);
+    if (endpoint == nullptr || !endpoint->room.empty()) {
+        return;
+    }
+
+    if (room.empty()) {
+        std::string id = std::to_string(10000+(++_roomCount));
+        Room& lobby = _rooms[id];
+        lobby.host = uuid;
+        lobby.players.push_back(uuid);
+        lobby.capacity = capacity ? capacity : DEFAULT_CAPACITY;
+        lobby.started = false;
+        endpoint->room = id;
+        endpoint->state = NetTransport::State::CONNECTED;
+        return;
+    }
+
+    auto it = _rooms.find(room);
+    if (it == _rooms.end()) {
+        endpoint->state = NetTransport::State::INVALID;
+    } else if (it->second.started || it->second.players.size() >= it->second.capacity) {
+        endpoint->state = NetTransport::State::DENIED;
+    } else {
+        it->second.players.push_back(uuid);
+        endpoint->room = room;
+        endpoint->state = NetTransport::State::CONNECTED;
+    }
+}
+
+/**
+ * Closes the connection of the given peer.
+ *
+ * Any messages in flight to this peer are lost.
+ *
+ * @param uuid  The peer UUID
+ */
+void LoopbackNetwork::closePeer(const std::string& uuid) {
+    Endpoint* endpoint = getEndpoint(uuid);
+    if (endpoint == nullptr) {
+        return;
+    }
+
+    auto it = _rooms.find(endpoint->room);
+    if (it != _rooms.end()) {
+        auto& players = it->second.players;
+        players.erase(std::remove(players.begin(), players.end(), uuid), players.end());
+        if (players.empty()) {
+            _rooms.erase(it);
+        }
+    }
+    endpoint->room.clear();
+    endpoint->state = NetTransport::State::DISCONNECTED;
+    while (!endpoint->inbox.empty()) {
+        endpoint->inbox.pop();
+    }
+}
+
+/**
+ * Removes the given peer from this network.
+ *
+ * @param uuid  The peer UUID
+ */
+void LoopbackNetwork::removePeer(const std::string& uuid) {
+    closePeer(uuid);
+    _endpoints.erase(uuid);
+}
+
+/**
+ * Returns the endpoint for the given peer (or nullptr if none)
+ *
+ * @param uuid  The peer UUID
+ *
+ * @return the endpoint for the given peer (or nullptr if none)
+ */
+LoopbackNetwork::Endpoint* LoopbackNetwork::getEndpoint(const std::string& uuid) {
+    auto it = _endpoints.find(uuid);
+    return it == _endpoints.end() ? nullptr : &(it->second);
+}
+
+/**
+ * Returns the room of the given peer (or nullptr if none)
+ *
+ * @param uuid  The peer UUID
+ *
+ * @return the room of the given peer (or nullptr if none)
+ */
+LoopbackNetwork::Room* LoopbackNetwork::getRoom(const std::string& uuid) {
+    Endpoint* endpoint = getEndpoint(uuid);
+    if (endpoint == nullptr) {
+        return nullptr;
+    }
+    auto it = _rooms.find(endpoint->room);
+    return it == _rooms.end() ? nullptr : &(it->second);
+}
+
+/**
+ * Returns the number of bytes waiting for bandwidth on the given link.
+ *
+ * @param src   The source UUID
+ * @param dst   The destination UUID
+ *
+ * @return the number of bytes waiting for bandwidth on the given link.
+ */
+size_t LoopbackNetwork::getBacklog(const std::string& src, const std::string& dst) const {
+    auto it = _links.find(std::make_pair(src,dst));
+    if (it == _links.end() || it->second.config.bandwidth == 0 || it->second.busy <= _time) {
+        return 0;
+    }
+    return (size_t)((it->second.busy-_time)*it->second.config.bandwidth/1000000);
+}
+
+#pragma mark Link Conditions
+/**
+ * Sets the conditions of every link without explicit conditions.
+ *
+ * @param config    The link conditions
+ */
+void LoopbackNetwork::setDefaultConfig(const LinkConfig& config) {
+    _default = config;
+    for(auto it = _links.begin(); it != _links.end(); ++it) {
+        if (!it->second.custom) {
+            it->second.config = config;
+        }
+    }
+}
+
+/**
+ * Returns the conditions of the link from source to destination.
+ *
+ * @param src   The source UUID
+ * @param dst   The destination UUID
+ *
+ * @return the conditions of the link from source to destination.
+ */
+const LoopbackNetwork::LinkConfig& LoopbackNetwork::getLinkConfig(const std::string& src,
+                                                                  const std::string& dst) const {
+    auto it = _links.find(std::make_pair(src, dst));
+    return it == _links.end() ? _default : it->second.config;
+}
+
+/**
+ * Sets the conditions of the link from source to destination.
+ *
+ * This only affects one direction of the link. Messages already in
+ * flight are not affected.
+ *
+ * @param src       The source UUID
+ * @param dst       The destination UUID
+ * @param config    The link conditions
+ */
+void LoopbackNetwork::setLinkConfig(const std::string& src, const std::string& dst,
+                                    const LinkConfig& config) {
+    Link& link = acquireLink(src, dst);
+    link.config = config;
+    link.custom = true;
+}
+
+/**
+ * Returns the statistics of the link from source to destination.
+ *
+ * @param src   The source UUID
+ * @param dst   The destination UUID
+ *
+ * @return the statistics of the link from source to destination.
+ */
+LoopbackNetwork::LinkStats LoopbackNetwork::getLinkStats(const std::string& src,
+                                                         const std::string& dst) const {
+    auto it = _links.find(std::make_pair(src, dst));
+    return it == _links.end() ? LinkStats() : it->second.stats;
+}
+
+/**
+ * Returns the total statistics of every link in this network.
+ *
+ * @return the total statistics of every link in this network.
+ */
+LoopbackNetwork::LinkStats LoopbackNetwork::getTotalStats() const {
+    LinkStats result;
+    for(auto it = _links.begin(); it != _links.end(); ++it) {
+        const LinkStats& stats = it->second.stats;
+        result.sent += stats.sent;
+        result.bytes += stats.bytes;
+        result.delivered += stats.delivered;
+        result.lost += stats.lost;
+        result.duplicated += stats.duplicated;
+        result.reordered += stats.reordered;
+        result.dropped += stats.dropped;
+        result.totalDelay += stats.totalDelay;
+    }
+    return result;
+}
+
+/**
+ * Resets the statistics of every link to zero.
+ */
+void LoopbackNetwork::resetStats() {
+    for(auto it = _links.begin(); it != _links.end(); ++it) {
+        it->second.stats = LinkStats();
+    }
+}
+
+#pragma mark -
+#pragma mark Loopback Transport
+/**
+ * Creates a transport on the given network.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ *
+ * @param network   The loopback network
+ * @param room      The room to join ("" to host)
+ * @param capacity  The maximum number of players in a hosted room
+ */
+LoopbackTransport::LoopbackTransport(const std::shared_ptr<LoopbackNetwork>& network,
+                                     const std::string room, size_t capacity) :
+    _network(network),
+    _room(room),
+    _capacity(capacity) {
+    _uuid = _network->createPeer();
+}
+
+/**
+ * Deletes this transport, removing it from the network.
+ */
+LoopbackTransport::~LoopbackTransport() {
+    _network->removePeer(_uuid);
+}
+
+/**
+ * Returns the current state of this transport.
+ *
+ * @return the current state of this transport.
+ */
+NetTransport::State LoopbackTransport::getState() const {
+    auto endpoint = _network->getEndpoint(_uuid);
+    return endpoint == nullptr ? State::DISPOSED : endpoint->state;
+}
+
+/**
+ * Returns true if this transport is open.
+ *
+ * @return true if this transport is open.
+ */
+bool LoopbackTransport::isOpen() const {
+    State state = getState();
+    return state == State::CONNECTED || state == State::INSESSION;
+}
+
+/**
+ * Returns the UUID of the host player.
+ *
+ * @return the UUID of the host player.
+ */
+const std::string LoopbackTransport::getHost() {
+    auto room = _network->getRoom(_uuid);
+    return room == nullptr ? "" : room->host;
+}
+
+/**
+ * Returns the room ID of the connected lobby.
+ *
+ * @return the room ID of the connected lobby.
+ */
+const std::string LoopbackTransport::getRoom() const {
+    auto endpoint = _network->getEndpoint(_uuid);
+    return endpoint == nullptr ? "" : endpoint->room;
+}
+
+/**
+ * Returns the UUIDs of the active players (including this one)
+ *
+ * @return the UUIDs of the active players (including this one)
+ */
+const std::unordered_set<std::string> LoopbackTransport::getPlayers() {
+    std::unordered_set<std::string> result;
+    auto room = _network->getRoom(_uuid);
+    if (room != nullptr) {
+        result.insert(room->players.begin(), room->players.end());
+    }
+    return result;
+}
+
+/**
+ * Returns true if the given player is currently connected to the game.
+ *
+ * @param player    The player to test for connection
+ *
+ * @return true if the given player is currently connected to the game.
+ */
+bool LoopbackTransport::isPlayerActive(const std::string player) {
+    auto room = _network->getRoom(_uuid);
+    if (room == nullptr) {
+        return false;
+    }
+    return std::find(room->players.begin(), room->players.end(), player) != room->players.end();
+}
+
+/**
+ * Returns the number of players currently connected to this game
+ *
+ * @return the number of players currently connected to this game
+ */
+size_t LoopbackTransport::getNumPlayers() {
+    auto room = _network->getRoom(_uuid);
+    return room == nullptr ? 0 : room->players.size();
+}
+
+/**
+ * Returns the number of bytes queued for the given player but not yet sent.
+ *
+ * These are the bytes still waiting for the bandwidth cap of the link
+ * to the player. It is always 0 on links without a bandwidth cap.
+ *
+ * @param player    The player to query
+ *
+ * @return the number of bytes queued for the given player but not yet sent.
+ */
+size_t LoopbackTransport::getBufferedAmount(const std::string player) {
+    return _network->getBacklog(_uuid, player);
+}
+
+/**
+ * Opens the connection to the lobby.
+ *
+ * The connection succeeds immediately, unless the room to join does not
+ * exist (INVALID), or is full or in session (DENIED).
+ */
+void LoopbackTransport::open() {
+    if (getState() == State::INACTIVE) {
+        _network->openPeer(_uuid, _room, _capacity);
+    }
+}
+
+/**
+ * Closes the connection to the lobby.
+ *
+ * Any messages in flight to this peer are lost.
+ */
+void LoopbackTransport::close() {
+    _network->closePeer(_uuid);
+}
+
+/**
+ * Marks the game as started and bans incoming connections.
+ *
+ * Every player in the room moves to state INSESSION. This can only be
+ * called by the host.
+ */
+void LoopbackTransport::startSession() {
+    auto room = _network->getRoom(_uuid);
+    CUAssertLog(room == nullptr || room->host == _uuid, "Only a host should execute this method");
+    if (room == nullptr || room->host != _uuid || room->started) {
+        return;
+    }
+    room->started = true;
+    for(auto it = room->players.begin(); it != room->players.end(); ++it) {
+        _network->getEndpoint(*it)->state = State::INSESSION;
+    }
+}
+
+/**
+ * Sends a byte array to the specified player.
+ *
+ * @param dst       The UUID of the receiving player
+ * @param data      The byte array to send
+ * @param reliable  Whether to use the reliable, ordered channel
+ *
+ * @return true if the message was (apparently) sent
+ */
+bool LoopbackTransport::sendTo(const std::string dst, const std::vector<std::byte>& data, bool reliable) {
+    if (!isOpen() || !isPlayerActive(dst)) {
+        return false;
+    }
+    auto message = std::make_shared<std::vector<std::byte>>(data);
+    if (dst == _uuid) {
+        _network->deliverSelf(_uuid, message);
+    } else {
+        _network->schedule(_uuid, dst, message, reliable);
+    }
+    return true;
+}
+
+/**
+ * Sends a byte array to all other players (and this one).
+ *
+ * @param data      The byte array to send
+ * @param reliable  Whether to use the reliable, ordered channel
+ *
+ * @return true if the message was (apparently) sent
+ */
+bool LoopbackTransport::broadcast(const std::vector<std::byte>& data, bool reliable) {
+    auto room = _network->getRoom(_uuid);
+    if (!isOpen() || room == nullptr) {
+        return false;
+    }
+    // All copies share the message, as it is never modified
+    auto message = std::make_shared<std::vector<std::byte>>(data);
+    for(auto it = room->players.begin(); it != room->players.end(); ++it) {
+        if (*it != _uuid) {
+            _network->schedule(_uuid, *it, message, reliable);
+        }
+    }
+    _network->deliverSelf(_uuid, message);
+    return true;
+}
+
+/**
+ * Receives incoming network messages.
+ *
+ * The dispatcher is called on every message whose delivery time has
+ * been reached, in order of delivery, up to the given limit.
+ *
+ * @param dispatcher    The function to process received data
+ * @param limit         The maximum number of messages to process
+ *
+ * @return the number of messages processed
+ */
+size_t LoopbackTransport::receive(const Dispatcher& dispatcher, size_t limit) {
+    if (dispatcher == nullptr) {
+        return 0;
+    }
+
+    size_t count = 0;
+    while (count < limit) {
+        // The dispatcher may close this transport, so look up every time
+        auto endpoint = _network->getEndpoint(_uuid);
+        if (endpoint == nullptr || endpoint->inbox.empty() ||
+            endpoint->inbox.top().time > _network->getTime()) {
+            break;
+        }
+        LoopbackNetwork::Packet packet = endpoint->inbox.top();
+        endpoint->inbox.pop();
+        if (!packet.source.empty()) {
+            LoopbackNetwork::Link& link = _network->acquireLink(packet.source, _uuid);
+            link.stats.delivered++;
+            link.stats.totalDelay += packet.time-packet.sent;
+        }
+        dispatcher(packet.source, *packet.message);
+        count++;
+    }
+    return count;
+}
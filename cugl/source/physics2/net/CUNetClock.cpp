@@ -0,0 +1,173 @@
+//
+//  CUNetClock.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a clock synchronization filter for networked physics.
+//  It estimates the offset and drift between the clock of this machine and the
+//  clock of a remote machine from NTP-style ping exchanges. It also tracks the
+//  round trip time and jitter of the connection.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CUNetClock.h>
+#include <algorithm>
+#include <cmath>
+
+/** The number of samples in the filter window */
+#define WINDOW_SIZE     32
+/** The minimum number of samples to estimate drift */
+#define MIN_FIT_SAMPLES 8
+/** The minimum time (in microseconds) the window must span to estimate drift */
+#define MIN_FIT_SPAN    2000000.0
+/** The maximum drift accepted (1000 ppm, far beyond any real clock) */
+#define MAX_SKEW        0.001
+/** The smoothing factor for the round trip time (RFC 6298) */
+#define RTT_ALPHA       0.125
+/** The smoothing factor for the round trip variation (RFC 6298) */
+#define RTT_BETA        0.25
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+/**
+ * Creates a new clock filter on the stack.
+ *
+ * Clock filters do not have any nontrivial state and so it is unnecessary
+ * to use an init method. However, we do include a static {@link #alloc}
+ * method for creating shared pointers.
+ */
+NetClock::NetClock() {
+    reset();
+}
+
+/**
+ * Discards all samples, returning the filter to its initial state.
+ */
+void NetClock::reset() {
+    _samples.clear();
+    _next = 0;
+    _count = 0;
+    _offset = 0;
+    _reference = 0;
+    _skew = 0;
+    _rtt = 0;
+    _jitter = 0;
+}
+
+/**
+ * Adds the result of a ping exchange to the filter.
+ *
+ * Samples with a negative round trip time (which can only occur with
+ * corrupt data) are ignored.
+ *
+ * @param t0    The local time the ping was sent
+ * @param t1    The remote time the ping was received
+ * @param t2    The remote time the reply was sent
+ * @param t3    The local time the reply was received
+ *
+ * @return true if the sample was accepted
+ */
+bool NetClock::addSample(Uint64 t0, Uint64 t1, Uint64 t2, Uint64 t3) {
+    double rtt = ((double)t3-(double)t0)-((double)t2-(double)t1);
+    if (t3 < t0 || t2 < t1 || rtt < 0) {
+        return false;
+    }
+
+    Sample sample;
+    sample.local  = ((double)t0+(double)t3)/2;
+    sample.offset = (((double)t1-(double)t0)+((double)t2-(double)t3))/2;
+    sample.rtt = rtt;
+    if (_samples.size() < WINDOW_SIZE) {
+        _samples.push_back(sample);
+    } else {
+        _samples[_next] = sample;
+    }
+    _next = (_next+1) % WINDOW_SIZE;
+
+    if (_count == 0) {
+        _rtt = rtt;
+        _jitter = rtt/2;
+    } else {
+        _jitter = (1-RTT_BETA)*_jitter+RTT_BETA*std::fabs(_rtt-rtt);
+        _rtt = (1-RTT_ALPHA)*_rtt+RTT_ALPHA*rtt;
+    }
+    _count++;
+
+    refilter();
+    return true;
+}
+
+/**
+ * Recomputes the offset and drift from the sample window.
+ */
+void NetClock::refilter() {
+    // The least delayed sample has the least asymmetry
+    const Sample* best = &_samples[0];
+    for(auto it = _samples.begin(); it != _samples.end(); ++it) {
+        if (it->rtt < best->rtt) {
+            best = &(*it);
+        }
+    }
+    _offset = best->offset;
+    _reference = best->local;
+
+    if (_samples.size() < MIN_FIT_SAMPLES) {
+        return;
+    }
+
+    // Fit the drift to the least delayed quarter of the window
+    std::vector<double> rtts;
+    rtts.reserve(_samples.size());
+    for(auto it = _samples.begin(); it != _samples.end(); ++it) {
+        rtts.push_back(it->rtt);
+    }
+    size_t quarter = (rtts.size()-1)/4;
+    std::nth_element(rtts.begin(), rtts.begin()+quarter, rtts.end());
+    double cutoff = rtts[quarter];
+
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    double lo = best->local, hi = best->local;
+    for(auto it = _samples.begin(); it != _samples.end(); ++it) {
+        if (it->rtt > cutoff) {
+            continue;
+        }
+        // Center on the reference to keep the sums well conditioned
+        double x = it->local-_reference;
+        double y = it->offset-_offset;
+        n++;
+        sx += x;
+        sy += y;
+        sxx += x*x;
+        sxy += x*y;
+        lo = std::min(lo, it->local);
+        hi = std::max(hi, it->local);
+    }
+
+    double denom = n*sxx-sx*sx;
+    if (n < 2 || hi-lo < MIN_FIT_SPAN || denom <= 0) {
+        return;
+    }
+    double skew = (n*sxy-sx*sy)/denom;
+    _skew = std::max(-MAX_SKEW, std::min(MAX_SKEW, skew));
+}
@@ -46,9 +46,24 @@
 #include <cugl/physics2/net/CUNetEventController.h>
 #include <cugl/physics2/net/CULWSerializer.h>
 #include <cugl/net/CUNetworkLayer.h>
+#include <cmath>
 
-/** The minimum message length */
-#define MIN_MSG_LENGTH sizeof(std::byte)+sizeof(Uint64)
+/** The minimum message length (the shared tick header of a frame) */
+#define MIN_MSG_LENGTH sizeof(Uint64)
+/** The per-event header length (the event type and payload length) */
+#define EVENT_HEADER_LENGTH sizeof(std::byte)+sizeof(Uint32)
+/** The default maximum frame size (the WebRTC remote message limit) */
+#define DEFAULT_MAX_FRAME_SIZE 65536
+/** The number of clock samples before pinging at the slower rate */
+#define CLOCK_WARMUP_SAMPLES 8
+/** The number of ticks between clock pings while warming up */
+#define CLOCK_FAST_INTERVAL 6
+/** The number of ticks between clock pings once warmed up */
+#define CLOCK_SLOW_INTERVAL 60
+/** The tick error beyond which the game tick is corrected at once */
+#define CLOCK_SNAP_TICKS 4.0
+/** The maximum tick correction per update when slewing */
+#define CLOCK_SLEW_TICKS 0.05
 
 using namespace cugl;
 using namespace cugl::physics2;
@@ -66,13 +81,30 @@ using namespace cugl::physics2::net;
  * the heap, use one of the static constructors instead.
  */
 NetEventController::NetEventController(void):
+_startGameTimeStamp(0),
+_hostStartTimeStamp(0),
+_tickOffset(0),
+_lastGameTick(0),
+_clockSampleTick(0),
+_clockSampleTime(0),
+_clockPingTimeStamp(0),
+_transportFactory(NetcodeTransport::alloc),
+_metrics(NetMetrics::alloc()),
 _isHost(false),
 _shortUID(0),
 _numReady(0),
 _roomid(""),
 _physEnabled(false),
 _status(Status::IDLE),
-_startGameTimeStamp(0) {
+_gameStateType(UINT8_MAX),
+_physSyncType(UINT8_MAX),
+_physObstType(UINT8_MAX),
+_inEventCount(0),
+_maxFrameSize(DEFAULT_MAX_FRAME_SIZE),
+_lockstep(false),
+_inputDelay(1),
+_lockstepTick(0),
+_lockstepReady(false) {
 }
 
 /**
@@ -96,12 +128,28 @@ void NetEventController::dispose() {
  * @return true if the network controller was successfully initialized
  */
 bool NetEventController::init(const std::shared_ptr<cugl::AssetManager>& assets) {
+    auto json = assets->get<JsonValue>("server");
+    return init(cugl::net::NetcodeConfig(json));
+}
+
+/**
+ * Initializes the controller for the given network configuration.
+ *
+ * This initializer does not require any assets. Together with a
+ * {@link LoopbackNetwork}, it allows a controller to run headless.
+ *
+ * @param config    The network configuration
+ *
+ * @return true if the network controller was successfully initialized
+ */
+bool NetEventController::init(const cugl::net::NetcodeConfig& config) {
     // Attach the primitive event types for deserialization
-    attachEventType<GameStateEvent>();
+    _gameStateType = attachEventType<GameStateEvent>();
+    _metrics->setTypeName(_gameStateType, "GameStateEvent");
 
-    // Configure the NetcodeConnection
-    auto json = assets->get<JsonValue>("server");
-    _config.set(json);
+    // Configure the network transport
+    _config = config;
+    _maxFrameSize = _config.maxMessage ? _config.maxMessage : DEFAULT_MAX_FRAME_SIZE;
     _status = Status::IDLE;
     return true;
 }
@@ -136,7 +184,11 @@ bool NetEventController::connectAsHost() {
     _isHost = true;
     if (_status == Status::IDLE) {
         _status = Status::CONNECTING;
-        _network = cugl::net::NetcodeConnection::alloc(_config);
+        _network = _transportFactory(_config, "");
+        if (_network == nullptr) {
+            _status = Status::NETERROR;
+            return false;
+        }
         _network->open();
     }
     return checkConnection();
@@ -157,7 +209,11 @@ bool NetEventController::connectAsClient(std::string roomID) {
     _isHost = false;
     if (_status == Status::IDLE) {
         _status = Status::CONNECTING;
-        _network = cugl::net::NetcodeConnection::alloc(_config, roomID);
+        _network = _transportFactory(_config, roomID);
+        if (_network == nullptr) {
+            _status = Status::NETERROR;
+            return false;
+        }
         _network->open();
     }
     _roomid = roomID;
@@ -179,12 +235,28 @@ void NetEventController::disconnect() {
     _physEnabled = false;
     _isHost = false;
     _startGameTimeStamp = 0;
+    _hostStartTimeStamp = 0;
+    _tickOffset = 0;
+    _lastGameTick = 0;
+    _clock.reset();
+    _clockSampleTick = 0;
+    _clockSampleTime = 0;
+    _clockPingTimeStamp = 0;
+    _sendRate.reset();
     _numReady = 0;
     _outEventQueue.clear();
+    _directOutQueue.clear();
+    _pendingInterests.clear();
+    _pendingPredictions.clear();
+    _lockstepTick = 0;
+    _lockstepReady = false;
+    _peerTicks.clear();
+    _lockstepEvents.clear();
     
     while (!_inEventQueue.empty()) {
         _inEventQueue.pop();
     }
+    _inEventCount = 0;
 }
 
 /**
@@ -222,14 +294,19 @@ bool NetEventController::markReady() {
  * Returns the discrete timestamp since the game started.
  *
  * Peers should have similar timestamps regardless of when their app was
- * launched, although peer gameticks might fluctuate due to network
- * latency.
+ * launched. The host game tick is the reference, and clients correct
+ * their own towards it with clock synchronization. The game tick never
+ * decreases during a game.
  *
  * @return the discrete timestamp since the game started.
  */
 Uint64 NetEventController::getGameTick() const {
     Uint64 time = Application::get()->getFixedCount();
-    return time - _startGameTimeStamp;
+    Sint64 tick = (Sint64)(time - _startGameTimeStamp)+(Sint64)std::llround(_tickOffset);
+    if (tick > (Sint64)_lastGameTick) {
+        _lastGameTick = (Uint64)tick;
+    }
+    return _lastGameTick;
 }
     
 /**
@@ -247,12 +324,29 @@ void NetEventController::enablePhysics(std::shared_ptr<NetWorld>& world, Obstacl
     CUAssertLog(_shortUID, "You must receive a UID assigned from host before enabling physics.");
     _physEnabled = true;
     _physController = NetPhysicsController::alloc(world,_shortUID,_isHost,linkFunc);
+    if (_network) {
+        auto peers = _network->getPlayers();
+        peers.erase(_network->getUUID());
+        _physController->setSyncPeers(peers);
+    }
     //CULog("ENABLED PHYSICS");
-    attachEventType<PhysSyncEvent>();
-    attachEventType<PhysObstEvent>();
+    // Snapshots are superseded by the next one, so they never need a resend
+    _physSyncType = attachEventType<PhysSyncEvent>(Delivery::UNRELIABLE);
+    _physObstType = attachEventType<PhysObstEvent>();
+    _metrics->setTypeName(_physSyncType, "PhysSyncEvent");
+    _metrics->setTypeName(_physObstType, "PhysObstEvent");
+    _physController->setMetrics(_metrics);
     if(_isHost) {
         _physController->ownAll();
     }
+    for(auto it = _pendingInterests.begin(); it != _pendingInterests.end(); ++it) {
+        _physController->processInterest(it->first, it->second->getObstacleId(), it->second->getRegion());
+    }
+    _pendingInterests.clear();
+    for(auto it = _pendingPredictions.begin(); it != _pendingPredictions.end(); ++it) {
+        _physController->processPredict(it->second, it->first);
+    }
+    _pendingPredictions.clear();
 }
 
 /**
@@ -264,6 +358,126 @@ void NetEventController::disablePhysics() {
 }
 
 
+#pragma mark Lockstep
+/**
+ * Enables lockstep mode with the given input delay.
+ *
+ * In lockstep mode, physics state is never synchronized. Instead, every
+ * event pushed during lockstep tick T is delivered to every peer
+ * (including this one) at tick T+delay. Each peer only advances to a
+ * tick once all peers have sent their events for it, so all peers see
+ * the same events at the same tick. If the simulation is deterministic
+ * (see {@link NetWorld#setDeterministic}), all peers stay in sync with
+ * network cost independent of the number of obstacles.
+ *
+ * All peers must enable lockstep with the same delay before the game
+ * starts. The delay must be at least 1, and should cover the round trip
+ * time to avoid stalls.
+ *
+ * @param delay The number of ticks between sending and simulating events
+ */
+void NetEventController::enableLockstep(Uint32 delay) {
+    CUAssertLog(_status != Status::INGAME, "Lockstep must be enabled before the game starts");
+    _lockstep = true;
+    _inputDelay = SDL_max(delay,1);
+    _lockstepTick = 0;
+    _lockstepReady = false;
+    _peerTicks.clear();
+    _lockstepEvents.clear();
+}
+
+/**
+ * Disables lockstep mode.
+ *
+ * Physics synchronization (if enabled) resumes on the next update.
+ */
+void NetEventController::disableLockstep() {
+    _lockstep = false;
+    _lockstepReady = false;
+    _peerTicks.clear();
+    
+    // Deliver anything left over rather than drop it
+    for(auto it = _lockstepEvents.begin(); it != _lockstepEvents.end(); ++it) {
+        for(auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            for(auto kt = jt->second.begin(); kt != jt->second.end(); ++kt) {
+                queueInEvent(*kt);
+            }
+        }
+    }
+    _lockstepEvents.clear();
+}
+
+/**
+ * Completes the current lockstep tick.
+ *
+ * This method sends the queued outbound events, stamped with the current
+ * tick, followed by a marker that this peer has finished the tick. It
+ * then moves on to the next tick. This method has no effect unless
+ * {@link #isLockstepReady} is true.
+ *
+ * @return true if the lockstep tick was completed
+ */
+bool NetEventController::advanceLockstep() {
+    if (!isLockstepReady()) {
+        return false;
+    }
+    
+    auto frames = wrap(_outEventQueue);
+    // A frame with no events marks the end of the tick
+    LWSerializer serializer;
+    serializer.writeUint64(_lockstepTick);
+    frames.push_back(serializer.serialize());
+    for(auto it = frames.begin(); it != frames.end(); it++){
+        _network->broadcast(*it);
+    }
+    _outEventQueue.clear();
+    
+    _lockstepTick++;
+    _lockstepReady = false;
+    releaseLockstep();
+    return true;
+}
+
+/**
+ * Releases the events for the current lockstep tick, if possible.
+ *
+ * The events are released once every active peer has finished sending
+ * its events for this tick. They are moved to the inbound queue in a
+ * deterministic order (by sender UUID, then by order sent).
+ *
+ * @return true if the events for the current lockstep tick are released
+ */
+bool NetEventController::releaseLockstep() {
+    if (_lockstepReady) {
+        return true;
+    } else if (_lockstepTick >= _inputDelay) {
+        // Every peer must have completed the tick that targets this one
+        Uint64 needed = _lockstepTick-_inputDelay+1;
+        auto players = _network->getPlayers();
+        for(auto it = players.begin(); it != players.end(); ++it) {
+            if (!_network->isPlayerActive(*it)) {
+                continue;
+            }
+            auto jt = _peerTicks.find(*it);
+            if (jt == _peerTicks.end() || jt->second < needed) {
+                return false;
+            }
+        }
+    }
+    
+    auto it = _lockstepEvents.find(_lockstepTick);
+    if (it != _lockstepEvents.end()) {
+        for(auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+            for(auto kt = jt->second.begin(); kt != jt->second.end(); ++kt) {
+                queueInEvent(*kt);
+            }
+        }
+        _lockstepEvents.erase(it);
+    }
+    _lockstepReady = true;
+    return true;
+}
+
 #pragma mark Event Management
 /**
  * Returns true if there are remaining custom inbound events.
@@ -278,10 +492,61 @@ bool NetEventController::isInAvailable() {
     if ( _inEventQueue.empty() ) {
         return false;
     }
-    
-    Uint64 time = Application::get()->getFixedCount();
-    std::shared_ptr<NetEvent> top = _inEventQueue.front();
-    return top->_eventTimeStamp <= time-_startGameTimeStamp;
+    return isDue(*_inEventQueue.top().event);
+}
+
+/**
+ * Returns true if an inbound event may be processed by the game.
+ *
+ * Events stamped with a tick ahead of this machine are held back until
+ * this machine reaches that tick.
+ *
+ * @param e The inbound event
+ *
+ * @return true if an inbound event may be processed by the game.
+ */
+bool NetEventController::isDue(const NetEvent& e) const {
+    return e._eventTimeStamp <= getGameTick();
+}
+
+/**
+ * Records the latency of an inbound event released to the game.
+ *
+ * The latency is the number of ticks between the tick the event was
+ * sent at and the current game tick.
+ *
+ * @param e The inbound event
+ */
+void NetEventController::recordLatency(const NetEvent& e) {
+    if (_lockstep || e._sourceID == "") {
+        return; // Lockstep ticks are not game ticks
+    }
+    Uint64 tick = getGameTick();
+    Uint64 sent = e._eventTimeStamp;
+    _metrics->record(NetMetrics::Metric::INBOUND_LATENCY, tick > sent ? (double)(tick-sent) : 0.0);
+}
+
+/**
+ * Dispatches every available inbound event to its handler.
+ *
+ * This method pops events for as long as {@link #isInAvailable} is true.
+ * Events without a registered handler are discarded, so this method
+ * should not be combined with {@link #popInEvent} unless every custom
+ * type has a handler.
+ *
+ * @return the number of events dispatched to a handler
+ */
+size_t NetEventController::dispatchInEvents() {
+    size_t count = 0;
+    while (isInAvailable()) {
+        std::shared_ptr<NetEvent> e = popInEvent();
+        Uint8 type = e->_eventType;
+        if (type < _handlers.size() && _handlers[type]) {
+            _handlers[type](*e);
+            count++;
+        }
+    }
+    return count;
 }
 
 /**
@@ -293,11 +558,29 @@ bool NetEventController::isInAvailable() {
  * @return the next custom inbound event
  */
 std::shared_ptr<NetEvent> NetEventController::popInEvent() {
-	auto e = _inEventQueue.front();
+    if (_inEventQueue.empty()) {
+        return nullptr;
+    }
+	auto e = _inEventQueue.top().event;
 	_inEventQueue.pop();
+	_metrics->set(NetMetrics::Gauge::INBOUND_QUEUE, (Sint64)_inEventQueue.size());
+	recordLatency(*e);
 	return e;
 }
 
+/**
+ * Adds a custom event to the inbound queue.
+ *
+ * The queue is ordered by the game tick each event was sent at. Events
+ * sent at the same tick are released in the order they arrived.
+ *
+ * @param e The received event
+ */
+void NetEventController::queueInEvent(const std::shared_ptr<NetEvent>& e) {
+    _inEventQueue.push(InEvent{e->_eventTimeStamp, _inEventCount++, e});
+    _metrics->set(NetMetrics::Gauge::INBOUND_QUEUE, (Sint64)_inEventQueue.size());
+}
+
 /**
  * Queues an outbound event to be sent to peers.
  *
@@ -310,6 +593,20 @@ void NetEventController::pushOutEvent(const std::shared_ptr<NetEvent>& e) {
 	_outEventQueue.push_back(e);
 }
 
+/**
+ * Queues an outbound event to be sent to a single peer.
+ *
+ * Queued events are sent when {@link #updateNet} is called. and cleared
+ * after sending. Unlike {@link #pushOutEvent}, this machine does not
+ * receive a copy of the event.
+ *
+ * @param dst   The UUID of the peer to receive the event
+ * @param e     The event to send
+ */
+void NetEventController::pushOutEventTo(const std::string dst, const std::shared_ptr<NetEvent>& e) {
+    _directOutQueue[dst].push_back(e);
+}
+
 /**
  * Updates the network controller.
  *
@@ -319,77 +616,149 @@ void NetEventController::pushOutEvent(const std::shared_ptr<NetEvent>& e) {
 void NetEventController::updateNet() {
     if(_network){
         checkConnection();
+        updateClock();
 
-        if (_status == Status::INGAME && _physEnabled) {
-            _physController->packPhysSync(NetPhysicsController::SyncType::FULL_SYNC);
+        if (_status == Status::INGAME && _physEnabled && !_lockstep) {
+            _physController->setGameTick(getGameTick());
+            updateSendRate();
+            if (_sendRate.isSnapshotDue()) {
+                _physController->setSyncBudget(_sendRate.getBudget());
+                _physController->packPhysSync(NetPhysicsController::SyncType::FULL_SYNC);
+            }
             _physController->packPhysObj();
             _physController->updateSimulation();
             for (auto it = _physController->getOutEvents().begin(); it != _physController->getOutEvents().end(); it++) {
                 pushOutEvent(*it);
             }
             _physController->getOutEvents().clear();
-                
+            
+            auto& direct = _physController->getDirectOutEvents();
+            for (auto it = direct.begin(); it != direct.end(); it++) {
+                for (auto jt = it->second.begin(); jt != it->second.end(); jt++) {
+                    pushOutEventTo(it->first, *jt);
+                }
+            }
+            direct.clear();
         }
         
         processReceivedData();
-        sendQueuedOutData();
+        if (_status == Status::INGAME && _lockstep) {
+            // Outbound events are sent by advanceLockstep instead
+            releaseLockstep();
+        } else {
+            sendQueuedOutData();
+        }
     }
 }
 
 
 #pragma mark Networking Internals
 /**
- * Unwraps the a byte vector data into a NetEvent.
+ * Unwraps a network frame into the NetEvents that it contains.
+ *
+ * A frame is a single network message holding every event sent by a
+ * peer during one tick. It starts with the shared tick timestamp, which
+ * is followed by each event as a type byte, a payload length, and the
+ * payload itself.
  *
- * The controller automatically detects the type of event, spawns a new
- * empty instance of that event, and calls the event's
- * {@link NetEvent#deserialize} method. This method is only called on
- * outbound events.
+ * The controller automatically detects the type of each event, spawns a
+ * new empty instance of that event, and calls the event's
+ * {@link NetEvent#deserializeFrom} method. The payloads are read in place
+ * from the frame, so no event bytes are copied. This method is only called
+ * on inbound frames.
  *
- * @param byte      The message received
+ * @param data      The frame received
  * @param source    The UUID of the sender
+ *
+ * @return the events in the frame, in the order they were sent
  */
-std::shared_ptr<NetEvent> NetEventController::unwrap(const std::vector<std::byte>& data, std::string source) {
-    CUAssertLog(data.size() >= MIN_MSG_LENGTH && (Uint8)data[0] < _newEventVector.size(),
-                "Unwrapping invalid event");
+std::vector<std::shared_ptr<NetEvent>> NetEventController::unwrap(const std::vector<std::byte>& data, std::string source) {
+    CUAssertLog(data.size() >= MIN_MSG_LENGTH, "Unwrapping invalid frame");
+    std::vector<std::shared_ptr<NetEvent>> events;
     LWDeserializer deserializer;
-    deserializer.receive(data);
-    Uint8 eventType = (Uint8)deserializer.readByte();
-    std::shared_ptr<NetEvent> e = _newEventVector[eventType]->newEvent();
+    deserializer.receive(data.data(), data.size());
     Uint64 eventTimeStamp = deserializer.readUint64();
-
-    Uint64 time = Application::get()->getFixedCount();
-    Uint64 receiveTimeStamp = time-_startGameTimeStamp;
-    e->setMetaData(eventTimeStamp, receiveTimeStamp, source);
-    e->deserialize(std::vector(data.begin()+MIN_MSG_LENGTH,data.end()));
-    return e;
+    Uint64 receiveTimeStamp = getGameTick();
+    
+    while (deserializer.remaining() >= EVENT_HEADER_LENGTH) {
+        Uint8 eventType = (Uint8)deserializer.readByte();
+        Uint32 length = deserializer.readUint32();
+        const std::byte* payload = deserializer.readBytes(length);
+        CUAssertLog(eventType < _newEventVector.size() && payload != nullptr,
+                    "Unwrapping invalid event");
+        if (eventType >= _newEventVector.size() || payload == nullptr) {
+            break;
+        }
+        
+        std::shared_ptr<NetEvent> e = _newEventVector[eventType]->newEvent();
+        e->setMetaData(eventTimeStamp, receiveTimeStamp, source, eventType);
+        e->deserializeFrom(payload, length);
+        if (source != "") {
+            _metrics->recordReceived(eventType, length+EVENT_HEADER_LENGTH);
+        }
+        events.push_back(e);
+    }
+    return events;
 }
 
 /**
- * Wraps a NetEvent into a byte vector.
+ * Wraps a list of NetEvents into network frames.
  *
- * The controller calls the event's {@link NetEvent#serialize()} method
- * and packs the event into byte data. This method is only on inbound
- * events.
+ * The controller calls each event's {@link NetEvent#serializeTo} method
+ * so that the payload is written directly into a reusable frame buffer,
+ * behind a single tick header. Events are batched into as few frames as
+ * possible; a new frame is only started when the next event would push the
+ * current one past {@link #getMaxFrameSize}. An event that is larger than
+ * the limit on its own is sent in a frame by itself. This method is only
+ * called on outbound events.
  *
- * @param e The event to wrap
+ * @param events    The events to wrap
+ *
+ * @return the frames containing the events
  */
-const std::vector<std::byte> NetEventController::wrap(const std::shared_ptr<NetEvent>& e) {
-    LWSerializer serializer;
-    serializer.writeByte((std::byte)getType(*e));
-    //CULog("flag: %x",(std::byte)getType(*e));
-
-    Uint64 time = Application::get()->getFixedCount();
-    serializer.writeUint64(time-_startGameTimeStamp);
-    serializer.writeByteVector(e->serialize());
-    return serializer.serialize();
+std::vector<std::vector<std::byte>> NetEventController::wrap(const std::vector<std::shared_ptr<NetEvent>>& events) {
+    std::vector<std::vector<std::byte>> frames;
+    Uint64 tick = (_lockstep && _status == Status::INGAME) ? _lockstepTick : getGameTick();
+    
+    LWSerializer& serializer = _frameSerializer;
+    serializer.reset();
+    serializer.writeUint64(tick);
+    for(auto it = events.begin(); it != events.end(); ++it) {
+        size_t start = serializer.size();
+        serializer.writeByte((std::byte)getType(*(*it)));
+        serializer.writeUint32(0);
+        (*it)->serializeTo(serializer);
+        size_t end = serializer.size();
+        serializer.rewriteUint32(start+sizeof(std::byte), (Uint32)(end-start-EVENT_HEADER_LENGTH));
+        _metrics->recordSent(getType(*(*it)), end-start);
+        
+        if (start > MIN_MSG_LENGTH && end > _maxFrameSize) {
+            // Move this event to the start of a new frame
+            const std::byte* data = serializer.serialize().data();
+            _frameOverflow.assign(data+start, data+end);
+            serializer.truncate(start);
+            frames.push_back(serializer.serialize());
+            _metrics->add(NetMetrics::Counter::FRAMES_SENT);
+            _metrics->add(NetMetrics::Counter::FRAME_BYTES_SENT, frames.back().size());
+            serializer.reset();
+            serializer.writeUint64(tick);
+            serializer.writeBytes(_frameOverflow.data(), _frameOverflow.size());
+        }
+    }
+    
+    if (serializer.size() > MIN_MSG_LENGTH) {
+        frames.push_back(serializer.serialize());
+        _metrics->add(NetMetrics::Counter::FRAMES_SENT);
+        _metrics->add(NetMetrics::Counter::FRAME_BYTES_SENT, frames.back().size());
+    }
+    return frames;
 }
 
 /**
  * Processes all received packets received during the last update.
  *
- * This method unwraps byte vectors into NetEvents and calls
- * {@link processReceivedEvent()}.
+ * This method unwraps frames into NetEvents and calls
+ * {@link processReceivedEvent()} on each of them in order.
  */
 void NetEventController::processReceivedData(){
     _network->receive([this](const std::string source,
@@ -397,7 +766,22 @@ void NetEventController::processReceivedData(){
         //if (cugl::net::NetworkLayer::get()->isDebug()) {
         //    CULog("DATA %d, CUR STATE %d, SOURCE %s", data[0], _status, source.c_str());
         //}
-        processReceivedEvent(unwrap(data, source));
+        if (source != "") {
+            _metrics->add(NetMetrics::Counter::FRAMES_RECEIVED);
+            _metrics->add(NetMetrics::Counter::FRAME_BYTES_RECEIVED, data.size());
+        }
+        if (_lockstep && _status == Status::INGAME && data.size() == MIN_MSG_LENGTH) {
+            // The end of a lockstep tick for this peer
+            LWDeserializer deserializer;
+            deserializer.receive(data);
+            Uint64& ticks = _peerTicks[source == "" ? _network->getUUID() : source];
+            ticks = SDL_max(ticks, deserializer.readUint64()+1);
+            return;
+        }
+        auto events = unwrap(data, source);
+        for(auto it = events.begin(); it != events.end(); ++it) {
+            processReceivedEvent(*it);
+        }
     });
 }
 
@@ -405,25 +789,45 @@ void NetEventController::processReceivedData(){
  * Processes all events received during the last update.
  *
  * This method either processes events internally if it is a built-in event
- * and adds them to the inbound event queue otherwise.
+ * and adds them to the inbound event queue otherwise. Events are identified
+ * by their type id, and custom events with a registered handler bypass the
+ * queue whenever possible.
  *
  * @param e The received event
  */
 void NetEventController::processReceivedEvent(const std::shared_ptr<NetEvent>& e) {
-    if (auto game = std::dynamic_pointer_cast<GameStateEvent>(e)) {
-        processGameStateEvent(game);
+    Uint8 type = e->_eventType;
+    if (type == _gameStateType) {
+        processGameStateEvent(std::static_pointer_cast<GameStateEvent>(e));
+    } else if (_status == Status::INGAME && _lockstep) {
+        // Hold the event until every peer reaches its target tick
+        std::string source = e->getSourceId() == "" ? _network->getUUID() : e->getSourceId();
+        _lockstepEvents[e->getEventTimeStamp()+_inputDelay][source].push_back(e);
     } else if (_status == Status::INGAME){
-        if (auto phys = std::dynamic_pointer_cast<PhysSyncEvent>(e)) {
-            if(_physEnabled)
-                _physController->processPhysSyncEvent(phys);
+        if (type == _physSyncType) {
+            auto phys = std::static_pointer_cast<PhysSyncEvent>(e);
+            if (_physEnabled && e->getSourceId() != "") {
+                recordLatency(*e);
+                if (!_physController->processPhysSyncEvent(phys)) {
+                    _metrics->add(NetMetrics::Counter::STALE_SNAPSHOTS);
+                } else if (phys->isCompact()) {
+                    pushOutEvent(GameStateEvent::allocSyncAck(phys->getShortUID(), phys->getSequence()));
+                }
+            }
         }
-        else if (auto phys = std::dynamic_pointer_cast<PhysObstEvent>(e)) {
+        else if (type == _physObstType) {
             if (_physEnabled) {
-                _physController->processPhysObstEvent(phys);
+                recordLatency(*e);
+                _physController->processPhysObstEvent(std::static_pointer_cast<PhysObstEvent>(e));
             }
         }
+        else if (type < _handlers.size() && _handlers[type] && _inEventQueue.empty() && isDue(*e)) {
+            // Nothing is ahead of this event, so skip the queue
+            recordLatency(*e);
+            _handlers[type](*e);
+        }
         else {
-            _inEventQueue.push(e);
+            queueInEvent(e);
         }
     }
 }
@@ -436,6 +840,52 @@ void NetEventController::processReceivedEvent(const std::shared_ptr<NetEvent>& e
  * @param e The received event
  */
 void NetEventController::processGameStateEvent(const std::shared_ptr<GameStateEvent>& e) {
+    if (e->getType() == GameStateEvent::EventType::SYNC_ACK) {
+        if (_physEnabled) {
+            _physController->processSyncAck(e->getSourceId(), e->getShortUID(), e->getSequence());
+        }
+        if (e->getShortUID() == _shortUID && e->getSourceId() != "") {
+            _sendRate.recordAck(e->getSourceId(), e->getSequence(), Application::get()->getEllapsedMicros());
+        }
+        return;
+    } else if (e->getType() == GameStateEvent::EventType::INTEREST) {
+        if (_physEnabled) {
+            _physController->processInterest(e->getSourceId(), e->getObstacleId(), e->getRegion());
+        } else if (e->getSourceId() != "") {
+            _pendingInterests[e->getSourceId()] = e;
+        }
+        return;
+    } else if (e->getType() == GameStateEvent::EventType::PREDICT) {
+        if (_physEnabled) {
+            _physController->processPredict(e->getSourceId(), e->getObstacleId());
+        } else if (e->getSourceId() != "") {
+            _pendingPredictions[e->getObstacleId()] = e->getSourceId();
+        }
+        return;
+    } else if (e->getType() == GameStateEvent::EventType::PREDICT_STATE) {
+        if (_physEnabled) {
+            _physController->processPredictState(e->getObstacleId(), e->getTick(),
+                                                 e->getPosition(), e->getVelocity());
+        }
+        return;
+    } else if (e->getType() == GameStateEvent::EventType::CLOCK_PING) {
+        if (_isHost && e->getSourceId() != "") {
+            Uint64 now = Application::get()->getEllapsedMicros();
+            Uint64 tick = Application::get()->getFixedCount();
+            pushOutEventTo(e->getSourceId(), GameStateEvent::allocClockPong(e->getPingTime(), now, now, tick));
+        }
+        return;
+    } else if (e->getType() == GameStateEvent::EventType::CLOCK_PONG) {
+        Uint64 now = Application::get()->getEllapsedMicros();
+        if (!_isHost && _clock.addSample(e->getPingTime(), e->getReceiveTime(), e->getReplyTime(), now)) {
+            _clockSampleTick = e->getTick();
+            _clockSampleTime = e->getReplyTime();
+            double rtt = (double)(now-e->getPingTime())-(double)(e->getReplyTime()-e->getReceiveTime());
+            _sendRate.recordRoundTrip(e->getSourceId(), rtt, now);
+        }
+        return;
+    }
+    
     bool debug = cugl::net::NetworkLayer::get()->isDebug();
     
     if (debug) {
@@ -449,7 +899,11 @@ void NetEventController::processGameStateEvent(const std::shared_ptr<GameStateEv
     }
     if (_status == Status::READY && e->getType() == GameStateEvent::EventType::GAME_START) {
         _status = Status::INGAME;
-        _startGameTimeStamp = Application::get()->getFixedCount();
+        _hostStartTimeStamp = e->getTick();
+        _startGameTimeStamp = _isHost ? _hostStartTimeStamp : Application::get()->getFixedCount();
+        _tickOffset = 0;
+        _lastGameTick = 0;
+        correctTick(true);
     }
     if (_isHost) {
         if (e->getType() == GameStateEvent::EventType::CLIENT_RDY) {
@@ -464,6 +918,61 @@ void NetEventController::processGameStateEvent(const std::shared_ptr<GameStateEv
     }
 }
 
+/**
+ * Updates the clock synchronization with the host.
+ *
+ * Clients ping the host periodically (more often until the clock filter
+ * has warmed up) and correct their game tick towards the host estimate.
+ * This method does nothing on the host, whose clock is the reference.
+ */
+void NetEventController::updateClock() {
+    if (_isHost || (_lockstep && _status == Status::INGAME)) {
+        return;
+    } else if (_status != Status::HANDSHAKE && _status != Status::READY && _status != Status::INGAME) {
+        return;
+    }
+    
+    Uint64 count = Application::get()->getFixedCount();
+    Uint64 interval = _clock.getSampleCount() < CLOCK_WARMUP_SAMPLES ? CLOCK_FAST_INTERVAL : CLOCK_SLOW_INTERVAL;
+    if (count >= _clockPingTimeStamp+interval) {
+        Uint64 now = Application::get()->getEllapsedMicros();
+        pushOutEventTo(_network->getHost(), GameStateEvent::allocClockPing(now));
+        _clockPingTimeStamp = count;
+    }
+    
+    if (_status == Status::INGAME) {
+        correctTick(false);
+    }
+}
+
+/**
+ * Corrects the game tick towards the estimate of the host game tick.
+ *
+ * Small errors are slewed away over several updates so that the game
+ * tick advances smoothly. Large errors (or any error if snap is true)
+ * are corrected at once.
+ *
+ * @param snap  Whether to correct the error at once
+ */
+void NetEventController::correctTick(bool snap) {
+    if (_isHost || !_clock.isSynchronized()) {
+        return;
+    }
+    
+    // Extrapolate the host tick count from the last sample on the host clock
+    Uint64 now = Application::get()->getEllapsedMicros();
+    double step = (double)Application::get()->getFixedStep();
+    double host = (double)_clockSampleTick+(_clock.toRemote(now)-(double)_clockSampleTime)/step;
+    double local = (double)(Application::get()->getFixedCount()-_startGameTimeStamp);
+    double error = (host-(double)_hostStartTimeStamp-local)-_tickOffset;
+    
+    if (snap || std::fabs(error) > CLOCK_SNAP_TICKS) {
+        _tickOffset += error;
+    } else {
+        _tickOffset += SDL_clamp(error, -CLOCK_SLEW_TICKS, CLOCK_SLEW_TICKS);
+    }
+}
+
 /**
  * Returns true if the connection is still active after a status check
  *
@@ -495,7 +1004,10 @@ bool NetEventController::checkConnection() {
                 if (debug) {
                     CULog("NET PHYSICS: Player '%s'", (*it).c_str());
                 }
-                _network->sendTo((*it), wrap(GameStateEvent::allocUIDAssign(shortUID++)));
+                auto frames = wrap({GameStateEvent::allocUIDAssign(shortUID++)});
+                for(auto jt = frames.begin(); jt != frames.end(); ++jt) {
+                    _network->sendTo((*it), *jt);
+                }
             }
         }
         return true;
@@ -503,7 +1015,7 @@ bool NetEventController::checkConnection() {
         if (debug) {
             CULog("NET PHYSICS: Start message sent");
         }
-        pushOutEvent(GameStateEvent::allocGameStart());
+        pushOutEvent(GameStateEvent::allocGameStart(Application::get()->getFixedCount()));
     } else if (state == cugl::net::NetcodeConnection::State::NEGOTIATING) {
         _status = Status::CONNECTING;
         return true;
@@ -519,19 +1031,93 @@ bool NetEventController::checkConnection() {
 }
 
 /**
- * Broadcasts all queued outbound events.
+ * Sends all queued outbound events.
+ *
+ * The events are batched into frames with {@link #wrap}, so a typical
+ * tick results in a single broadcast message per delivery class. Events
+ * queued for a single peer are batched separately, and sent after the
+ * broadcast.
  */
 void NetEventController::sendQueuedOutData(){
-    int msgCount = 0;
-    int byteCount = 0;
-    for(auto it = _outEventQueue.begin(); it != _outEventQueue.end(); it++){
-        auto e = *(it);
-        auto wrapped = wrap(e);
-        msgCount++;
-        byteCount += wrapped.size();
-        //CULog("flag: %x", (std::byte)getType(*e))
-        _network->broadcast(wrap(e));
+    if (!_outEventQueue.empty()) {
+        sendEvents("", _outEventQueue);
+        _outEventQueue.clear();
     }
-    _outEventQueue.clear();
+    
+    for(auto it = _directOutQueue.begin(); it != _directOutQueue.end(); it++) {
+        if (it->second.empty() || !_network->isPlayerActive(it->first)) {
+            continue;
+        }
+        sendEvents(it->first, it->second);
+    }
+    _directOutQueue.clear();
 }
 
+/**
+ * Sends a list of outbound events to one or all peers.
+ *
+ * The events are split by the delivery class of their type. Reliable
+ * events are wrapped and sent on the reliable channel, and unreliable
+ * events on the unreliable channel, each in their original order.
+ *
+ * @param dst       The UUID of the receiving peer ("" to broadcast)
+ * @param events    The events to send
+ */
+void NetEventController::sendEvents(const std::string dst, const std::vector<std::shared_ptr<NetEvent>>& events) {
+    std::vector<std::shared_ptr<NetEvent>> reliable;
+    std::vector<std::shared_ptr<NetEvent>> unreliable;
+    reliable.reserve(events.size());
+    for(auto it = events.begin(); it != events.end(); ++it) {
+        if (getDelivery(getType(*(*it))) == Delivery::UNRELIABLE) {
+            unreliable.push_back(*it);
+        } else {
+            reliable.push_back(*it);
+        }
+    }
+    
+    for (bool ordered : { true, false }) {
+        auto& batch = ordered ? reliable : unreliable;
+        if (batch.empty()) {
+            continue;
+        }
+        auto frames = wrap(batch);
+        for(auto jt = frames.begin(); jt != frames.end(); ++jt) {
+            if (dst == "") {
+                _network->broadcast(*jt, ordered);
+            } else {
+                _network->sendTo(dst, *jt, ordered);
+            }
+            _sendRate.recordSent(dst, jt->size());
+        }
+    }
+    
+    // Acknowledgements of compact snapshots measure the connection
+    Uint64 now = Application::get()->getEllapsedMicros();
+    for(auto it = unreliable.begin(); it != unreliable.end(); ++it) {
+        if (_physEnabled && getType(*(*it)) == _physSyncType) {
+            auto phys = std::static_pointer_cast<PhysSyncEvent>(*it);
+            if (phys->isCompact()) {
+                _sendRate.recordSnapshot(dst, phys->getSequence(), now);
+            }
+        }
+    }
+}
+
+/**
+ * Updates the send scheduler with the current state of the transport.
+ *
+ * This method refreshes the peers and their send buffers, and then
+ * advances the scheduler to the current time. The physics controller
+ * receives the same peers, so that peers joining or leaving mid-game
+ * are synchronized.
+ */
+void NetEventController::updateSendRate() {
+    auto peers = _network->getPlayers();
+    peers.erase(_network->getUUID());
+    _sendRate.setPeers(peers);
+    _physController->setSyncPeers(peers);
+    for(auto it = peers.begin(); it != peers.end(); ++it) {
+        _sendRate.recordBuffered(*it, _network->getBufferedAmount(*it));
+    }
+    _sendRate.update(Application::get()->getEllapsedMicros());
+}
@@ -0,0 +1,423 @@
+//
+//  CUNetMetrics.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides the telemetry for networked physics. It collects the
+//  traffic of every event type, the size of every synchronization correction,
+//  the depth of the interpolation buffers and the latency of inbound events.
+//  All readings are lock-free counters, so they can be recorded from any
+//  thread, and sampled by the game or exported as JSON or CSV.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CUNetMetrics.h>
+#include <sstream>
+#include <limits>
+#include <cmath>
+
+/** The fixed point units of a histogram sum, per unit of the base */
+#define SUM_SCALE   1024.0
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+/** The names of the counters, for export */
+static const char* COUNTER_NAMES[] = {
+    "frames_sent", "frame_bytes_sent", "frames_received", "frame_bytes_received",
+    "corrections", "snap_overrides", "prediction_corrections", "buffer_underruns",
+    "stale_snapshots", "suppressed_syncs", "diverged_regions"
+};
+
+/** The names of the traffic readings, for export */
+static const char* TRAFFIC_NAMES[] = {
+    "events_sent", "bytes_sent", "events_received", "bytes_received"
+};
+
+/** The names of the gauges, for export */
+static const char* GAUGE_NAMES[] = {
+    "interpolating", "inbound_queue"
+};
+
+/** The names of the histograms, for export */
+static const char* METRIC_NAMES[] = {
+    "position_error", "angle_error", "queue_depth", "inbound_latency"
+};
+
+/** The base of each histogram */
+static const double METRIC_BASES[] = {
+    0.001, 0.001, 1, 1
+};
+
+#pragma mark -
+#pragma mark Histogram
+/**
+ * Creates an empty histogram with the given base.
+ *
+ * @param base  The upper bound of the first bucket
+ */
+NetMetrics::Histogram::Histogram(double base) {
+    setBase(base);
+}
+
+/**
+ * Sets the upper bound of the first bucket.
+ *
+ * This resets the histogram.
+ *
+ * @param base  The upper bound of the first bucket
+ */
+void NetMetrics::Histogram::setBase(double base) {
+    _base = base > 0 ? base : 1;
+    reset();
+}
+
+/**
+ * Adds a value to this histogram.
+ *
+ * This method is safe to call from any thread.
+ *
+ * @param value The value to add
+ */
+void NetMetrics::Histogram::record(double value) {
+    if (!(value > 0)) {
+        value = 0;  // Also catches NaN
+    }
+    double units = value/_base;
+    size_t bucket = 0;
+    if (units >= 1) {
+        bucket = SDL_min((size_t)std::log2(units)+1, BUCKETS-1);
+    }
+    _counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    _total.fetch_add(1, std::memory_order_relaxed);
+
+    double limit = (double)std::numeric_limits<Uint64>::max()/2;
+    Uint64 fixed = (Uint64)SDL_min(units*SUM_SCALE, limit);
+    _sum.fetch_add(fixed, std::memory_order_relaxed);
+    Uint64 prev = _max.load(std::memory_order_relaxed);
+    while (fixed > prev && !_max.compare_exchange_weak(prev, fixed, std::memory_order_relaxed)) {}
+}
+
+/**
+ * Removes every value from this histogram.
+ */
+void NetMetrics::Histogram::reset() {
+    for(size_t ii = 0; ii < BUCKETS; ii++) {
+        _counts[ii].store(0, std::memory_order_relaxed);
+    }
+    _total.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Returns the mean of the values in this histogram.
+ *
+ * @return the mean of the values in this histogram.
+ */
+double NetMetrics::Histogram::getMean() const {
+    Uint64 total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+    return (double)_sum.load(std::memory_order_relaxed)/SUM_SCALE*_base/total;
+}
+
+/**
+ * Returns the largest value in this histogram.
+ *
+ * @return the largest value in this histogram.
+ */
+double NetMetrics::Histogram::getMax() const {
+    return (double)_max.load(std::memory_order_relaxed)/SUM_SCALE*_base;
+}
+
+/**
+ * Returns an estimate of the given percentile.
+ *
+ * The estimate is the upper bound of the bucket containing the
+ * percentile, so it is accurate to within a factor of two.
+ *
+ * @param percent   The percentile in [0,100]
+ *
+ * @return an estimate of the given percentile.
+ */
+double NetMetrics::Histogram::getPercentile(double percent) const {
+    Uint64 total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+    double rank = SDL_clamp(percent, 0.0, 100.0)/100*total;
+    Uint64 seen = 0;
+    for(size_t ii = 0; ii < BUCKETS; ii++) {
+        seen += getBucketCount(ii);
+        if (seen >= rank && seen > 0) {
+            // Never report more than the largest value seen
+            return SDL_min(getBucketBound(ii), getMax());
+        }
+    }
+    return getMax();
+}
+
+/**
+ * Returns the upper bound of the given bucket.
+ *
+ * The last bucket has no upper bound, and returns infinity.
+ *
+ * @param bucket    The bucket index
+ *
+ * @return the upper bound of the given bucket.
+ */
+double NetMetrics::Histogram::getBucketBound(size_t bucket) const {
+    if (bucket+1 >= BUCKETS) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return std::ldexp(_base, (int)bucket);
+}
+
+#pragma mark -
+#pragma mark Constructors
+/**
+ * Creates a new metrics record with every reading zero.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ */
+NetMetrics::NetMetrics() {
+    for(int ii = 0; ii < (int)Metric::COUNT; ii++) {
+        _histograms[ii].setBase(METRIC_BASES[ii]);
+    }
+    reset();
+}
+
+/**
+ * Resets every reading (and rate) to zero.
+ *
+ * The event type names are retained.
+ */
+void NetMetrics::reset() {
+    for(int ii = 0; ii < (int)Counter::COUNT; ii++) {
+        _counters[ii].store(0, std::memory_order_relaxed);
+        _lastCounters[ii] = 0;
+        _counterRates[ii] = 0;
+    }
+    for(int ii = 0; ii < (int)Traffic::COUNT; ii++) {
+        for(size_t jj = 0; jj < MAX_TYPES; jj++) {
+            _traffic[ii][jj].store(0, std::memory_order_relaxed);
+            _lastTraffic[ii][jj] = 0;
+            _trafficRates[ii][jj] = 0;
+        }
+    }
+    for(int ii = 0; ii < (int)Gauge::COUNT; ii++) {
+        _gauges[ii].store(0, std::memory_order_relaxed);
+    }
+    for(int ii = 0; ii < (int)Metric::COUNT; ii++) {
+        _histograms[ii].reset();
+    }
+    _sampleTime = 0;
+    _interval = 0;
+}
+
+/**
+ * Returns the name of the given event type.
+ *
+ * If the type has no name, this is "type" followed by the id.
+ *
+ * @param type  The event type id
+ *
+ * @return the name of the given event type.
+ */
+std::string NetMetrics::getTypeName(Uint8 type) const {
+    return _names[type].empty() ? "type"+std::to_string(type) : _names[type];
+}
+
+#pragma mark -
+#pragma mark Sampling
+/**
+ * Computes the rate of every counter since the previous sample.
+ *
+ * The rates are per second of the given clock. Typically this is the
+ * elapsed time of the application, but a simulation may use any clock.
+ * The first sample only establishes the start of the interval.
+ *
+ * @param micros    The current time in microseconds
+ */
+void NetMetrics::sample(Uint64 micros) {
+    bool first = _sampleTime == 0 && _interval == 0;
+    _interval = micros > _sampleTime ? (micros-_sampleTime)/1000000.0 : 0;
+    _sampleTime = micros;
+    double scale = (first || _interval <= 0) ? 0 : 1/_interval;
+
+    for(int ii = 0; ii < (int)Counter::COUNT; ii++) {
+        Uint64 value = _counters[ii].load(std::memory_order_relaxed);
+        _counterRates[ii] = (value-_lastCounters[ii])*scale;
+        _lastCounters[ii] = value;
+    }
+    for(int ii = 0; ii < (int)Traffic::COUNT; ii++) {
+        for(size_t jj = 0; jj < MAX_TYPES; jj++) {
+            Uint64 value = _traffic[ii][jj].load(std::memory_order_relaxed);
+            _trafficRates[ii][jj] = (value-_lastTraffic[ii][jj])*scale;
+            _lastTraffic[ii][jj] = value;
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark Export
+/**
+ * Returns a JSON object with every reading.
+ *
+ * Only event types with traffic (or a name) are included.
+ *
+ * @return a JSON object with every reading.
+ */
+std::shared_ptr<JsonValue> NetMetrics::toJson() const {
+    auto result = JsonValue::allocObject();
+    result->appendValue("time", (double)_sampleTime);
+    result->appendValue("interval", _interval);
+
+    auto counters = JsonValue::allocObject();
+    for(int ii = 0; ii < (int)Counter::COUNT; ii++) {
+        auto entry = JsonValue::allocObject();
+        entry->appendValue("total", (double)get((Counter)ii));
+        entry->appendValue("rate", _counterRates[ii]);
+        counters->appendChild(COUNTER_NAMES[ii], entry);
+    }
+    result->appendChild("counters", counters);
+
+    auto gauges = JsonValue::allocObject();
+    for(int ii = 0; ii < (int)Gauge::COUNT; ii++) {
+        gauges->appendValue(GAUGE_NAMES[ii], (double)get((Gauge)ii));
+    }
+    result->appendChild("gauges", gauges);
+
+    auto types = JsonValue::allocObject();
+    for(size_t jj = 0; jj < MAX_TYPES; jj++) {
+        bool active = !_names[jj].empty();
+        for(int ii = 0; ii < (int)Traffic::COUNT && !active; ii++) {
+            active = get((Traffic)ii, (Uint8)jj) > 0;
+        }
+        if (!active) {
+            continue;
+        }
+        auto entry = JsonValue::allocObject();
+        entry->appendValue("id", (long)jj);
+        for(int ii = 0; ii < (int)Traffic::COUNT; ii++) {
+            auto reading = JsonValue::allocObject();
+            reading->appendValue("total", (double)get((Traffic)ii, (Uint8)jj));
+            reading->appendValue("rate", _trafficRates[ii][jj]);
+            entry->appendChild(TRAFFIC_NAMES[ii], reading);
+        }
+        types->appendChild(getTypeName((Uint8)jj), entry);
+    }
+    result->appendChild("types", types);
+
+    auto histograms = JsonValue::allocObject();
+    for(int ii = 0; ii < (int)Metric::COUNT; ii++) {
+        const Histogram& histogram = _histograms[ii];
+        auto entry = JsonValue::allocObject();
+        entry->appendValue("count", (double)histogram.getCount());
+        entry->appendValue("mean", histogram.getMean());
+        entry->appendValue("p50", histogram.getPercentile(50));
+        entry->appendValue("p90", histogram.getPercentile(90));
+        entry->appendValue("p99", histogram.getPercentile(99));
+        entry->appendValue("max", histogram.getMax());
+        auto buckets = JsonValue::allocArray();
+        for(size_t jj = 0; jj < Histogram::BUCKETS; jj++) {
+            buckets->appendValue((double)histogram.getBucketCount(jj));
+        }
+        entry->appendValue("base", histogram.getBase());
+        entry->appendChild("buckets", buckets);
+        histograms->appendChild(METRIC_NAMES[ii], entry);
+    }
+    result->appendChild("histograms", histograms);
+    return result;
+}
+
+/**
+ * Returns the header row for {@link #toCSV}.
+ *
+ * The columns depend on the named event types, so the header should
+ * be written after every type is attached.
+ *
+ * @return the header row for {@link #toCSV}.
+ */
+std::string NetMetrics::getCSVHeader() const {
+    std::stringstream ss;
+    ss << "time";
+    for(int ii = 0; ii < (int)Counter::COUNT; ii++) {
+        ss << "," << COUNTER_NAMES[ii] << "_per_sec";
+    }
+    for(size_t jj = 0; jj < MAX_TYPES; jj++) {
+        if (_names[jj].empty()) {
+            continue;
+        }
+        for(int ii = 0; ii < (int)Traffic::COUNT; ii++) {
+            ss << "," << _names[jj] << "_" << TRAFFIC_NAMES[ii] << "_per_sec";
+        }
+    }
+    for(int ii = 0; ii < (int)Gauge::COUNT; ii++) {
+        ss << "," << GAUGE_NAMES[ii];
+    }
+    for(int ii = 0; ii < (int)Metric::COUNT; ii++) {
+        const char* name = METRIC_NAMES[ii];
+        ss << "," << name << "_count," << name << "_mean,";
+        ss << name << "_p50," << name << "_p99," << name << "_max";
+    }
+    return ss.str();
+}
+
+/**
+ * Returns a CSV row with the most recent sample.
+ *
+ * The row has the time, the rate of every counter and of the traffic
+ * of every named event type, every gauge, and a summary of every
+ * histogram. It does not include a line terminator.
+ *
+ * @return a CSV row with the most recent sample.
+ */
+std::string NetMetrics::toCSV() const {
+    std::stringstream ss;
+    ss << _sampleTime;
+    for(int ii = 0; ii < (int)Counter::COUNT; ii++) {
+        ss << "," << _counterRates[ii];
+    }
+    for(size_t jj = 0; jj < MAX_TYPES; jj++) {
+        if (_names[jj].empty()) {
+            continue;
+        }
+        for(int ii = 0; ii < (int)Traffic::COUNT; ii++) {
+            ss << "," << _trafficRates[ii][jj];
+        }
+    }
+    for(int ii = 0; ii < (int)Gauge::COUNT; ii++) {
+        ss << "," << get((Gauge)ii);
+    }
+    for(int ii = 0; ii < (int)Metric::COUNT; ii++) {
+        const Histogram& histogram = _histograms[ii];
+        ss << "," << histogram.getCount() << "," << histogram.getMean();
+        ss << "," << histogram.getPercentile(50) << "," << histogram.getPercentile(99);
+        ss << "," << histogram.getMax();
+    }
+    return ss.str();
+}
@@ -43,6 +43,52 @@
 #include <cugl/physics2/net/CUNetPhysicsController.h>
 #include <cugl/physics2/net/CULWSerializer.h>
 
+/** The maximum number of compact snapshots retained per stream */
+#define MAX_SNAPSHOT_HISTORY 64
+/** The default cell size of the interest management grid */
+#define DEFAULT_INTEREST_CELL 4.0f
+/** The default number of synchronizations between far obstacle refreshes */
+#define DEFAULT_FAR_REFRESH 30
+/** The default number of bytes for each prioritized synchronization */
+#define DEFAULT_SYNC_BUDGET 1200
+/** The default minimum display delay of buffered interpolation in ticks */
+#define DEFAULT_MIN_DELAY 2.0f
+/** The default maximum display delay of buffered interpolation in ticks */
+#define DEFAULT_MAX_DELAY 30.0f
+/** The default maximum extrapolation of buffered interpolation in ticks */
+#define DEFAULT_MAX_EXTRAP 6.0f
+/** The maximum number of states retained per snapshot buffer */
+#define MAX_BUFFER_DEPTH 32
+/** The number of jitter deviations covered by the display delay */
+#define JITTER_MARGIN 4.0f
+/** The gain of the running averages for buffered interpolation (RFC 3550) */
+#define CLOCK_GAIN (1.0f/16.0f)
+/** The maximum number of predicted steps retained per obstacle */
+#define MAX_PREDICTION_HISTORY 128
+/** The smallest prediction error that is corrected */
+#define PREDICTION_EPSILON 0.001f
+/** The size of an uncompressed obstacle in a synchronization (id + 6 floats) */
+#define RAW_SYNC_ENTRY_COST 32
+/** The default position (and velocity) error tolerated for an obstacle at rest */
+#define DEFAULT_REST_POSITION 0.01f
+/** The default angle (and angular velocity) error tolerated for an obstacle at rest */
+#define DEFAULT_REST_ANGLE 0.01f
+/** The default number of ticks between keyframes of an obstacle at rest */
+#define DEFAULT_REST_REFRESH 60
+/** The default number of bytes in one world snapshot chunk */
+#define DEFAULT_IMAGE_CHUNK 1024
+/** The default number of world snapshot chunks sent to a peer each tick */
+#define DEFAULT_IMAGE_RATE 4
+/** The number of ticks an obstacle must be missing before it is requested */
+#define MISSING_GRACE 10
+/** The number of ticks between requests for the same missing obstacle */
+#define MISSING_RETRY 60
+/** The number of times a missing obstacle is requested before giving up */
+#define MISSING_ATTEMPTS 3
+/** The default number of ticks between world state digests */
+#define DEFAULT_DIGEST_INTERVAL 30
+/** The number of consecutive digest mismatches before requesting a repair */
+#define DIGEST_MISMATCHES 2
 
 using namespace cugl;
 using namespace cugl::physics2;
@@ -73,8 +119,33 @@ _itprDebug(false),
 _itprCount(0),
 _ovrdCount(0),
 _stepSum(0),
+_bufferUnderruns(0),
+_bufferDepthSum(0),
+_bufferSamples(0),
+_bufferDelay(0),
 _objRotation(0),
-_isHost(false) {
+_isHost(false),
+_itprTick(0),
+_itprMinDelay(DEFAULT_MIN_DELAY),
+_itprMaxDelay(DEFAULT_MAX_DELAY),
+_itprMaxExtrap(DEFAULT_MAX_EXTRAP),
+_gameTick(0),
+_predictError(0),
+_compactSync(true),
+_syncSequence(0),
+_farRefreshRate(DEFAULT_FAR_REFRESH),
+_syncCount(0),
+_syncBudget(DEFAULT_SYNC_BUDGET),
+_restSuppress(true),
+_restPosTolerance(DEFAULT_REST_POSITION),
+_restAngleTolerance(DEFAULT_REST_ANGLE),
+_restRefreshRate(DEFAULT_REST_REFRESH),
+_imageSequence(0),
+_imageChunkSize(DEFAULT_IMAGE_CHUNK),
+_imageChunkRate(DEFAULT_IMAGE_RATE),
+_imageLoading(false),
+_digestInterval(DEFAULT_DIGEST_INTERVAL),
+_digestMismatches(0) {
 }
 
 
@@ -104,6 +175,9 @@ bool NetPhysicsController::init(std::shared_ptr<NetWorld>& world, Uint32 shortUI
     //_world->setshortUID(shortUID);
     _linkSceneToObsFunc = linkFunc;
     _isHost = isHost;
+    _syncQuant.bounds = world->getBounds();
+    _interestGrid = InterestGrid::alloc(world->getBounds(), DEFAULT_INTEREST_CELL);
+    _syncScheduler = SyncScheduler::alloc();
     return true;
 }
 
@@ -119,6 +193,9 @@ void NetPhysicsController::dispose() {
     _world = nullptr;
     _isHost = false;
     _linkSceneToObsFunc = nullptr;
+    _interestGrid = nullptr;
+    _syncScheduler = nullptr;
+    _syncPeers.clear();
 }
 
 #pragma mark Object Management
@@ -141,11 +218,14 @@ ObstacleScene NetPhysicsController::addSharedObstacle(Uint32 factoryID,
     pair.first->setShared(true);
     Uint64 objId = _world->placeObstacle(pair.first);
     if (_isHost){
-        _world->getOwnedObstacles().insert(std::make_pair(pair.first,0));
+        _world->ownObstacle(pair.first);
     }
     if (_linkSceneToObsFunc) {
         _linkSceneToObsFunc(pair.first, pair.second);
     }
+    PhysObstEvent::Record& record = _creations[objId];
+    record.factoryId = factoryID;
+    record.packedParam = bytes;
     _outEvents.push_back(PhysObstEvent::allocCreation(factoryID,objId,bytes));
     return pair;
 }
@@ -158,10 +238,12 @@ ObstacleScene NetPhysicsController::addSharedObstacle(Uint32 factoryID,
  * @param obs   the obstacle to remove
  */
 void NetPhysicsController::removeSharedObstacle(std::shared_ptr<physics2::Obstacle> obj) {
-    auto map = _world->getObstacleIds();
-    if (map.count(obj)) {
-        Uint64 objId = map.at(obj);
+    auto handle = _world->getObstacleHandle(obj);
+    if (handle != SlotRegistry<Obstacle>::INVALID_HANDLE) {
+        Uint64 objId = _world->_obsRegistry.getId(handle);
         _outEvents.push_back(PhysObstEvent::allocDeletion(objId));
+        _restStates.erase(objId);
+        _creations.erase(objId);
         _world->removeObstacle(obj);
         if (_sharedObsToNodeMap.count(obj)) {
             _sharedObsToNodeMap.at(obj)->removeFromParent();
@@ -189,89 +271,1366 @@ void NetPhysicsController::removeSharedObstacle(std::shared_ptr<physics2::Obstac
  * @param duration  number of physics steps to hold ownership
  */
 void NetPhysicsController::acquireObs(std::shared_ptr<physics2::Obstacle> obs, Uint64 duration){
-    auto owned = _world->getOwnedObstacles();
+    _world->ownObstacle(obs, _isHost ? 0 : duration);
+    Uint64 id = _world->getObstacleId(obs);
+    auto event = PhysObstEvent::allocOwnerAcquire(id, duration);
+    _outEvents.push_back(event);
+}
+
+/**
+ * Releases the ownership of the object.
+ *
+ * This method is the opposite of {@link #acquireObs}. When called by a
+ * client, it will return ownership to the host. This method has no effect
+ * if the client does not have ownership of that obstacle or if it is
+ * called by the host.
+ *
+ * @param obs       the obstacle to release
+ */
+void NetPhysicsController::releaseObs(std::shared_ptr<physics2::Obstacle> obs) {
+    if (!_isHost) {
+        _world->disownObstacle(obs);
+        Uint64 id = _world->getObstacleId(obs);
+        auto event = PhysObstEvent::allocOwnerRelease(id);
+        _outEvents.push_back(event);
+    }
+}
+
+/**
+ * Makes this client the owner of all objects in the simulation.
+ *
+ * This method does not actually send any information to the other
+ * clients on the network.  It should be used for initial objects only.
+ */
+void NetPhysicsController::ownAll() {
+    _world->ownAllObstacles();
+}
+
+/**
+ * Adds an object to interpolate with the given target parameters.
+ *
+ * This method is used for error smoothing.
+ *
+ * @param obj   The obstacle to interpolate
+ * @param param The target parameters for interpolation
+ */
+void NetPhysicsController::addSyncObject(std::shared_ptr<physics2::Obstacle> obj,
+                                         const std::shared_ptr<TargetParams>& param) {
+    if (_itprMethod == 1) {
+        return;
+    } else if (_cache.count(obj)) {
+        auto oldParam = _cache.at(obj);
+        obj->setShared(false);
+        // ===== BEGIN NON-SHARED BLOCK =====
+        obj->setLinearVelocity(oldParam->targetVel);
+        obj->setAngularVelocity(oldParam->targetAngV);
+        // ====== END NON-SHARED BLOCK ======
+        obj->setShared(true);
+        param->I = oldParam->I;
+        param->numI = oldParam->numI;
+    }
+    _cache.erase(obj);
+    _cache.insert(std::make_pair(obj,param));
+    _stepSum += param->numSteps;
+    _itprCount++;
+}
+
+#pragma mark -
+#pragma mark Prediction
+/**
+ * Predicts an obstacle locally, leaving the host authoritative.
+ *
+ * This is an alternative to {@link #acquireObs} for obstacles controlled
+ * by the input of this client. The client moves the obstacle immediately,
+ * and only its changes in velocity (the inputs) are sent to the host. The
+ * host replies with its authoritative state, tagged with the last input
+ * it applied. The client then rewinds to that state and replays the steps
+ * predicted since, instead of easing toward a stale position.
+ *
+ * This method has no effect on the host.
+ *
+ * @param obs   the obstacle to predict
+ */
+void NetPhysicsController::predictObs(std::shared_ptr<physics2::Obstacle> obs) {
+    if (_isHost || _predictions.count(obs)) {
+        return;
+    }
+    PredictionBuffer& buffer = _predictions[obs];
+    buffer.ring.resize(MAX_PREDICTION_HISTORY);
+    _cache.erase(obs);
+    _itprBuffers.erase(obs);
+    
+    Uint64 id = _world->getObstacleId(obs);
+    _outEvents.push_back(GameStateEvent::allocPredict(id));
+}
+
+/**
+ * Processes the announcement of a remotely predicted obstacle.
+ *
+ * This method is called automatically by the NetEventController. It
+ * is ignored if this controller is not the host.
+ *
+ * @param source    The UUID of the predicting peer
+ * @param obsId     The predicted obstacle
+ */
+void NetPhysicsController::processPredict(const std::string source, Uint64 obsId) {
+    if (!_isHost || source == "") {
+        return;
+    }
+    RemotePrediction& remote = _remotePredictions[obsId];
+    remote.source = source;
+    remote.tick = 0;
+}
+
+/**
+ * Processes the authoritative state of a locally predicted obstacle.
+ *
+ * The obstacle is corrected by the difference between the authoritative
+ * state and the prediction for the given tick, and the steps predicted
+ * after that tick are replayed from the corrected state.
+ *
+ * This method is called automatically by the NetEventController.
+ *
+ * @param obsId The predicted obstacle
+ * @param tick  The last input tick applied to the authoritative state
+ * @param pos   The authoritative position
+ * @param vel   The authoritative linear velocity
+ */
+void NetPhysicsController::processPredictState(Uint64 obsId, Uint64 tick, const Vec2 pos, const Vec2 vel) {
+    auto obj = _world->getObstacle(obsId);
+    auto it = _predictions.find(obj);
+    if (it == _predictions.end()) {
+        return;
+    }
+    
+    // Rewind to the acknowledged step, discarding everything before it
+    PredictionBuffer& buffer = it->second;
+    size_t capacity = buffer.ring.size();
+    bool found = false;
+    Vec2 predicted;
+    while (buffer.count > 0 && buffer.ring[buffer.head].tick <= tick) {
+        if (buffer.ring[buffer.head].tick == tick) {
+            predicted = buffer.ring[buffer.head].pos;
+            found = true;
+        }
+        buffer.head = (buffer.head+1) % capacity;
+        buffer.count--;
+    }
+    if (!found) {
+        return; // Stale, or older than the history
+    }
+    
+    // Replay the later steps from the authoritative position
+    Vec2 replay = pos;
+    for (size_t ii = 0; ii < buffer.count; ii++) {
+        PredictedState& state = buffer.ring[(buffer.head+ii) % capacity];
+        replay += state.delta;
+        state.pos = replay;
+    }
+    
+    Vec2 error = pos-predicted;
+    _predictError = error.length();
+    if (_metrics) {
+        _metrics->record(NetMetrics::Metric::POSITION_ERROR, _predictError);
+    }
+    if (_predictError > PREDICTION_EPSILON) {
+        if (_metrics) {
+            _metrics->add(NetMetrics::Counter::PREDICTION_CORRECTIONS);
+        }
+        obj->setShared(false);
+        // ===== BEGIN NON-SHARED BLOCK =====
+        obj->setPosition(buffer.count ? replay : pos);
+        if (!buffer.count) {
+            obj->setLinearVelocity(vel);
+        }
+        // ====== END NON-SHARED BLOCK ======
+        obj->setShared(true);
+    }
+}
+
+/**
+ * Records the current step of every locally predicted obstacle.
+ *
+ * Each step is recorded once per game tick. Recording the same tick
+ * again overwrites the previous record. The input of each new step is
+ * sent to the host, even if it is unchanged, so that the host can tag
+ * its authoritative state with the last applied input.
+ */
+void NetPhysicsController::recordPredictions() {
+    std::shared_ptr<PhysObstEvent> inputs = nullptr;
+    for (auto it = _predictions.begin(); it != _predictions.end(); ++it) {
+        PredictionBuffer& buffer = it->second;
+        size_t capacity = buffer.ring.size();
+        
+        PredictedState* state = nullptr;
+        Vec2 prev = it->first->getPosition();
+        if (buffer.count > 0) {
+            PredictedState& last = buffer.ring[(buffer.head+buffer.count-1) % capacity];
+            if (last.tick == _gameTick) {
+                state = &last;
+                prev = last.pos-last.delta;
+            } else {
+                prev = last.pos;
+            }
+        }
+        if (state == nullptr) {
+            if (buffer.count == capacity) {
+                buffer.head = (buffer.head+1) % capacity;
+                buffer.count--;
+            }
+            state = &buffer.ring[(buffer.head+buffer.count) % capacity];
+            buffer.count++;
+            if (inputs == nullptr) {
+                inputs = PhysObstEvent::allocDelta();
+            }
+            PhysObstEvent::Delta& delta = inputs->addDelta(_world->getObstacleId(it->first));
+            delta.mask = PhysObstEvent::Delta::VELOCITY;
+            delta.vel = it->first->getLinearVelocity();
+        }
+        
+        state->tick = _gameTick;
+        state->input = it->first->getLinearVelocity();
+        state->pos = it->first->getPosition();
+        state->delta = state->pos-prev;
+    }
+    if (inputs != nullptr) {
+        _outEvents.push_back(inputs);
+    }
+}
+
+/**
+ * Packs the authoritative state of every remotely predicted obstacle.
+ *
+ * Each state is sent directly to the predicting peer, and is tagged with
+ * the last input tick of that peer applied to the obstacle.
+ */
+void NetPhysicsController::packPredictStates() {
+    for (auto it = _remotePredictions.begin(); it != _remotePredictions.end(); ++it) {
+        auto obj = _world->getObstacle(it->first);
+        if (obj == nullptr || it->second.tick == 0) {
+            continue;
+        }
+        _directEvents[it->second.source].push_back(
+            GameStateEvent::allocPredictState(it->first, it->second.tick,
+                                              obj->getPosition(), obj->getLinearVelocity()));
+    }
+}
+
+/**
+ * Applies a single obstacle delta record to the simulation.
+ *
+ * Every field present in the record is applied in one pass, with
+ * sharing disabled. Records for unknown obstacles are ignored.
+ *
+ * @param delta     The record to apply
+ * @param source    The UUID of the peer that sent the record
+ * @param tick      The game tick the record was sent on
+ */
+void NetPhysicsController::applyObstDelta(const PhysObstEvent::Delta& delta,
+                                          const std::string& source, Uint64 tick) {
+    auto obj = _world->getObstacle(delta.obstacleId);
+    if (obj == nullptr) {
+        noteMissing(delta.obstacleId);
+        return;
+    }
+    
+    if (delta.has(PhysObstEvent::Delta::POSITION) || delta.has(PhysObstEvent::Delta::VELOCITY)) {
+        // Track the inputs applied to obstacles predicted by this peer
+        auto remote = _remotePredictions.find(delta.obstacleId);
+        if (remote != _remotePredictions.end() && remote->second.source == source) {
+            remote->second.tick = SDL_max(remote->second.tick, tick);
+        }
+    }
+    
+    obj->setShared(false);
+    // ===== BEGIN NON-SHARED BLOCK =====
+    if (delta.has(PhysObstEvent::Delta::BODY_TYPE)) {
+        obj->setBodyType(delta.bodyType);
+    }
+    if (delta.has(PhysObstEvent::Delta::POSITION)) {
+        obj->setPosition(delta.pos);
+    }
+    if (delta.has(PhysObstEvent::Delta::VELOCITY)) {
+        obj->setLinearVelocity(delta.vel);
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGLE)) {
+        obj->setAngle(delta.angle);
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGULAR_VEL)) {
+        obj->setAngularVelocity(delta.angularVel);
+    }
+    if (delta.has(PhysObstEvent::Delta::BOOL_CONSTS)) {
+        const PhysObstEvent::BoolConsts& bools = delta.bools;
+        if (bools.isEnabled != obj->isEnabled()) {
+            obj->setEnabled(bools.isEnabled);
+        }
+        if (bools.isAwake != obj->isAwake()) {
+            obj->setAwake(bools.isAwake);
+        }
+        if (bools.isSleepingAllowed != obj->isSleepingAllowed()) {
+            obj->setSleepingAllowed(bools.isSleepingAllowed);
+        }
+        if (bools.isFixedRotation != obj->isFixedRotation()) {
+            obj->setFixedRotation(bools.isFixedRotation);
+        }
+        if (bools.isBullet != obj->isBullet()) {
+            obj->setBullet(bools.isBullet);
+        }
+        if (bools.isSensor != obj->isSensor()) {
+            obj->setSensor(bools.isSensor);
+        }
+    }
+    if (delta.has(PhysObstEvent::Delta::FLOAT_CONSTS)) {
+        const PhysObstEvent::FloatConsts& floats = delta.floats;
+        if (floats.density != obj->getDensity()) {
+            obj->setDensity(floats.density);
+        }
+        if (floats.friction != obj->getFriction()) {
+            obj->setFriction(floats.friction);
+        }
+        if (floats.restitution != obj->getRestitution()) {
+            obj->setRestitution(floats.restitution);
+        }
+        if (floats.linearDamping != obj->getLinearDamping()) {
+            obj->setLinearDamping(floats.linearDamping);
+        }
+        if (floats.angularDamping != obj->getAngularDamping()) {
+            obj->setAngularDamping(floats.angularDamping);
+        }
+        if (floats.gravityScale != obj->getGravityScale()) {
+            obj->setGravityScale(floats.gravityScale);
+        }
+        if (floats.mass != obj->getMass()) {
+            obj->setMass(floats.mass);
+        }
+        if (floats.inertia != obj->getInertia()) {
+            obj->setInertia(floats.inertia);
+        }
+        if (floats.centroid != obj->getCentroid()) {
+            obj->setCentroid(floats.centroid);
+        }
+    }
+    // ====== END NON-SHARED BLOCK ======
+    obj->setShared(true);
+}
+
+#pragma mark -
+#pragma mark World Snapshots
+/**
+ * Fills a delta record with the full state of an obstacle.
+ *
+ * @param delta The record to fill
+ * @param obj   The obstacle to read
+ */
+static void fill_state(PhysObstEvent::Delta& delta, const std::shared_ptr<physics2::Obstacle>& obj) {
+    delta.mask = PhysObstEvent::Delta::POSITION | PhysObstEvent::Delta::VELOCITY |
+                 PhysObstEvent::Delta::ANGLE | PhysObstEvent::Delta::ANGULAR_VEL |
+                 PhysObstEvent::Delta::BODY_TYPE | PhysObstEvent::Delta::BOOL_CONSTS |
+                 PhysObstEvent::Delta::FLOAT_CONSTS;
+    delta.pos = obj->getPosition();
+    delta.vel = obj->getLinearVelocity();
+    delta.angle = obj->getAngle();
+    delta.angularVel = obj->getAngularVelocity();
+    delta.bodyType = obj->getBodyType();
+    
+    PhysObstEvent::BoolConsts& bools = delta.bools;
+    bools.isEnabled = obj->isEnabled();
+    bools.isAwake = obj->isAwake();
+    bools.isSleepingAllowed = obj->isSleepingAllowed();
+    bools.isFixedRotation = obj->isFixedRotation();
+    bools.isBullet = obj->isBullet();
+    bools.isSensor = obj->isSensor();
+    
+    PhysObstEvent::FloatConsts& floats = delta.floats;
+    floats.density = obj->getDensity();
+    floats.friction = obj->getFriction();
+    floats.restitution = obj->getRestitution();
+    floats.linearDamping = obj->getLinearDamping();
+    floats.angularDamping = obj->getAngularDamping();
+    floats.gravityScale = obj->getGravityScale();
+    floats.mass = obj->getMass();
+    floats.inertia = obj->getInertia();
+    floats.centroid = obj->getCentroid();
+}
+
+/**
+ * Requests a complete snapshot of the world from the host.
+ *
+ * This should be called by a client that joins (or rejoins) a game in
+ * progress. The host streams the snapshot in chunks, while live updates
+ * keep flowing. Until the snapshot is complete, obstacle events are held
+ * back, and are replayed once the snapshot has been applied.
+ *
+ * This method does nothing on the host.
+ */
+void NetPhysicsController::requestWorld() {
+    if (_isHost) {
+        return;
+    }
+    
+    // Anything we know of that is not in the snapshot was deleted
+    _imageKnown.clear();
+    auto view = _world->getObstacleView();
+    for (size_t ii = 0; ii < view.size(); ii++) {
+        if (view[ii]->isShared() || _creations.count(view.getId(ii))) {
+            _imageKnown.insert(view.getId(ii));
+        }
+    }
+    _imageLoading = true;
+    _missingObs.clear();
+    _outEvents.push_back(PhysObstEvent::allocWorldRequest(std::vector<Uint64>()));
+}
+
+/**
+ * Creates an obstacle announced by a peer.
+ *
+ * The obstacle is created with the given factory and activated under the
+ * given id. If an obstacle with this id already exists, it is returned
+ * instead, so that a creation may safely be applied twice (once from a
+ * snapshot and once from the live event).
+ *
+ * @param obsId     The obstacle global id
+ * @param factoryId The obstacle factory id
+ * @param params    The packed parameters for the factory
+ *
+ * @return the created obstacle
+ */
+std::shared_ptr<physics2::Obstacle> NetPhysicsController::createRemoteObstacle(Uint64 obsId, Uint32 factoryId,
+                                                                              const std::shared_ptr<std::vector<std::byte>>& params) {
+    auto obj = _world->getObstacle(obsId);
+    if (obj != nullptr) {
+        return obj;
+    }
+    
+    CUAssertLog(factoryId < _obstacleFacts.size(), "Unknown object Factory %u", factoryId);
+    auto pair = _obstacleFacts[factoryId]->createObstacle(*params);
+    _world->activateObstacle(obsId,pair.first);
+    if (_linkSceneToObsFunc) {
+        _linkSceneToObsFunc(pair.first, pair.second);
+        _sharedObsToNodeMap.insert(std::make_pair(pair.first, pair.second));
+    }
     if(_isHost){
-        owned.insert(std::make_pair(obs, 0));
+        _world->ownObstacle(pair.first);
+    }
+    
+    PhysObstEvent::Record& record = _creations[obsId];
+    record.factoryId = factoryId;
+    record.packedParam = params;
+    _missingObs.erase(obsId);
+    return pair.first;
+}
+
+/**
+ * Removes an obstacle deleted by a peer.
+ *
+ * This removes the obstacle from the world and the scene graph, and
+ * clears any synchronization state kept for it.
+ *
+ * @param obsId The obstacle global id
+ * @param obj   The obstacle to remove
+ */
+void NetPhysicsController::removeRemoteObstacle(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obj) {
+    _cache.erase(obj);
+    _itprBuffers.erase(obj);
+    _predictions.erase(obj);
+    _remotePredictions.erase(obsId);
+    _restStates.erase(obsId);
+    _creations.erase(obsId);
+    _missingObs.erase(obsId);
+    _world->removeObstacle(obj);
+    if (_sharedObsToNodeMap.count(obj)) {
+        _sharedObsToNodeMap.at(obj)->removeFromParent();
+        _sharedObsToNodeMap.erase(obj);
+    }
+}
+
+/**
+ * Records that a peer referenced an obstacle that does not exist locally.
+ *
+ * The obstacle will be requested from the host in a later call to
+ * {@link #packImageRequests}.
+ *
+ * @param obsId The obstacle global id
+ */
+void NetPhysicsController::noteMissing(Uint64 obsId) {
+    if (_isHost || _imageLoading) {
+        return; // The complete snapshot will cover it
+    }
+    if (!_missingObs.count(obsId)) {
+        _missingObs[obsId].tick = _itprTick;
+    }
+}
+
+/**
+ * Requests a snapshot of the missing obstacles from the host.
+ *
+ * All obstacles due for a request are coalesced into a single
+ * {@link PhysObstEvent::EventType::WORLD_REQUEST} event. An obstacle is
+ * only requested a few times before it is given up on.
+ */
+void NetPhysicsController::packImageRequests() {
+    if (_missingObs.empty() || _imageLoading) {
+        return;
+    }
+    
+    std::vector<Uint64> obsIds;
+    for (auto it = _missingObs.begin(); it != _missingObs.end(); ++it) {
+        MissingObstacle& missing = it->second;
+        // An update may simply have overtaken the creation, so wait a bit
+        Uint64 wait = missing.attempts ? MISSING_RETRY : MISSING_GRACE;
+        if (missing.attempts >= MISSING_ATTEMPTS || _itprTick-missing.tick < wait) {
+            continue;
+        }
+        missing.tick = _itprTick;
+        missing.attempts++;
+        obsIds.push_back(it->first);
+    }
+    if (!obsIds.empty()) {
+        _outEvents.push_back(PhysObstEvent::allocWorldRequest(obsIds));
+    }
+}
+
+/**
+ * Returns a snapshot of the requested obstacles, encoded as bytes.
+ *
+ * @param request   The obstacles to include
+ *
+ * @return a snapshot of the requested obstacles, encoded as bytes.
+ */
+std::vector<std::byte> NetPhysicsController::captureImage(const ImageRequest& request) {
+    std::vector<PhysObstEvent::Record> records;
+    auto add = [&](Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obj) {
+        auto created = _creations.find(obsId);
+        if (!obj->isShared() && created == _creations.end()) {
+            return; // Not a networked obstacle
+        }
+        records.emplace_back();
+        PhysObstEvent::Record& record = records.back();
+        if (created != _creations.end()) {
+            record.factoryId = created->second.factoryId;
+            record.packedParam = created->second.packedParam;
+        }
+        record.state.obstacleId = obsId;
+        fill_state(record.state, obj);
+    };
+    
+    if (request.complete) {
+        auto view = _world->getObstacleView();
+        records.reserve(view.size());
+        for (size_t ii = 0; ii < view.size(); ii++) {
+            add(view.getId(ii), view[ii]);
+        }
+    } else {
+        records.reserve(request.obsIds.size());
+        for (auto it = request.obsIds.begin(); it != request.obsIds.end(); ++it) {
+            auto obj = _world->getObstacle(*it);
+            if (obj != nullptr) {
+                add(*it, obj);
+            }
+        }
+    }
+    return PhysObstEvent::encodeImage(records, request.complete);
+}
+
+/**
+ * Streams the requested world snapshots to their peers.
+ *
+ * A snapshot is taken for a peer whenever it has pending requests and is
+ * not already receiving one. Each stream sends at most
+ * {@link #getImageChunkRate} chunks per call (host only).
+ */
+void NetPhysicsController::packImageChunks() {
+    for (auto it = _imageRequests.begin(); it != _imageRequests.end(); ) {
+        if (_imageStreams.count(it->first)) {
+            ++it;   // Coalesce until the current snapshot is through
+            continue;
+        }
+        ImageStream& stream = _imageStreams[it->first];
+        stream.imageId = ++_imageSequence;
+        stream.tick = _gameTick;
+        stream.bytes = captureImage(it->second);
+        stream.chunkSize = _imageChunkSize;
+        stream.next = 0;
+        stream.count = (Uint32)((stream.bytes.size()+stream.chunkSize-1)/stream.chunkSize);
+        it = _imageRequests.erase(it);
+    }
+    
+    for (auto it = _imageStreams.begin(); it != _imageStreams.end(); ) {
+        ImageStream& stream = it->second;
+        auto& events = _directEvents[it->first];
+        for (Uint32 ii = 0; ii < _imageChunkRate && stream.next < stream.count; ii++) {
+            size_t start = stream.next*stream.chunkSize;
+            size_t end = SDL_min(start+stream.chunkSize, stream.bytes.size());
+            auto chunk = std::make_shared<std::vector<std::byte>>(stream.bytes.begin()+start,
+                                                                  stream.bytes.begin()+end);
+            events.push_back(PhysObstEvent::allocWorldChunk(stream.imageId, stream.next,
+                                                            stream.count, stream.tick, chunk));
+            stream.next++;
+        }
+        if (stream.next >= stream.count) {
+            it = _imageStreams.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/**
+ * Adds a chunk to the world snapshot being reassembled.
+ *
+ * When the last chunk arrives, the snapshot is applied with
+ * {@link #applyImage}. A chunk from a newer snapshot discards any
+ * older snapshot still being reassembled.
+ *
+ * @param event The chunk to add
+ */
+void NetPhysicsController::receiveImageChunk(const std::shared_ptr<PhysObstEvent>& event) {
+    Uint32 index = event->getChunkIndex();
+    Uint32 count = event->getChunkCount();
+    if (index >= count || event->getPackedParam() == nullptr) {
+        return;
+    }
+    
+    ImageAssembly& image = _imageAssembly;
+    if (image.source != event->getSourceId() || image.imageId != event->getImageId()) {
+        if (image.source == event->getSourceId() && event->getImageId() < image.imageId) {
+            return; // Chunk of an abandoned snapshot
+        }
+        image = ImageAssembly();
+        image.source = event->getSourceId();
+        image.imageId = event->getImageId();
+        image.tick = event->getImageTick();
+        image.chunks.resize(count);
+    } else if (image.chunks.size() != count) {
+        return;
+    }
+    
+    if (image.chunks[index] == nullptr) {
+        image.chunks[index] = event->getPackedParam();
+        image.received++;
+    }
+    if (image.received < image.chunks.size()) {
+        return;
+    }
+    
+    size_t total = 0;
+    for (auto it = image.chunks.begin(); it != image.chunks.end(); ++it) {
+        total += (*it)->size();
+    }
+    std::vector<std::byte> bytes;
+    bytes.reserve(total);
+    for (auto it = image.chunks.begin(); it != image.chunks.end(); ++it) {
+        bytes.insert(bytes.end(), (*it)->begin(), (*it)->end());
+    }
+    std::string source = image.source;
+    Uint64 tick = image.tick;
+    image.chunks.clear();
+    image.received = 0;
+    
+    std::vector<PhysObstEvent::Record> records;
+    bool complete;
+    if (!PhysObstEvent::decodeImage(bytes, records, complete)) {
+        CULogError("NET PHYSICS: Discarding corrupt world snapshot %u", image.imageId);
+        if (_imageLoading) {
+            _outEvents.push_back(PhysObstEvent::allocWorldRequest(std::vector<Uint64>()));
+        }
+        return;
+    }
+    applyImage(records, complete, source, tick);
+}
+
+/**
+ * Applies a world snapshot to the simulation.
+ *
+ * The snapshot is applied in a single pass. Missing obstacles are created,
+ * and every obstacle in it is set to its recorded state. A complete
+ * snapshot also removes the shared obstacles that were deleted before it
+ * was taken. Finally, any obstacle events held back while waiting on a
+ * complete snapshot are replayed if they are not older than it.
+ *
+ * @param records   The obstacles in the snapshot
+ * @param complete  Whether the snapshot contains the entire world
+ * @param source    The UUID of the peer that sent the snapshot
+ * @param tick      The game tick at which the snapshot was taken
+ */
+void NetPhysicsController::applyImage(const std::vector<PhysObstEvent::Record>& records, bool complete,
+                                      const std::string& source, Uint64 tick) {
+    std::unordered_set<Uint64> present;
+    for (auto it = records.begin(); it != records.end(); ++it) {
+        Uint64 obsId = it->state.obstacleId;
+        bool rebuild = it->factoryId < _obstacleFacts.size() && it->packedParam != nullptr;
+        present.insert(obsId);
+        
+        auto obj = _world->getObstacle(obsId);
+        if (obj == nullptr) {
+            if (!rebuild) {
+                continue; // Initial obstacles cannot be rebuilt
+            }
+            obj = createRemoteObstacle(obsId, it->factoryId, it->packedParam);
+        } else if (rebuild && !_creations.count(obsId)) {
+            PhysObstEvent::Record& record = _creations[obsId];
+            record.factoryId = it->factoryId;
+            record.packedParam = it->packedParam;
+        }
+        
+        // The snapshot supersedes any correction in progress
+        _cache.erase(obj);
+        _itprBuffers.erase(obj);
+        _missingObs.erase(obsId);
+        applyObstDelta(it->state, source, tick);
+    }
+    
+    if (!complete) {
+        return;
+    }
+    for (auto it = _imageKnown.begin(); it != _imageKnown.end(); ++it) {
+        auto obj = present.count(*it) ? nullptr : _world->getObstacle(*it);
+        if (obj != nullptr) {
+            removeRemoteObstacle(*it, obj);
+        }
+    }
+    _imageKnown.clear();
+    
+    if (_imageLoading) {
+        _imageLoading = false;
+        std::vector<std::shared_ptr<PhysObstEvent>> backlog;
+        backlog.swap(_imageBacklog);
+        for (auto it = backlog.begin(); it != backlog.end(); ++it) {
+            if ((*it)->getSourceId() == source && (*it)->getEventTimeStamp() < tick) {
+                continue; // Already part of the snapshot
+            }
+            processPhysObstEvent(*it);
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark State Digests
+/**
+ * Compares the world state digest of the host with our own.
+ *
+ * If the digests disagree twice in a row, we send our region digests to
+ * the host, so that it can repair the regions that have diverged. A
+ * single disagreement is ignored, as it is often an obstacle that is
+ * just coming to rest on one machine before the other.
+ *
+ * @param source    The UUID of the host
+ * @param digest    The world state digest of the host
+ * @param regions   The number of digest regions of the host
+ */
+void NetPhysicsController::processWorldDigest(const std::string& source, Uint64 digest, Uint32 regions) {
+    if (_imageLoading || !_imageAssembly.chunks.empty()) {
+        return; // A snapshot is already on its way
+    }
+    
+    std::vector<Uint64> local;
+    if (_world->computeDigests(local) == digest) {
+        _digestMismatches = 0;
+        return;
+    }
+    CUAssertLog(local.size() == regions, "Peers disagree on the digest regions");
+    if (++_digestMismatches >= DIGEST_MISMATCHES && local.size() == regions) {
+        _directEvents[source].push_back(PhysObstEvent::allocRegionDigests(local));
+        _digestMismatches = 0;
+    }
+}
+
+/**
+ * Repairs the regions where a peer disagrees with our state digests.
+ *
+ * The settled obstacles in every region that disagrees are sent to the
+ * peer as a world snapshot (host only).
+ *
+ * @param source    The UUID of the peer
+ * @param digests   The region state digests of the peer
+ */
+void NetPhysicsController::processRegionDigests(const std::string& source, const std::vector<Uint64>& digests) {
+    std::vector<Uint64> local;
+    _world->computeDigests(local);
+    if (local.size() != digests.size()) {
+        return;
+    }
+    
+    std::vector<bool> diverged(local.size(), false);
+    Uint32 count = 0;
+    for (size_t ii = 0; ii < local.size(); ii++) {
+        if (local[ii] != digests[ii]) {
+            diverged[ii] = true;
+            count++;
+        }
+    }
+    if (_metrics) {
+        _metrics->add(NetMetrics::Counter::DIVERGED_REGIONS, count);
+    }
+    if (count == 0) {
+        return;
+    }
+    
+    std::vector<Uint64> repairs;
+    auto view = _world->getObstacleView();
+    for (size_t ii = 0; ii < view.size(); ii++) {
+        const auto& obj = view[ii];
+        if (_world->isDigestSettled(obj) && diverged[_world->getDigestRegion(obj->getPosition())]) {
+            repairs.push_back(view.getId(ii));
+        }
+    }
+    if (!repairs.empty()) {
+        ImageRequest& request = _imageRequests[source];
+        request.obsIds.insert(repairs.begin(), repairs.end());
+    }
+}
+
+#pragma mark -
+#pragma mark Interpolation
+/**
+ * Sets the method for smoothing synchronized objects.
+ *
+ * Switching methods discards any interpolation in progress.
+ *
+ * @param method    The method for smoothing synchronized objects
+ */
+void NetPhysicsController::setInterpolation(ItprMethod method) {
+    if ((Uint32)method != _itprMethod) {
+        _cache.clear();
+        _itprBuffers.clear();
+        _itprClocks.clear();
+        _itprMethod = (Uint32)method;
+    }
+}
+
+/**
+ * Updates the clock estimate of a sender of synchronizations.
+ *
+ * This method is used for buffered interpolation, and should be called
+ * once for each synchronization received.
+ *
+ * @param source    The UUID of the sender
+ * @param tick      The sender tick of the synchronization
+ */
+void NetPhysicsController::updateClock(const std::string source, Uint64 tick) {
+    float sample = (float)_itprTick-(float)tick;
+    auto clock = _itprClocks.find(source);
+    if (clock == _itprClocks.end()) {
+        ClockEstimate estimate;
+        estimate.offset = sample;
+        estimate.last = sample;
+        _itprClocks[source] = estimate;
+        return;
+    }
+    
+    ClockEstimate& estimate = clock->second;
+    estimate.jitter += (std::abs(sample-estimate.last)-estimate.jitter)*CLOCK_GAIN;
+    estimate.offset += (sample-estimate.offset)*CLOCK_GAIN;
+    estimate.last = sample;
+}
+
+/**
+ * Adds a synchronized state to the snapshot buffer of an obstacle.
+ *
+ * This method is used for buffered interpolation. The clock estimate of
+ * the sender should be updated first.
+ *
+ * @param obj       The synchronized obstacle
+ * @param source    The UUID of the sender
+ * @param tick      The sender tick of the state
+ * @param param     The synchronized state
+ */
+void NetPhysicsController::bufferSyncObject(const std::shared_ptr<physics2::Obstacle>& obj,
+                                            const std::string source, Uint64 tick,
+                                            const PhysSyncEvent::Parameters& param) {
+    SnapshotBuffer& buffer = _itprBuffers[obj];
+    if (buffer.source != source) {
+        buffer.source = source;
+        buffer.states.clear();
+    }
+    
+    auto pos = buffer.states.end();
+    while (pos != buffer.states.begin() && (pos-1)->tick >= tick) {
+        if ((pos-1)->tick == tick) {
+            return; // Duplicate state
+        }
+        --pos;
+    }
+    
+    BufferedState state;
+    state.tick = tick;
+    state.pos = Vec2(param.x,param.y);
+    state.vel = Vec2(param.vx,param.vy);
+    state.angle = param.angle;
+    state.angV = param.vAngular;
+    if (pos != buffer.states.begin()) {
+        const BufferedState& prev = *(pos-1);
+        float ticks = (float)(tick-prev.tick);
+        state.angle += 2*M_PI*std::round((prev.angle-state.angle)/(2*M_PI));
+        state.rate = (state.pos-prev.pos)/ticks;
+        state.angRate = (state.angle-prev.angle)/ticks;
+        if (pos == buffer.states.end()) {
+            buffer.interval += (ticks-buffer.interval)*CLOCK_GAIN;
+        }
+    } else {
+        state.angle += 2*M_PI*std::round((obj->getAngle()-state.angle)/(2*M_PI));
+        state.rate = state.vel*_world->getStepsize();
+        state.angRate = state.angV*_world->getStepsize();
+    }
+    buffer.states.insert(pos, state);
+    
+    while (buffer.states.size() > MAX_BUFFER_DEPTH) {
+        buffer.states.pop_front();
+    }
+}
+
+/**
+ * Updates every buffered obstacle to the current display time.
+ *
+ * Each obstacle is interpolated between the two states bracketing the
+ * display time. If there is no newer state, the obstacle is extrapolated
+ * for a bounded number of ticks, and the update counts as an underrun
+ * (unless the obstacle is at rest). After that, the obstacle is left to the
+ * local simulation until the next synchronization arrives.
+ */
+void NetPhysicsController::updateBuffered() {
+    for (auto it = _itprBuffers.begin(); it != _itprBuffers.end(); ) {
+        auto obj = it->first;
+        SnapshotBuffer& buffer = it->second;
+        if (!obj->isShared() || !_itprClocks.count(buffer.source)) {
+            it = _itprBuffers.erase(it);
+            continue;
+        }
+        
+        // Display far enough behind the sender to absorb jitter and gaps
+        const ClockEstimate& clock = _itprClocks.at(buffer.source);
+        float delay = JITTER_MARGIN*clock.jitter+buffer.interval;
+        delay = SDL_max(_itprMinDelay, SDL_min(_itprMaxDelay, delay));
+        float render = (float)_itprTick-clock.offset-delay;
+        _bufferDelay = delay;
+        
+        auto& states = buffer.states;
+        while (states.size() > 1 && (float)states[1].tick <= render) {
+            states.pop_front();
+        }
+        _bufferDepthSum += (long)states.size();
+        _bufferSamples++;
+        if (_metrics) {
+            _metrics->record(NetMetrics::Metric::QUEUE_DEPTH, (double)states.size());
+        }
+        
+        const BufferedState& first = states.front();
+        if (render < (float)first.tick) {
+            ++it;
+            continue;   // Not yet reached the oldest state
+        }
+        
+        Vec2 pos, vel;
+        float angle, angV;
+        bool released = false;
+        if (states.size() > 1) {
+            const BufferedState& next = states[1];
+            float t = (render-first.tick)/(float)(next.tick-first.tick);
+            pos = first.pos+(next.pos-first.pos)*t;
+            vel = first.vel+(next.vel-first.vel)*t;
+            angle = first.angle+(next.angle-first.angle)*t;
+            angV = first.angV+(next.angV-first.angV)*t;
+        } else {
+            float ahead = SDL_min(render-first.tick, _itprMaxExtrap);
+            bool resting = first.vel.isNearZero() && first.angV == 0;
+            if (render > (float)first.tick && !resting) {
+                _bufferUnderruns++;
+                if (_metrics) {
+                    _metrics->add(NetMetrics::Counter::BUFFER_UNDERRUNS);
+                }
+            }
+            pos = first.pos+first.rate*ahead;
+            vel = first.vel;
+            angle = first.angle+first.angRate*ahead;
+            angV = first.angV;
+            // The sender may have stopped sending because the obstacle is at
+            // rest (or easily extrapolated), so hand it back to the simulation
+            released = render-first.tick >= _itprMaxExtrap;
+        }
+        
+        obj->setShared(false);
+        // ===== BEGIN NON-SHARED BLOCK =====
+        obj->setPosition(pos);
+        obj->setLinearVelocity(vel);
+        obj->setAngle(angle);
+        obj->setAngularVelocity(angV);
+        // ====== END NON-SHARED BLOCK ======
+        obj->setShared(true);
+        if (released) {
+            it = _itprBuffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    if (_itprDebug && _bufferSamples) {
+        CULog("Buffer delay: %f, depth: %f", _bufferDelay, getAverageBufferDepth());
+        CULog("%ld/%ld underruns", _bufferUnderruns, _bufferSamples);
+    }
+}
+
+/**
+ * Returns the result of linear object interpolation.
+ *
+ * Formula: (target-source)/stepsLeft + source
+ *
+ * @return the result of linear object interpolation.
+ */
+float NetPhysicsController::interpolate(int stepsLeft, float target, float source) {
+    return (target-source)/stepsLeft+source;
+}
+
+#pragma mark Snapshot Compression
+/**
+ * Returns the baseline for the next compact snapshot to a destination.
+ *
+ * This is the latest retained snapshot in that stream acknowledged by
+ * every peer receiving it. Snapshots are sent unreliably, so a peer that
+ * acknowledged a later snapshot may never have received an earlier one.
+ * If no retained snapshot was acknowledged by every peer, this method
+ * returns 0, and the next snapshot is sent in full.
+ *
+ * @param dest  The destination UUID ("" for broadcast)
+ *
+ * @return the baseline for the next compact snapshot to a destination.
+ */
+Uint32 NetPhysicsController::getSyncBaseline(const std::string dest) const {
+    auto stream = _sentStreams.find(dest);
+    if (stream == _sentStreams.end() || (dest == "" && _syncPeers.empty())) {
+        return 0;
+    }
+    // Only the current receivers matter; a peer that just joined has no acks
+    std::vector<const std::set<Uint32>*> receivers;
+    const auto& acks = stream->second.acks;
+    if (dest == "") {
+        for (auto pt = _syncPeers.begin(); pt != _syncPeers.end(); ++pt) {
+            auto it = acks.find(*pt);
+            if (it == acks.end()) {
+                return 0;
+            }
+            receivers.push_back(&(it->second));
+        }
     } else {
-        owned.insert(std::make_pair(obs,duration));
+        auto it = acks.find(dest);
+        if (it == acks.end()) {
+            return 0;
+        }
+        receivers.push_back(&(it->second));
     }
-    Uint64 id = _world->getObstacleIds().at(obs);
-    auto event = PhysObstEvent::allocOwnerAcquire(id, duration);
-    _outEvents.push_back(event);
+    
+    const auto& snapshots = stream->second.snapshots;
+    for (auto jt = snapshots.rbegin(); jt != snapshots.rend(); ++jt) {
+        bool shared = true;
+        for (auto it = receivers.begin(); shared && it != receivers.end(); ++it) {
+            shared = (*it)->count(jt->first) > 0;
+        }
+        if (shared) {
+            return jt->first;
+        }
+    }
+    return 0;
 }
 
 /**
- * Releases the ownership of the object.
+ * Switches an outbound event to the compact encoding (if enabled).
  *
- * This method is the opposite of {@link #acquireObs}. When called by a
- * client, it will return ownership to the host. This method has no effect
- * if the client does not have ownership of that obstacle or if it is
- * called by the host.
+ * This method assigns the event a sequence number and a baseline in the
+ * stream for the given destination, and records its snapshot.
  *
- * @param obs       the obstacle to release
+ * @param event The event to encode
+ * @param dest  The destination UUID ("" for broadcast)
  */
-void NetPhysicsController::releaseObs(std::shared_ptr<physics2::Obstacle> obs) {
-    if (!_isHost) {
-        _world->getOwnedObstacles().erase(obs);
-        Uint64 id = _world->getObstacleIds().at(obs);
-        auto event = PhysObstEvent::allocOwnerRelease(id);
-        _outEvents.push_back(event);
+void NetPhysicsController::encodeSync(const std::shared_ptr<PhysSyncEvent>& event, const std::string dest) {
+    if (!_compactSync) {
+        return;
+    }
+    Uint32 baseline = getSyncBaseline(dest);
+    SyncStream& stream = _sentStreams[dest];
+    event->setCompact(++_syncSequence, _world->getshortUID(), _syncQuant, dest != "");
+    event->setBaseline(baseline, baseline ? stream.snapshots.at(baseline) : nullptr);
+    stream.snapshots.erase(stream.snapshots.begin(), stream.snapshots.lower_bound(baseline));
+    stream.snapshots[_syncSequence] = event->getSnapshot();
+    while (stream.snapshots.size() > MAX_SNAPSHOT_HISTORY) {
+        stream.snapshots.erase(stream.snapshots.begin());
+    }
+    // Acknowledgements of discarded snapshots can never be a baseline
+    Uint32 oldest = stream.snapshots.begin()->first;
+    for (auto it = stream.acks.begin(); it != stream.acks.end(); ++it) {
+        it->second.erase(it->second.begin(), it->second.lower_bound(oldest));
     }
 }
 
 /**
- * Makes this client the owner of all objects in the simulation.
+ * Sets the peers that receive physics synchronizations.
  *
- * This method does not actually send any information to the other
- * clients on the network.  It should be used for initial objects only.
+ * A broadcast snapshot is only used as a delta baseline once all of these
+ * peers have acknowledged it. They are also the recipients of per-peer
+ * synchronizations for interest management. Acknowledgements and interest
+ * regions of peers that have left are discarded. This method is called automatically by
+ * the {@link NetEventController} every tick, so peers may join or leave
+ * at any time.
+ *
+ * @param peers The UUIDs of the peers (not including this machine)
  */
-void NetPhysicsController::ownAll() {
-    auto obstacles = _world->getObstacles();
-    auto ownership = _world->getOwnedObstacles();
-    // TODO: This really needs a better method
-    for(auto it = obstacles.begin(); it != obstacles.end(); ++it){
-        ownership.insert(std::make_pair((*it), 0));
+void NetPhysicsController::setSyncPeers(const std::unordered_set<std::string>& peers) {
+    if (peers == _syncPeers) {
+        return;
+    }
+    for (auto pt = _syncPeers.begin(); pt != _syncPeers.end(); ++pt) {
+        if (peers.count(*pt)) {
+            continue;
+        }
+        _sentStreams.erase(*pt);
+        _interests.erase(*pt);
+        auto broadcast = _sentStreams.find("");
+        if (broadcast != _sentStreams.end()) {
+            broadcast->second.acks.erase(*pt);
+        }
+    }
+    for (auto pt = peers.begin(); pt != peers.end(); ++pt) {
+        if (!_syncPeers.count(*pt)) {
+            // Obstacles at rest were never sent to a new peer
+            _restStates.clear();
+            break;
+        }
     }
+    _syncPeers = peers;
 }
 
 /**
- * Adds an object to interpolate with the given target parameters.
+ * Processes the acknowledgement of a compact snapshot.
  *
- * This method is used for error smoothing.
+ * This method is called automatically by the NetEventController. It is
+ * ignored if the snapshot was not sent by this physics world.
  *
- * @param obj   The obstacle to interpolate
- * @param param The target parameters for interpolation
+ * @param source    The UUID of the acknowledging peer
+ * @param shortUID  The shortUID of the world that sent the snapshot
+ * @param sequence  The sequence number of the acknowledged snapshot
  */
-void NetPhysicsController::addSyncObject(std::shared_ptr<physics2::Obstacle> obj,
-                                         const std::shared_ptr<TargetParams>& param) {
-    if (_itprMethod == 1) {
+void NetPhysicsController::processSyncAck(const std::string source, Uint32 shortUID, Uint32 sequence) {
+    if (source == "" || shortUID != _world->getshortUID()) {
         return;
-    } else if (_cache.count(obj)) {
-        auto oldParam = _cache.at(obj);
-        obj->setShared(false);
-        // ===== BEGIN NON-SHARED BLOCK =====
-        obj->setLinearVelocity(oldParam->targetVel);
-        obj->setAngularVelocity(oldParam->targetAngV);
-        // ====== END NON-SHARED BLOCK ======
-        obj->setShared(true);
-        param->I = oldParam->I;
-        param->numI = oldParam->numI;
     }
-    _cache.erase(obj);
-    _cache.insert(std::make_pair(obj,param));
-    _stepSum += param->numSteps;
-    _itprCount++;
+    // Sequence numbers are unique across streams
+    for (const std::string& dest : { std::string(""), source }) {
+        auto stream = _sentStreams.find(dest);
+        if (stream != _sentStreams.end() && stream->second.snapshots.count(sequence)) {
+            stream->second.acks[source].insert(sequence);
+        }
+    }
 }
 
+#pragma mark Interest Management
 /**
- * Returns the result of linear object interpolation.
+ * Sets the interest region of this machine, centered on an obstacle.
  *
- * Formula: (target-source)/stepsLeft + source
+ * Peers synchronize the obstacles in or near this region at full rate,
+ * and only periodically refresh the others. The region follows the
+ * obstacle (typically the player avatar). The region is announced to all
+ * peers with a {@link GameStateEvent}.
  *
- * @return the result of linear object interpolation.
+ * @param obs   The obstacle at the center of the region
+ * @param size  The size of the region
  */
-float NetPhysicsController::interpolate(int stepsLeft, float target, float source) {
-    return (target-source)/stepsLeft+source;
+void NetPhysicsController::setInterest(const std::shared_ptr<physics2::Obstacle>& obs, const Size size) {
+    Uint64 id = _world->getObstacleId(obs);
+    _outEvents.push_back(GameStateEvent::allocInterest(id, Rect(Vec2::ZERO, size)));
+}
+
+/**
+ * Sets the interest region of this machine.
+ *
+ * Peers synchronize the obstacles in or near this region at full rate,
+ * and only periodically refresh the others. An empty region clears the
+ * interest, so that peers synchronize everything at full rate. The region
+ * is announced to all peers with a {@link GameStateEvent}.
+ *
+ * @param region    The interest region
+ */
+void NetPhysicsController::setInterest(const Rect region) {
+    _outEvents.push_back(GameStateEvent::allocInterest(0, region));
+}
+
+/**
+ * Processes the interest region announced by a peer.
+ *
+ * This method is called automatically by the NetEventController.
+ *
+ * @param source    The UUID of the peer
+ * @param obsId     The obstacle at the center of the region (0 for none)
+ * @param region    The interest region
+ */
+void NetPhysicsController::processInterest(const std::string source, Uint64 obsId, const Rect region) {
+    if (source == "") {
+        return; // Our own interest does not affect what we send
+    } else if (region.size.width <= 0 || region.size.height <= 0) {
+        _interests.erase(source);
+        return;
+    }
+    InterestRegion& interest = _interests[source];
+    interest.obsId = obsId;
+    interest.region = region;
+}
+
+/**
+ * Sets the cell size of the interest management grid.
+ *
+ * Obstacles in any cell overlapping the interest region of a peer are
+ * synchronized at full rate. So larger cells include more nearby
+ * obstacles, at a lower cost per query.
+ *
+ * @param size  The width and height of each cell
+ */
+void NetPhysicsController::setInterestCellSize(float size) {
+    if (_world) {
+        _interestGrid = InterestGrid::alloc(_world->getBounds(), size);
+    }
+}
+
+/**
+ * Packs a full synchronization for each peer based on its interest.
+ *
+ * Each peer receives the obstacles in or near its interest region, plus
+ * a rotating slice of the remaining obstacles. Peers without an interest
+ * region receive every obstacle. Obstacles at rest are only sent in the
+ * rotating slice (or as a keyframe).
+ */
+void NetPhysicsController::packInterestSync() {
+    Uint64 slice = (_syncCount++) % _farRefreshRate;
+    
+    std::vector<Uint64> candidates;
+    std::vector<Uint64> active;
+    auto owned = _world->getOwnedObstacles();
+    _interestGrid->clear();
+    for (size_t ii = 0; ii < owned.size(); ii++) {
+        if (!owned[ii]->isShared()) {
+            continue;
+        }
+        candidates.push_back(owned.getId(ii));
+        if (isSyncRedundant(owned.getId(ii), owned[ii])) {
+            continue;   // Still sent in the far refresh slice
+        }
+        active.push_back(owned.getId(ii));
+        _interestGrid->insert(owned.getId(ii), owned[ii]->getPosition());
+        recordSyncState(owned.getId(ii), owned[ii]);
+    }
+    
+    std::vector<Uint64> nearby;
+    for (auto pt = _syncPeers.begin(); pt != _syncPeers.end(); ++pt) {
+        auto event = PhysSyncEvent::alloc();
+        auto interest = _interests.find(*pt);
+        if (interest == _interests.end()) {
+            for (auto it = active.begin(); it != active.end(); ++it) {
+                event->addObstacle(*it, _world->getObstacle(*it));
+            }
+        } else {
+            Rect region = interest->second.region;
+            if (interest->second.obsId) {
+                auto center = _world->getObstacle(interest->second.obsId);
+                if (center) {
+                    region.origin = center->getPosition()-region.size/2;
+                }
+            }
+            
+            nearby.clear();
+            _interestGrid->query(region, nearby);
+            for (auto it = nearby.begin(); it != nearby.end(); ++it) {
+                event->addObstacle(*it, _world->getObstacle(*it));
+            }
+            // Duplicates are ignored by the event
+            for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+                if ((*it) % _farRefreshRate == slice) {
+                    event->addObstacle(*it, _world->getObstacle(*it));
+                }
+            }
+        }
+        encodeSync(event, *pt);
+        _directEvents[*pt].push_back(event);
+    }
+}
+
+/**
+ * Returns true if a peer can extrapolate the state of an obstacle.
+ *
+ * This is the case if the current state is within tolerance of the last
+ * state sent, extrapolated to the current tick. A sleeping obstacle is
+ * suppressed once a resting state has been sent. Every obstacle is still
+ * sent once every {@link #getRestRefreshRate} ticks as a keyframe, unless
+ * it is asleep and the host is sending state digests.
+ *
+ * @param obsId The obstacle id
+ * @param obs   The obstacle
+ *
+ * @return true if a peer can extrapolate the state of an obstacle.
+ */
+bool NetPhysicsController::isSyncRedundant(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obs) {
+    if (!_restSuppress) {
+        return false;
+    }
+    auto it = _restStates.find(obsId);
+    if (it == _restStates.end()) {
+        return false;
+    }
+    // Divergence of sleeping bodies is caught by the state digests instead
+    bool verified = _isHost && _digestInterval && !obs->isAwake();
+    if (!verified && _itprTick-it->second.tick >= _restRefreshRate) {
+        return false;
+    }
+    
+    const RestState& last = it->second;
+    bool redundant = false;
+    if (!obs->isAwake()) {
+        // Sleeping bodies do not move, so only the last state has to be at rest
+        redundant = last.vel.isNearZero(_restPosTolerance) && std::abs(last.angV) <= _restAngleTolerance &&
+                    obs->getPosition().distance(last.pos) <= _restPosTolerance;
+    } else if (obs->getLinearVelocity().distance(last.vel) <= _restPosTolerance &&
+               std::abs(obs->getAngularVelocity()-last.angV) <= _restAngleTolerance) {
+        float time = (_itprTick-last.tick)*_world->getStepsize();
+        Vec2 pos = last.pos+last.vel*time;
+        float angle = last.angle+last.angV*time;
+        redundant = obs->getPosition().distance(pos) <= _restPosTolerance &&
+                    std::abs(obs->getAngle()-angle) <= _restAngleTolerance;
+    }
+    if (redundant && _metrics) {
+        _metrics->add(NetMetrics::Counter::SUPPRESSED_SYNCS);
+    }
+    return redundant;
+}
+
+/**
+ * Records the state of an obstacle added to a synchronization.
+ *
+ * @param obsId The obstacle id
+ * @param obs   The obstacle
+ */
+void NetPhysicsController::recordSyncState(Uint64 obsId, const std::shared_ptr<physics2::Obstacle>& obs) {
+    if (!_restSuppress) {
+        return;
+    }
+    RestState& state = _restStates[obsId];
+    state.tick = _itprTick;
+    state.pos = obs->getPosition();
+    state.vel = obs->getLinearVelocity();
+    state.angle = obs->getAngle();
+    state.angV = obs->getAngularVelocity();
+}
+
+/**
+ * Returns the estimated size in bytes of one obstacle in a synchronization.
+ *
+ * This is a conservative estimate that does not account for delta
+ * encoding. It is used to fill the budget of prioritized synchronizations.
+ *
+ * @return the estimated size in bytes of one obstacle in a synchronization.
+ */
+size_t NetPhysicsController::getSyncEntryCost() const {
+    if (!_compactSync) {
+        return RAW_SYNC_ENTRY_COST;
+    }
+    // Id tag, changed bit, explicit id, then every field in full
+    size_t bits = 2+1+32+2*_syncQuant.posBits+2*_syncQuant.velBits;
+    bits += _syncQuant.angleBits+_syncQuant.angVelBits;
+    return (bits+7)/8;
 }
 
 #pragma mark Synchronization
@@ -280,22 +1639,38 @@ float NetPhysicsController::interpolate(int stepsLeft, float target, float sourc
  */
 void NetPhysicsController::updateSimulation() {
     packPhysObj();
+    recordPredictions();
     
     // Ownership transfer
     std::vector<std::shared_ptr<cugl::physics2::Obstacle>> deleteCache;
-    auto ownership = _world->getOwnedObstacles();
-    for(auto it = _world->getObstacles().begin() ; it != _world->getObstacles().end(); ++it) {
-        if (ownership.count(*it)){
-            Uint64 left = ownership.at(*it);
-            if (left==1){
-                releaseObs(*it);
-            } else if (left>1) {
-                ownership[*it]=left-1;
-            }
+    auto owned = _world->getOwnedObstacles();
+    for(size_t ii = 0; ii < owned.size(); ii++) {
+        Uint64 left = owned.getDuration(ii);
+        if (left==1){
+            deleteCache.push_back(owned[ii]);
+        } else if (left>1) {
+            // Does not reorder the view
+            _world->ownObstacle(owned[ii],left-1);
         }
     }
     for(auto it = deleteCache.begin(); it != deleteCache.end(); ++it){
-        ownership.erase((*it));
+        releaseObs(*it);
+    }
+    
+    _itprTick++;
+    if (_itprMethod == (Uint32)ItprMethod::BUFFERED) {
+        updateBuffered();
+    }
+    if (_isHost) {
+        packPredictStates();
+        packImageChunks();
+        if (_digestInterval && _itprTick % _digestInterval == 0) {
+            std::vector<Uint64> regions;
+            Uint64 digest = _world->computeDigests(regions);
+            _outEvents.push_back(PhysObstEvent::allocWorldDigest(digest, (Uint32)regions.size()));
+        }
+    } else {
+        packImageRequests();
     }
 
     for(auto it = _cache.begin(); it != _cache.end(); it++){
@@ -316,6 +1691,9 @@ void NetPhysicsController::updateSimulation() {
             obj->setAngularVelocity(param->targetAngV);
             _deleteCache.push_back(it->first);
             _ovrdCount++;
+            if (_metrics) {
+                _metrics->add(NetMetrics::Counter::SNAP_OVERRIDES);
+            }
         } else{
             float t = ((float)param->curStep)/param->numSteps;
             CUAssert(t<=1.f && t>=0.f);
@@ -369,6 +1747,9 @@ void NetPhysicsController::updateSimulation() {
         _cache.erase(*it);
     }
     _deleteCache.clear();
+    if (_metrics) {
+        _metrics->set(NetMetrics::Gauge::INTERPOLATING, (Sint64)(_cache.size()+_itprBuffers.size()));
+    }
 
     if (_itprDebug) {
         CULog("%ld/%ld overriden", _itprCount-_ovrdCount,_itprCount);
@@ -379,6 +1760,10 @@ void NetPhysicsController::updateSimulation() {
 /**
  * Processes a physics object synchronization event.
  *
+ * Events that reference an unknown obstacle are dropped, but the
+ * obstacle is requested from the host. While waiting on a complete world
+ * snapshot, events are held back and replayed once it has been applied.
+ *
  * This method is called automatically by the NetEventController.
  *
  * @param event The event to be processed
@@ -387,38 +1772,78 @@ void NetPhysicsController::processPhysObstEvent(const std::shared_ptr<PhysObstEv
     if (event->getSourceId() == "")
         return; // Ignore physic syncs from self.
 
+    switch (event->getType()) {
+        case PhysObstEvent::EventType::WORLD_REQUEST:
+            if (_isHost) {
+                ImageRequest& request = _imageRequests[event->getSourceId()];
+                const std::vector<Uint64>& ids = event->getRequestIds();
+                request.complete = request.complete || ids.empty();
+                request.obsIds.insert(ids.begin(), ids.end());
+            }
+            return;
+        case PhysObstEvent::EventType::WORLD_CHUNK:
+            if (!_isHost) {
+                receiveImageChunk(event);
+            }
+            return;
+        case PhysObstEvent::EventType::WORLD_DIGEST:
+            if (!_isHost) {
+                processWorldDigest(event->getSourceId(), event->getDigest(), event->getRegionCount());
+            }
+            return;
+        case PhysObstEvent::EventType::REGION_DIGESTS:
+            if (_isHost) {
+                processRegionDigests(event->getSourceId(), event->getDigests());
+            }
+            return;
+        default:
+            break;
+    }
+    
+    if (_imageLoading) {
+        // Replayed once the world snapshot has been applied
+        _imageBacklog.push_back(event);
+        return;
+    }
+
     if (event->getType() == PhysObstEvent::EventType::CREATION) {
-        CUAssertLog(event->getFactoryId() < _obstacleFacts.size(), "Unknown object Factory %u",
-                    event->getFactoryId());
-        auto pair = _obstacleFacts[event->getFactoryId()]->createObstacle(*event->getPackedParam());
-        _world->activateObstacle(event->getObstacleId(),pair.first);
-        if (_linkSceneToObsFunc) {
-            _linkSceneToObsFunc(pair.first, pair.second);
-            _sharedObsToNodeMap.insert(std::make_pair(pair.first, pair.second));
-        }
-        if(_isHost){
-            _world->getOwnedObstacles().insert({pair.first,0});
+        createRemoteObstacle(event->getObstacleId(), event->getFactoryId(), event->getPackedParam());
+        return;
+    }
+    
+    if (event->getType() == PhysObstEvent::EventType::DELTA) {
+        const std::vector<PhysObstEvent::Delta>& deltas = event->getDeltas();
+        for(auto it = deltas.begin(); it != deltas.end(); ++it) {
+            applyObstDelta(*it, event->getSourceId(), event->getEventTimeStamp());
         }
         return;
     }
 
-    // Ignore event if object is not found.
-    // TODO: Send request to object owner to sync object.
+    // Request any obstacle we do not know about from the host
     auto obj = _world->getObstacle(event->getObstacleId());
     if (obj == nullptr) {
+        if (event->getType() == PhysObstEvent::EventType::DELETION) {
+            _missingObs.erase(event->getObstacleId());
+        } else {
+            noteMissing(event->getObstacleId());
+        }
         return;
     }
 
     if (event->getType() == PhysObstEvent::EventType::DELETION) {
-        _cache.erase(obj);
-        _world->removeObstacle(obj);
-        if (_sharedObsToNodeMap.count(obj)) {
-            _sharedObsToNodeMap.at(obj)->removeFromParent();
-            _sharedObsToNodeMap.erase(obj);
-        }
+        removeRemoteObstacle(event->getObstacleId(), obj);
         return;
     }
 
+    if (event->getType() == PhysObstEvent::EventType::POSITION ||
+        event->getType() == PhysObstEvent::EventType::VELOCITY) {
+        // Track the inputs applied to obstacles predicted by this peer
+        auto remote = _remotePredictions.find(event->getObstacleId());
+        if (remote != _remotePredictions.end() && remote->second.source == event->getSourceId()) {
+            remote->second.tick = SDL_max(remote->second.tick, event->getEventTimeStamp());
+        }
+    }
+    
     obj->setShared(false);
     // ===== BEGIN NON-SHARED BLOCK =====
     switch (event->getType()) {
@@ -482,12 +1907,12 @@ void NetPhysicsController::processPhysObstEvent(const std::shared_ptr<PhysObstEv
             }
             break;
         case PhysObstEvent::EventType::OWNER_ACQUIRE:
-            _world->getOwnedObstacles().erase(obj);
+            _world->disownObstacle(obj);
             //CULog("Erased ownership for %llu",event->getObjId());
             break;
         case PhysObstEvent::EventType::OWNER_RELEASE:
             if (_isHost) {
-                _world->getOwnedObstacles().insert(std::make_pair(obj,0));
+                _world->ownObstacle(obj);
                 //CULog("Regained ownership for %llu",event->getObjId());
             }
         default:
@@ -499,30 +1924,96 @@ void NetPhysicsController::processPhysObstEvent(const std::shared_ptr<PhysObstEv
 
 /**
  * Processes a physics synchronization event.
+ *
+ * Compact events are first decoded against the snapshot they were delta
+ * encoded from. An event that cannot be decoded (because the baseline is
+ * no longer retained) is dropped.
+ *
+ * Synchronization events are delivered unreliably, and may arrive out of
+ * order. An event older than one already applied from the same stream is
+ * stale, and is also dropped.
+ *
+ * This method is called automatically by the NetEventController.
+ *
+ * @param event The event to be processed
+ *
+ * @return true if the event was applied to the simulation
  */
-void NetPhysicsController::processPhysSyncEvent(const std::shared_ptr<PhysSyncEvent>& event) {
+bool NetPhysicsController::processPhysSyncEvent(const std::shared_ptr<PhysSyncEvent>& event) {
     if (event->getSourceId() == "") {
-        return; // Ignore physic syncs from self.
+        return false; // Ignore physic syncs from self.
     }
+    
+    if (event->isCompact()) {
+        SyncStream& stream = _recvStreams[std::make_pair(event->getSourceId(),event->isDirect())];
+        if (event->getSequence() <= stream.latest) {
+            return false; // Overtaken by a later snapshot
+        }
+        auto& history = stream.snapshots;
+        std::shared_ptr<PhysSyncEvent::Snapshot> baseline = nullptr;
+        if (event->getBaseline()) {
+            auto it = history.find(event->getBaseline());
+            if (it == history.end()) {
+                return false; // The sender falls back to a full snapshot
+            }
+            baseline = it->second;
+        }
+        if (!event->decode(_syncQuant, baseline)) {
+            return false;
+        }
+        // The sender never uses a baseline older than the current one
+        history.erase(history.begin(), history.lower_bound(event->getBaseline()));
+        history[event->getSequence()] = event->getSnapshot();
+        while (history.size() > MAX_SNAPSHOT_HISTORY) {
+            history.erase(history.begin());
+        }
+        stream.latest = event->getSequence();
+    } else {
+        Uint64& latest = _recvSyncTicks[event->getSourceId()];
+        if (event->getEventTimeStamp() < latest) {
+            return false; // Overtaken by a later snapshot
+        }
+        latest = event->getEventTimeStamp();
+    }
+    
+    if (_itprMethod == (Uint32)ItprMethod::BUFFERED) {
+        updateClock(event->getSourceId(), event->getEventTimeStamp());
+    }
+    
     const std::vector<PhysSyncEvent::Parameters>& params = event->getSyncList();
     for (auto it = params.begin(); it != params.end(); it++) {
         PhysSyncEvent::Parameters param = (*it);
         
         auto obj = _world->getObstacle(param.obsId);
         if (obj == nullptr) {
-            //CUAssertLog(obs, "Invalid PhysSyncEvent, obj %llu not found.",param.obsId);
-            // Ugh
+            noteMissing(param.obsId);
             continue;
         }
             
+        if (_predictions.count(obj)) {
+            continue;   // Corrected by processPredictState instead
+        } else if (_itprMethod == (Uint32)ItprMethod::BUFFERED) {
+            bufferSyncObject(obj, event->getSourceId(), event->getEventTimeStamp(), param);
+            continue;
+        }
+        
         float x = param.x;
         float y = param.y;
         float angle = param.angle;
         float vAngular = param.vAngular;
         float vx = param.vx;
         float vy = param.vy;
+        if (event->isCompact()) {
+            // Compact angles are wrapped, so unwrap them near the current angle
+            angle += 2*M_PI*std::round((obj->getAngle()-angle)/(2*M_PI));
+        }
         float diff = (obj->getPosition() - Vec2(x, y)).length();
         float angDiff = 10 * abs(obj->getAngle() - angle);
+        if (_metrics) {
+            _metrics->add(NetMetrics::Counter::CORRECTIONS);
+            _metrics->record(NetMetrics::Metric::POSITION_ERROR, diff);
+            _metrics->record(NetMetrics::Metric::ANGLE_ERROR, angDiff/10);
+        }
             
         int steps = SDL_max(1, SDL_min(30, SDL_max((int)(diff * 30), (int)angDiff)));
 
@@ -539,13 +2030,20 @@ void NetPhysicsController::processPhysSyncEvent(const std::shared_ptr<PhysSyncEv
 
         addSyncObject(obj, target);
     }
+    return true;
 }
 
 /**
  * Packs object data for synchronization.
  *
  * This data will be added to {@link #getOutEvents}, which is the queue
- * of information to be sent over the network.
+ * of information to be sent over the network. If any peer has announced
+ * an interest region, a full synchronization is instead split into one
+ * event per peer in {@link #getDirectOutEvents}.
+ *
+ * A full synchronization leaves out obstacles at rest (see
+ * {@link #isRestSuppressed}), and is not sent at all if every obstacle is
+ * at rest.
  *
  * This method can be used to prompt the physics controller to synchronize
  * objects. It is called automatically by {@link NetEventController}, but
@@ -558,63 +2056,65 @@ void NetPhysicsController::packPhysSync(SyncType type) {
     
     switch (type) {
         case SyncType::OVERRIDE_FULL_SYNC:
-            for (auto it = _world->getObstacleMap().begin(); it != _world->getObstacleMap().end(); it++) {
-                Uint64 id = (*it).first;
-                auto obj = (*it).second;
-                if (obj->isShared()) {
-                    event->addObstacle(id,obj);
+        {
+            auto view = _world->getObstacleView();
+            for (size_t ii = 0; ii < view.size(); ii++) {
+                if (view[ii]->isShared()) {
+                    event->addObstacle(view.getId(ii),view[ii]);
                 }
             }
+        }
             break;
         case SyncType::FULL_SYNC:
         {
-            auto ownership = _world->getOwnedObstacles();
-            for (auto it = _world->getObstacleMap().begin(); it != _world->getObstacleMap().end(); it++) {
-                Uint64 id = (*it).first;
-                auto obj = (*it).second;
-                if (obj->isShared() && ownership.count(obj))
-                    event->addObstacle(id,obj);
+            if (!_interests.empty() && _interestGrid) {
+                // Interest management sends each peer its own event
+                packInterestSync();
+                return;
+            }
+            auto owned = _world->getOwnedObstacles();
+            for (size_t ii = 0; ii < owned.size(); ii++) {
+                if (owned[ii]->isShared() && !isSyncRedundant(owned.getId(ii),owned[ii])) {
+                    event->addObstacle(owned.getId(ii),owned[ii]);
+                    recordSyncState(owned.getId(ii),owned[ii]);
+                }
+            }
+            if (event->getSyncList().empty()) {
+                return; // Everything is at rest
             }
         }
             break;
         case SyncType::PRIO_SYNC:
         {
-            std::vector<Uint64> velQueue;
-            auto objmap = _world->getObstacleMap();
-            for (auto it = objmap.begin(); it != objmap.end(); it++) {
-                Uint64 id = (*it).first;
-                auto obj = (*it).second;
-                if(obj->isShared()) {
-                    velQueue.push_back(id);
+            _syncScheduler->beginTick(_world->getStepsize());
+            auto view = _world->getObstacleView();
+            std::vector<Vec2> focus;
+            for (auto it = _interests.begin(); it != _interests.end(); ++it) {
+                const Rect& region = it->second.region;
+                auto center = _world->getObstacle(it->second.obsId);
+                if (center != nullptr) {
+                    focus.push_back(center->getPosition());
+                } else {
+                    focus.push_back(region.origin+region.size/2);
                 }
             }
-            
-            std::sort(velQueue.begin(), velQueue.end(), [this](Uint64 const& l, Uint64 const& r) {
-                auto omap = _world->getObstacleMap();
-                return omap.at(l)->getLinearVelocity().length() > omap.at(r)->getLinearVelocity().length();
-            });
-            
-            size_t defaultPri = 60;
-            size_t numPrioObj = std::min(defaultPri,velQueue.size());
-            
-            
-            for (size_t ii = 0; ii < numPrioObj; ii++) {
-                auto obj = objmap.at(velQueue[ii]);
-                if(obj->isShared()) {
-                    event->addObstacle(velQueue[ii],obj);
+            for (size_t ii = 0; ii < view.size(); ii++) {
+                if (view[ii]->isShared()) {
+                    _syncScheduler->update(view.getId(ii), view[ii], focus);
                 }
             }
+            _syncScheduler->endTick();
             
-            defaultPri = 20;
-            for (size_t ii = 0; ii < std::min(defaultPri,velQueue.size()); ii++) {
-                // Refactored as obstacles are no longer a vector
-                auto obj = _world->getNextObstacle();
-                event->addObstacle(_world->getObstacleId(obj),obj);
+            std::vector<Uint64> scheduled;
+            _syncScheduler->schedule(_syncBudget/getSyncEntryCost(), scheduled);
+            for (auto it = scheduled.begin(); it != scheduled.end(); ++it) {
+                event->addObstacle(*it, _world->getObstacle(*it));
             }
         }
             break;
     }
     
+    encodeSync(event, "");
     _outEvents.push_back(event);
 }
 
@@ -624,56 +2124,83 @@ void NetPhysicsController::packPhysSync(SyncType type) {
  * This method checks the world for any dirty objects (e.g. objects that
  * have changed state outside of the simulation). If so, it packages
  * that information as an event to send out to other machines on the
- * network.
+ * network. All of the changes are packed into a single
+ * {@link PhysObstEvent::EventType::DELTA} event, with one record per
+ * dirty obstacle holding only the changed fields.
  */
 
 void NetPhysicsController::packPhysObj() {
-    auto objs = _world->getObstacles();
-    for (auto it = objs.begin(); it != objs.end(); it++) {
-        auto obj = (*it);
-        Uint64 id = _world->getObstacleIds().at(obj);
-        if (obj->isShared()) {
-            if (obj->hasDirtyPosition()) {
-                _outEvents.push_back(PhysObstEvent::allocPos(id,obj->getPosition()));
-            }
-            if (obj->hasDirtyAngle()) {
-				_outEvents.push_back(PhysObstEvent::allocAngle(id,obj->getAngle()));
-			}
-            if (obj->hasDirtyVelocity()) {
-				_outEvents.push_back(PhysObstEvent::allocVel(id,obj->getLinearVelocity()));
-			}
-            if (obj->hasDirtyAngularVelocity()) {
-				_outEvents.push_back(PhysObstEvent::allocAngularVel(id,obj->getAngularVelocity()));
-			}
-            if (obj->hasDirtyType()) {
-                _outEvents.push_back(PhysObstEvent::allocBodyType(id,obj->getBodyType()));
-            }
-            if (obj->hasDirtyBool()) {
-                PhysObstEvent::BoolConsts values;
-                values.isEnabled = obj->isEnabled();
-                values.isAwake = obj->isAwake();
-                values.isSleepingAllowed = obj->isSleepingAllowed();
-                values.isFixedRotation = obj->isFixedRotation();
-                values.isBullet = obj->isBullet();
-                values.isSensor = obj->isSensor();
-				_outEvents.push_back(PhysObstEvent::allocBoolConsts(id,values));
-			}
-            if (obj->hasDirtyFloat()) {
-                PhysObstEvent::FloatConsts values;
-                values.density = obj->getDensity();
-                values.friction = obj->getFriction();
-                values.restitution = obj->getRestitution();
-                values.linearDamping = obj->getLinearDamping();
-                values.angularDamping = obj->getAngularDamping();
-                values.gravityScale = obj->getGravityScale();
-                values.mass = obj->getMass();
-                values.inertia = obj->getInertia();
-                values.centroid = obj->getCentroid();
-                _outEvents.push_back(PhysObstEvent::allocFloatConsts(id,values));
-            }
-            obj->clearSharingDirtyBits();
+    std::shared_ptr<PhysObstEvent> event = nullptr;
+    auto view = _world->getObstacleView();
+    for (size_t ii = 0; ii < view.size(); ii++) {
+        const auto& obj = view[ii];
+        if (!obj->isShared()) {
+            continue;
         }
-	}
+        
+        Uint8 mask = 0;
+        if (obj->hasDirtyPosition()) {
+            mask |= PhysObstEvent::Delta::POSITION;
+        }
+        if (obj->hasDirtyAngle()) {
+            mask |= PhysObstEvent::Delta::ANGLE;
+        }
+        if (obj->hasDirtyVelocity() && !_predictions.count(obj)) {
+            // Predicted obstacles send their velocity every tick instead
+            mask |= PhysObstEvent::Delta::VELOCITY;
+        }
+        if (obj->hasDirtyAngularVelocity()) {
+            mask |= PhysObstEvent::Delta::ANGULAR_VEL;
+        }
+        if (obj->hasDirtyType()) {
+            mask |= PhysObstEvent::Delta::BODY_TYPE;
+        }
+        if (obj->hasDirtyBool()) {
+            mask |= PhysObstEvent::Delta::BOOL_CONSTS;
+        }
+        if (obj->hasDirtyFloat()) {
+            mask |= PhysObstEvent::Delta::FLOAT_CONSTS;
+        }
+        obj->clearSharingDirtyBits();
+        if (mask == 0) {
+            continue;
+        }
+        
+        if (event == nullptr) {
+            event = PhysObstEvent::allocDelta();
+        }
+        PhysObstEvent::Delta& delta = event->addDelta(view.getId(ii));
+        delta.mask = mask;
+        delta.pos = obj->getPosition();
+        delta.vel = obj->getLinearVelocity();
+        delta.angle = obj->getAngle();
+        delta.angularVel = obj->getAngularVelocity();
+        delta.bodyType = obj->getBodyType();
+        if (delta.has(PhysObstEvent::Delta::BOOL_CONSTS)) {
+            PhysObstEvent::BoolConsts& values = delta.bools;
+            values.isEnabled = obj->isEnabled();
+            values.isAwake = obj->isAwake();
+            values.isSleepingAllowed = obj->isSleepingAllowed();
+            values.isFixedRotation = obj->isFixedRotation();
+            values.isBullet = obj->isBullet();
+            values.isSensor = obj->isSensor();
+        }
+        if (delta.has(PhysObstEvent::Delta::FLOAT_CONSTS)) {
+            PhysObstEvent::FloatConsts& values = delta.floats;
+            values.density = obj->getDensity();
+            values.friction = obj->getFriction();
+            values.restitution = obj->getRestitution();
+            values.linearDamping = obj->getLinearDamping();
+            values.angularDamping = obj->getAngularDamping();
+            values.gravityScale = obj->getGravityScale();
+            values.mass = obj->getMass();
+            values.inertia = obj->getInertia();
+            values.centroid = obj->getCentroid();
+        }
+    }
+    if (event != nullptr) {
+        _outEvents.push_back(event);
+    }
 }
 
 /**
@@ -684,8 +2211,38 @@ void NetPhysicsController::reset() {
     _ovrdCount = 0;
     _stepSum = 0;
     _cache.clear();
+    _itprTick = 0;
+    _itprBuffers.clear();
+    _itprClocks.clear();
+    _predictions.clear();
+    _remotePredictions.clear();
+    _predictError = 0;
+    _gameTick = 0;
+    resetBufferStats();
+    _bufferDelay = 0;
     _objRotation = 0;
     _deleteCache.clear();
     _outEvents.clear();
     _sharedObsToNodeMap.clear();
+    _syncSequence = 0;
+    _sentStreams.clear();
+    _recvStreams.clear();
+    _recvSyncTicks.clear();
+    _interests.clear();
+    _syncCount = 0;
+    _restStates.clear();
+    _directEvents.clear();
+    _creations.clear();
+    _imageRequests.clear();
+    _imageStreams.clear();
+    _imageSequence = 0;
+    _imageAssembly = ImageAssembly();
+    _imageLoading = false;
+    _imageBacklog.clear();
+    _imageKnown.clear();
+    _missingObs.clear();
+    _digestMismatches = 0;
+    if (_syncScheduler) {
+        _syncScheduler->clear();
+    }
 }
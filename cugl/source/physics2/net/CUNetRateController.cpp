@@ -0,0 +1,450 @@
+//
+//  CUNetRateController.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a congestion-aware send scheduler for networked
+//  physics. It estimates the round trip time and available bandwidth of each
+//  peer from snapshot acknowledgements, and watches the send buffers of the
+//  transport. From these it adapts how often physics snapshots are sent, and
+//  how many bytes each one may use.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CUNetRateController.h>
+#include <algorithm>
+#include <cmath>
+
+/** The default minimum snapshot rate (per second) */
+#define DEFAULT_MIN_RATE        5.0
+/** The default maximum snapshot rate (per second) */
+#define DEFAULT_MAX_RATE        60.0
+/** The default increase of the snapshot rate per second while clear */
+#define DEFAULT_INCREASE        10.0
+/** The default factor to multiply the snapshot rate by when congested */
+#define DEFAULT_DECREASE        0.5
+/** The default send buffer size (in bytes) that signals congestion */
+#define DEFAULT_BUFFER_LIMIT    16384
+/** The default rise in round trip time (in microseconds) that signals congestion */
+#define DEFAULT_RTT_TOLERANCE   100000.0
+/** The default largest snapshot budget in bytes */
+#define DEFAULT_MAX_BUDGET      8192
+/** The smoothing factor for the round trip time (RFC 6298) */
+#define RTT_ALPHA               0.125
+/** The smoothing factor for the round trip variation (RFC 6298) */
+#define RTT_BETA                0.25
+/** The time (in microseconds) a minimum round trip time is trusted */
+#define MIN_RTT_WINDOW          10000000
+/** The smoothing factor for a bandwidth sample below the estimate */
+#define BANDWIDTH_DECAY         0.125
+/** The token refill rate (relative to the bandwidth) while clear */
+#define PROBE_GAIN              1.25
+/** The token refill rate (relative to the bandwidth) while congested */
+#define DRAIN_GAIN              0.75
+/** The time (in seconds) of bandwidth a token bucket may hold */
+#define BURST_TIME              0.1
+/** The maximum number of snapshots awaiting acknowledgement per peer */
+#define MAX_PENDING             64
+/** The longest update (in seconds), to survive stalls */
+#define MAX_UPDATE              1.0
+/** The tolerance for accumulated snapshot credit */
+#define CREDIT_EPSILON          1e-6
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+#pragma mark Constructors
+/** Creates a peer with no measurements */
+NetRateController::Peer::Peer() :
+rtt(0),
+rttVar(0),
+minRtt(0),
+minRttTime(0),
+bandwidth(0),
+sent(0),
+ackSent(0),
+ackTime(0),
+buffered(0),
+lastBuffered(0),
+tokens(0) {
+}
+
+/**
+ * Creates a new send scheduler on the stack.
+ *
+ * Send schedulers do not have any nontrivial state and so it is
+ * unnecessary to use an init method. However, we do include a static
+ * {@link #alloc} method for creating shared pointers.
+ */
+NetRateController::NetRateController() :
+_minRate(DEFAULT_MIN_RATE),
+_maxRate(DEFAULT_MAX_RATE),
+_rate(DEFAULT_MAX_RATE),
+_increase(DEFAULT_INCREASE),
+_decrease(DEFAULT_DECREASE),
+_bufferLimit(DEFAULT_BUFFER_LIMIT),
+_rttTolerance(DEFAULT_RTT_TOLERANCE),
+_maxBudget(DEFAULT_MAX_BUDGET),
+_congested(false),
+_credit(1),
+_idle(0),
+_lastTime(0),
+_lastDecrease(0) {
+}
+
+/**
+ * Discards all measurements and peers, keeping the settings.
+ *
+ * The snapshot rate starts again at the maximum.
+ */
+void NetRateController::reset() {
+    _peers.clear();
+    _rate = _maxRate;
+    _congested = false;
+    _credit = 1;
+    _idle = 0;
+    _lastTime = 0;
+    _lastDecrease = 0;
+}
+
+#pragma mark Settings
+/**
+ * Sets the range of the snapshot rate (per second).
+ *
+ * The maximum should be no more than the fixed update rate, as at most
+ * one snapshot is sent per update.
+ *
+ * @param minRate   The minimum snapshot rate
+ * @param maxRate   The maximum snapshot rate
+ */
+void NetRateController::setRateRange(double minRate, double maxRate) {
+    _minRate = std::max(minRate, 0.0);
+    _maxRate = std::max(maxRate, _minRate);
+    _rate = std::min(std::max(_rate, _minRate), _maxRate);
+}
+
+#pragma mark Measurements
+/**
+ * Adds a round trip time sample for the given peer.
+ *
+ * @param peer  The peer connection
+ * @param rtt   The round trip time
+ * @param now   The current time
+ */
+void NetRateController::addRoundTrip(Peer& peer, double rtt, Uint64 now) {
+    if (peer.rtt == 0) {
+        peer.rtt = rtt;
+        peer.rttVar = rtt/2;
+    } else {
+        peer.rttVar += (std::abs(rtt-peer.rtt)-peer.rttVar)*RTT_BETA;
+        peer.rtt += (rtt-peer.rtt)*RTT_ALPHA;
+    }
+    // The minimum expires, in case the route has changed
+    if (peer.minRttTime == 0 || rtt <= peer.minRtt || now-peer.minRttTime > MIN_RTT_WINDOW) {
+        peer.minRtt = rtt;
+        peer.minRttTime = now;
+    }
+}
+
+/**
+ * Records a snapshot sent to the given peer connection.
+ *
+ * @param peer      The peer connection
+ * @param sequence  The sequence number of the snapshot
+ * @param now       The current time
+ */
+void NetRateController::addSnapshot(Peer& peer, Uint32 sequence, Uint64 now) {
+    Pending& pending = peer.pending[sequence];
+    pending.time = now;
+    pending.sent = peer.sent;
+    while (peer.pending.size() > MAX_PENDING) {
+        peer.pending.erase(peer.pending.begin());
+    }
+}
+
+/**
+ * Sets the peers that this machine sends to.
+ *
+ * Measurements are kept for peers already present, and discarded for
+ * peers that are no longer present.
+ *
+ * @param peers The UUIDs of the peers (not including this machine)
+ */
+void NetRateController::setPeers(const std::unordered_set<std::string>& peers) {
+    for(auto it = _peers.begin(); it != _peers.end(); ) {
+        if (peers.count(it->first)) {
+            ++it;
+        } else {
+            it = _peers.erase(it);
+        }
+    }
+    for(auto it = peers.begin(); it != peers.end(); ++it) {
+        _peers.emplace(*it, Peer());
+    }
+}
+
+/**
+ * Records bytes sent to the given peer.
+ *
+ * Every message should be recorded, including game events, so that
+ * snapshots only use the bandwidth that is left. An empty UUID records
+ * a broadcast to every peer.
+ *
+ * @param peer  The UUID of the peer ("" for all)
+ * @param bytes The number of bytes sent
+ */
+void NetRateController::recordSent(const std::string& peer, size_t bytes) {
+    for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+        if (peer.empty() || it->first == peer) {
+            it->second.sent += bytes;
+            if (it->second.bandwidth > 0) {
+                it->second.tokens -= (double)bytes;
+            }
+        }
+    }
+}
+
+/**
+ * Records a snapshot sent to the given peer.
+ *
+ * This should be called after the bytes of the snapshot are recorded.
+ * An empty UUID records a broadcast to every peer.
+ *
+ * @param peer      The UUID of the peer ("" for all)
+ * @param sequence  The sequence number of the snapshot
+ * @param now       The current time
+ */
+void NetRateController::recordSnapshot(const std::string& peer, Uint32 sequence, Uint64 now) {
+    if (peer.empty()) {
+        for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+            addSnapshot(it->second, sequence, now);
+        }
+        return;
+    }
+    auto it = _peers.find(peer);
+    if (it != _peers.end()) {
+        addSnapshot(it->second, sequence, now);
+    }
+}
+
+/**
+ * Records the acknowledgement of a snapshot by the given peer.
+ *
+ * This measures both the round trip time and the delivery rate. It is
+ * ignored if the snapshot is unknown (or was already acknowledged).
+ *
+ * @param peer      The UUID of the peer
+ * @param sequence  The sequence number of the snapshot
+ * @param now       The current time
+ */
+void NetRateController::recordAck(const std::string& peer, Uint32 sequence, Uint64 now) {
+    auto it = _peers.find(peer);
+    if (it == _peers.end()) {
+        return;
+    }
+    Peer& state = it->second;
+    auto jt = state.pending.find(sequence);
+    if (jt == state.pending.end() || now < jt->second.time) {
+        return;
+    }
+
+    addRoundTrip(state, (double)(now-jt->second.time), now);
+
+    // Delivery rate is the bytes acknowledged since the last acknowledgement
+    Uint64 sent = jt->second.sent;
+    if (state.ackTime > 0 && now > state.ackTime && sent > state.ackSent) {
+        double sample = (double)(sent-state.ackSent)*1000000.0/(double)(now-state.ackTime);
+        if (sample >= state.bandwidth) {
+            state.bandwidth = sample;
+        } else {
+            state.bandwidth += (sample-state.bandwidth)*BANDWIDTH_DECAY;
+        }
+    }
+    if (sent >= state.ackSent) {
+        state.ackSent = sent;
+        state.ackTime = now;
+    }
+    state.pending.erase(state.pending.begin(), ++jt);
+}
+
+/**
+ * Records a round trip time measured by other means (e.g. clock pings).
+ *
+ * @param peer  The UUID of the peer
+ * @param rtt   The round trip time
+ * @param now   The current time
+ */
+void NetRateController::recordRoundTrip(const std::string& peer, double rtt, Uint64 now) {
+    auto it = _peers.find(peer);
+    if (it != _peers.end() && rtt >= 0) {
+        addRoundTrip(it->second, rtt, now);
+    }
+}
+
+/**
+ * Records the bytes queued in the send buffers to the given peer.
+ *
+ * @param peer  The UUID of the peer
+ * @param bytes The number of bytes queued
+ */
+void NetRateController::recordBuffered(const std::string& peer, size_t bytes) {
+    auto it = _peers.find(peer);
+    if (it != _peers.end()) {
+        it->second.buffered = bytes;
+    }
+}
+
+#pragma mark Scheduling
+/**
+ * Updates the snapshot rate and budgets to the current time.
+ *
+ * This should be called once per fixed update, after the buffers have
+ * been recorded, and before {@link #isSnapshotDue}.
+ *
+ * @param now   The current time
+ */
+void NetRateController::update(Uint64 now) {
+    double dt = (_lastTime == 0 || now <= _lastTime) ? 0 : (double)(now-_lastTime)/1000000.0;
+    dt = std::min(dt, MAX_UPDATE);
+    _lastTime = now;
+
+    double rtt = 0;
+    _congested = false;
+    for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+        Peer& peer = it->second;
+        if (peer.buffered > _bufferLimit) {
+            _congested = true;
+        } else if (peer.buffered > peer.lastBuffered && peer.buffered > _bufferLimit/4) {
+            _congested = true;  // Growing queue
+        } else if (_rttTolerance > 0 && peer.rtt > 0 && peer.rtt > peer.minRtt+_rttTolerance) {
+            _congested = true;  // Queuing in the network
+        }
+        peer.lastBuffered = peer.buffered;
+        rtt = std::max(rtt, peer.rtt);
+    }
+
+    for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+        Peer& peer = it->second;
+        if (peer.bandwidth > 0) {
+            double fill = peer.bandwidth*(_congested ? DRAIN_GAIN : PROBE_GAIN);
+            peer.tokens = std::min(peer.tokens+fill*dt, fill*BURST_TIME);
+        }
+    }
+
+    if (_congested) {
+        // Decrease at most once per round trip, so one event is one decrease
+        double wait = std::max(rtt, 1000000.0/std::max(_maxRate, 1.0));
+        if (_lastDecrease == 0 || (double)(now-_lastDecrease) >= wait) {
+            _rate = std::max(_minRate, _rate*_decrease);
+            _lastDecrease = now;
+        }
+    } else {
+        _rate = std::min(_maxRate, _rate+_increase*dt);
+    }
+
+    _credit = std::min(_credit+_rate*dt, 1.0);
+    _idle += dt;
+}
+
+/**
+ * Returns true if a snapshot should be sent in this update.
+ *
+ * If so, this method assumes that the snapshot will be sent, and
+ * schedules the next one.
+ *
+ * @return true if a snapshot should be sent in this update.
+ */
+bool NetRateController::isSnapshotDue() {
+    bool starved = _minRate > 0 && _idle*_minRate >= 1-CREDIT_EPSILON;
+    if (!starved) {
+        if (_credit < 1-CREDIT_EPSILON) {
+            return false;
+        }
+        for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+            if (it->second.bandwidth > 0 && it->second.tokens < 0) {
+                return false;
+            }
+        }
+    }
+    _credit = std::max(_credit-1, 0.0);
+    _idle = 0;
+    return true;
+}
+
+/**
+ * Returns the number of bytes a snapshot may use right now.
+ *
+ * This is the smallest token bucket of any peer with a bandwidth
+ * estimate, but never more than {@link #getMaxBudget}.
+ *
+ * @return the number of bytes a snapshot may use right now.
+ */
+size_t NetRateController::getBudget() const {
+    double budget = (double)_maxBudget;
+    for(auto it = _peers.begin(); it != _peers.end(); ++it) {
+        if (it->second.bandwidth > 0) {
+            budget = std::min(budget, std::max(it->second.tokens, 0.0));
+        }
+    }
+    return (size_t)budget;
+}
+
+/**
+ * Returns the smoothed round trip time to the given peer.
+ *
+ * This value is 0 if there are no measurements.
+ *
+ * @param peer  The UUID of the peer
+ *
+ * @return the smoothed round trip time to the given peer.
+ */
+double NetRateController::getRoundTripTime(const std::string& peer) const {
+    auto it = _peers.find(peer);
+    return it == _peers.end() ? 0 : it->second.rtt;
+}
+
+/**
+ * Returns the estimated bandwidth to the given peer in bytes per second.
+ *
+ * This value is 0 if there are no measurements.
+ *
+ * @param peer  The UUID of the peer
+ *
+ * @return the estimated bandwidth to the given peer in bytes per second.
+ */
+double NetRateController::getBandwidth(const std::string& peer) const {
+    auto it = _peers.find(peer);
+    return it == _peers.end() ? 0 : it->second.bandwidth;
+}
+
+/**
+ * Returns the bytes queued in the send buffers to the given peer.
+ *
+ * @param peer  The UUID of the peer
+ *
+ * @return the bytes queued in the send buffers to the given peer.
+ */
+size_t NetRateController::getBuffered(const std::string& peer) const {
+    auto it = _peers.find(peer);
+    return it == _peers.end() ? 0 : it->second.buffered;
+}
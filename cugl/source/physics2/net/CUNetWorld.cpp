@@ -45,6 +45,17 @@
 #include <algorithm>
 #include <random>
 
+#if defined(__FAST_MATH__)
+    #warning "Fast floating point math breaks deterministic NetWorld simulation"
+#endif
+
+/** The default width and height of a state digest region */
+#define DEFAULT_DIGEST_REGION   8.0f
+/** The default position quantum of state digests */
+#define DEFAULT_DIGEST_POSITION 0.05f
+/** The default angle quantum of state digests */
+#define DEFAULT_DIGEST_ANGLE    0.05f
+
 
 using namespace cugl;
 using namespace cugl::physics2;
@@ -81,7 +92,12 @@ NetWorld::NetWorld() : ObstacleWorld(),
 _nextInitObj(0),
 _nextSharedObj(0),
 _nextInitJoint(0),
-_nextSharedJoint(0) {
+_nextSharedJoint(0),
+_deterministic(false),
+_orderDirty(true),
+_digestSize(DEFAULT_DIGEST_REGION),
+_digestPosQuant(DEFAULT_DIGEST_POSITION),
+_digestAngleQuant(DEFAULT_DIGEST_ANGLE) {
     _uuid = genuuid();
     std::hash<std::string> hasher;
     _shortUID = (Uint32)hasher(_uuid);
@@ -95,16 +111,15 @@ _nextSharedJoint(0) {
  * object owns them.
  */
 void NetWorld::dispose() {
-    _obsToId.clear();
-    _idToObs.clear();
-    _ownedObs.clear();
-    _jntToId.clear();
-    _idToJnt.clear();
-    _ownedJoints.clear();
+    _obsRegistry.clear();
+    _jntRegistry.clear();
     _nextInitObj = 0;
     _nextSharedObj = 0;
     _nextInitJoint = 0;
     _nextSharedJoint = 0;
+    _deterministic = false;
+    _updateOrder.clear();
+    _orderDirty = true;
     ObstacleWorld::dispose();
 }
 
@@ -174,6 +189,85 @@ std::shared_ptr<Obstacle> NetWorld::getNextObstacle() {
 }
 
 
+#pragma mark -
+#pragma mark Deterministic Simulation
+/**
+ * Configures this world for deterministic simulation.
+ *
+ * This is required for lockstep networking, where every peer simulates
+ * the world independently from the same inputs. The world is set to
+ * lockstep with the given step size, Box2d sub-stepping is disabled, and
+ * obstacles are updated in increasing id order (instead of hash order).
+ * Obstacle ids, and hence this order, are the same on every peer.
+ *
+ * Bitwise identical results also require every peer to run the same
+ * build, compiled without fast floating point math (e.g. -ffast-math
+ * or /fp:fast), and to create obstacles in the same order.
+ *
+ * @param step  The fixed step size in seconds
+ */
+void NetWorld::setDeterministic(float step) {
+    _deterministic = true;
+    _orderDirty = true;
+    setLockStep(true);
+    setStepsize(step);
+    if (_world) {
+        _world->SetSubStepping(false);
+        _world->SetWarmStarting(true);
+        _world->SetContinuousPhysics(true);
+    }
+}
+
+/**
+ * Executes a single step of the physics engine.
+ *
+ * If {@link #isLockStep} is true, then this method will run the physics
+ * simulation for {@link #getStepsize} time, no matter the value of dt.
+ * Otherwise, it will run the simulation for dt seconds. If the world is
+ * deterministic, obstacles and joints are updated in increasing id order.
+ *
+ * @param dt Number of seconds to run the (non-lockstep) simulation
+ */
+void NetWorld::update(float dt) {
+    if (!_deterministic) {
+        ObstacleWorld::update(dt);
+        return;
+    }
+    
+    _world->Step((_lockstep ? _stepssize : dt),_itvelocity,_itposition);
+    
+    if (_orderDirty) {
+        ObstacleView view = _obsRegistry.all();
+        std::vector<std::pair<Uint64,size_t>> ids;
+        ids.reserve(view.size());
+        for(size_t ii = 0; ii < view.size(); ii++) {
+            ids.push_back(std::make_pair(view.getId(ii),ii));
+        }
+        std::sort(ids.begin(), ids.end());
+        _updateOrder.clear();
+        for(auto it = ids.begin(); it != ids.end(); ++it) {
+            _updateOrder.push_back(view[it->second]);
+        }
+        _orderDirty = false;
+    }
+    for(auto it = _updateOrder.begin(); it != _updateOrder.end(); ++it) {
+        (*it)->update(dt);
+    }
+    
+    JointView joints = _jntRegistry.all();
+    std::vector<std::pair<Uint64,Joint*>> dirty;
+    for(size_t ii = 0; ii < joints.size(); ii++) {
+        if (joints[ii]->isDirty()) {
+            dirty.push_back(std::make_pair(joints.getId(ii),joints[ii].get()));
+        }
+    }
+    std::sort(dirty.begin(), dirty.end());
+    for(auto jt = dirty.begin(); jt != dirty.end(); ++jt) {
+        jt->second->deactivatePhysics(*_world);
+        jt->second->activatePhysics(*_world);
+    }
+}
+
 /**
  * Activates this obstacle in the shared physics world
  *
@@ -190,12 +284,12 @@ std::shared_ptr<Obstacle> NetWorld::getNextObstacle() {
  */
 void NetWorld::activateObstacle(Uint64 oid, const std::shared_ptr<Obstacle>& obj) {
     CUAssertLog(inBounds(obj.get()), "Obstacle is not in bounds");
-    CUAssertLog(!_idToObs.count(oid), "Duplicate obstacle ids are not allowed");
+    ObstacleHandle handle = _obsRegistry.insert(oid, obj);
+    CUAssertLog(handle != SlotRegistry<Obstacle>::INVALID_HANDLE, "Duplicate obstacle ids are not allowed");
     _obstacles.emplace(obj);
     obj->activatePhysics(*_world);
-    _idToObs[oid] = obj;
-    _obsToId[obj] = oid;
     _nextObstacle = _obstacles.find(obj);
+    _orderDirty = true;
 }
 
 /**
@@ -274,13 +368,9 @@ void NetWorld::addObstacle(const std::shared_ptr<Obstacle>& obj) {
  * @param obj The obstacle to remove
  */
 void NetWorld::removeObstacle(const std::shared_ptr<Obstacle>& obj) {
-    auto pos = _obsToId.find(obj);
-    if (pos != _obsToId.end()) {
-        Uint64 oid = pos->second;
-        _obsToId.erase(pos);
-        _idToObs.erase(oid);
-        _ownedObs.erase(obj);
+    if (_obsRegistry.erase(_obsRegistry.find(obj.get()))) {
         _nextObstacle = _obstacles.begin();
+        _orderDirty = true;
         ObstacleWorld::removeObstacle(obj);
     }
 }
@@ -305,12 +395,11 @@ void NetWorld::activateJoint(Uint64 jid, const std::shared_ptr<Joint>& joint) {
     CUAssertLog(it != _obstacles.end(), "Obstacle A not found in physics world");
     auto jt = _obstacles.find(joint->getObstacleB());
     CUAssertLog(jt != _obstacles.end(), "Obstacle B not found in physics world");
-    CUAssertLog(!_idToJnt.count(jid), "Duplicate joint ids are not allowed");
+    auto handle = _jntRegistry.insert(jid, joint);
+    CUAssertLog(handle != SlotRegistry<Joint>::INVALID_HANDLE, "Duplicate joint ids are not allowed");
 
     joint->activatePhysics(*_world);
     _joints[joint->getJoint()] = joint;
-    _idToJnt[jid] = joint;
-    _jntToId[joint] = jid;
 }
 
 /**
@@ -392,16 +481,180 @@ void NetWorld::addJoint(const std::shared_ptr<Joint>& joint) {
  * @param joint  The joint to remove
  */
 void NetWorld::removeJoint(const std::shared_ptr<Joint>& joint) {
-    auto pos = _jntToId.find(joint);
-    if (pos != _jntToId.end()) {
-        Uint64 jid = pos->second;
-        _jntToId.erase(pos);
-        _idToJnt.erase(jid);
-        _ownedJoints.erase(joint);
+    if (_jntRegistry.erase(_jntRegistry.find(joint.get()))) {
         ObstacleWorld::removeJoint(joint);
     }
 }
 
+#pragma mark -
+#pragma mark State Digests
+/**
+ * Returns the 64-bit finalizer of SplitMix64 applied to a value.
+ *
+ * This is a cheap mixing function that spreads every input bit across the
+ * whole output.
+ *
+ * @param x The value to mix
+ *
+ * @return the mixed value
+ */
+static Uint64 mix64(Uint64 x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Returns a value rounded to the nearest multiple of a quantum.
+ *
+ * The result is the number of quanta, so that it can be hashed exactly.
+ *
+ * @param value     The value to round
+ * @param quantum   The quantum
+ *
+ * @return a value rounded to the nearest multiple of a quantum.
+ */
+static Sint64 quantize(float value, float quantum) {
+    return (Sint64)std::llround((double)value/quantum);
+}
+
+/**
+ * Sets the width and height of each state digest region.
+ *
+ * Every peer must use the same region size, or their digests will never
+ * agree.
+ *
+ * @param size  The width and height of each region
+ */
+void NetWorld::setDigestRegionSize(float size) {
+    CUAssertLog(size > 0, "Region size must be positive");
+    _digestSize = size;
+}
+
+/**
+ * Returns the number of state digest regions.
+ *
+ * Positions outside of the world bounds are clamped to the nearest region.
+ *
+ * @return the number of state digest regions.
+ */
+Uint32 NetWorld::getDigestRegionCount() const {
+    int cols = SDL_max((int)std::ceil(_bounds.size.width/_digestSize),1);
+    int rows = SDL_max((int)std::ceil(_bounds.size.height/_digestSize),1);
+    return (Uint32)(cols*rows);
+}
+
+/**
+ * Returns the state digest region containing the given position.
+ *
+ * Regions are numbered in row-major order. Positions outside of the world
+ * bounds are clamped to the nearest region.
+ *
+ * @param pos   The position in Box2d coordinates
+ *
+ * @return the state digest region containing the given position.
+ */
+Uint32 NetWorld::getDigestRegion(const Vec2 pos) const {
+    int cols = SDL_max((int)std::ceil(_bounds.size.width/_digestSize),1);
+    int rows = SDL_max((int)std::ceil(_bounds.size.height/_digestSize),1);
+    int col = (int)std::floor((pos.x-_bounds.origin.x)/_digestSize);
+    int row = (int)std::floor((pos.y-_bounds.origin.y)/_digestSize);
+    col = SDL_max(0,SDL_min(col,cols-1));
+    row = SDL_max(0,SDL_min(row,rows-1));
+    return (Uint32)(row*cols+col);
+}
+
+/**
+ * Sets the precision of state digests.
+ *
+ * Positions and angles are rounded to a multiple of these values before
+ * hashing. Coarser values tolerate more drift between peers before a
+ * repair is requested. Every peer must use the same precision.
+ *
+ * @param position  The position quantum
+ * @param angle     The angle quantum in radians
+ */
+void NetWorld::setDigestPrecision(float position, float angle) {
+    CUAssertLog(position > 0 && angle > 0, "Digest quanta must be positive");
+    _digestPosQuant = position;
+    _digestAngleQuant = angle;
+}
+
+/**
+ * Returns true if the given obstacle contributes to the state digests.
+ *
+ * Only settled obstacles contribute. An obstacle is settled if it is
+ * asleep, or if it moves less than one quantum per second. Moving
+ * obstacles are already covered by the regular synchronization, and peers
+ * never see them at quite the same time.
+ *
+ * @param obs   The obstacle to check
+ *
+ * @return true if the given obstacle contributes to the state digests.
+ */
+bool NetWorld::isDigestSettled(const std::shared_ptr<Obstacle>& obs) const {
+    if (!obs->isAwake()) {
+        return true;
+    }
+    return obs->getLinearVelocity().isNearZero(_digestPosQuant) &&
+           std::abs(obs->getAngularVelocity()) <= _digestAngleQuant;
+}
+
+/**
+ * Returns the quantized hash of an obstacle state.
+ *
+ * The hash covers the obstacle id, its position and angle (quantized),
+ * its body type, and whether it is enabled. It is the same on every peer
+ * that agrees on this state, regardless of platform.
+ *
+ * @param oid   The obstacle id
+ * @param obs   The obstacle
+ *
+ * @return the quantized hash of an obstacle state.
+ */
+Uint64 NetWorld::hashObstacle(Uint64 oid, const std::shared_ptr<Obstacle>& obs) const {
+    // Peers may disagree on the number of full turns
+    float angle = std::remainder(obs->getAngle(), (float)(2*M_PI));
+    Vec2 pos = obs->getPosition();
+    Uint64 hash = mix64(oid);
+    hash = mix64(hash ^ (Uint64)quantize(pos.x, _digestPosQuant));
+    hash = mix64(hash ^ (Uint64)quantize(pos.y, _digestPosQuant));
+    hash = mix64(hash ^ (Uint64)quantize(angle, _digestAngleQuant));
+    hash = mix64(hash ^ (((Uint64)obs->getBodyType() << 1) | (obs->isEnabled() ? 1 : 0)));
+    return hash;
+}
+
+/**
+ * Computes the state digest of every region, returning the world digest.
+ *
+ * The digest of a region is the sum of the hashes of the settled
+ * obstacles in it. As a sum, it does not depend on the order of the
+ * obstacles, and can be updated one obstacle at a time. The world digest
+ * is a hash of the region digests in order, so that peers only have to
+ * compare the region digests when their world digests disagree.
+ *
+ * @param regions   The vector to store the region digests
+ *
+ * @return the world state digest
+ */
+Uint64 NetWorld::computeDigests(std::vector<Uint64>& regions) const {
+    regions.assign(getDigestRegionCount(), 0);
+    auto view = _obsRegistry.all();
+    for (size_t ii = 0; ii < view.size(); ii++) {
+        const auto& obs = view[ii];
+        if (isDigestSettled(obs)) {
+            regions[getDigestRegion(obs->getPosition())] += hashObstacle(view.getId(ii), obs);
+        }
+    }
+    
+    Uint64 root = mix64(regions.size());
+    for (auto it = regions.begin(); it != regions.end(); ++it) {
+        root = mix64(root ^ *it);
+    }
+    return root;
+}
+
 #pragma mark Destruction Callback Functions
 /**
  * Called when a joint is about to be destroyed.
@@ -415,12 +668,9 @@ void NetWorld::SayGoodbye(b2Joint* joint) {
     auto jt = _joints.find(joint);
     if (jt != _joints.end()) {
         std::shared_ptr<Joint> jobj = jt->second;
-        Uint64 jid = _jntToId.at(jobj);
         jobj->release();
         jt = _joints.erase(jt);
-        _jntToId.erase(jobj);
-        _idToJnt.erase(jid);
-        _ownedJoints.erase(jobj);
+        _jntRegistry.erase(_jntRegistry.find(jobj.get()));
     }
     if (destroyJoint != nullptr) {
         destroyJoint(joint);
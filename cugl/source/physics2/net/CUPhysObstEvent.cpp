@@ -58,6 +58,243 @@ PhysObstEvent::FloatConsts::FloatConsts() {
     inertia = 0;
 }
 
+/** Creates a new delta record with no fields present */
+PhysObstEvent::Delta::Delta() {
+    obstacleId = 0;
+    mask = 0;
+    angle = 0;
+    angularVel = 0;
+    bodyType = b2_staticBody;
+}
+
+#pragma mark -
+#pragma mark Delta Encoding
+/** The bits of a packed boolean constants byte */
+#define BOOL_ENABLED        0x01
+#define BOOL_AWAKE          0x02
+#define BOOL_SLEEP_ALLOWED  0x04
+#define BOOL_FIXED_ROTATION 0x08
+#define BOOL_BULLET         0x10
+#define BOOL_SENSOR         0x20
+
+/**
+ * The smallest possible size of a delta record on the wire.
+ *
+ * This is an obstacle id and an empty presence mask.
+ */
+#define MIN_DELTA_SIZE  (sizeof(Uint64)+1)
+
+/**
+ * Returns the size of a delta record on the wire.
+ *
+ * @param mask  The presence mask of the record
+ *
+ * @return the size of a delta record on the wire.
+ */
+static size_t delta_size(Uint8 mask) {
+    size_t size = MIN_DELTA_SIZE;
+    size += (mask & PhysObstEvent::Delta::POSITION) ? 2*sizeof(float) : 0;
+    size += (mask & PhysObstEvent::Delta::VELOCITY) ? 2*sizeof(float) : 0;
+    size += (mask & PhysObstEvent::Delta::ANGLE) ? sizeof(float) : 0;
+    size += (mask & PhysObstEvent::Delta::ANGULAR_VEL) ? sizeof(float) : 0;
+    size += (mask & PhysObstEvent::Delta::BODY_TYPE) ? 1 : 0;
+    size += (mask & PhysObstEvent::Delta::BOOL_CONSTS) ? 1 : 0;
+    size += (mask & PhysObstEvent::Delta::FLOAT_CONSTS) ? 10*sizeof(float) : 0;
+    return size;
+}
+
+/**
+ * Writes a delta record to the end of the given serializer.
+ *
+ * Only the fields present in the mask are written.
+ *
+ * @param out   The serializer to write to
+ * @param delta The record to write
+ */
+static void write_delta(LWSerializer& out, const PhysObstEvent::Delta& delta) {
+    out.writeUint64(delta.obstacleId);
+    out.writeByte((std::byte)delta.mask);
+    if (delta.has(PhysObstEvent::Delta::POSITION)) {
+        out.writeFloat(delta.pos.x);
+        out.writeFloat(delta.pos.y);
+    }
+    if (delta.has(PhysObstEvent::Delta::VELOCITY)) {
+        out.writeFloat(delta.vel.x);
+        out.writeFloat(delta.vel.y);
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGLE)) {
+        out.writeFloat(delta.angle);
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGULAR_VEL)) {
+        out.writeFloat(delta.angularVel);
+    }
+    if (delta.has(PhysObstEvent::Delta::BODY_TYPE)) {
+        out.writeByte((std::byte)delta.bodyType);
+    }
+    if (delta.has(PhysObstEvent::Delta::BOOL_CONSTS)) {
+        const PhysObstEvent::BoolConsts& bools = delta.bools;
+        Uint8 bits = 0;
+        bits |= bools.isEnabled ? BOOL_ENABLED : 0;
+        bits |= bools.isAwake ? BOOL_AWAKE : 0;
+        bits |= bools.isSleepingAllowed ? BOOL_SLEEP_ALLOWED : 0;
+        bits |= bools.isFixedRotation ? BOOL_FIXED_ROTATION : 0;
+        bits |= bools.isBullet ? BOOL_BULLET : 0;
+        bits |= bools.isSensor ? BOOL_SENSOR : 0;
+        out.writeByte((std::byte)bits);
+    }
+    if (delta.has(PhysObstEvent::Delta::FLOAT_CONSTS)) {
+        const PhysObstEvent::FloatConsts& floats = delta.floats;
+        float consts[10] = { floats.density, floats.friction, floats.restitution,
+            floats.linearDamping, floats.angularDamping, floats.gravityScale,
+            floats.mass, floats.inertia, floats.centroid.x, floats.centroid.y };
+        out.writeFloats(consts, 10);
+    }
+}
+
+/**
+ * Reads a delta record from the given deserializer.
+ *
+ * Fields not present in the mask are left at their defaults.
+ *
+ * @param in    The deserializer to read from
+ * @param delta The record to read into
+ */
+static void read_delta(LWDeserializer& in, PhysObstEvent::Delta& delta) {
+    delta.obstacleId = in.readUint64();
+    delta.mask = (Uint8)in.readByte();
+    if (delta.has(PhysObstEvent::Delta::POSITION)) {
+        delta.pos.x = in.readFloat();
+        delta.pos.y = in.readFloat();
+    }
+    if (delta.has(PhysObstEvent::Delta::VELOCITY)) {
+        delta.vel.x = in.readFloat();
+        delta.vel.y = in.readFloat();
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGLE)) {
+        delta.angle = in.readFloat();
+    }
+    if (delta.has(PhysObstEvent::Delta::ANGULAR_VEL)) {
+        delta.angularVel = in.readFloat();
+    }
+    if (delta.has(PhysObstEvent::Delta::BODY_TYPE)) {
+        delta.bodyType = (b2BodyType)in.readByte();
+    }
+    if (delta.has(PhysObstEvent::Delta::BOOL_CONSTS)) {
+        Uint8 bits = (Uint8)in.readByte();
+        PhysObstEvent::BoolConsts& bools = delta.bools;
+        bools.isEnabled = (bits & BOOL_ENABLED) != 0;
+        bools.isAwake = (bits & BOOL_AWAKE) != 0;
+        bools.isSleepingAllowed = (bits & BOOL_SLEEP_ALLOWED) != 0;
+        bools.isFixedRotation = (bits & BOOL_FIXED_ROTATION) != 0;
+        bools.isBullet = (bits & BOOL_BULLET) != 0;
+        bools.isSensor = (bits & BOOL_SENSOR) != 0;
+    }
+    if (delta.has(PhysObstEvent::Delta::FLOAT_CONSTS)) {
+        float consts[10];
+        in.readFloats(consts, 10);
+        PhysObstEvent::FloatConsts& floats = delta.floats;
+        floats.density = consts[0];
+        floats.friction = consts[1];
+        floats.restitution = consts[2];
+        floats.linearDamping = consts[3];
+        floats.angularDamping = consts[4];
+        floats.gravityScale = consts[5];
+        floats.mass = consts[6];
+        floats.inertia = consts[7];
+        floats.centroid.set(consts[8], consts[9]);
+    }
+}
+
+#pragma mark -
+#pragma mark World Snapshots
+/**
+ * The smallest possible size of a snapshot record on the wire.
+ *
+ * This is a factory id, a parameter length, and an empty delta record.
+ */
+#define MIN_RECORD_SIZE (2*sizeof(Uint32)+MIN_DELTA_SIZE)
+
+/**
+ * Encodes a world snapshot as a sequence of bytes.
+ *
+ * The bytes are meant to be split into {@link EventType::WORLD_CHUNK}
+ * events. A complete snapshot contains every shared obstacle in the world,
+ * while a partial one only contains the obstacles that were requested.
+ *
+ * @param records   The obstacles in the snapshot
+ * @param complete  Whether the snapshot contains the entire world
+ *
+ * @return the encoded world snapshot
+ */
+std::vector<std::byte> PhysObstEvent::encodeImage(const std::vector<Record>& records, bool complete) {
+    LWSerializer out;
+    out.writeBool(complete);
+    out.writeUint32((Uint32)records.size());
+    for(auto it = records.begin(); it != records.end(); ++it) {
+        out.writeUint32(it->factoryId);
+        if (it->packedParam == nullptr) {
+            out.writeUint32(0);
+        } else {
+            out.writeUint32((Uint32)it->packedParam->size());
+            out.writeByteVector(*(it->packedParam));
+        }
+        write_delta(out, it->state);
+    }
+    return out.serialize();
+}
+
+/**
+ * Decodes a world snapshot from a sequence of bytes.
+ *
+ * This is the counterpart of {@link #encodeImage}. If the bytes are
+ * truncated, this method decodes what it can and returns false.
+ *
+ * @param data      The encoded world snapshot
+ * @param records   The vector to store the obstacles in
+ * @param complete  Whether the snapshot contains the entire world
+ *
+ * @return true if the snapshot was decoded in full
+ */
+bool PhysObstEvent::decodeImage(const std::vector<std::byte>& data,
+                                std::vector<Record>& records, bool& complete) {
+    records.clear();
+    complete = false;
+    if (data.size() < 1+sizeof(Uint32)) {
+        return false;
+    }
+    
+    LWDeserializer in;
+    in.receive(data.data(), data.size());
+    complete = in.readBool();
+    Uint32 count = in.readUint32();
+    // Do not trust the count further than the bytes can back it up
+    records.reserve(SDL_min((size_t)count, in.remaining()/MIN_RECORD_SIZE));
+    for(Uint32 ii = 0; ii < count; ii++) {
+        if (in.remaining() < MIN_RECORD_SIZE) {
+            return false;
+        }
+        Record record;
+        record.factoryId = in.readUint32();
+        Uint32 length = in.readUint32();
+        if (length > 0) {
+            if (in.remaining() < length+MIN_DELTA_SIZE) {
+                return false;
+            }
+            record.packedParam = std::make_shared<std::vector<std::byte>>(in.readByteVector(length));
+        }
+        size_t available = in.remaining();
+        read_delta(in, record.state);
+        if (available < delta_size(record.state.mask)) {
+            return false;
+        }
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+#pragma mark -
+#pragma mark Serialization
+
 /**
  * Returns a byte vector serializing this event
  *
@@ -65,79 +302,128 @@ PhysObstEvent::FloatConsts::FloatConsts() {
  */
 std::vector<std::byte> PhysObstEvent::serialize() {
     _serializer.reset();
-    _serializer.writeUint32((uint32)_type);
-    _serializer.writeUint64(_obstacleId);
+    serializeTo(_serializer);
+    return _serializer.serialize();
+}
+
+/**
+ * Deserializes this event from a byte vector.
+ *
+ * This method will set the type of the event and all relevant fields.
+ */
+void PhysObstEvent::deserialize(const std::vector<std::byte>& data) {
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Writes this event to the end of the given serializer.
+ *
+ * The output is the same as {@link #serialize()}, but no intermediate
+ * byte vector is allocated.
+ *
+ * @param out   The serializer to write to
+ */
+void PhysObstEvent::serializeTo(LWSerializer& out) {
+    out.writeUint32((uint32)_type);
+    out.writeUint64(_obstacleId);
     switch (_type) {
         case PhysObstEvent::EventType::CREATION:
-            _serializer.writeUint32(_factoryId);
-            _serializer.writeByteVector(*_packedParam);
+            out.writeUint32(_factoryId);
+            out.writeByteVector(*_packedParam);
             break;
         case PhysObstEvent::EventType::DELETION:
             break;
         case PhysObstEvent::EventType::BODY_TYPE:
-            _serializer.writeUint32(_bodyType);
+            out.writeUint32(_bodyType);
             break;
         case PhysObstEvent::EventType::POSITION:
-            _serializer.writeFloat(_pos.x);
-            _serializer.writeFloat(_pos.y);
+            out.writeFloat(_pos.x);
+            out.writeFloat(_pos.y);
             break;
         case PhysObstEvent::EventType::VELOCITY:
-            _serializer.writeFloat(_vel.x);
-            _serializer.writeFloat(_vel.y);
+            out.writeFloat(_vel.x);
+            out.writeFloat(_vel.y);
             break;
         case PhysObstEvent::EventType::ANGLE:
-            _serializer.writeFloat(_angle);
+            out.writeFloat(_angle);
             break;
         case PhysObstEvent::EventType::ANGULAR_VEL:
-            _serializer.writeFloat(_angularVel);
+            out.writeFloat(_angularVel);
             break;
         case PhysObstEvent::EventType::BOOL_CONSTS:
-            _serializer.writeBool(_isEnabled);
-            _serializer.writeBool(_isAwake);
-            _serializer.writeBool(_isSleepingAllowed);
-            _serializer.writeBool(_isFixedRotation);
-            _serializer.writeBool(_isBullet);
-            _serializer.writeBool(_isSensor);
+            out.writeBool(_isEnabled);
+            out.writeBool(_isAwake);
+            out.writeBool(_isSleepingAllowed);
+            out.writeBool(_isFixedRotation);
+            out.writeBool(_isBullet);
+            out.writeBool(_isSensor);
             break;
         case PhysObstEvent::EventType::FLOAT_CONSTS:
-            _serializer.writeFloat(_density);
-            _serializer.writeFloat(_friction);
-            _serializer.writeFloat(_restitution);
-            _serializer.writeFloat(_linearDamping);
-            _serializer.writeFloat(_angularDamping);
-            _serializer.writeFloat(_gravityScale);
-            _serializer.writeFloat(_mass);
-            _serializer.writeFloat(_inertia);
-            _serializer.writeFloat(_centroid.x);
-            _serializer.writeFloat(_centroid.y);
+        {
+            float consts[10] = { _density, _friction, _restitution,
+                _linearDamping, _angularDamping, _gravityScale,
+                _mass, _inertia, _centroid.x, _centroid.y };
+            out.writeFloats(consts, 10);
+        }
             break;
         case PhysObstEvent::EventType::OWNER_ACQUIRE:
-            _serializer.writeUint64(_duration);
+            out.writeUint64(_duration);
             break;
         case PhysObstEvent::EventType::OWNER_RELEASE:
             break;
+        case PhysObstEvent::EventType::DELTA:
+            out.writeUint32((Uint32)_deltas.size());
+            for(auto it = _deltas.begin(); it != _deltas.end(); ++it) {
+                write_delta(out, *it);
+            }
+            break;
+        case PhysObstEvent::EventType::WORLD_REQUEST:
+            out.writeUint32((Uint32)_requestIds.size());
+            for(auto it = _requestIds.begin(); it != _requestIds.end(); ++it) {
+                out.writeUint64(*it);
+            }
+            break;
+        case PhysObstEvent::EventType::WORLD_CHUNK:
+            out.writeUint32(_imageId);
+            out.writeUint32(_chunkIndex);
+            out.writeUint32(_chunkCount);
+            out.writeUint64(_imageTick);
+            out.writeByteVector(*_packedParam);
+            break;
+        case PhysObstEvent::EventType::WORLD_DIGEST:
+            out.writeUint64(_digest);
+            out.writeUint32(_regionCount);
+            break;
+        case PhysObstEvent::EventType::REGION_DIGESTS:
+            out.writeUint32((Uint32)_digests.size());
+            for(auto it = _digests.begin(); it != _digests.end(); ++it) {
+                out.writeUint64(*it);
+            }
+            break;
         default:
             CUAssertLog(false, "Serializing invalid obstacle event type");
     }
-    return _serializer.serialize();
 }
 
 /**
- * Deserializes this event from a byte vector.
+ * Deserializes this event from a span of bytes.
  *
- * This method will set the type of the event and all relevant fields.
+ * The bytes are read in place and are not retained. This method will set
+ * the type of the event and all relevant fields.
+ *
+ * @param data  The bytes to deserialize
+ * @param size  The number of bytes
  */
-void PhysObstEvent::deserialize(const std::vector<std::byte>& data) {
-    if (data.size() < sizeof(Uint32) + sizeof(Uint64))
+void PhysObstEvent::deserializeFrom(const std::byte* data, size_t size) {
+    if (size < sizeof(Uint32) + sizeof(Uint64))
         return;
-    _deserializer.reset();
-    _deserializer.receive(data);
+    _deserializer.receive(data, size);
     _type = (EventType)_deserializer.readUint32();
     _obstacleId = _deserializer.readUint64();
     switch (_type) {
         case PhysObstEvent::EventType::CREATION:
             _factoryId = _deserializer.readUint32();
-            _packedParam = std::make_shared<std::vector<std::byte>>(data.begin() + 2 * sizeof(Uint32) + sizeof(Uint64), data.end());
+            _packedParam = std::make_shared<std::vector<std::byte>>(_deserializer.readByteVector(_deserializer.remaining()));
             break;
         case PhysObstEvent::EventType::DELETION:
             break;
@@ -167,23 +453,74 @@ void PhysObstEvent::deserialize(const std::vector<std::byte>& data) {
             _isSensor = _deserializer.readBool();
             break;
         case PhysObstEvent::EventType::FLOAT_CONSTS:
-            _density = _deserializer.readFloat();
-            _friction = _deserializer.readFloat();
-            _restitution = _deserializer.readFloat();
-            _linearDamping = _deserializer.readFloat();
-            _angularDamping = _deserializer.readFloat();
-            _gravityScale = _deserializer.readFloat();
-            _mass = _deserializer.readFloat();
-            _inertia = _deserializer.readFloat();
-            _centroid.x = _deserializer.readFloat();
-            _centroid.y = _deserializer.readFloat();
+        {
+            float consts[10];
+            _deserializer.readFloats(consts, 10);
+            _density = consts[0];
+            _friction = consts[1];
+            _restitution = consts[2];
+            _linearDamping = consts[3];
+            _angularDamping = consts[4];
+            _gravityScale = consts[5];
+            _mass = consts[6];
+            _inertia = consts[7];
+            _centroid.set(consts[8], consts[9]);
+        }
             break;
         case PhysObstEvent::EventType::OWNER_ACQUIRE:
             _duration = _deserializer.readUint64();
             break;
         case PhysObstEvent::EventType::OWNER_RELEASE:
             break;
+        case PhysObstEvent::EventType::DELTA:
+        {
+            Uint32 count = _deserializer.readUint32();
+            // Do not trust the count further than the bytes can back it up
+            size_t bound = _deserializer.remaining()/MIN_DELTA_SIZE;
+            _deltas.clear();
+            _deltas.reserve(SDL_min((size_t)count, bound));
+            for(Uint32 ii = 0; ii < count && _deserializer.remaining() >= MIN_DELTA_SIZE; ii++) {
+                _deltas.emplace_back();
+                read_delta(_deserializer, _deltas.back());
+            }
+        }
+            break;
+        case PhysObstEvent::EventType::WORLD_REQUEST:
+        {
+            Uint32 count = _deserializer.readUint32();
+            size_t bound = _deserializer.remaining()/sizeof(Uint64);
+            _requestIds.clear();
+            _requestIds.reserve(SDL_min((size_t)count, bound));
+            for(Uint32 ii = 0; ii < count && _deserializer.remaining() >= sizeof(Uint64); ii++) {
+                _requestIds.push_back(_deserializer.readUint64());
+            }
+        }
+            break;
+        case PhysObstEvent::EventType::WORLD_CHUNK:
+            _imageId = _deserializer.readUint32();
+            _chunkIndex = _deserializer.readUint32();
+            _chunkCount = _deserializer.readUint32();
+            _imageTick = _deserializer.readUint64();
+            _packedParam = std::make_shared<std::vector<std::byte>>(_deserializer.readByteVector(_deserializer.remaining()));
+            break;
+        case PhysObstEvent::EventType::WORLD_DIGEST:
+            _digest = _deserializer.readUint64();
+            _regionCount = _deserializer.readUint32();
+            break;
+        case PhysObstEvent::EventType::REGION_DIGESTS:
+        {
+            Uint32 count = _deserializer.readUint32();
+            size_t bound = _deserializer.remaining()/sizeof(Uint64);
+            _digests.clear();
+            _digests.reserve(SDL_min((size_t)count, bound));
+            for(Uint32 ii = 0; ii < count && _deserializer.remaining() >= sizeof(Uint64); ii++) {
+                _digests.push_back(_deserializer.readUint64());
+            }
+        }
+            break;
         default:
             CUAssertLog(false, "Deserializing invalid obstacle event type");
     }
+    // The span is not retained past this call
+    _deserializer.reset();
 }
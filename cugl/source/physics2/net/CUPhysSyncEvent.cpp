@@ -28,6 +28,27 @@
 //  Version: 11/13/23
 //
 #include <cugl/physics2/net/CUPhysSyncEvent.h>
+#include <cugl/physics2/net/CULWDeserializer.h>
+#include <cugl/util/CUDebug.h>
+#include <algorithm>
+#include <cmath>
+
+/** The leading payload byte marking the compact encoding */
+#define COMPACT_ENCODING 0
+/** The leading payload byte marking the raw encoding */
+#define RAW_ENCODING     1
+/** The number of quantized fields per object */
+#define NUM_FIELDS      6
+/** The id tag for an id sharing the owner of the previous id */
+#define ID_SEQUENTIAL   0
+/** The id tag for an id owned by the sender */
+#define ID_SENDER       1
+/** The id tag for an id of an initial object */
+#define ID_INITIAL      2
+/** The id tag for an id with an explicit owner */
+#define ID_EXPLICIT     3
+/** The owner (upper half) of the ids of initial objects */
+#define INITIAL_OWNER   0xffffffff
 
 using namespace cugl;
 using namespace cugl::physics2;
@@ -44,6 +65,16 @@ PhysSyncEvent::Parameters::Parameters() {
     vAngular = 0;
 }
 
+/** Creates a new quantization with default values */
+PhysSyncEvent::Quantization::Quantization() {
+    posBits = 16;
+    velBits = 12;
+    maxVel = 64.0f;
+    angleBits = 12;
+    angVelBits = 10;
+    maxAngVel = 8*M_PI;
+}
+
 /**
  * Snapshots an obstacle's current position and velocity.
  *
@@ -66,6 +97,9 @@ void PhysSyncEvent::addObstacle(Uint64 id, const std::shared_ptr<physics2::Obsta
     param.angle = obs->getAngle();
     param.vAngular = obs->getAngularVelocity();
     _syncList.push_back(param);
+    if (_compact) {
+        (*_snapshot)[id] = quantize(param);
+    }
 }
 
 /**
@@ -74,19 +108,9 @@ void PhysSyncEvent::addObstacle(Uint64 id, const std::shared_ptr<physics2::Obsta
  * @return a byte vector serializing the current list of snapshots.
  */
 std::vector<std::byte> PhysSyncEvent::serialize() {
-    _serializer.reset();
-    _serializer.writeUint64((Uint64)_syncList.size());
-    for (auto it = _syncList.begin(); it != _syncList.end(); it++) {
-        Parameters& obj = (*it);
-        _serializer.writeUint64(obj.obsId);
-        _serializer.writeFloat(obj.x);
-        _serializer.writeFloat(obj.y);
-        _serializer.writeFloat(obj.vx);
-        _serializer.writeFloat(obj.vy);
-        _serializer.writeFloat(obj.angle);
-        _serializer.writeFloat(obj.vAngular);
-    }
-    return _serializer.serialize();
+    LWSerializer serializer;
+    serializeTo(serializer);
+    return serializer.serialize();
 }
 
 /**
@@ -97,21 +121,355 @@ std::vector<std::byte> PhysSyncEvent::serialize() {
  * @param data the byte vector to deserialize
  */
 void PhysSyncEvent::deserialize(const std::vector<std::byte>& data) {
-    if (data.size() < 4)
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Writes the current list of snapshots to the end of the given serializer.
+ *
+ * The output is the same as {@link #serialize()}, but no intermediate
+ * byte vector is allocated for the raw encoding.
+ *
+ * @param out   The serializer to write to
+ */
+void PhysSyncEvent::serializeTo(LWSerializer& out) {
+    if (_compact) {
+        serializeCompact(out);
         return;
+    }
     
-    _deserializer.reset();
-    _deserializer.receive(data);
-    Uint64 numObjs = _deserializer.readUint64();
-    for (size_t i = 0; i < numObjs; i++) {
+    out.writeByte(std::byte(RAW_ENCODING));
+    out.writeUint32((Uint32)_syncList.size());
+    for (auto it = _syncList.begin(); it != _syncList.end(); it++) {
+        const Parameters& obj = (*it);
+        float values[NUM_FIELDS] = { obj.x, obj.y, obj.vx, obj.vy, obj.angle, obj.vAngular };
+        out.writeUint64(obj.obsId);
+        out.writeFloats(values, NUM_FIELDS);
+    }
+}
+
+/**
+ * Unpacks a span of bytes into a list of snapshots.
+ *
+ * Raw snapshots are read in place. Compact snapshots are copied, as they
+ * are not decoded until {@link #decode} is called.
+ *
+ * @param data  The bytes to deserialize
+ * @param size  The number of bytes
+ */
+void PhysSyncEvent::deserializeFrom(const std::byte* data, size_t size) {
+    if (size < 4)
+        return;
+    
+    if ((Uint8)data[0] == COMPACT_ENCODING) {
+        // Only the header can be read without a baseline
+        _compact = true;
+        _bitDeserializer.receive(data,size,1);
+        _shortUID = _bitDeserializer.readBits(32);
+        _direct = _bitDeserializer.readBool();
+        _sequence = (Uint32)_bitDeserializer.readVarUint();
+        Uint32 back = (Uint32)_bitDeserializer.readVarUint();
+        _baseline = back ? _sequence-back : 0;
+        return;
+    }
+    
+    LWDeserializer deserializer;
+    deserializer.receive(data, size);
+    deserializer.readByte();
+    Uint32 numObjs = deserializer.readUint32();
+    size_t stride = sizeof(Uint64)+NUM_FIELDS*sizeof(float);
+    _syncList.reserve(_syncList.size()+std::min((size_t)numObjs, deserializer.remaining()/stride));
+    for (Uint32 i = 0; i < numObjs && deserializer.remaining() >= stride; i++) {
         Parameters param;
-        param.obsId = _deserializer.readUint64();
-        param.x = _deserializer.readFloat();
-        param.y = _deserializer.readFloat();
-        param.vx = _deserializer.readFloat();
-        param.vy = _deserializer.readFloat();
-        param.angle = _deserializer.readFloat();
-        param.vAngular = _deserializer.readFloat();
+        float values[NUM_FIELDS];
+        param.obsId = deserializer.readUint64();
+        deserializer.readFloats(values, NUM_FIELDS);
+        param.x = values[0];
+        param.y = values[1];
+        param.vx = values[2];
+        param.vy = values[3];
+        param.angle = values[4];
+        param.vAngular = values[5];
         _syncList.push_back(param);
     }
 }
+
+#pragma mark Compact Encoding
+/**
+ * Switches this event to the compact encoding.
+ *
+ * In the compact encoding, every field is quantized with the given bit
+ * budgets and obstacle ids are written relative to the given shortUID.
+ * The event is also delta encoded against the baseline (if any), so that
+ * unchanged fields only cost a single bit.
+ *
+ * This method may be called before or after the obstacles are added.
+ *
+ * Snapshots sent to a single peer are direct. Direct and broadcast
+ * snapshots form separate streams, each with their own baselines.
+ *
+ * @param sequence  The sequence number of this snapshot (must be nonzero)
+ * @param shortUID  The shortUID of the sending physics world
+ * @param quant     The bit budgets for quantization
+ * @param direct    Whether this snapshot is sent to a single peer
+ */
+void PhysSyncEvent::setCompact(Uint32 sequence, Uint32 shortUID, const Quantization& quant, bool direct) {
+    CUAssertLog(sequence, "Compact snapshots require a nonzero sequence number");
+    _compact = true;
+    _sequence = sequence;
+    _shortUID = shortUID;
+    _direct = direct;
+    _quant = quant;
+    _snapshot = std::make_shared<Snapshot>();
+    for (auto it = _syncList.begin(); it != _syncList.end(); it++) {
+        (*_snapshot)[it->obsId] = quantize(*it);
+    }
+}
+
+/**
+ * Returns the range and bit width of the given quantized field.
+ *
+ * @param field The field index (in the order of {@link Parameters})
+ * @param min   The minimum value of the range
+ * @param max   The maximum value of the range
+ *
+ * @return the bit width of the given quantized field.
+ */
+Uint8 PhysSyncEvent::getFieldRange(size_t field, float& min, float& max) const {
+    switch (field) {
+        case 0:
+            min = _quant.bounds.origin.x;
+            max = _quant.bounds.origin.x+_quant.bounds.size.width;
+            return _quant.posBits;
+        case 1:
+            min = _quant.bounds.origin.y;
+            max = _quant.bounds.origin.y+_quant.bounds.size.height;
+            return _quant.posBits;
+        case 2:
+        case 3:
+            min = -_quant.maxVel;
+            max = _quant.maxVel;
+            return _quant.velBits;
+        case 4:
+            min = -M_PI;
+            max = M_PI;
+            return _quant.angleBits;
+        default:
+            min = -_quant.maxAngVel;
+            max = _quant.maxAngVel;
+            return _quant.angVelBits;
+    }
+}
+
+/**
+ * Returns the quantized fields of an object snapshot.
+ *
+ * @param param The object snapshot
+ *
+ * @return the quantized fields of an object snapshot.
+ */
+PhysSyncEvent::Quantized PhysSyncEvent::quantize(const Parameters& param) const {
+    float values[NUM_FIELDS] = { param.x, param.y, param.vx, param.vy,
+        std::remainder(param.angle, (float)(2*M_PI)), param.vAngular };
+    Quantized result;
+    float min, max;
+    for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+        Uint8 bits = getFieldRange(ii, min, max);
+        result[ii] = BitSerializer::quantize(values[ii], min, max, bits);
+    }
+    return result;
+}
+
+/**
+ * Returns the object snapshot represented by the quantized fields.
+ *
+ * @param id    The obstacle id
+ * @param q     The quantized fields
+ *
+ * @return the object snapshot represented by the quantized fields.
+ */
+PhysSyncEvent::Parameters PhysSyncEvent::dequantize(Uint64 id, const Quantized& q) const {
+    float values[NUM_FIELDS];
+    float min, max;
+    for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+        Uint8 bits = getFieldRange(ii, min, max);
+        values[ii] = BitDeserializer::dequantize(q[ii], min, max, bits);
+    }
+    Parameters param;
+    param.obsId = id;
+    param.x = values[0];
+    param.y = values[1];
+    param.vx = values[2];
+    param.vy = values[3];
+    param.angle = values[4];
+    param.vAngular = values[5];
+    return param;
+}
+
+/**
+ * Writes the snapshots in the compact encoding to the given serializer.
+ *
+ * The payload starts with a marker byte. The bit stream that follows holds
+ * the sender shortUID, the stream (broadcast or direct), the sequence
+ * number, the distance to the baseline, and the number of objects. Objects
+ * are written in id order. Each id is tagged with its owner, so that most
+ * ids reduce to a small varint. If the baseline has the object, a single
+ * bit marks whether it changed at all, followed by one bit per field. Only
+ * changed fields are written in full.
+ *
+ * @param out   The serializer to write to
+ */
+void PhysSyncEvent::serializeCompact(LWSerializer& out) {
+    _bitSerializer.reset();
+    _bitSerializer.writeBits(_shortUID, 32);
+    _bitSerializer.writeBool(_direct);
+    _bitSerializer.writeVarUint(_sequence);
+    _bitSerializer.writeVarUint(_baseline ? _sequence-_baseline : 0);
+    
+    std::vector<Uint64> ids;
+    ids.reserve(_syncList.size());
+    for (auto it = _syncList.begin(); it != _syncList.end(); it++) {
+        ids.push_back(it->obsId);
+    }
+    std::sort(ids.begin(), ids.end());
+    _bitSerializer.writeVarUint(ids.size());
+    
+    Uint8 bits[NUM_FIELDS];
+    float min, max;
+    for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+        bits[ii] = getFieldRange(ii, min, max);
+    }
+    
+    Uint64 prev = 0;
+    for (auto it = ids.begin(); it != ids.end(); it++) {
+        Uint64 id = *it;
+        Uint32 owner = (Uint32)(id >> 32);
+        Uint32 local = (Uint32)(id & 0xffffffff);
+        if (it != ids.begin() && owner == (Uint32)(prev >> 32)) {
+            _bitSerializer.writeBits(ID_SEQUENTIAL, 2);
+            _bitSerializer.writeVarUint(local-(Uint32)(prev & 0xffffffff)-1, 3);
+        } else if (owner == _shortUID) {
+            _bitSerializer.writeBits(ID_SENDER, 2);
+            _bitSerializer.writeVarUint(local);
+        } else if (owner == INITIAL_OWNER) {
+            _bitSerializer.writeBits(ID_INITIAL, 2);
+            _bitSerializer.writeVarUint(local);
+        } else {
+            _bitSerializer.writeBits(ID_EXPLICIT, 2);
+            _bitSerializer.writeBits(owner, 32);
+            _bitSerializer.writeVarUint(local);
+        }
+        prev = id;
+        
+        const Quantized& q = _snapshot->at(id);
+        auto base = _baseSnapshot ? _baseSnapshot->find(id) : Snapshot::iterator();
+        if (_baseSnapshot && base != _baseSnapshot->end()) {
+            bool changed = q != base->second;
+            _bitSerializer.writeBool(changed);
+            if (changed) {
+                for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+                    bool diff = q[ii] != base->second[ii];
+                    _bitSerializer.writeBool(diff);
+                    if (diff) {
+                        _bitSerializer.writeBits(q[ii], bits[ii]);
+                    }
+                }
+            }
+        } else {
+            for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+                _bitSerializer.writeBits(q[ii], bits[ii]);
+            }
+        }
+    }
+    
+    _bitSerializer.align();
+    const std::vector<std::byte>& body = _bitSerializer.bytes();
+    out.writeByte(std::byte(COMPACT_ENCODING));
+    out.writeBytes(body.data(), body.size());
+}
+
+/**
+ * Decodes a received compact event against its baseline.
+ *
+ * Compact events cannot be fully deserialized on their own, as both the
+ * bit budgets and the baseline are local to the receiver. This method
+ * populates {@link #getSyncList} and {@link #getSnapshot}. The baseline
+ * must be the snapshot with sequence number {@link #getBaseline}, and
+ * should be nullptr if that number is 0.
+ *
+ * @param quant     The bit budgets for quantization
+ * @param baseline  The quantized baseline snapshot
+ *
+ * @return true if the event was successfully decoded
+ */
+bool PhysSyncEvent::decode(const Quantization& quant, const std::shared_ptr<Snapshot>& baseline) {
+    if (!_compact || _snapshot != nullptr) {
+        return true;
+    } else if ((_baseline != 0) != (baseline != nullptr)) {
+        return false;
+    }
+    
+    _quant = quant;
+    _baseSnapshot = baseline;
+    _snapshot = std::make_shared<Snapshot>();
+    _syncList.clear();
+    _obsSet.clear();
+    
+    Uint8 bits[NUM_FIELDS];
+    float min, max;
+    for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+        bits[ii] = getFieldRange(ii, min, max);
+    }
+    
+    Uint64 numObjs = _bitDeserializer.readVarUint();
+    Uint64 prev = 0;
+    for (Uint64 jj = 0; jj < numObjs && !_bitDeserializer.isEmpty(); jj++) {
+        Uint32 owner = 0;
+        Uint32 local = 0;
+        switch (_bitDeserializer.readBits(2)) {
+            case ID_SEQUENTIAL:
+                owner = (Uint32)(prev >> 32);
+                local = (Uint32)(prev & 0xffffffff)+1+(Uint32)_bitDeserializer.readVarUint(3);
+                break;
+            case ID_SENDER:
+                owner = _shortUID;
+                local = (Uint32)_bitDeserializer.readVarUint();
+                break;
+            case ID_INITIAL:
+                owner = INITIAL_OWNER;
+                local = (Uint32)_bitDeserializer.readVarUint();
+                break;
+            default:
+                owner = _bitDeserializer.readBits(32);
+                local = (Uint32)_bitDeserializer.readVarUint();
+                break;
+        }
+        Uint64 id = (((Uint64)owner) << 32) | local;
+        prev = id;
+        
+        Quantized q;
+        auto base = baseline ? baseline->find(id) : Snapshot::iterator();
+        if (baseline && base != baseline->end()) {
+            q = base->second;
+            if (_bitDeserializer.readBool()) {
+                for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+                    if (_bitDeserializer.readBool()) {
+                        q[ii] = _bitDeserializer.readBits(bits[ii]);
+                    }
+                }
+            }
+        } else {
+            for (size_t ii = 0; ii < NUM_FIELDS; ii++) {
+                q[ii] = _bitDeserializer.readBits(bits[ii]);
+            }
+        }
+        
+        (*_snapshot)[id] = q;
+        if (!_obsSet.count(id)) {
+            _obsSet.insert(id);
+            _syncList.push_back(dequantize(id, q));
+        }
+    }
+    _bitDeserializer.reset();
+    return true;
+}
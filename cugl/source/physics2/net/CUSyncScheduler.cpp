@@ -0,0 +1,318 @@
+//
+//  CUSyncScheduler.cpp
+//  Cornell University Game Library (CUGL)
+//
+//  This module provides a priority accumulator for physics synchronization.
+//  Every obstacle accumulates priority each tick, and the physics controller
+//  sends the obstacles with the highest priority that fit in its budget.
+//
+//  This class uses our standard shared-pointer architecture.
+//
+//  1. The constructor does not perform any initialization; it just sets all
+//     attributes to their defaults.
+//
+//  2. All initialization takes place via init methods, which can fail if an
+//     object is initialized more than once.
+//
+//  3. All allocation takes place via static constructors which return a shared
+//     pointer.
+//
+//  CUGL MIT License:
+//      This software is provided 'as-is', without any express or implied
+//      warranty.  In no event will the authors be held liable for any damages
+//      arising from the use of this software.
+//
+//      Permission is granted to anyone to use this software for any purpose,
+//      including commercial applications, and to alter it and redistribute it
+//      freely, subject to the following restrictions:
+//
+//      1. The origin of this software must not be misrepresented; you must not
+//      claim that you wrote the original software. If you use this software
+//      in a product, an acknowledgment in the product documentation would be
+//      appreciated but is not required.
+//
+//      2. Altered source versions must be plainly marked as such, and must not
+//      be misrepresented as being the original software.
+//
+//      3. This notice may not be removed or altered from any source distribution.
+//
+//  Author: Barry Lyu
+//  Version: 11/13/23
+//
+#include <cugl/physics2/net/CUSyncScheduler.h>
+#include <algorithm>
+
+/** The default priority weight of the obstacle speed */
+#define DEFAULT_VEL_WEIGHT      1.0f
+/** The default priority weight of the extrapolation error */
+#define DEFAULT_ERROR_WEIGHT    10.0f
+/** The default priority weight of the proximity to the players */
+#define DEFAULT_DIST_WEIGHT     5.0f
+/** The default priority gained by every obstacle each tick */
+#define DEFAULT_AGE_WEIGHT      0.1f
+
+using namespace cugl;
+using namespace cugl::physics2;
+using namespace cugl::physics2::net;
+
+#pragma mark -
+#pragma mark Constructors
+/**
+ * Creates an empty scheduler with default weights.
+ *
+ * NEVER USE A CONSTRUCTOR WITH NEW. If you want to allocate an object on
+ * the heap, use one of the static constructors instead.
+ */
+SyncScheduler::SyncScheduler() :
+_tick(0),
+_seenCount(0),
+_dt(0),
+_velWeight(DEFAULT_VEL_WEIGHT),
+_errorWeight(DEFAULT_ERROR_WEIGHT),
+_distWeight(DEFAULT_DIST_WEIGHT),
+_ageWeight(DEFAULT_AGE_WEIGHT) {
+}
+
+/**
+ * Disposes the scheduler, releasing all resources.
+ *
+ * This scheduler can be safely reinitialized
+ */
+void SyncScheduler::dispose() {
+    clear();
+    _velWeight = DEFAULT_VEL_WEIGHT;
+    _errorWeight = DEFAULT_ERROR_WEIGHT;
+    _distWeight = DEFAULT_DIST_WEIGHT;
+    _ageWeight = DEFAULT_AGE_WEIGHT;
+}
+
+/**
+ * Initializes an empty scheduler with default weights.
+ *
+ * @return true if the scheduler was initialized successfully
+ */
+bool SyncScheduler::init() {
+    clear();
+    return true;
+}
+
+#pragma mark -
+#pragma mark Heap Internals
+/**
+ * Swaps two heap entries, updating the index.
+ *
+ * @param a The position of the first entry
+ * @param b The position of the second entry
+ */
+void SyncScheduler::swapEntries(size_t a, size_t b) {
+    std::swap(_heap[a],_heap[b]);
+    _index[_heap[a].id] = a;
+    _index[_heap[b].id] = b;
+}
+
+/**
+ * Moves an entry up the heap until its parent has higher priority.
+ *
+ * @param pos   The position of the entry
+ */
+void SyncScheduler::siftUp(size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos-1)/2;
+        if (_heap[parent].priority >= _heap[pos].priority) {
+            return;
+        }
+        swapEntries(pos,parent);
+        pos = parent;
+    }
+}
+
+/**
+ * Moves an entry down the heap until its children have lower priority.
+ *
+ * @param pos   The position of the entry
+ */
+void SyncScheduler::siftDown(size_t pos) {
+    size_t size = _heap.size();
+    while (true) {
+        size_t best = pos;
+        size_t left = 2*pos+1;
+        size_t rght = left+1;
+        if (left < size && _heap[left].priority > _heap[best].priority) {
+            best = left;
+        }
+        if (rght < size && _heap[rght].priority > _heap[best].priority) {
+            best = rght;
+        }
+        if (best == pos) {
+            return;
+        }
+        swapEntries(pos,best);
+        pos = best;
+    }
+}
+
+/**
+ * Removes the entry at the given heap position.
+ *
+ * @param pos   The position of the entry
+ */
+void SyncScheduler::removeAt(size_t pos) {
+    size_t last = _heap.size()-1;
+    _index.erase(_heap[pos].id);
+    if (pos == last) {
+        _heap.pop_back();
+        return;
+    }
+    
+    Uint64 moved = _heap[last].id;
+    _heap[pos] = _heap[last];
+    _index[moved] = pos;
+    _heap.pop_back();
+    siftUp(pos);
+    siftDown(_index[moved]);
+}
+
+#pragma mark -
+#pragma mark Scheduling
+/**
+ * Starts a new scheduling tick.
+ *
+ * This should be followed by a call to {@link #update} for each obstacle
+ * that may be sent, and then by {@link #endTick}.
+ *
+ * @param dt    The time since the previous tick in seconds
+ */
+void SyncScheduler::beginTick(float dt) {
+    _tick++;
+    _seenCount = 0;
+    _dt = dt;
+}
+
+/**
+ * Accumulates priority for an obstacle.
+ *
+ * The obstacle is added to the scheduler if it is not already present.
+ *
+ * @param id    The obstacle id
+ * @param obs   The obstacle
+ * @param focus The positions of the players
+ */
+void SyncScheduler::update(Uint64 id, const std::shared_ptr<physics2::Obstacle>& obs,
+                           const std::vector<Vec2>& focus) {
+    Vec2 pos = obs->getPosition();
+    Vec2 vel = obs->getLinearVelocity();
+    
+    auto it = _index.find(id);
+    size_t index;
+    if (it == _index.end()) {
+        Entry entry;
+        entry.id = id;
+        entry.priority = 0;
+        entry.sentPos = pos;
+        entry.sentVel = vel;
+        entry.elapsed = 0;
+        entry.seen = 0;
+        index = _heap.size();
+        _heap.push_back(entry);
+        _index[id] = index;
+    } else {
+        index = it->second;
+    }
+    
+    Entry& entry = _heap[index];
+    entry.pos = pos;
+    entry.vel = vel;
+    entry.elapsed += _dt;
+    if (entry.seen != _tick) {
+        entry.seen = _tick;
+        _seenCount++;
+    }
+    
+    float error = (pos-(entry.sentPos+entry.sentVel*entry.elapsed)).length();
+    float nearest = -1;
+    for(auto jt = focus.begin(); jt != focus.end(); ++jt) {
+        float d = pos.distance(*jt);
+        nearest = nearest < 0 ? d : std::min(nearest,d);
+    }
+    float proximity = nearest < 0 ? 0 : 1/(1+nearest);
+    
+    entry.priority += _velWeight*vel.length()+_errorWeight*error+_distWeight*proximity+_ageWeight;
+    siftUp(index);
+}
+
+/**
+ * Ends the current scheduling tick.
+ *
+ * Any obstacle that was not updated this tick is assumed to be removed
+ * from the world, and is dropped from the scheduler.
+ */
+void SyncScheduler::endTick() {
+    if (_seenCount == _heap.size()) {
+        return;
+    }
+    std::vector<Uint64> stale;
+    for(auto it = _heap.begin(); it != _heap.end(); ++it) {
+        if (it->seen != _tick) {
+            stale.push_back(it->id);
+        }
+    }
+    for(auto it = stale.begin(); it != stale.end(); ++it) {
+        remove(*it);
+    }
+}
+
+/**
+ * Appends the ids of the obstacles with the highest priority.
+ *
+ * These obstacles are marked as sent, so their priority is reset to zero
+ * and their current state becomes the basis of the extrapolation error.
+ *
+ * @param count     The maximum number of obstacles to schedule
+ * @param result    The vector to append the ids to
+ */
+void SyncScheduler::schedule(size_t count, std::vector<Uint64>& result) {
+    count = std::min(count,_heap.size());
+    if (count == 0) {
+        return;
+    }
+    
+    // Pop every entry before reinserting, so no entry is picked twice
+    std::vector<Entry> sent;
+    sent.reserve(count);
+    for(size_t ii = 0; ii < count; ii++) {
+        sent.push_back(_heap[0]);
+        removeAt(0);
+    }
+    for(auto it = sent.begin(); it != sent.end(); ++it) {
+        it->priority = 0;
+        it->sentPos = it->pos;
+        it->sentVel = it->vel;
+        it->elapsed = 0;
+        result.push_back(it->id);
+        _index[it->id] = _heap.size();
+        _heap.push_back(*it);
+    }
+}
+
+/**
+ * Removes an obstacle from the scheduler.
+ *
+ * @param id    The obstacle id
+ */
+void SyncScheduler::remove(Uint64 id) {
+    auto it = _index.find(id);
+    if (it != _index.end()) {
+        removeAt(it->second);
+    }
+}
+
+/**
+ * Removes all obstacles from the scheduler.
+ */
+void SyncScheduler::clear() {
+    _heap.clear();
+    _index.clear();
+    _tick = 0;
+    _seenCount = 0;
+    _dt = 0;
+}
@@ -115,7 +115,7 @@ public:
     
     void increaseHealth(int inc_health){
         _health += inc_health;
-        _maxHealth = max(_maxHealth,_health);
+        _maxHealth = std::max(_maxHealth,_health);
 //        float dim = (float) _health/6.0 + 1.0;
 //        cugl::Size nxtSize(dim,dim);
 //        setDimension(nxtSize);
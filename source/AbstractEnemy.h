@@ -23,11 +23,9 @@
 #define PATHFIND_COOLDOWN 20
 
 
-#define CLOSE_DISTANCE 2
 #define STRAY_DISTANCE 3
 
-#include "stlastar.h"
-#include "WorldSearchVertex.h"
+#include "PathService.h"
 
 class AbstractEnemy : public cugl::physics2::BoxObstacle {
     
@@ -61,7 +59,6 @@ public:
             targetIndex = m_targetIndex;
             _prevDirection =AnimationSceneNode::Directions::EAST;
             _curDirection = AnimationSceneNode::Directions::EAST;
-            _pathfinder = std::make_shared<AStarSearch<WorldSearchVertex>>();
             
             return true;
         }
@@ -120,6 +117,19 @@ public:
         return target_pos;
     }
     
+    // Walks around walls using the shared flow field of the current target,
+    // heading straight for target_pos when there is no field to follow
+    cugl::Vec2 getSteeringDirection(OverWorld& overWorld, cugl::Vec2 target_pos){
+        const std::shared_ptr<FlowFieldController>& flowFields = overWorld.getFlowFields();
+        if (flowFields != nullptr){
+            cugl::Vec2 step = flowFields->getDirection(getTargetIndex(), getPosition());
+            if (!step.isZero()){
+                return step;
+            }
+        }
+        return target_pos - getPosition();
+    }
+    
     void setHealthBar(std::shared_ptr<cugl::scene2::ProgressBar> bar){
         _healthBar = bar;
         _healthBar->setScale(0.1);
@@ -148,6 +158,10 @@ public:
         return topLevelPlaceHolder;
     }
     
+    void setPathService(const std::shared_ptr<PathService>& paths){
+        _paths = paths;
+    }
+    
 protected:
     int _maxHealth;
     int _health;
@@ -155,8 +169,8 @@ protected:
     int updateRate;
     int _counter;
     
-    /** The next step along the enemy's path */
-    Vec2 _nextStep = Vec2(-1, -1);
+    /** The index of the next tile along the enemy's path */
+    size_t _pathIndex = 0;
     
     EnemyActions curAction;
     AnimationSceneNode::Directions _prevDirection;
@@ -164,7 +178,8 @@ protected:
     std::shared_ptr<cugl::scene2::SceneNode> topLevelPlaceHolder;
     std::shared_ptr<AnimationSceneNode> runAnimations;
     std::shared_ptr<AnimationSceneNode> attackAnimations;
-    std::shared_ptr<AStarSearch<WorldSearchVertex>> _pathfinder;
+    std::shared_ptr<PathService> _paths;
+    std::shared_ptr<const Path> _path;
     
     /** The health  bar */
     std::shared_ptr<cugl::scene2::ProgressBar>  _healthBar;
@@ -172,149 +187,57 @@ protected:
     /** Timers */
     int _pathfindTimer = PATHFIND_COOLDOWN;
     
-    /** Sets a new goal for this enemy to go to. Returns true if pathfinding to the goal was successful */
-    bool setGoal(Vec2 goal, std::shared_ptr<World> world){
-        
-        // If we already pathfound recently, don't path find again
-        if(_pathfindTimer < PATHFIND_COOLDOWN){
-            return searchSuccess();
-        }
-        
-        // Garbage collect the nodes used for the previous path if they exist
-        if(_pathfinder->GetSolutionEnd() && _pathfinder->SearchStep() == AStarSearch<WorldSearchVertex>::SEARCH_STATE_SUCCEEDED){
-//            CULog("Garbage Collecting Path...");
-            _pathfinder->FreeSolutionNodes();
-        }
-        
-        cugl::Vec2 my_pos = getPosition();
-        
-        // Initialize start and end for the search
-        WorldSearchVertex start = WorldSearchVertex(static_cast<int>(my_pos.x), static_cast<int>(my_pos.y), world);
-        WorldSearchVertex end = WorldSearchVertex(static_cast<int>(goal.x), static_cast<int>(goal.y), world);
-        _pathfinder->SetStartAndGoalStates(start, end);
-        
-        // Perform the search
-        unsigned int SearchState = _pathfinder->SearchStep();
-        while( SearchState == AStarSearch<WorldSearchVertex>::SEARCH_STATE_SEARCHING )
-        {
-            SearchState = _pathfinder->SearchStep();
-        }
-        
-        // Check if the search was successful
-        if( SearchState == AStarSearch<WorldSearchVertex>::SEARCH_STATE_SUCCEEDED ){
-            
-//            CULog("Found Solution from (%d, %d) to (%d, %d)", start.x, start.y, end.x, end.y);
-            
-            _pathfinder->GetSolutionStart();
-            WorldSearchVertex* nextNode = _pathfinder->GetSolutionNext();
-            
-            if(nextNode){
-                _nextStep = Vec2((int) nextNode->x, (int) nextNode->y);
-            } else{
-                _nextStep = my_pos;
-            }
-            
-            return true;
+    /** Requests a path to the goal from the shared path service, unless the current path already leads there */
+    void setGoal(Vec2 goal){
+        if(_paths == nullptr){
+            return;
         }
         
-        if( SearchState == AStarSearch<WorldSearchVertex>::SEARCH_STATE_FAILED ){
-            CULog("Search Failed");
+        bool sameGoal = _path && _path->goalX == (int)std::floor(goal.x) && _path->goalY == (int)std::floor(goal.y);
+        if(sameGoal && _path->state != Path::State::FAILED && !_path->outdated){
+            return;
         }
         
-        if( SearchState == AStarSearch<WorldSearchVertex>::SEARCH_STATE_OUT_OF_MEMORY ){
-            CULog("Search Out of Memory");
+        // If we asked for a path recently, don't ask again
+        if(_pathfindTimer < PATHFIND_COOLDOWN){
+            _pathfindTimer++;
+            return;
         }
-        
-        return false;
+        _pathfindTimer = 0;
+        _path = _paths->request(getPosition(), goal);
+        _pathIndex = 0;
     };
     
-    /** Goes towards the goal. If there is no goal, do nothing. */
-    void goToGoal(){
-        
-        // Get the goal
-        WorldSearchVertex* goalNode = _pathfinder->GetSolutionEnd();
-        cugl::Vec2 direction;
-        
-        // If there is no goal or we are already at the goal, do nothing
-        if(!goalNode || atGoal() || _nextStep.x == -1){
-            return;
+    /** Sets direction toward the next tile of the path. Returns false if there is no path to follow (yet) */
+    bool followPath(cugl::Vec2& direction){
+        if(!_path || !_path->isReady()){
+            return false;
         }
         
-        Vec2 goalTile = Vec2(goalNode->x + 0.5, goalNode->y + 0.5);
-        
-        // If we are very close to the goal, go directly to it instead of using pathfinding
-        if(getPosition().distance(goalTile) < CLOSE_DISTANCE){
-            direction = goalTile - getPosition();
-        }
-        else {
-            
-            // If we strayed too far from the pathfinding path, restart pathfinding
-            Vec2 nextTile = Vec2(_nextStep.x + 0.5, _nextStep.y + 0.5);
-            if(getPosition().distance(nextTile) > STRAY_DISTANCE){
-                CULog("Recalculating Path...");
-                setGoal(Vec2(goalNode->x, goalNode->y), goalNode->_world);
+        // Skip past the tile we are on (diagonal corners can skip a tile or two)
+        const std::vector<Vec2>& tiles = _path->tiles;
+        Vec2 tile = Vec2(std::floor(getX()), std::floor(getY()));
+        for(size_t ii = _pathIndex; ii < tiles.size() && ii < _pathIndex + 3; ii++){
+            if(tiles[ii] == tile){
+                _pathIndex = ii + 1;
             }
-            
-            // If we already reached the next tile, get the next node along the path and set it as the next tile
-            if(atTile(_nextStep)){
-                
-                WorldSearchVertex* nextNode = _pathfinder->GetSolutionNext();
-                
-                if(nextNode){
-                    _nextStep = Vec2((int) nextNode->x, (int) nextNode->y);
-                } else{
-                    return;
-                }
-            
-            }
-            
-            direction = _nextStep - getPosition();
         }
         
-        //Move towards the next tile
-        setVX(direction.normalize().x * 0.5);
-        setVY(direction.normalize().y * 0.5);
-        setX(getX());
-        setY(getY());
-        _prevDirection =_curDirection;
-        _curDirection = AnimationSceneNode::convertRadiansToDirections(direction.getAngle());
-        
-        
-        
-        
-        
-        // If we have been stuck on the same tile for too long, move randomly and then restart pathfinding
-        
-    };
-    
-    /** Returns whether the enemy is at its goal */
-    bool atGoal(){
-        // Get the goal
-        WorldSearchVertex* goalNode = _pathfinder->GetSolutionEnd();
-        
-        Vec2 goal = Vec2(goalNode->x, goalNode->y);
-        
-        return atTile(goal);
-    };
-    
-    /** Returns whether the enemy is on the given tile , i. e. close  to its center. Tiles should have integer coordinates*/
-    bool atTile(Vec2 tile){
-        
-        // Get the center of the tile
-        Vec2 tileCenter = Vec2(tile.x + 0.5, tile.y + 0.5);
+        // At the goal tile, the caller heads straight for the goal
+        if(_pathIndex >= tiles.size()){
+            return false;
+        }
         
-        // Check if the enemy position is close to the center
-        if(getPosition().distance(tileCenter) < 0.05 ){
-            return true;
-        };
+        // If we strayed too far from the path, drop it so the next setGoal asks again
+        Vec2 nextTile = tiles[_pathIndex] + Vec2(0.5, 0.5);
+        if(getPosition().distance(nextTile) > STRAY_DISTANCE){
+            _path = nullptr;
+            return false;
+        }
         
-        return false;
+        direction = nextTile - getPosition();
+        return true;
     };
     
-    /** Returns whether the last pathfind was successful */
-    bool searchSuccess(){
-        return _pathfinder->GetSolutionEnd() && _pathfinder->SearchStep() == AStarSearch<WorldSearchVertex>::SEARCH_STATE_SUCCEEDED;
-    }
-    
 };
 #endif /* AbstractEnemy_h */
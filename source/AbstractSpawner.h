@@ -66,7 +66,7 @@ public:
         return _position; }
     void subHealth(const int val) {
         _health -= val;
-        cout << _health;
+        std::cout << _health;
     }
     bool dead(){
         return _health <= 0;
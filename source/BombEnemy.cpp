@@ -141,7 +141,7 @@ void BombEnemy::preUpdate(float dt, OverWorld& overWorld){
         _counter++;
     }
     cugl::Vec2 target_pos = getTargetPositionFromIndex(overWorld);
-    cugl::Vec2 direction = target_pos - getPosition();
+    cugl::Vec2 direction = getSteeringDirection(overWorld, target_pos);
     if (overWorld._isHost && _counter >= updateRate){
         setVX(direction.normalize().x * 0.5);
         setVY(direction.normalize().y * 0.5);
@@ -73,11 +73,10 @@ bool withinAngle(float ang1, float ang2, float degrees){
     return a <= N || N <= b;
 }
 void CollisionController::overWorldMonsterControllerCollisions(OverWorld& overWorld, MonsterController& monsterController){
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& monsterEnemies = monsterController.getEnemies();
-    if (monsterDogCollision(overWorld.getDog(), monsterEnemies)){
+    if (monsterDogCollision(overWorld.getDog(), monsterController)){
 //         CULog("MONSTER DOG COLLISION DETECTED\n");
     }
-    if (monsterDecoyCollision(overWorld.getDecoys(), monsterEnemies)){
+    if (monsterDecoyCollision(overWorld.getDecoys(), monsterController)){
 //         CULog("MONSTER DECOY COLLISION DETECTED\n");
     }
     if (monsterDecoyExplosionCollision(overWorld.getDecoys(), monsterController)){
@@ -127,167 +126,113 @@ void CollisionController::attackCollisions(OverWorld& overWorld, MonsterControll
     }
 }
 bool CollisionController::monsterBaseCollsion(OverWorld& overWorld, std::shared_ptr<BaseSet> curBases, MonsterController& monsterController){
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies = monsterController.getEnemies();
+    const SpatialHash& index = monsterController.getEnemyIndex();
     bool collision = false;
     float baseRadius = DEFAULT_RADIUS_COLLIDE;
-    auto itP = curBases->_bases.begin();
-    while (itP != curBases->_bases.end()){
-        std::shared_ptr<Base> base = *itP;
-        auto itA = curEnemies.begin();
+    for (const std::shared_ptr<Base>& base : curBases->_bases){
         bool hitSomething = false;
-        while ( itA != curEnemies.end()){
-            const std::shared_ptr<AbstractEnemy>& enemy = *itA;
+        _candidates.clear();
+        index.queryRadius(base->getPos(), baseRadius, _candidates);
+        for (const SpatialHash::Entry* entry : _candidates){
+            const std::shared_ptr<AbstractEnemy>& enemy = entry->enemy;
             float enemyRadius = fmin(enemy->getWidth(), enemy->getHeight())/2;
-            Vec2 norm = base->getPos() - enemy->getPosition();
-            float distance = norm.length();
-            float impactDistance = baseRadius + enemyRadius;
-            auto curA = itA;
-            itA++;
-            if (distance < impactDistance) {
-                hitSomething = true;
-                collision = true;
-                monsterController.removeEnemy(enemy);
-                enemy->executeDeath(overWorld);
-                curEnemies.erase(curA);
+            if (monsterController.isRemoved(enemy) ||
+                !SpatialHash::isWithin(base->getPos(), entry->pos, baseRadius + enemyRadius)){
+                continue;
             }
+            hitSomething = true;
+            collision = true;
+            monsterController.removeEnemy(enemy);
+            enemy->executeDeath(overWorld);
         }
-        auto curP = itP++;
         if (hitSomething){
-            CULog("Base Health %d", (*curP)->getHealth());
-            (*curP)->reduceHealth(5);
+            CULog("Base Health %d", base->getHealth());
+            base->reduceHealth(5);
         }
     }
     return collision;
 }
-bool CollisionController::monsterDecoyCollision(std::shared_ptr<DecoySet> decoySet, std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies){
+bool CollisionController::monsterDecoyCollision(std::shared_ptr<DecoySet> decoySet, MonsterController& monsterController){
+    const SpatialHash& index = monsterController.getEnemyIndex();
     bool collide = false;
-    std::vector<std::shared_ptr<Decoy>> decoys = decoySet->getCurrentDecoys();
-//    std::vector<std::shared_ptr<Decoy>> removedDecoys = decoySet->getRemovedDecoys();
-    for (std::shared_ptr<Decoy> curDecoy: decoys){
-        float decoyRadius = DEFAULT_RADIUS_COLLIDE;
-        for (std::shared_ptr<AbstractEnemy> enemy: curEnemies){
-            Vec2 norm = curDecoy->getPos() - enemy->getPosition();
+    float decoyRadius = DEFAULT_RADIUS_COLLIDE;
+    for (const std::shared_ptr<Decoy>& curDecoy: decoySet->getCurrentDecoys()){
+        _candidates.clear();
+        index.queryRadius(curDecoy->getPos(), decoyRadius, _candidates);
+        for (const SpatialHash::Entry* entry : _candidates){
+            const std::shared_ptr<AbstractEnemy>& enemy = entry->enemy;
             float enemyRadius = fmin(enemy->getWidth(), enemy->getHeight())/2;
-            float distance = norm.length();
-            float impactDistance = decoyRadius + enemyRadius;
-            if (distance < impactDistance){ // need noise
-                if (enemy->canAttack()){
-                    collide = true;
-                    enemy->resetAttack();
-                    curDecoy->subHealth(enemy->getDamage());
-                }
+            if (monsterController.isRemoved(enemy) ||
+                !SpatialHash::isWithin(curDecoy->getPos(), entry->pos, decoyRadius + enemyRadius)){
+                continue;
+            }
+            if (enemy->canAttack()){ // need noise
+                collide = true;
+                enemy->resetAttack();
+                curDecoy->subHealth(enemy->getDamage());
             }
         }
     }
-//    auto itDec = removedDecoys.begin();
-//    auto itMon = curEnemies.begin();
-//    float decoyRadius = 0.26f;
-//    while (itDec != removedDecoys.end()){
-//        const std::shared_ptr<Decoy>& decoy= *itDec;
-//        auto curDec = itDec;
-//        itDec++;
-//        while(itMon != curEnemies.end()){
-//            const std::shared_ptr<AbstractEnemy>& enemy = *itMon;
-//            auto curMon = itMon;
-//            itMon++;
-//            Vec2 norm = decoy->getPos() - enemy->getPosition();
-//            float enemyRadius = fmin(enemy->getWidth(), enemy->getHeight())/2;
-//            float distance = norm.length();
-//            float impactDistance = decoyRadius + enemyRadius;
-//            if (distance < impactDistance){ // need noise
-//                collide = true;
-//                curEnemies.erase(enemy);
-//            }
-//        }
-//    }
     return collide;
 }
 bool CollisionController::monsterDecoyExplosionCollision(std::shared_ptr<DecoySet> decoySet, MonsterController& monsterController){
+    const SpatialHash& index = monsterController.getEnemyIndex();
     bool collide = false;
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies = monsterController.getEnemies();
-    std::vector<std::shared_ptr<Decoy>> removedDecoys = decoySet->getRemovedDecoys();
-    
-    auto itDec = removedDecoys.begin();
-    auto itMon = curEnemies.begin();
     float decoyRadius = 2.00f;
-    while (itDec != removedDecoys.end()){
-        const std::shared_ptr<Decoy>& decoy= *itDec;
-        auto curDec = itDec;
-        itDec++;
-        while(itMon != curEnemies.end()){
-            const std::shared_ptr<AbstractEnemy>& enemy = *itMon;
-            auto curMon = itMon;
-            itMon++;
-            Vec2 norm = decoy->getPos() - enemy->getPosition();
+    for (const std::shared_ptr<Decoy>& decoy : decoySet->getRemovedDecoys()){
+        _candidates.clear();
+        index.queryRadius(decoy->getPos(), decoyRadius, _candidates);
+        for (const SpatialHash::Entry* entry : _candidates){
+            const std::shared_ptr<AbstractEnemy>& enemy = entry->enemy;
             float enemyRadius = fmin(enemy->getWidth(), enemy->getHeight())/2;
-            float distance = norm.length();
-            float impactDistance = decoyRadius + enemyRadius;
-            if (distance < impactDistance){ // need noise
-                collide = true;
-                monsterController.removeEnemy(enemy);
-                curEnemies.erase(curMon);
+            if (monsterController.isRemoved(enemy) ||
+                !SpatialHash::isWithin(decoy->getPos(), entry->pos, decoyRadius + enemyRadius)){
+                continue;
             }
+            collide = true; // need noise
+            monsterController.removeEnemy(enemy);
         }
     }
     return collide;
 }
-bool CollisionController::monsterDogCollision(std::shared_ptr<Dog> curDog, std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies){
+bool CollisionController::monsterDogCollision(std::shared_ptr<Dog> curDog, MonsterController& monsterController){
+    const SpatialHash& index = monsterController.getEnemyIndex();
     float dogRadius = fmax(curDog->getWidth(), curDog->getHeight())/2;
     bool collision = false;
-    auto it = curEnemies.begin();
-    while (it != curEnemies.end()){
-        std::shared_ptr<AbstractEnemy> enemy = *it;
-        float enemyRadius = fmax(enemy->getWidth(), enemy->getHeight())/2;
-        Vec2 norm = curDog->getPosition() - enemy->getPosition();
-        float distance = norm.length();
-        float impactDistance = dogRadius + enemyRadius + BUFFER;
-        it++;
-        if (distance < impactDistance) {
-            if (enemy->canAttack()){
-                collision = true;
-                enemy->resetAttack();
-                curDog->setHealth(curDog->getHealth()-enemy->getDamage());
-            }else{
-            }
+    _candidates.clear();
+    // entry radius is already fmax(width, height)/2
+    index.queryRadius(curDog->getPosition(), dogRadius + BUFFER, _candidates);
+    for (const SpatialHash::Entry* entry : _candidates){
+        const std::shared_ptr<AbstractEnemy>& enemy = entry->enemy;
+        if (!monsterController.isRemoved(enemy) && enemy->canAttack()){
+            collision = true;
+            enemy->resetAttack();
+            curDog->setHealth(curDog->getHealth()-enemy->getDamage());
         }
     }
     return collision;
-    
-    
-    return false;
 }
 
 void CollisionController::resolveBiteAttack(const std::shared_ptr<ActionPolygon>& action, MonsterController& monsterController, OverWorld& overWorld){
-    Poly2 bitePolygon = action->getPolygon();
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& monsterEnemies = monsterController.getEnemies();
-    auto itA = monsterEnemies.begin();
-    bool hitSomething = false;
-    while ( itA != monsterEnemies.end()){
-        const std::shared_ptr<AbstractEnemy>& enemy = *itA;
-        auto curA = itA;
-        itA++;
-        
-        Vec2 diff = enemy->getPosition() - action->getCenter();
-        float ang = diff.getAngle();
-        float result = ((ang > 0 ? ang : (2*M_PI +ang)) * 360 / (2*M_PI)) - 90.0f;
-        if (result < 0.0f){
-            result += 360.0f;
+    // The frame decides the damage, not the enemy
+    if (!action->dealDamage()){
+        return;
+    }
+    // The bite covers the half circle from angle to angle+180 degrees
+    float facing = (action->getAngle() + 90.0f) * M_PI / 180.0f;
+    _candidates.clear();
+    monsterController.getEnemyIndex().querySector(action->getCenter(), 3 * action->getScale(),
+                                                  Vec2(cosf(facing), sinf(facing)), M_PI_2, _candidates);
+    for (const SpatialHash::Entry* entry : _candidates){
+        const std::shared_ptr<AbstractEnemy>& enemy = entry->enemy;
+        if (monsterController.isRemoved(enemy)){
+            continue;
         }
-        float dist = diff.length();
-//        if (dist <= 3 && action->dealDamage()){
-//            CULog("%s %f",diff.toString().data(), result);
-////            CULog("Attack Angle: %f, angle enemy %f %d",action->getAngle(), ang, withinAngle(action->getAngle()-90.0f, ang, 180.0f));
-////            CULog("%f, %f %f %s %s", dist, ang, diff.getAngle(), enemy->getPosition().toString().data(), action->getCenter().toString().data());
-//        }
-        if (withinAngle(action->getAngle()-90.0f, result, 180.0f) && dist <= 3 * action->getScale() && action->dealDamage()){
-            hitSomething = true;
-            enemy->setHealth(enemy->getHealth() - 1);
-            if(enemy->getHealth() <= 0){
-                monsterController.removeEnemy(enemy);
-                enemy->executeDeath(overWorld);
-                overWorld.getDog()->addAbsorb((*curA)->getAbsorbValue());
-                monsterEnemies.erase(curA);
-            }
+        enemy->setHealth(enemy->getHealth() - 1);
+        if(enemy->getHealth() <= 0){
+            monsterController.removeEnemy(enemy);
+            enemy->executeDeath(overWorld);
+            overWorld.getDog()->addAbsorb(enemy->getAbsorbValue());
         }
     }
 }
@@ -312,30 +257,22 @@ bool CollisionController::healFromBaseCollsion( BaseSet& bset, std::shared_ptr<D
     return false;
 }
 void CollisionController::hugeBlastCollision(const std::shared_ptr<ActionPolygon>& action, MonsterController& monsterController){
-    Poly2 blastRectangle = action->getPolygon();
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& enemies = monsterController.getEnemies();
-    auto itA = enemies.begin();
-    while (itA != enemies.end()){
-        const std::shared_ptr<AbstractEnemy>& enemy = *itA;
-        Vec2 enemyPos = enemy->getPosition();
-        auto curA = itA;
-        itA++;
-        if (blastRectangle.contains(enemyPos)){
-            monsterController.removeEnemy(enemy);
-            enemies.erase(curA);
+    const Poly2& blastRectangle = action->getPolygon();
+    _candidates.clear();
+    monsterController.getEnemyIndex().queryRect(blastRectangle.getBounds(), _candidates);
+    for (const SpatialHash::Entry* entry : _candidates){
+        if (blastRectangle.contains(entry->pos)){
+            monsterController.removeEnemy(entry->enemy);
         }
     }
 }
 void CollisionController::resolveBlowup(const std::shared_ptr<ActionPolygon>& action, MonsterController& monsterController, std::unordered_set<std::shared_ptr<AbstractSpawner>>& spawners){
-    Poly2 blastCircle = action->getPolygon();
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& monsterEnemies = monsterController.getEnemies();
-    auto itA = monsterEnemies.begin();
-    while (itA != monsterEnemies.end()){
-        const std::shared_ptr<AbstractEnemy>& enemy = *itA;
-        auto curA = itA++;
-        if (blastCircle.contains(enemy->getPosition())){
-            monsterController.removeEnemy(enemy);
-            monsterEnemies.erase(curA);
+    const Poly2& blastCircle = action->getPolygon();
+    _candidates.clear();
+    monsterController.getEnemyIndex().queryRect(blastCircle.getBounds(), _candidates);
+    for (const SpatialHash::Entry* entry : _candidates){
+        if (blastCircle.contains(entry->pos)){
+            monsterController.removeEnemy(entry->enemy);
         }
     }
     auto itS = spawners.begin();
@@ -353,36 +290,33 @@ void CollisionController::resolveBlowup(const std::shared_ptr<ActionPolygon>& ac
 }
 
 bool CollisionController::absorbEnemMonsterCollision(MonsterController& monsterController, std::unordered_set<std::shared_ptr<AbsorbEnemy>>& absorbCurEnemies){
+    const SpatialHash& index = monsterController.getEnemyIndex();
     bool collision = false;
-    std::unordered_set<std::shared_ptr<AbstractEnemy>>& monsterEnemies = monsterController.getEnemies();
-    
-    auto itAbs = absorbCurEnemies.begin();
-    auto itMon = monsterEnemies.begin();
-    while (itAbs != absorbCurEnemies.end()){
-        const std::shared_ptr<AbsorbEnemy>& absEnemy = *itAbs;
-        auto curAbs = itAbs;
-        itAbs++;
-        while(itMon != monsterEnemies.end()){
-            const std::shared_ptr<AbstractEnemy>& curEnemy = *itMon;
-            auto curMon = itMon;
-            itMon++;
-            Vec2 norm = (absEnemy)->getPosition() - (curEnemy)->getPosition();
-            float distance = norm.length();
-            float impactDistance = 1.5;
-            if (distance < impactDistance){
-                std::shared_ptr<AbsorbEnemy> isAbsorb = std::dynamic_pointer_cast<AbsorbEnemy>(curEnemy);
-                if (isAbsorb == nullptr && absEnemy->canAttack()){
-                    collision = true;
-                    absEnemy->resetAttack();
-                    absEnemy->increaseHealth(curEnemy->getHealth());
-                    // SCALE ABSORB ENEMY
-//                    float newWidth = (*curAbs)->getDimension().width + 0.02;
-//                    float newHeight = (*curAbs)->getDimension().height + 0.02;
-//                    cugl::Size newSize(newWidth,newHeight);
-//                    (*curAbs)->setDimension(newSize);
-                    monsterController.removeEnemy(curEnemy);
-                    monsterEnemies.erase(curMon);
-                }
+    float impactDistance = 1.5;
+    for (const std::shared_ptr<AbsorbEnemy>& absEnemy : absorbCurEnemies){
+        if (monsterController.isRemoved(absEnemy)){
+            continue;
+        }
+        Vec2 absPos = absEnemy->getPosition();
+        _candidates.clear();
+        index.queryRadius(absPos, impactDistance, _candidates);
+        for (const SpatialHash::Entry* entry : _candidates){
+            const std::shared_ptr<AbstractEnemy>& curEnemy = entry->enemy;
+            if (monsterController.isRemoved(curEnemy) ||
+                !SpatialHash::isWithin(absPos, entry->pos, impactDistance)){
+                continue;
+            }
+            std::shared_ptr<AbsorbEnemy> isAbsorb = std::dynamic_pointer_cast<AbsorbEnemy>(curEnemy);
+            if (isAbsorb == nullptr && absEnemy->canAttack()){
+                collision = true;
+                absEnemy->resetAttack();
+                absEnemy->increaseHealth(curEnemy->getHealth());
+                // SCALE ABSORB ENEMY
+//                float newWidth = absEnemy->getDimension().width + 0.02;
+//                float newHeight = absEnemy->getDimension().height + 0.02;
+//                cugl::Size newSize(newWidth,newHeight);
+//                absEnemy->setDimension(newSize);
+                monsterController.removeEnemy(curEnemy);
             }
         }
     }
@@ -37,6 +37,8 @@
  */
 class CollisionController {
 private:
+    /** Scratch buffer for the enemies returned by each index query */
+    std::vector<const SpatialHash::Entry*> _candidates;
 
 public:
     /**
@@ -88,8 +90,8 @@ public:
     
     void overWorldMonsterControllerCollisions(OverWorld& overWorld, MonsterController& monsterController);
     
-    bool monsterDogCollision(std::shared_ptr<Dog> curDog, std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies);
-    bool monsterDecoyCollision(std::shared_ptr<DecoySet> decoySet, std::unordered_set<std::shared_ptr<AbstractEnemy>>& curEnemies);
+    bool monsterDogCollision(std::shared_ptr<Dog> curDog, MonsterController& monsterController);
+    bool monsterDecoyCollision(std::shared_ptr<DecoySet> decoySet, MonsterController& monsterController);
     bool monsterDecoyExplosionCollision(std::shared_ptr<DecoySet> decoySet, MonsterController& monsterController);
     bool monsterBaseCollsion(OverWorld& overWorld, std::shared_ptr<BaseSet> curBases, MonsterController& monsterController);
     bool absorbEnemMonsterCollision(MonsterController& monsterController, std::unordered_set<std::shared_ptr<AbsorbEnemy>>& absorbCurEnemies);
@@ -0,0 +1,199 @@
+//
+//  FlowFieldController.cpp
+//  Heavan
+//
+#include "FlowFieldController.h"
+#include <cfloat>
+#include <queue>
+
+using namespace cugl;
+
+#define DIAGONAL_COST 1.41421356f
+/** Tiles a target may drift from its field's goal before the field is not used */
+#define GOAL_TOLERANCE 2
+
+static const int NEIGHBOR_COL[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int NEIGHBOR_ROW[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+// A diagonal step may not cut the corner of a wall
+static bool canStep(const std::vector<bool>& passable, int cols, int rows, int col, int row, int dir){
+    int nc = col+NEIGHBOR_COL[dir];
+    int nr = row+NEIGHBOR_ROW[dir];
+    if (nc < 0 || nr < 0 || nc >= cols || nr >= rows || !passable[nr*cols+nc]){
+        return false;
+    }
+    if (dir >= 4){
+        return passable[row*cols+nc] && passable[nr*cols+col];
+    }
+    return true;
+}
+
+std::shared_ptr<FlowField> FlowField::compute(const std::vector<bool>& passable, int cols, int rows,
+                                              int goalCol, int goalRow){
+    std::shared_ptr<FlowField> field = std::make_shared<FlowField>();
+    field->cols = cols;
+    field->rows = rows;
+    field->goalCol = goalCol;
+    field->goalRow = goalRow;
+    field->cost.assign(cols*rows, FLT_MAX);
+    field->flow.assign(cols*rows, Vec2::ZERO);
+    if (goalCol < 0 || goalRow < 0 || goalCol >= cols || goalRow >= rows){
+        return field;
+    }
+    
+    // Dijkstra outward from the goal. Costs are symmetric, so the cost from
+    // the goal equals the cost to it.
+    typedef std::pair<float, int> Node;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open;
+    field->cost[goalRow*cols+goalCol] = 0;
+    open.push({0, goalRow*cols+goalCol});
+    while (!open.empty()){
+        Node node = open.top();
+        open.pop();
+        if (node.first > field->cost[node.second]){
+            continue;
+        }
+        int col = node.second % cols;
+        int row = node.second / cols;
+        for (int dir = 0; dir < 8; dir++){
+            if (!canStep(passable, cols, rows, col, row, dir)){
+                continue;
+            }
+            int next = (row+NEIGHBOR_ROW[dir])*cols+col+NEIGHBOR_COL[dir];
+            float cost = node.first + (dir < 4 ? 1.0f : DIAGONAL_COST);
+            if (cost < field->cost[next]){
+                field->cost[next] = cost;
+                open.push({cost, next});
+            }
+        }
+    }
+    
+    // Each tile points at its cheapest reachable neighbor
+    for (int row = 0; row < rows; row++){
+        for (int col = 0; col < cols; col++){
+            int here = row*cols+col;
+            float best = field->cost[here];
+            if (best == FLT_MAX || best == 0){
+                continue;
+            }
+            for (int dir = 0; dir < 8; dir++){
+                if (!canStep(passable, cols, rows, col, row, dir)){
+                    continue;
+                }
+                float cost = field->cost[(row+NEIGHBOR_ROW[dir])*cols+col+NEIGHBOR_COL[dir]];
+                if (cost < best){
+                    best = cost;
+                    field->flow[here] = Vec2(NEIGHBOR_COL[dir], NEIGHBOR_ROW[dir]).getNormalization();
+                }
+            }
+        }
+    }
+    return field;
+}
+
+bool FlowFieldController::init(const std::shared_ptr<World>& world){
+    dispose();
+    if (world == nullptr || world->getRows() == 0){
+        return false;
+    }
+    _world = world;
+    _rows = world->getRows();
+    _cols = world->getCols();
+    snapshot();
+    _mailbox = std::make_shared<Mailbox>();
+    _worker = ThreadPool::alloc(1);
+    return _worker != nullptr;
+}
+
+void FlowFieldController::dispose(){
+    // The pool joins its thread when destroyed (disposing twice would not)
+    _worker = nullptr;
+    _mailbox = nullptr;
+    _world = nullptr;
+    _passable = nullptr;
+    _revision = 0;
+    _slots.clear();
+    _active = 0;
+    _cols = _rows = 0;
+}
+
+void FlowFieldController::snapshot(){
+    std::shared_ptr<std::vector<bool>> passable = std::make_shared<std::vector<bool>>(_cols*_rows);
+    for (int row = 0; row < _rows; row++){
+        for (int col = 0; col < _cols; col++){
+            (*passable)[row*_cols+col] = _world->isPassable(col, row);
+        }
+    }
+    // Tasks already queued keep the old snapshot alive until they finish
+    _passable = passable;
+    _revision = _world->getRevision();
+}
+
+void FlowFieldController::request(size_t index){
+    Slot& slot = _slots[index];
+    slot.pending = true;
+    // The task only holds shared state, so it outlives a disposed controller
+    std::shared_ptr<const std::vector<bool>> passable = _passable;
+    std::shared_ptr<Mailbox> mailbox = _mailbox;
+    int cols = _cols, rows = _rows, col = slot.col, row = slot.row;
+    Uint32 revision = _revision;
+    _worker->addTask([=](){
+        std::shared_ptr<FlowField> field = FlowField::compute(*passable, cols, rows, col, row);
+        field->revision = revision;
+        std::lock_guard<std::mutex> lock(mailbox->mutex);
+        mailbox->finished.emplace_back(index, field);
+    });
+}
+
+void FlowFieldController::update(const std::vector<Vec2>& targets){
+    if (_worker == nullptr){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mailbox->mutex);
+        for (auto& result : _mailbox->finished){
+            _slots[result.first].field = result.second;
+            _slots[result.first].pending = false;
+        }
+        _mailbox->finished.clear();
+    }
+    if (_world->getRevision() != _revision){
+        snapshot();
+    }
+    
+    _active = targets.size();
+    while (_slots.size() < _active){
+        _slots.push_back({-1, -1, false, nullptr});
+    }
+    for (size_t ii = 0; ii < _active; ii++){
+        Slot& slot = _slots[ii];
+        slot.col = (int)std::floor(targets[ii].x);
+        slot.row = (int)std::floor(targets[ii].y);
+        // If the target moves again mid-computation, the next update catches it
+        bool moved = slot.field == nullptr || slot.field->goalCol != slot.col || slot.field->goalRow != slot.row;
+        // Old fields stay in use until they are replaced
+        bool outdated = slot.field != nullptr && slot.field->revision != _revision;
+        if ((moved || outdated) && !slot.pending){
+            request(ii);
+        }
+    }
+}
+
+Vec2 FlowFieldController::getDirection(int targetIndex, Vec2 pos) const{
+    if (targetIndex < 0 || targetIndex >= (int)_active || _slots[targetIndex].field == nullptr){
+        return Vec2::ZERO;
+    }
+    const Slot& slot = _slots[targetIndex];
+    const FlowField* field = slot.field.get();
+    // Slots follow the order of the targets, so once a target is removed a
+    // slot can hold the field of another target until it is recomputed
+    if (std::abs(field->goalCol-slot.col) > GOAL_TOLERANCE || std::abs(field->goalRow-slot.row) > GOAL_TOLERANCE){
+        return Vec2::ZERO;
+    }
+    int col = (int)std::floor(pos.x);
+    int row = (int)std::floor(pos.y);
+    if (col < 0 || row < 0 || col >= field->cols || row >= field->rows){
+        return Vec2::ZERO;
+    }
+    return field->flow[row*field->cols+col];
+}
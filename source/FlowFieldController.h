@@ -0,0 +1,85 @@
+//
+//  FlowFieldController.h
+//  Heavan
+//
+
+#ifndef FlowFieldController_h
+#define FlowFieldController_h
+#include <cugl/cugl.h>
+#include <mutex>
+#include <vector>
+#include "World.h"
+
+// Integration field toward one target tile. Immutable once computed, so the
+// game thread can read it while the worker builds the next one.
+class FlowField{
+public:
+    int cols;
+    int rows;
+    int goalCol;
+    int goalRow;
+    // World::getRevision() of the tiles the field was computed on
+    Uint32 revision = 0;
+    // path cost to the goal per tile, FLT_MAX where unreachable
+    std::vector<float> cost;
+    // unit step toward the next tile on the path, ZERO where unreachable
+    std::vector<cugl::Vec2> flow;
+    
+    static std::shared_ptr<FlowField> compute(const std::vector<bool>& passable, int cols, int rows,
+                                              int goalCol, int goalRow);
+};
+
+// Shared pathfinding for enemy swarms. Keeps one flow field per target
+// (dog, each base, each decoy, in target index order) and recomputes a field
+// on a worker thread only when its target crosses into a new tile, or when
+// World tiles change. Enemies sample their steering direction from the last
+// finished field in O(1).
+class FlowFieldController{
+private:
+    // Fields finished by the worker, waiting to be picked up by update()
+    struct Mailbox{
+        std::mutex mutex;
+        std::vector<std::pair<size_t, std::shared_ptr<FlowField>>> finished;
+    };
+    struct Slot{
+        int col;
+        int row;
+        bool pending;
+        std::shared_ptr<const FlowField> field;
+    };
+    
+    std::shared_ptr<World> _world;
+    int _cols;
+    int _rows;
+    // passability snapshot, so the worker never touches the World
+    std::shared_ptr<const std::vector<bool>> _passable;
+    Uint32 _revision;
+    // slots are never removed, so a finished field always has a home
+    std::vector<Slot> _slots;
+    size_t _active;
+    std::shared_ptr<Mailbox> _mailbox;
+    std::shared_ptr<cugl::ThreadPool> _worker;
+    
+    void request(size_t index);
+    void snapshot();
+public:
+    FlowFieldController() : _cols(0), _rows(0), _revision(0), _active(0) {}
+    ~FlowFieldController(){
+        dispose();
+    }
+    bool init(const std::shared_ptr<World>& world);
+    void dispose();
+    
+    // Publishes finished fields and requests new ones for targets that moved
+    void update(const std::vector<cugl::Vec2>& targets);
+    
+    // Unit steering direction toward the target, or ZERO if the enemy should
+    // head straight for it (same tile, unreachable, or no field yet)
+    cugl::Vec2 getDirection(int targetIndex, cugl::Vec2 pos) const;
+    
+    std::shared_ptr<const FlowField> getField(int targetIndex) const{
+        return targetIndex >= 0 && targetIndex < (int)_active ? _slots[targetIndex].field : nullptr;
+    }
+};
+
+#endif /* FlowFieldController_h */
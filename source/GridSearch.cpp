@@ -0,0 +1,359 @@
+//
+//  GridSearch.cpp
+//  Heavan
+//
+#include "GridSearch.h"
+#include <algorithm>
+#include <cfloat>
+
+#define DIAGONAL_COST   1.41421356f
+/** _heapIndex of a cell that has been expanded */
+#define CLOSED  -1
+/** _heapIndex of a cell that has been reached but never queued */
+#define UNQUEUED -2
+
+// Straight moves first, then diagonals
+static const int STEP_X[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int STEP_Y[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+static inline int sign(int value){
+    return (value > 0) - (value < 0);
+}
+
+float GridSearch::octile(int dx, int dy){
+    dx = std::abs(dx);
+    dy = std::abs(dy);
+    return (dx+dy) + (DIAGONAL_COST-2)*std::min(dx, dy);
+}
+
+GridSearch::GridSearch() :
+_cols(0),
+_rows(0),
+_jumpPoints(false),
+_generation(0),
+_start(-1),
+_goal(-1),
+_state(State::IDLE),
+_expansions(0){
+}
+
+bool GridSearch::init(const std::shared_ptr<World>& world){
+    if (world == nullptr){
+        return false;
+    }
+    _world = world;
+    _cols = world->getCols();
+    _rows = world->getRows();
+    size_t cells = _cols*_rows;
+    _stamp.assign(cells, 0);
+    _g.resize(cells);
+    _f.resize(cells);
+    _parent.resize(cells);
+    _heapIndex.resize(cells);
+    _heap.clear();
+    _path.clear();
+    _generation = 0;
+    _state = State::IDLE;
+    return true;
+}
+
+#pragma mark Search
+bool GridSearch::start(int startX, int startY, int goalX, int goalY){
+    _heap.clear();
+    _path.clear();
+    _expansions = 0;
+    if (_world == nullptr || startX < 0 || startY < 0 || startX >= _cols || startY >= _rows ||
+        !isOpen(goalX, goalY)){
+        // An unreachable goal would otherwise flood the whole map
+        _state = State::FAILED;
+        return false;
+    }
+    if (++_generation == 0){
+        std::fill(_stamp.begin(), _stamp.end(), 0);
+        _generation = 1;
+    }
+    _start = startY*_cols+startX;
+    _goal = goalY*_cols+goalX;
+    touch(_start);
+    _g[_start] = 0;
+    _f[_start] = heuristic(_start);
+    heapPush(_start);
+    _state = State::SEARCHING;
+    return true;
+}
+
+GridSearch::State GridSearch::step(int maxExpansions){
+    for (int ii = 0; ii < maxExpansions && _state == State::SEARCHING; ii++){
+        if (_heap.empty()){
+            _state = State::FAILED;
+            break;
+        }
+        int cell = heapPop();
+        _heapIndex[cell] = CLOSED;
+        _expansions++;
+        if (cell == _goal){
+            buildPath();
+            _state = State::SUCCEEDED;
+        } else if (_jumpPoints){
+            expandJumpPoints(cell);
+        } else {
+            expand(cell);
+        }
+    }
+    return _state;
+}
+
+void GridSearch::cancel(){
+    if (_state == State::SEARCHING){
+        _heap.clear();
+        _state = State::FAILED;
+    }
+}
+
+float GridSearch::getPathCost() const{
+    return _state == State::SUCCEEDED ? _g[_goal] : FLT_MAX;
+}
+
+float GridSearch::heuristic(int cell) const{
+    return octile(cell % _cols - _goal % _cols, cell / _cols - _goal / _cols);
+}
+
+void GridSearch::touch(int cell){
+    if (_stamp[cell] != _generation){
+        _stamp[cell] = _generation;
+        _g[cell] = FLT_MAX;
+        _parent[cell] = -1;
+        _heapIndex[cell] = UNQUEUED;
+    }
+}
+
+void GridSearch::relax(int from, int to, float cost){
+    touch(to);
+    // The octile heuristic is consistent, so closed cells are final
+    if (_heapIndex[to] == CLOSED){
+        return;
+    }
+    float g = _g[from]+cost;
+    if (g >= _g[to]){
+        return;
+    }
+    _g[to] = g;
+    _f[to] = g+heuristic(to);
+    _parent[to] = from;
+    if (_heapIndex[to] == UNQUEUED){
+        heapPush(to);
+    } else {
+        siftUp(_heapIndex[to]);
+    }
+}
+
+void GridSearch::expand(int cell){
+    int x = cell % _cols;
+    int y = cell / _cols;
+    for (int dir = 0; dir < 8; dir++){
+        int nx = x+STEP_X[dir];
+        int ny = y+STEP_Y[dir];
+        if (!isOpen(nx, ny) || (dir >= 4 && !(isOpen(nx, y) && isOpen(x, ny)))){
+            continue;
+        }
+        relax(cell, ny*_cols+nx, dir < 4 ? 1.0f : DIAGONAL_COST);
+    }
+}
+
+#pragma mark Jump Point Search
+void GridSearch::expandJumpPoints(int cell){
+    int x = cell % _cols;
+    int y = cell / _cols;
+    int dirX[8];
+    int dirY[8];
+    int count = 0;
+    auto add = [&](int dx, int dy){
+        dirX[count] = dx;
+        dirY[count] = dy;
+        count++;
+    };
+
+    int parent = _parent[cell];
+    if (parent < 0){
+        for (int dir = 0; dir < 8; dir++){
+            int nx = x+STEP_X[dir];
+            int ny = y+STEP_Y[dir];
+            if (isOpen(nx, ny) && (dir < 4 || (isOpen(nx, y) && isOpen(x, ny)))){
+                add(STEP_X[dir], STEP_Y[dir]);
+            }
+        }
+    } else {
+        // Prune to the natural and forced neighbors of the travel direction
+        int dx = sign(x - parent % _cols);
+        int dy = sign(y - parent / _cols);
+        if (dx != 0 && dy != 0){
+            bool vertical = isOpen(x, y+dy);
+            bool horizontal = isOpen(x+dx, y);
+            if (vertical){
+                add(0, dy);
+            }
+            if (horizontal){
+                add(dx, 0);
+            }
+            if (vertical && horizontal){
+                add(dx, dy);
+            }
+        } else if (dx != 0){
+            bool next = isOpen(x+dx, y);
+            bool up = isOpen(x, y+1);
+            bool down = isOpen(x, y-1);
+            if (next){
+                add(dx, 0);
+                if (up){
+                    add(dx, 1);
+                }
+                if (down){
+                    add(dx, -1);
+                }
+            }
+            if (up){
+                add(0, 1);
+            }
+            if (down){
+                add(0, -1);
+            }
+        } else {
+            bool next = isOpen(x, y+dy);
+            bool right = isOpen(x+1, y);
+            bool left = isOpen(x-1, y);
+            if (next){
+                add(0, dy);
+                if (right){
+                    add(1, dy);
+                }
+                if (left){
+                    add(-1, dy);
+                }
+            }
+            if (right){
+                add(1, 0);
+            }
+            if (left){
+                add(-1, 0);
+            }
+        }
+    }
+
+    for (int ii = 0; ii < count; ii++){
+        int point = jump(x+dirX[ii], y+dirY[ii], dirX[ii], dirY[ii]);
+        if (point >= 0){
+            relax(cell, point, octile(point % _cols - x, point / _cols - y));
+        }
+    }
+}
+
+int GridSearch::jump(int x, int y, int dx, int dy) const{
+    while (true){
+        if (!isOpen(x, y)){
+            return -1;
+        }
+        int cell = y*_cols+x;
+        if (cell == _goal){
+            return cell;
+        }
+        if (dx != 0 && dy != 0){
+            // A diagonal stops wherever a straight scan would find something
+            if (jump(x+dx, y, dx, 0) >= 0 || jump(x, y+dy, 0, dy) >= 0){
+                return cell;
+            }
+            if (!(isOpen(x+dx, y) && isOpen(x, y+dy))){
+                return -1;
+            }
+        } else if (dx != 0){
+            if ((isOpen(x, y-1) && !isOpen(x-dx, y-1)) || (isOpen(x, y+1) && !isOpen(x-dx, y+1))){
+                return cell;
+            }
+        } else {
+            if ((isOpen(x-1, y) && !isOpen(x-1, y-dy)) || (isOpen(x+1, y) && !isOpen(x+1, y-dy))){
+                return cell;
+            }
+        }
+        x += dx;
+        y += dy;
+    }
+}
+
+void GridSearch::buildPath(){
+    _path.clear();
+    int cell = _goal;
+    _path.push_back(cell);
+    // Jump point segments are straight or diagonal, so walk them tile by tile
+    while (cell != _start){
+        int parent = _parent[cell];
+        int x = cell % _cols;
+        int y = cell / _cols;
+        int dx = sign(parent % _cols - x);
+        int dy = sign(parent / _cols - y);
+        while (cell != parent){
+            x += dx;
+            y += dy;
+            cell = y*_cols+x;
+            _path.push_back(cell);
+        }
+    }
+    std::reverse(_path.begin(), _path.end());
+}
+
+#pragma mark Open List
+bool GridSearch::heapLess(int a, int b) const{
+    // Break ties toward the goal
+    return _f[a] < _f[b] || (_f[a] == _f[b] && _g[a] > _g[b]);
+}
+
+void GridSearch::heapPush(int cell){
+    _heap.push_back(cell);
+    siftUp((int)_heap.size()-1);
+}
+
+int GridSearch::heapPop(){
+    int top = _heap.front();
+    int last = _heap.back();
+    _heap.pop_back();
+    if (!_heap.empty()){
+        _heap[0] = last;
+        siftDown(0);
+    }
+    return top;
+}
+
+void GridSearch::siftUp(int pos){
+    int cell = _heap[pos];
+    while (pos > 0){
+        int parent = (pos-1)/2;
+        if (!heapLess(cell, _heap[parent])){
+            break;
+        }
+        _heap[pos] = _heap[parent];
+        _heapIndex[_heap[pos]] = pos;
+        pos = parent;
+    }
+    _heap[pos] = cell;
+    _heapIndex[cell] = pos;
+}
+
+void GridSearch::siftDown(int pos){
+    int cell = _heap[pos];
+    int size = (int)_heap.size();
+    while (true){
+        int child = 2*pos+1;
+        if (child >= size){
+            break;
+        }
+        if (child+1 < size && heapLess(_heap[child+1], _heap[child])){
+            child++;
+        }
+        if (!heapLess(_heap[child], cell)){
+            break;
+        }
+        _heap[pos] = _heap[child];
+        _heapIndex[_heap[pos]] = pos;
+        pos = child;
+    }
+    _heap[pos] = cell;
+    _heapIndex[cell] = pos;
+}
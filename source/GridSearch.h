@@ -0,0 +1,107 @@
+//
+//  GridSearch.h
+//  Heavan
+//
+
+#ifndef GridSearch_h
+#define GridSearch_h
+#include <cugl/cugl.h>
+#include <vector>
+#include "World.h"
+
+// Resumable A* over the World tile grid, 8-connected with real diagonal
+// costs and no corner cutting. Search state lives in per-cell arrays that
+// are reused between searches (a generation stamp marks which entries are
+// current), and the open list is an indexed binary heap with decrease-key,
+// so a search allocates nothing once the arrays are sized. Optionally runs
+// Jump Point Search, which expands far fewer cells on open maps.
+class GridSearch{
+public:
+    enum class State{
+        IDLE,
+        SEARCHING,
+        SUCCEEDED,
+        FAILED
+    };
+private:
+    std::shared_ptr<World> _world;
+    int _cols;
+    int _rows;
+    bool _jumpPoints;
+
+    // Per cell search state, valid only where _stamp matches _generation
+    std::vector<Uint32> _stamp;
+    std::vector<float> _g;
+    std::vector<float> _f;
+    std::vector<int> _parent;
+    // position in _heap, or CLOSED once expanded
+    std::vector<int> _heapIndex;
+    std::vector<int> _heap;
+    Uint32 _generation;
+
+    int _start;
+    int _goal;
+    State _state;
+    int _expansions;
+    // every tile from start to goal, once succeeded
+    std::vector<int> _path;
+
+    bool isOpen(int x, int y) const{
+        return _world->isPassable(x, y);
+    }
+    float heuristic(int cell) const;
+    void touch(int cell);
+    void relax(int from, int to, float cost);
+    void expand(int cell);
+    void expandJumpPoints(int cell);
+    int jump(int x, int y, int dx, int dy) const;
+
+    bool heapLess(int a, int b) const;
+    void heapPush(int cell);
+    int heapPop();
+    void siftUp(int pos);
+    void siftDown(int pos);
+
+    void buildPath();
+public:
+    GridSearch();
+
+    bool init(const std::shared_ptr<World>& world);
+    const std::shared_ptr<World>& getWorld() const{
+        return _world;
+    }
+
+    bool usesJumpPoints() const{
+        return _jumpPoints;
+    }
+    // Only affects searches started afterwards
+    void setJumpPoints(bool value){
+        _jumpPoints = value;
+    }
+
+    // Starts a new search, abandoning any search in progress
+    bool start(int startX, int startY, int goalX, int goalY);
+    // Expands up to maxExpansions cells and returns the resulting state
+    State step(int maxExpansions = 1);
+    void cancel();
+
+    State getState() const{
+        return _state;
+    }
+    int getExpansions() const{
+        return _expansions;
+    }
+    // Tiles (as y*cols+x) from start to goal inclusive, empty unless succeeded
+    const std::vector<int>& getPath() const{
+        return _path;
+    }
+    float getPathCost() const;
+    int getCols() const{
+        return _cols;
+    }
+
+    // Cost of the cheapest 8-connected move between tiles on an open grid
+    static float octile(int dx, int dy);
+};
+
+#endif /* GridSearch_h */
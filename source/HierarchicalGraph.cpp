@@ -0,0 +1,377 @@
+//
+//  HierarchicalGraph.cpp
+//  Heavan
+//
+#include "HierarchicalGraph.h"
+#include "GridSearch.h"
+#include <algorithm>
+#include <cfloat>
+#include <queue>
+
+#define DIAGONAL_COST   1.41421356f
+/** Open border runs at least this long get an entrance at each end */
+#define ENTRANCE_SPLIT  6
+
+static const int STEP_X[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+static const int STEP_Y[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+typedef std::pair<float, int> QueueEntry;
+typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> MinQueue;
+
+HierarchicalGraph::HierarchicalGraph() :
+_cols(0),
+_rows(0),
+_clusterSize(0),
+_clustersX(0),
+_clustersY(0),
+_revision(0),
+_generation(0),
+_searchGeneration(0){
+}
+
+bool HierarchicalGraph::init(const std::shared_ptr<World>& world, int clusterSize){
+    dispose();
+    if (world == nullptr || clusterSize <= 1){
+        return false;
+    }
+    _world = world;
+    _cols = world->getCols();
+    _rows = world->getRows();
+    _clusterSize = clusterSize;
+    _clustersX = (_cols+clusterSize-1)/clusterSize;
+    _clustersY = (_rows+clusterSize-1)/clusterSize;
+    _revision = world->getRevision();
+    _clusterNodes.resize(_clustersX*_clustersY);
+    _dist.resize(_cols*_rows);
+    _stamp.assign(_cols*_rows, 0);
+
+    for (int cluster = 0; cluster < _clustersX*_clustersY; cluster++){
+        buildBorder(eastBorder(cluster));
+        buildBorder(northBorder(cluster));
+    }
+    for (int cluster = 0; cluster < _clustersX*_clustersY; cluster++){
+        buildCluster(cluster);
+    }
+    return true;
+}
+
+void HierarchicalGraph::dispose(){
+    _world = nullptr;
+    _nodes.clear();
+    _freeNodes.clear();
+    _clusterNodes.clear();
+    _dist.clear();
+    _stamp.clear();
+    _g.clear();
+    _parent.clear();
+    _searchStamp.clear();
+    _goalCost.clear();
+    _generation = 0;
+    _searchGeneration = 0;
+    _cols = _rows = _clusterSize = _clustersX = _clustersY = 0;
+}
+
+#pragma mark Construction
+int HierarchicalGraph::addNode(int cell, int border){
+    int id;
+    if (_freeNodes.empty()){
+        id = (int)_nodes.size();
+        _nodes.emplace_back();
+    } else {
+        id = _freeNodes.back();
+        _freeNodes.pop_back();
+    }
+    Node& node = _nodes[id];
+    node.cell = cell;
+    node.cluster = clusterOf(cell);
+    node.border = border;
+    node.edges.clear();
+    _clusterNodes[node.cluster].push_back(id);
+    return id;
+}
+
+void HierarchicalGraph::removeNode(int id){
+    Node& node = _nodes[id];
+    std::vector<int>& members = _clusterNodes[node.cluster];
+    members.erase(std::remove(members.begin(), members.end(), id), members.end());
+    node.border = -1;
+    node.edges.clear();
+    _freeNodes.push_back(id);
+}
+
+void HierarchicalGraph::buildBorder(int border){
+    bool east = border < _clustersX*_clustersY;
+    int cluster = east ? border : border - _clustersX*_clustersY;
+    int cx = cluster % _clustersX;
+    int cy = cluster / _clustersX;
+    if ((east && cx+1 >= _clustersX) || (!east && cy+1 >= _clustersY)){
+        return;
+    }
+
+    // Walk along the border; (x,y) is inside this cluster, (x+nx,y+ny) in the next
+    int nx = east ? 1 : 0;
+    int ny = east ? 0 : 1;
+    int first = east ? cy*_clusterSize : cx*_clusterSize;
+    int last = std::min(first+_clusterSize, east ? _rows : _cols)-1;
+    int fixed = (east ? cx+1 : cy+1)*_clusterSize-1;
+    auto link = [&](int along){
+        int x = east ? fixed : along;
+        int y = east ? along : fixed;
+        int inside = addNode(y*_cols+x, border);
+        int outside = addNode((y+ny)*_cols+x+nx, border);
+        _nodes[inside].edges.push_back({outside, 1.0f, false});
+        _nodes[outside].edges.push_back({inside, 1.0f, false});
+    };
+
+    int runStart = -1;
+    for (int along = first; along <= last+1; along++){
+        bool open = false;
+        if (along <= last){
+            int x = east ? fixed : along;
+            int y = east ? along : fixed;
+            open = isOpen(x, y) && isOpen(x+nx, y+ny);
+        }
+        if (open && runStart < 0){
+            runStart = along;
+        } else if (!open && runStart >= 0){
+            int runEnd = along-1;
+            if (runEnd-runStart+1 < ENTRANCE_SPLIT){
+                link((runStart+runEnd)/2);
+            } else {
+                link(runStart);
+                link(runEnd);
+            }
+            runStart = -1;
+        }
+    }
+}
+
+void HierarchicalGraph::clearBorder(int border){
+    bool east = border < _clustersX*_clustersY;
+    int cluster = east ? border : border - _clustersX*_clustersY;
+    int other = east ? cluster+1 : cluster+_clustersX;
+    for (int side : { cluster, other }){
+        std::vector<int> doomed;
+        for (int id : _clusterNodes[side]){
+            if (_nodes[id].border == border){
+                doomed.push_back(id);
+            }
+        }
+        for (int id : doomed){
+            removeNode(id);
+        }
+    }
+}
+
+void HierarchicalGraph::buildCluster(int cluster){
+    std::vector<int>& members = _clusterNodes[cluster];
+    for (int id : members){
+        std::vector<Edge>& edges = _nodes[id].edges;
+        edges.erase(std::remove_if(edges.begin(), edges.end(), [](const Edge& e){ return e.intra; }), edges.end());
+    }
+    for (int id : members){
+        localDistances(_nodes[id].cell, cluster);
+        for (int other : members){
+            float cost = localDistance(_nodes[other].cell);
+            if (other != id && cost < FLT_MAX){
+                _nodes[id].edges.push_back({other, cost, true});
+            }
+        }
+    }
+}
+
+void HierarchicalGraph::localDistances(int cell, int cluster){
+    if (++_generation == 0){
+        std::fill(_stamp.begin(), _stamp.end(), 0);
+        _generation = 1;
+    }
+    int minX = (cluster % _clustersX)*_clusterSize;
+    int minY = (cluster / _clustersX)*_clusterSize;
+    int maxX = std::min(minX+_clusterSize, _cols)-1;
+    int maxY = std::min(minY+_clusterSize, _rows)-1;
+
+    MinQueue open;
+    _stamp[cell] = _generation;
+    _dist[cell] = 0;
+    open.push({0, cell});
+    while (!open.empty()){
+        QueueEntry entry = open.top();
+        open.pop();
+        if (entry.first > _dist[entry.second]){
+            continue;
+        }
+        int x = entry.second % _cols;
+        int y = entry.second / _cols;
+        for (int dir = 0; dir < 8; dir++){
+            int tx = x+STEP_X[dir];
+            int ty = y+STEP_Y[dir];
+            if (tx < minX || ty < minY || tx > maxX || ty > maxY || !isOpen(tx, ty) ||
+                (dir >= 4 && !(isOpen(tx, y) && isOpen(x, ty)))){
+                continue;
+            }
+            int next = ty*_cols+tx;
+            float cost = entry.first + (dir < 4 ? 1.0f : DIAGONAL_COST);
+            if (_stamp[next] != _generation || cost < _dist[next]){
+                _stamp[next] = _generation;
+                _dist[next] = cost;
+                open.push({cost, next});
+            }
+        }
+    }
+}
+
+float HierarchicalGraph::localDistance(int cell) const{
+    return _stamp[cell] == _generation ? _dist[cell] : FLT_MAX;
+}
+
+bool HierarchicalGraph::sync(){
+    if (_world == nullptr || _world->getRevision() == _revision){
+        return false;
+    }
+    int clusters = _clustersX*_clustersY;
+    std::vector<bool> dirty(clusters, false);
+    for (Uint32 rev = _revision; rev < _world->getRevision(); rev++){
+        dirty[clusterOf(_world->getChangedTile(rev))] = true;
+    }
+    _revision = _world->getRevision();
+
+    // Every border of a dirty cluster, and the clusters on both sides of it
+    std::vector<bool> borders(2*clusters, false);
+    std::vector<bool> affected(clusters, false);
+    for (int cluster = 0; cluster < clusters; cluster++){
+        if (!dirty[cluster]){
+            continue;
+        }
+        int cx = cluster % _clustersX;
+        int cy = cluster / _clustersX;
+        affected[cluster] = true;
+        if (cx+1 < _clustersX){
+            borders[eastBorder(cluster)] = affected[cluster+1] = true;
+        }
+        if (cx > 0){
+            borders[eastBorder(cluster-1)] = affected[cluster-1] = true;
+        }
+        if (cy+1 < _clustersY){
+            borders[northBorder(cluster)] = affected[cluster+_clustersX] = true;
+        }
+        if (cy > 0){
+            borders[northBorder(cluster-_clustersX)] = affected[cluster-_clustersX] = true;
+        }
+    }
+    for (int border = 0; border < 2*clusters; border++){
+        if (borders[border]){
+            clearBorder(border);
+            buildBorder(border);
+        }
+    }
+    for (int cluster = 0; cluster < clusters; cluster++){
+        if (affected[cluster]){
+            buildCluster(cluster);
+        }
+    }
+    return true;
+}
+
+#pragma mark Search
+bool HierarchicalGraph::findPath(int start, int goal, std::vector<int>& waypoints, int& expansions){
+    waypoints.clear();
+    int cells = _cols*_rows;
+    if (_world == nullptr || start < 0 || goal < 0 || start >= cells || goal >= cells ||
+        !isOpen(goal % _cols, goal / _cols)){
+        return false;
+    }
+    int startCluster = clusterOf(start);
+    int goalCluster = clusterOf(goal);
+    int startId = (int)_nodes.size();
+    int goalId = startId+1;
+    if (_g.size() < _nodes.size()+2){
+        _g.resize(_nodes.size()+2);
+        _parent.resize(_nodes.size()+2);
+        _searchStamp.resize(_nodes.size()+2, 0);
+        _goalCost.resize(_nodes.size()+2);
+    }
+    if (++_searchGeneration == 0){
+        std::fill(_searchStamp.begin(), _searchStamp.end(), 0);
+        _searchGeneration = 1;
+    }
+    auto touch = [&](int id){
+        if (_searchStamp[id] != _searchGeneration){
+            _searchStamp[id] = _searchGeneration;
+            _g[id] = FLT_MAX;
+            _parent[id] = -1;
+            _goalCost[id] = FLT_MAX;
+        }
+    };
+    auto heuristic = [&](int id){
+        int cell = id == goalId ? goal : id == startId ? start : _nodes[id].cell;
+        return GridSearch::octile(cell % _cols - goal % _cols, cell / _cols - goal / _cols);
+    };
+
+    // Distances within their clusters stand in for the start and goal edges
+    localDistances(goal, goalCluster);
+    for (int id : _clusterNodes[goalCluster]){
+        touch(id);
+        _goalCost[id] = localDistance(_nodes[id].cell);
+    }
+    touch(goalId);
+    touch(startId);
+    _g[startId] = 0;
+
+    MinQueue open;
+    localDistances(start, startCluster);
+    for (int id : _clusterNodes[startCluster]){
+        float cost = localDistance(_nodes[id].cell);
+        touch(id);
+        if (cost < _g[id]){
+            _g[id] = cost;
+            _parent[id] = startId;
+            open.push({cost+heuristic(id), id});
+        }
+    }
+    if (startCluster == goalCluster){
+        float cost = localDistance(goal);
+        if (cost < FLT_MAX){
+            _g[goalId] = cost;
+            _parent[goalId] = startId;
+            open.push({cost, goalId});
+        }
+    }
+
+    while (!open.empty()){
+        QueueEntry entry = open.top();
+        open.pop();
+        int id = entry.second;
+        if (id == goalId){
+            for (int step = goalId; step >= 0; step = _parent[step]){
+                int cell = step == goalId ? goal : step == startId ? start : _nodes[step].cell;
+                if (waypoints.empty() || waypoints.back() != cell){
+                    waypoints.push_back(cell);
+                }
+            }
+            std::reverse(waypoints.begin(), waypoints.end());
+            return true;
+        }
+        if (entry.first > _g[id]+heuristic(id)+0.0001f){
+            continue;
+        }
+        expansions++;
+        for (const Edge& edge : _nodes[id].edges){
+            touch(edge.to);
+            float cost = _g[id]+edge.cost;
+            if (cost < _g[edge.to]){
+                _g[edge.to] = cost;
+                _parent[edge.to] = id;
+                open.push({cost+heuristic(edge.to), edge.to});
+            }
+        }
+        if (_nodes[id].cluster == goalCluster && _goalCost[id] < FLT_MAX){
+            float cost = _g[id]+_goalCost[id];
+            if (cost < _g[goalId]){
+                _g[goalId] = cost;
+                _parent[goalId] = id;
+                open.push({cost, goalId});
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,110 @@
+//
+//  HierarchicalGraph.h
+//  Heavan
+//
+
+#ifndef HierarchicalGraph_h
+#define HierarchicalGraph_h
+#include <cugl/cugl.h>
+#include <vector>
+#include "World.h"
+
+// Abstract graph for hierarchical pathfinding (HPA*) over the World tiles.
+// The boundary grid is split into square clusters. Wherever two adjacent
+// clusters share open border tiles, an entrance adds a node on each side,
+// linked by a single step. Nodes in the same cluster are linked by their
+// shortest path inside it. A long search then runs over clusters instead of
+// tiles, and only yields waypoints; each leg between waypoints is short and
+// is searched on the grid when it is needed.
+//
+// Tile changes made through World::setPassable are picked up by sync(),
+// which rebuilds only the clusters around the changed tiles.
+class HierarchicalGraph{
+private:
+    struct Edge{
+        int to;
+        float cost;
+        // false for the step across a border, which sync() keeps
+        bool intra;
+    };
+    struct Node{
+        int cell;
+        int cluster;
+        // the border this entrance node belongs to, or -1 if unused
+        int border;
+        std::vector<Edge> edges;
+    };
+
+    std::shared_ptr<World> _world;
+    int _cols;
+    int _rows;
+    int _clusterSize;
+    int _clustersX;
+    int _clustersY;
+    Uint32 _revision;
+
+    std::vector<Node> _nodes;
+    std::vector<int> _freeNodes;
+    std::vector<std::vector<int>> _clusterNodes;
+
+    // Local Dijkstra scratch, valid where _stamp matches _generation
+    std::vector<float> _dist;
+    std::vector<Uint32> _stamp;
+    Uint32 _generation;
+
+    // Abstract search scratch, indexed by node (plus start and goal)
+    std::vector<float> _g;
+    std::vector<int> _parent;
+    std::vector<Uint32> _searchStamp;
+    std::vector<float> _goalCost;
+    Uint32 _searchGeneration;
+
+    bool isOpen(int x, int y) const{
+        return _world->isPassable(x, y);
+    }
+    int clusterOf(int cell) const{
+        return (cell / _cols) / _clusterSize * _clustersX + (cell % _cols) / _clusterSize;
+    }
+    // Borders are numbered east borders first (cluster to cluster+1), then
+    // north borders (cluster to cluster+clustersX)
+    int eastBorder(int cluster) const{
+        return cluster;
+    }
+    int northBorder(int cluster) const{
+        return _clustersX*_clustersY + cluster;
+    }
+
+    int addNode(int cell, int border);
+    void removeNode(int node);
+    void buildBorder(int border);
+    void clearBorder(int border);
+    void buildCluster(int cluster);
+    void localDistances(int cell, int cluster);
+    float localDistance(int cell) const;
+public:
+    HierarchicalGraph();
+
+    bool init(const std::shared_ptr<World>& world, int clusterSize);
+    void dispose();
+
+    // Rebuilds the clusters around tiles changed since the last sync.
+    // Returns true if anything changed.
+    bool sync();
+
+    // Finds the waypoints (tiles as y*cols+x, start and goal included) of an
+    // abstract path. Returns false if the goal is unreachable. Expansions
+    // made are added to expansions.
+    bool findPath(int start, int goal, std::vector<int>& waypoints, int& expansions);
+
+    bool isSameCluster(int a, int b) const{
+        return clusterOf(a) == clusterOf(b);
+    }
+    int getClusterSize() const{
+        return _clusterSize;
+    }
+    size_t getNodeCount() const{
+        return _nodes.size() - _freeNodes.size();
+    }
+};
+
+#endif /* HierarchicalGraph_h */
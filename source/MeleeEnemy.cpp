@@ -120,7 +120,7 @@ void MeleeEnemy::preUpdate(float dt, OverWorld& overWorld){
     }
     
     cugl::Vec2 target_pos = getTargetPositionFromIndex(overWorld);
-    cugl::Vec2 direction = target_pos - getPosition();
+    cugl::Vec2 direction = getSteeringDirection(overWorld, target_pos);
     if (overWorld._isHost && _counter >= updateRate){
         
 //        setGoal(target_pos, overWorld.getWorld());
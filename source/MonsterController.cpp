@@ -21,7 +21,15 @@ bool MonsterController::init(OverWorld& overWorld,
     _current.clear();
     _pending.clear();
     _absorbEnem.clear();
+    _removed.clear();
     _debugNode = debugNode;
+    _paths = nullptr;
+    if (overWorld._isHost){
+        _paths = std::make_shared<PathService>();
+        if (!_paths->init(overWorld.getWorld())){
+            _paths = nullptr;
+        }
+    }
 
     for (const cugl::Vec3& cluster : overWorld.getLevelModel()->preSpawnLocs()){
         float cx = cluster.x;
@@ -38,6 +46,7 @@ bool MonsterController::init(OverWorld& overWorld,
 }
 void MonsterController::postUpdate(){
     for (std::shared_ptr<AbstractEnemy> curEnemy: _pending){
+        curEnemy->setPathService(_paths);
         _current.insert(curEnemy);
     }
     _pending.clear();
@@ -83,6 +92,10 @@ void MonsterController::update(float timestep, OverWorld& overWorld){
     if (!overWorld._isHost){
         return;
     }
+    // Serves the requests enemies posted last frame
+    if (_paths){
+        _paths->update();
+    }
     std::shared_ptr<DecoySet> decoySet = overWorld.getDecoys();
     if (decoySet->addedNewDecoy()){
         retargetToDecoy(overWorld);
@@ -229,9 +242,26 @@ void MonsterController::spawnBombEnemy(cugl::Vec2 pos, OverWorld& overWorld, flo
     }
 }
 void MonsterController::removeEnemy(std::shared_ptr<AbstractEnemy> enemy){
-    getNetwork()->getPhysController()->removeSharedObstacle(enemy);
-    enemy->getTopLevelNode()->removeFromParent();
-    if (auto absorb  = std::dynamic_pointer_cast<AbsorbEnemy>(enemy)){
-        _absorbEnem.erase(absorb);
+    // Deferred so the collision passes never erase from _current mid-iteration
+    _removed.insert(enemy);
+}
+
+void MonsterController::flushRemovals(){
+    for (const std::shared_ptr<AbstractEnemy>& enemy : _removed){
+        getNetwork()->getPhysController()->removeSharedObstacle(enemy);
+        enemy->getTopLevelNode()->removeFromParent();
+        if (auto absorb  = std::dynamic_pointer_cast<AbsorbEnemy>(enemy)){
+            _absorbEnem.erase(absorb);
+        }
+        _current.erase(enemy);
+    }
+    _removed.clear();
+}
+
+void MonsterController::buildIndex(){
+    _enemyIndex.clear();
+    for (const std::shared_ptr<AbstractEnemy>& enemy : _current){
+        _enemyIndex.insert(enemy, enemy->getPosition(), fmax(enemy->getWidth(), enemy->getHeight())/2);
     }
+    _enemyIndex.build();
 }
@@ -15,6 +15,8 @@
 #include "AbsorbEnemy.h"
 #include "BombEnemy.h"
 #include "OverWorld.h"
+#include "SpatialHash.h"
+#include "PathService.h"
 #include <unordered_set>
 #include <vector>
 #include <random>
@@ -46,6 +48,12 @@ private:
     std::unordered_set<std::shared_ptr<AbstractEnemy>> _current;
     std::unordered_set<std::shared_ptr<AbstractEnemy>> _pending;
     std::unordered_set<std::shared_ptr<AbsorbEnemy>> _absorbEnem;
+    // enemy positions for the collision passes, rebuilt once per tick
+    SpatialHash _enemyIndex;
+    // enemies killed this tick, removed together in flushRemovals()
+    std::unordered_set<std::shared_ptr<AbstractEnemy>> _removed;
+    // A* requests from every enemy, run within a per-frame budget (host only)
+    std::shared_ptr<PathService> _paths;
     std::shared_ptr<NetEventController> _network;
     std::shared_ptr<cugl::scene2::SceneNode> _debugNode;
     // Need a Wrapper class that contains each and every Sprite
@@ -61,6 +69,25 @@ private:
 public:
     
     void removeEnemy(std::shared_ptr<AbstractEnemy> enemy);
+    bool isRemoved(const std::shared_ptr<AbstractEnemy>& enemy) const{
+        return _removed.count(enemy) > 0;
+    }
+    void flushRemovals();
+    
+    const std::shared_ptr<PathService>& getPathService() const{
+        return _paths;
+    }
+    // The world rectangles the players can see, so their enemies path first
+    void setViewBounds(const std::vector<cugl::Rect>& views){
+        if (_paths){
+            _paths->setViews(views);
+        }
+    }
+    
+    void buildIndex();
+    const SpatialHash& getEnemyIndex() const{
+        return _enemyIndex;
+    }
     void setNetwork(std::shared_ptr<NetEventController> network){
         _network = network;
     }
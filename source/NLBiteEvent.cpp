@@ -35,14 +35,23 @@ std::shared_ptr<NetEvent> BiteEvent::allocBiteEvent(Vec2 pos, float ang, bool m_
  * Serialize any paramater that the event contains to a vector of bytes.
  */
 std::vector<std::byte> BiteEvent::serialize(){
-    //TODO: serialize _pos
-#pragma mark BEGIN SOLUTION
     _serializer.reset();
-    _serializer.writeFloat(_pos.x);
-    _serializer.writeFloat(_pos.y);
-    _serializer.writeFloat(_ang);
-    _serializer.writeBool(_isHost);
+    serializeTo(_serializer);
     return _serializer.serialize();
+}
+
+/**
+ * Serialize any paramater that the event contains to the end of a frame.
+ *
+ * @param out   the serializer to write to
+ */
+void BiteEvent::serializeTo(LWSerializer& out){
+    //TODO: serialize _pos
+#pragma mark BEGIN SOLUTION
+    out.writeFloat(_pos.x);
+    out.writeFloat(_pos.y);
+    out.writeFloat(_ang);
+    out.writeBool(_isHost);
 #pragma mark END SOLUTION
 }
 /**
@@ -55,12 +64,23 @@ std::vector<std::byte> BiteEvent::serialize(){
  * useful parameters of this class.
  */
 void BiteEvent::deserialize(const std::vector<std::byte>& data){
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Deserialize a span of bytes and set the corresponding parameters.
+ *
+ * @param data  a span of bytes packed by serializeTo()
+ * @param size  the number of bytes
+ *
+ * The bytes are read in place and are not retained after this call.
+ */
+void BiteEvent::deserializeFrom(const std::byte* data, size_t size){
     //TODO: deserialize data and set _pos
     //NOTE: You might be tempted to write Vec2(_deserializer.readFloat(),_deserializer.readFloat()), however, C++ doesn't specify the order in which function arguments are evaluated, so you might end up with <y,x> instead of <x,y>.
     
 #pragma mark BEGIN SOLUTION
-    _deserializer.reset();
-    _deserializer.receive(data);
+    _deserializer.receive(data, size);
     float x = _deserializer.readFloat();
     float y = _deserializer.readFloat();
     _pos = Vec2(x,y);
@@ -68,5 +88,6 @@ void BiteEvent::deserialize(const std::vector<std::byte>& data){
     _ang = ang;
     bool host = _deserializer.readBool();
     _isHost = host;
+    _deserializer.reset();
 #pragma mark END SOLUTION
 }
@@ -33,11 +33,20 @@ std::shared_ptr<NetEvent> DashEvent::allocDashEvent(bool m_isHost){
  * Serialize any paramater that the event contains to a vector of bytes.
  */
 std::vector<std::byte> DashEvent::serialize(){
-    //TODO: serialize _pos
-#pragma mark BEGIN SOLUTION
     _serializer.reset();
-    _serializer.writeBool(isHost);
+    serializeTo(_serializer);
     return _serializer.serialize();
+}
+
+/**
+ * Serialize any paramater that the event contains to the end of a frame.
+ *
+ * @param out   the serializer to write to
+ */
+void DashEvent::serializeTo(LWSerializer& out){
+    //TODO: serialize _pos
+#pragma mark BEGIN SOLUTION
+    out.writeBool(isHost);
 #pragma mark END SOLUTION
 }
 /**
@@ -50,13 +59,25 @@ std::vector<std::byte> DashEvent::serialize(){
  * useful parameters of this class.
  */
 void DashEvent::deserialize(const std::vector<std::byte>& data){
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Deserialize a span of bytes and set the corresponding parameters.
+ *
+ * @param data  a span of bytes packed by serializeTo()
+ * @param size  the number of bytes
+ *
+ * The bytes are read in place and are not retained after this call.
+ */
+void DashEvent::deserializeFrom(const std::byte* data, size_t size){
     //TODO: deserialize data and set _pos
     //NOTE: You might be tempted to write Vec2(_deserializer.readFloat(),_deserializer.readFloat()), however, C++ doesn't specify the order in which function arguments are evaluated, so you might end up with <y,x> instead of <x,y>.
     
 #pragma mark BEGIN SOLUTION
-    _deserializer.reset();
-    _deserializer.receive(data);
+    _deserializer.receive(data, size);
     bool m_isHost = _deserializer.readBool();
     isHost = m_isHost;
+    _deserializer.reset();
 #pragma mark END SOLUTION
 }
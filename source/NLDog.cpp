@@ -217,24 +217,18 @@ void Dog::moveOnInputSetAction(InputController& _input){
     bool startingRecall = _startRecall;
     if (action != Actions::DASH){
         if (_startDash){
-            setX(getX());
-            setY(getY());
             _startDash = false;
             setVX(_vel.x*getThrust()*2.5);
             setVY(_vel.y*getThrust()*2.5);
             dir.x =_vel.x*getThrust()*2.5;
             dir.y = _vel.y*getThrust()*2.5;
         }else{
-            setX(getX());
-            setY(getY());
             setVX(_vel.x*getThrust());
             setVY(_vel.y*getThrust());
             dir.x =_vel.x*getThrust();
             dir.y = _vel.y*getThrust();
         }
     }else{
-        setX(getX());
-        setY(getY());
         setVX(dir.x);
         setVY(dir.y);
     }
@@ -33,12 +33,21 @@ std::shared_ptr<NetEvent> GameResEvent::allocGameResEvent(Vec2 pos){
  * Serialize any paramater that the event contains to a vector of bytes.
  */
 std::vector<std::byte> GameResEvent::serialize(){
-    //TODO: serialize _pos
-#pragma mark BEGIN SOLUTION
     _serializer.reset();
-    _serializer.writeFloat(_pos.x);
-    _serializer.writeFloat(_pos.y);
+    serializeTo(_serializer);
     return _serializer.serialize();
+}
+
+/**
+ * Serialize any paramater that the event contains to the end of a frame.
+ *
+ * @param out   the serializer to write to
+ */
+void GameResEvent::serializeTo(LWSerializer& out){
+    //TODO: serialize _pos
+#pragma mark BEGIN SOLUTION
+    out.writeFloat(_pos.x);
+    out.writeFloat(_pos.y);
 #pragma mark END SOLUTION
 }
 /**
@@ -51,14 +60,26 @@ std::vector<std::byte> GameResEvent::serialize(){
  * useful parameters of this class.
  */
 void GameResEvent::deserialize(const std::vector<std::byte>& data){
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Deserialize a span of bytes and set the corresponding parameters.
+ *
+ * @param data  a span of bytes packed by serializeTo()
+ * @param size  the number of bytes
+ *
+ * The bytes are read in place and are not retained after this call.
+ */
+void GameResEvent::deserializeFrom(const std::byte* data, size_t size){
     //TODO: deserialize data and set _pos
     //NOTE: You might be tempted to write Vec2(_deserializer.readFloat(),_deserializer.readFloat()), however, C++ doesn't specify the order in which function arguments are evaluated, so you might end up with <y,x> instead of <x,y>.
     
 #pragma mark BEGIN SOLUTION
-    _deserializer.reset();
-    _deserializer.receive(data);
+    _deserializer.receive(data, size);
     float x = _deserializer.readFloat();
     float y = _deserializer.readFloat();
     _pos = Vec2(x,y);
+    _deserializer.reset();
 #pragma mark END SOLUTION
 }
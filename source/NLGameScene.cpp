@@ -43,6 +43,8 @@ using namespace cugl::physics2::net;
 #define SCENE_HEIGHT 800
 
 #define CANVAS_TILE_HEIGHT 8
+/** How much larger than the visible area the network interest region is */
+#define INTEREST_SCALE 2.0f
 
 /** Width of the game world in Box2d units */
 #define DEFAULT_WIDTH 100.0f
@@ -246,6 +248,10 @@ bool GameScene::init(const std::shared_ptr<AssetManager> &assets, const Rect rec
         _uinode->addChild(overWorld.getClientDog()->getUINode());
     }
 
+    // Only ask the other player for frequent updates around our own dog
+    Size view(CANVAS_TILE_HEIGHT * dimen.width / dimen.height, CANVAS_TILE_HEIGHT);
+    _network->getPhysController()->setInterest(isHost ? overWorld.getDog() : overWorld.getClientDog(), view * INTEREST_SCALE);
+
     _monsterController.setNetwork(_network);
     _monsterController.setMeleeAnimationData(_constants->get("basicEnemy"), assets);
     _monsterController.setSpawnerAnimationData(_constants->get("spawnerEnemy"), assets);
@@ -269,6 +275,35 @@ bool GameScene::init(const std::shared_ptr<AssetManager> &assets, const Rect rec
     _network->attachEventType<ShootEvent>();
     _network->attachEventType<GameResEvent>();
 
+    // Inbound events are dispatched by type id, in GameScene::fixedUpdate
+    _network->registerHandler<DecoyEvent>([this](const DecoyEvent& e) {
+        overWorld.getDecoys()->addNewDecoy(e.getPos());
+    });
+    _network->registerHandler<BiteEvent>([this](const BiteEvent& e) {
+        overWorld.processBiteEvent(e);
+    });
+    _network->registerHandler<RecallEvent>([this](const RecallEvent& e) {
+        overWorld.processRecallEvent(e);
+    });
+    _network->registerHandler<ExplodeEvent>([this](const ExplodeEvent& e) {
+        overWorld.processExplodeEvent(e);
+    });
+    _network->registerHandler<ShootEvent>([this](const ShootEvent& e) {
+        overWorld.processShootEvent(e);
+    });
+    _network->registerHandler<DashEvent>([this](const DashEvent& e) {
+        overWorld.processDashEvent(e);
+    });
+    _network->registerHandler<SizeEvent>([this](const SizeEvent& e) {
+        overWorld.processSizeEvent(e);
+    });
+    _network->registerHandler<WinEvent>([this](const WinEvent&) {
+        winNode->setVisible(true);
+    });
+    _network->registerHandler<LoseEvent>([this](const LoseEvent&) {
+        loseNode->setVisible(true);
+    });
+
     // XNA nostalgia
     Application::get()->setClearColor(Color4f::CORNFLOWER);
 
@@ -330,6 +365,10 @@ void GameScene::dispose()
 {
     if (_active)
     {
+        if (_network)
+        {
+            _network->clearHandlers();
+        }
         removeAllChildren();
         _pause->dispose();
         //        _input.dispose();
@@ -408,7 +447,7 @@ void GameScene::addInitObstacle(const std::shared_ptr<physics2::Obstacle> &obj,
     obj->setDebugScene(_debugnode);
     if (_isHost)
     {
-        _world->getOwnedObstacles().insert({obj, 0});
+        _world->ownObstacle(obj);
     }
     linkSceneToObs(obj, node);
 }
@@ -453,13 +492,24 @@ void GameScene::preUpdate(float dt)
     }
     overWorld.update(_input, computeActiveSize(), dt);
     _spawnerController.update(_monsterController, overWorld, dt);
+    if (_isHost)
+    {
+        // Enemies either player can see get their paths first
+        Size dimen = computeActiveSize();
+        Size view = Size(CANVAS_TILE_HEIGHT * dimen.width / dimen.height, CANVAS_TILE_HEIGHT) / _zoom;
+        Vec2 half(view.width / 2, view.height / 2);
+        _monsterController.setViewBounds({Rect(overWorld.getDog()->getPosition() - half, view),
+                                          Rect(overWorld.getClientDog()->getPosition() - half, view)});
+    }
     _monsterController.update(dt, overWorld);
 
     if (_isHost)
     {
+        _monsterController.buildIndex();
         _collisionController.intraOverWorldCollisions(overWorld);
         _collisionController.overWorldMonsterControllerCollisions(overWorld, _monsterController);
         _collisionController.attackCollisions(overWorld, _monsterController, _spawnerController);
+        _monsterController.flushRemovals();
         
         if (_monsterController.isEmpty() && _spawnerController.win() && !winNode->isVisible())
         {
@@ -543,56 +593,10 @@ void GameScene::fixedUpdate()
     }
     // TODO: check for available incoming events from the network controller and call processCrateEvent if it is a CrateEvent.
 
-    // Hint: You can check if ptr points to an object of class A using std::dynamic_pointer_cast<A>(ptr). You should always check isInAvailable() before popInEvent().
+    // Hint: Handlers are registered in init. Events that could not be dispatched on arrival are dispatched here.
 
 #pragma mark BEGIN SOLUTION
-    while (_network->isInAvailable())
-    {
-        auto e = _network->popInEvent();
-        if (auto decoyEvent = std::dynamic_pointer_cast<DecoyEvent>(e))
-        {
-            //            CULog("Decoy Event Got");
-            overWorld.getDecoys()->addNewDecoy(Vec2(decoyEvent->getPos().x, decoyEvent->getPos().y));
-        }
-        if (auto biteEvent = std::dynamic_pointer_cast<BiteEvent>(e))
-        {
-            overWorld.processBiteEvent(biteEvent);
-        }
-        if (auto recallEvent = std::dynamic_pointer_cast<RecallEvent>(e))
-        {
-            overWorld.processRecallEvent(recallEvent);
-        }
-        if (auto explodeEvent = std::dynamic_pointer_cast<ExplodeEvent>(e))
-        {
-            //            CULog("Explode Event Got");
-            overWorld.processExplodeEvent(explodeEvent);
-        }
-        if (auto shootEvent = std::dynamic_pointer_cast<ShootEvent>(e))
-        {
-            //            CULog("Explode Event Got");
-            overWorld.processShootEvent(shootEvent);
-        }
-        if (auto dashEvent = std::dynamic_pointer_cast<DashEvent>(e))
-        {
-            //            CULog("Explode Event Got");
-            overWorld.processDashEvent(dashEvent);
-        }
-        if (auto sizeEvent = std::dynamic_pointer_cast<SizeEvent>(e))
-        {
-            //            CULog("Explode Event Got");
-            overWorld.processSizeEvent(sizeEvent);
-        }
-        if (auto winEvent = std::dynamic_pointer_cast<WinEvent>(e))
-        {
-            winNode->setVisible(true);
-//            CULog("winEvent Event Got");
-        }
-        if (auto loseEvent = std::dynamic_pointer_cast<LoseEvent>(e))
-        {
-            loseNode->setVisible(true);
-//            CULog("loseEvent Event Got");
-        }
-    }
+    _network->dispatchInEvents();
 #pragma mark END SOLUTION
 
     _world->update(FIXED_TIMESTEP_S);
@@ -689,7 +693,7 @@ void GameScene::addChildBackground()
                 t->setDebugScene(_debugnode);
                 if (_isHost)
                 {
-                    _world->getOwnedObstacles().insert({t, 0});
+                    _world->ownObstacle(t);
                 }
             }
         }
@@ -34,12 +34,21 @@ std::shared_ptr<NetEvent> SizeEvent::allocSizeEvent(int size, bool m_isHost){
  * Serialize any paramater that the event contains to a vector of bytes.
  */
 std::vector<std::byte> SizeEvent::serialize(){
-    //TODO: serialize _pos
-#pragma mark BEGIN SOLUTION
     _serializer.reset();
-    _serializer.writeSint32(_size);
-    _serializer.writeBool(_isHost);
+    serializeTo(_serializer);
     return _serializer.serialize();
+}
+
+/**
+ * Serialize any paramater that the event contains to the end of a frame.
+ *
+ * @param out   the serializer to write to
+ */
+void SizeEvent::serializeTo(LWSerializer& out){
+    //TODO: serialize _pos
+#pragma mark BEGIN SOLUTION
+    out.writeSint32(_size);
+    out.writeBool(_isHost);
 #pragma mark END SOLUTION
 }
 /**
@@ -52,15 +61,27 @@ std::vector<std::byte> SizeEvent::serialize(){
  * useful parameters of this class.
  */
 void SizeEvent::deserialize(const std::vector<std::byte>& data){
+    deserializeFrom(data.data(), data.size());
+}
+
+/**
+ * Deserialize a span of bytes and set the corresponding parameters.
+ *
+ * @param data  a span of bytes packed by serializeTo()
+ * @param size  the number of bytes
+ *
+ * The bytes are read in place and are not retained after this call.
+ */
+void SizeEvent::deserializeFrom(const std::byte* data, size_t size){
     //TODO: deserialize data and set _pos
     //NOTE: You might be tempted to write Vec2(_deserializer.readFloat(),_deserializer.readFloat()), however, C++ doesn't specify the order in which function arguments are evaluated, so you might end up with <y,x> instead of <x,y>.
     
 #pragma mark BEGIN SOLUTION
-    _deserializer.reset();
-    _deserializer.receive(data);
+    _deserializer.receive(data, size);
     int x = _deserializer.readSint32();
     _size = x;
     bool host = _deserializer.readBool();
     _isHost = host;
+    _deserializer.reset();
 #pragma mark END SOLUTION
 }
@@ -50,10 +50,27 @@ public:
      */
     void deserialize(const std::vector<std::byte>& data) override;
     
+    /**
+     * Serialize any paramater that the event contains to the end of a frame.
+     *
+     * This is the allocation-free version of serialize() used by the
+     * NetEventController when it packs outbound frames.
+     */
+    void serializeTo(LWSerializer& out) override;
+    /**
+     * Deserialize a span of bytes and set the corresponding parameters.
+     *
+     * @param data  a span of bytes packed by serializeTo()
+     * @param size  the number of bytes
+     *
+     * The bytes are read in place and are not retained after this call.
+     */
+    void deserializeFrom(const std::byte* data, size_t size) override;
+    
     /** Gets the position of the event. */
-    Vec2 getPos() { return _pos; }
+    Vec2 getPos() const { return _pos; }
     
-    bool isHost() {return _isHost; }
+    bool isHost() const {return _isHost; }
 };
 
 
@@ -431,6 +431,15 @@ bool OverWorld::init(const std::shared_ptr<cugl::AssetManager> &assets, const st
     _activeSize = activeSize;
     _constants = assets->get<cugl::JsonValue>("constants");
     _world = world;
+    _flowFields = nullptr;
+    if (_isHost && _world != nullptr)
+    {
+        _flowFields = std::make_shared<FlowFieldController>();
+        if (!_flowFields->init(_world))
+        {
+            _flowFields = nullptr;
+        }
+    }
 
     initWorld();
     initDogModel();
@@ -459,7 +468,7 @@ bool OverWorld::setRootNode(const std::shared_ptr<scene2::SceneNode> &_worldNode
     _dog->setDebugScene(_debugNode);
     if (_isHost)
     {
-        _worldNet->getOwnedObstacles().insert({_dog, 0});
+        _worldNet->ownObstacle(_dog);
     }
     _worldNode->addChild(_dog->getDogNode());
     _dog->addEffects(_attackPolygonSet.getFrontAttackPolygonNode(), _attackPolygonSet.getBackAttackPolygonNode());
@@ -473,12 +482,13 @@ bool OverWorld::setRootNode(const std::shared_ptr<scene2::SceneNode> &_worldNode
         _dogClient->setDebugScene(_debugNode);
         if (_isHost)
         {
-            _worldNet->getOwnedObstacles().insert({_dogClient, 0});
+            _worldNet->ownObstacle(_dogClient);
         }
         _worldNode->addChild(_dogClient->getDogNode());
         if (!_isHost)
         {
-            _network->getPhysController()->acquireObs(_dogClient, 0);
+            // Predict our dog locally, with the host as the authority
+            _network->getPhysController()->predictObs(_dogClient);
         }
     }
 
@@ -488,9 +498,9 @@ bool OverWorld::setRootNode(const std::shared_ptr<scene2::SceneNode> &_worldNode
     // Add Obstacles
     return true;
 }
-void OverWorld::processDashEvent(const std::shared_ptr<DashEvent> &dashEvent)
+void OverWorld::processDashEvent(const DashEvent& dashEvent)
 {
-    bool incomingHost = dashEvent->getHost();
+    bool incomingHost = dashEvent.getHost();
     if (incomingHost)
     {
         _dog->startDash();
@@ -500,24 +510,24 @@ void OverWorld::processDashEvent(const std::shared_ptr<DashEvent> &dashEvent)
         _dogClient->startDash();
     }
 }
-void OverWorld::processSizeEvent(const std::shared_ptr<SizeEvent> &sizeEvent)
+void OverWorld::processSizeEvent(const SizeEvent& sizeEvent)
 {
-    bool incomingHost = sizeEvent->isHost();
+    bool incomingHost = sizeEvent.isHost();
     bool currentHost = _isHost;
 //    CULog("processing Size Event %d %d", incomingHost, currentHost);
     if (incomingHost != currentHost)
     { // means we received from other person
         if (incomingHost)
         { // means incoming is from Original host
-            _dog->updateDogSize(sizeEvent->getSize());
+            _dog->updateDogSize(sizeEvent.getSize());
         }
     }
 }
-void OverWorld::processBiteEvent(const std::shared_ptr<BiteEvent> &biteEvent)
+void OverWorld::processBiteEvent(const BiteEvent& biteEvent)
 {
-    Vec2 center = biteEvent->getPos();
-    float ang = biteEvent->getAng();
-    bool incomingHost = biteEvent->isHost();
+    Vec2 center = biteEvent.getPos();
+    float ang = biteEvent.getAng();
+    bool incomingHost = biteEvent.isHost();
     if (incomingHost)
     {
         _attackPolygonSet.addBite(center, ang, _dog->getBiteRadius(), _dog->getAbsorb() / _dog->getMaxAbsorb());
@@ -529,8 +539,8 @@ void OverWorld::processBiteEvent(const std::shared_ptr<BiteEvent> &biteEvent)
         _dogClient->startBite();
     }
 }
-void OverWorld::processRecallEvent(const std::shared_ptr<RecallEvent>& recallEvent){
-    bool incomingHost = recallEvent->isHost();
+void OverWorld::processRecallEvent(const RecallEvent& recallEvent){
+    bool incomingHost = recallEvent.isHost();
     if (incomingHost){
         _dog->startRecall();
     }else{
@@ -538,12 +548,12 @@ void OverWorld::processRecallEvent(const std::shared_ptr<RecallEvent>& recallEve
     }
 }
 
-void OverWorld::processShootEvent(const std::shared_ptr<ShootEvent> &shootEvent)
+void OverWorld::processShootEvent(const ShootEvent& shootEvent)
 {
-    Vec2 center = shootEvent->getPos();
-    float ang = shootEvent->getAng();
+    Vec2 center = shootEvent.getPos();
+    float ang = shootEvent.getAng();
     _attackPolygonSet.addShoot(center, ang, _dog->getShootRadius());
-    bool incomingHost = shootEvent->isHost();
+    bool incomingHost = shootEvent.isHost();
     if (incomingHost)
     {
         _dog->startShoot();
@@ -553,9 +563,9 @@ void OverWorld::processShootEvent(const std::shared_ptr<ShootEvent> &shootEvent)
         _dogClient->startShoot();
     }
 }
-void OverWorld::processExplodeEvent(const std::shared_ptr<ExplodeEvent> &explodeEvent)
+void OverWorld::processExplodeEvent(const ExplodeEvent& explodeEvent)
 {
-    Vec2 center = explodeEvent->getPos();
+    Vec2 center = explodeEvent.getPos();
     _attackPolygonSet.addExplode(center, _dog->getExplosionRadius());
 }
 void OverWorld::recallDogToClosetBase(std::shared_ptr<Dog> _curDog){
@@ -642,6 +652,29 @@ void OverWorld::update(InputController &_input, cugl::Size totalSize, float time
     //    devilUpdate(_input, totalSize);
     _attackPolygonSet.update();
     _clientAttackPolygonSet.update();
+    // Paths and flow fields pick up opened or closed walls from the revision
+    _world->updateWalls();
+    flowFieldUpdate();
+}
+
+void OverWorld::flowFieldUpdate()
+{
+    if (_flowFields == nullptr)
+    {
+        return;
+    }
+    // Same order as AbstractEnemy::getTargetPositionFromIndex
+    _flowTargets.clear();
+    _flowTargets.push_back(_dog->getPosition());
+    for (const std::shared_ptr<Base> &base : _bases->_bases)
+    {
+        _flowTargets.push_back(base->getPos());
+    }
+    for (const std::shared_ptr<Decoy> &decoy : _decoys->getCurrentDecoys())
+    {
+        _flowTargets.push_back(decoy->getPos());
+    }
+    _flowFields->update(_flowTargets);
 }
 
 void OverWorld::postUpdate()
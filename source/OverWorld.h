@@ -24,6 +24,7 @@
 #include "NLExplodeEvent.h"
 #include "NLShootEvent.h"
 #include "World.h"
+#include "FlowFieldController.h"
 #include "NLDashEvent.h"
 #include "NLSizeEvent.h"
 
@@ -43,7 +44,10 @@ private:
     AttackPolygons _attackPolygonSet;
     AttackPolygons _clientAttackPolygonSet;
     std::shared_ptr<World> _world;
+    std::shared_ptr<FlowFieldController> _flowFields;
+    std::vector<cugl::Vec2> _flowTargets;
 
+    void flowFieldUpdate();
     void drawDecoy(const std::shared_ptr<cugl::SpriteBatch> &batch);
 
 public:
@@ -71,12 +75,12 @@ public:
     void update(InputController &input, cugl::Size totalSize, float timestep);
     void postUpdate();
     void ownedDogUpdate(InputController& _input, cugl::Size, std::shared_ptr<Dog> _curDog);
-    void processShootEvent(const std::shared_ptr<ShootEvent>& shootEvent);
-    void processSizeEvent(const std::shared_ptr<SizeEvent>& sizeEvent);
-    void processBiteEvent(const std::shared_ptr<BiteEvent>& biteEvent);
-    void processRecallEvent(const std::shared_ptr<RecallEvent>& recallEvent);
-    void processExplodeEvent(const std::shared_ptr<ExplodeEvent>& explodeEvent);
-    void processDashEvent(const std::shared_ptr<DashEvent>& dashEvent);
+    void processShootEvent(const ShootEvent& shootEvent);
+    void processSizeEvent(const SizeEvent& sizeEvent);
+    void processBiteEvent(const BiteEvent& biteEvent);
+    void processRecallEvent(const RecallEvent& recallEvent);
+    void processExplodeEvent(const ExplodeEvent& explodeEvent);
+    void processDashEvent(const DashEvent& dashEvent);
     void recallDogToClosetBase(std::shared_ptr<Dog> _curDog);
     void draw(const std::shared_ptr<cugl::SpriteBatch>& batch,cugl::Size totalSize);
     std::shared_ptr<Dog> getDog() const {
@@ -106,6 +110,11 @@ public:
     {
         return _world;
     }
+    // Only the host steers enemies, so this is null on clients
+    const std::shared_ptr<FlowFieldController>& getFlowFields() const
+    {
+        return _flowFields;
+    }
 
     int getTotalTargets() const
     {
@@ -0,0 +1,211 @@
+//
+//  PathService.cpp
+//  Heavan
+//
+#include "PathService.h"
+
+/** Node expansions spent on path requests each frame */
+#define DEFAULT_BUDGET  2000
+/** Frames a finished path is handed out again before it is searched anew */
+#define DEFAULT_CACHE_FRAMES    60
+/** Added to the priority of requests that no player can see */
+#define OFFSCREEN_PRIORITY  1000.0f
+/** Side length in tiles of the hierarchical graph's clusters */
+#define CLUSTER_SIZE    10
+/** Requests at least this many tiles apart (taxicab) go through the hierarchy */
+#define HIERARCHY_DISTANCE  2*CLUSTER_SIZE
+
+using namespace cugl;
+
+bool PathService::init(const std::shared_ptr<World>& world){
+    dispose();
+    _budget = DEFAULT_BUDGET;
+    _cacheFrames = DEFAULT_CACHE_FRAMES;
+    // Jump points keep long searches well inside the budget
+    _search.setJumpPoints(true);
+    return _search.init(world) && _hierarchy.init(world, CLUSTER_SIZE);
+}
+
+void PathService::dispose(){
+    _active = nullptr;
+    _waypoints.clear();
+    _segment = 0;
+    _queue = std::priority_queue<Request>();
+    _cache.clear();
+    _views.clear();
+    _frame = 0;
+    _order = 0;
+}
+
+float PathService::getPriority(Vec2 start, Vec2 goal) const{
+    float priority = start.distance(goal);
+    for (const Rect& view : _views){
+        if (view.contains(start)){
+            return priority;
+        }
+    }
+    return priority + OFFSCREEN_PRIORITY;
+}
+
+std::shared_ptr<const Path> PathService::request(Vec2 start, Vec2 goal){
+    int cols = _search.getCols();
+    int startX = (int)std::floor(start.x);
+    int startY = (int)std::floor(start.y);
+    int goalX = (int)std::floor(goal.x);
+    int goalY = (int)std::floor(goal.y);
+    int rows = _search.getWorld() ? _search.getWorld()->getRows() : 0;
+    if (startX < 0 || startY < 0 || goalX < 0 || goalY < 0 ||
+        startX >= cols || goalX >= cols || startY >= rows || goalY >= rows){
+        // Off the grid the key would alias another tile, so never cache these
+        std::shared_ptr<Path> path = std::make_shared<Path>();
+        path->startX = startX;
+        path->startY = startY;
+        path->goalX = goalX;
+        path->goalY = goalY;
+        finish(path, Path::State::FAILED);
+        return path;
+    }
+    Uint64 key = ((Uint64)(Uint32)(startY*cols+startX) << 32) | (Uint32)(goalY*cols+goalX);
+    
+    float priority = getPriority(start, goal);
+    auto it = _cache.find(key);
+    if (it != _cache.end()){
+        std::shared_ptr<Path>& path = it->second;
+        if (path->isPending() && path != _active){
+            // Queued again at the better priority; the stale entry is skipped
+            _queue.push({path, priority, _order++});
+        }
+        return path;
+    }
+    
+    std::shared_ptr<Path> path = std::make_shared<Path>();
+    path->startX = startX;
+    path->startY = startY;
+    path->goalX = goalX;
+    path->goalY = goalY;
+    _cache.emplace(key, path);
+    _queue.push({path, priority, _order++});
+    return path;
+}
+
+void PathService::update(){
+    _frame++;
+    if (_hierarchy.sync()){
+        invalidate();
+    }
+    expire();
+    
+    int budget = _budget;
+    while (budget > 0){
+        if (_active == nullptr){
+            while (!_queue.empty() && !_queue.top().path->isPending()){
+                _queue.pop();
+            }
+            if (_queue.empty()){
+                break;
+            }
+            _active = _queue.top().path;
+            _queue.pop();
+            if (!begin(_active, budget)){
+                finish(_active, Path::State::FAILED);
+                continue;
+            }
+        }
+        int before = _search.getExpansions();
+        GridSearch::State state = _search.step(budget);
+        budget -= std::max(_search.getExpansions()-before, 1);
+        if (state == GridSearch::State::SUCCEEDED){
+            appendSegment(_active);
+            if (++_segment+1 >= _waypoints.size()){
+                finish(_active, Path::State::READY);
+            } else if (!beginSegment()){
+                finish(_active, Path::State::FAILED);
+            }
+        } else if (state != GridSearch::State::SEARCHING){
+            finish(_active, Path::State::FAILED);
+        }
+    }
+}
+
+bool PathService::begin(const std::shared_ptr<Path>& path, int& budget){
+    int cols = _search.getCols();
+    int start = path->startY*cols+path->startX;
+    int goal = path->goalY*cols+path->goalX;
+    path->tiles.clear();
+    _waypoints.clear();
+    _segment = 0;
+    if (std::abs(path->goalX-path->startX)+std::abs(path->goalY-path->startY) >= HIERARCHY_DISTANCE &&
+        !_hierarchy.isSameCluster(start, goal)){
+        int expansions = 0;
+        bool found = _hierarchy.findPath(start, goal, _waypoints, expansions);
+        budget -= expansions;
+        if (!found){
+            return false;
+        }
+    } else {
+        _waypoints.push_back(start);
+        _waypoints.push_back(goal);
+    }
+    if (_waypoints.size() < 2){
+        // Already on the goal tile
+        _waypoints.push_back(goal);
+    }
+    return beginSegment();
+}
+
+bool PathService::beginSegment(){
+    int cols = _search.getCols();
+    int from = _waypoints[_segment];
+    int to = _waypoints[_segment+1];
+    return _search.start(from % cols, from / cols, to % cols, to / cols);
+}
+
+void PathService::appendSegment(const std::shared_ptr<Path>& path){
+    int cols = _search.getCols();
+    const std::vector<int>& leg = _search.getPath();
+    // Each leg starts on the tile the previous one ended on
+    for (size_t ii = path->tiles.empty() ? 0 : 1; ii < leg.size(); ii++){
+        path->tiles.emplace_back(leg[ii] % cols, leg[ii] / cols);
+    }
+    path->state = Path::State::READY;
+}
+
+void PathService::finish(const std::shared_ptr<Path>& path, Path::State state){
+    path->state = state;
+    path->complete = true;
+    path->finished = _frame;
+    if (path == _active){
+        _active = nullptr;
+    }
+}
+
+void PathService::invalidate(){
+    // Tiles changed, so drop every path that was searched on the old tiles.
+    // Holders ask again for a new path rather than watch this one's tiles
+    // be replaced under their path index.
+    if (_active != nullptr){
+        _search.cancel();
+        finish(_active, Path::State::FAILED);
+    }
+    for (auto it = _cache.begin(); it != _cache.end(); ){
+        const std::shared_ptr<Path>& path = it->second;
+        if (path->complete){
+            path->outdated = true;
+            it = _cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PathService::expire(){
+    // Enemies holding an expired path keep it; only new requests search again
+    for (auto it = _cache.begin(); it != _cache.end(); ){
+        const std::shared_ptr<Path>& path = it->second;
+        if (path->complete && _frame - path->finished > (Uint64)_cacheFrames){
+            it = _cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,133 @@
+//
+//  PathService.h
+//  Heavan
+//
+
+#ifndef PathService_h
+#define PathService_h
+#include <cugl/cugl.h>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "GridSearch.h"
+#include "HierarchicalGraph.h"
+
+// The result of a path request. Enemies with the same start and goal tiles
+// share one of these, and poll it until it is no longer pending.
+class Path{
+public:
+    enum class State{
+        PENDING,
+        READY,
+        FAILED
+    };
+    State state = State::PENDING;
+    int startX;
+    int startY;
+    int goalX;
+    int goalY;
+    // tile coordinates from start to goal, once ready
+    std::vector<cugl::Vec2> tiles;
+    // false while long paths are still being refined past the tiles so far
+    bool complete = false;
+    // set once tiles changed under the path, so holders ask again
+    bool outdated = false;
+    // frame the search finished, for cache expiry
+    Uint64 finished = 0;
+    
+    bool isPending() const{
+        return state == State::PENDING;
+    }
+    bool isReady() const{
+        return state == State::READY;
+    }
+};
+
+// Central A* service for MonsterController. Requests are queued by priority
+// (enemies on a player's screen first, then those closest to their goal),
+// identical start/goal tile pairs share one search and one cached result,
+// and update() spends at most a fixed number of node expansions per frame,
+// resuming the current search where the last frame left off.
+//
+// Long requests between clusters are first searched on the hierarchical
+// graph, and the tile path is then refined one waypoint leg at a time. The
+// path is ready once the first leg is, with later legs appended as the
+// budget allows.
+class PathService{
+private:
+    struct Request{
+        std::shared_ptr<Path> path;
+        float priority;
+        Uint64 order;
+        // lowest priority value on top, oldest first among equals
+        bool operator<(const Request& other) const{
+            return priority > other.priority || (priority == other.priority && order > other.order);
+        }
+    };
+    
+    GridSearch _search;
+    HierarchicalGraph _hierarchy;
+    std::shared_ptr<Path> _active;
+    // waypoints (y*cols+x) of the active path, and the leg being searched
+    std::vector<int> _waypoints;
+    size_t _segment;
+    std::priority_queue<Request> _queue;
+    std::unordered_map<Uint64, std::shared_ptr<Path>> _cache;
+    std::vector<cugl::Rect> _views;
+    int _budget;
+    int _cacheFrames;
+    Uint64 _frame;
+    Uint64 _order;
+    
+    bool begin(const std::shared_ptr<Path>& path, int& budget);
+    bool beginSegment();
+    void appendSegment(const std::shared_ptr<Path>& path);
+    void finish(const std::shared_ptr<Path>& path, Path::State state);
+    void expire();
+    void invalidate();
+public:
+    PathService() : _segment(0), _budget(0), _cacheFrames(0), _frame(0), _order(0) {}
+    
+    bool init(const std::shared_ptr<World>& world);
+    void dispose();
+    
+    // Returns the shared path from start to goal, queueing a search if no
+    // current one is cached. The handle stays pending until update() gets to it.
+    std::shared_ptr<const Path> request(cugl::Vec2 start, cugl::Vec2 goal);
+    // Lower values are searched first
+    float getPriority(cugl::Vec2 start, cugl::Vec2 goal) const;
+    
+    // Spends this frame's expansion budget on queued requests
+    void update();
+    
+    // The visible world rectangles, for on-screen priority
+    void setViews(const std::vector<cugl::Rect>& views){
+        _views = views;
+    }
+    int getBudget() const{
+        return _budget;
+    }
+    void setBudget(int expansions){
+        _budget = std::max(expansions, 1);
+    }
+    int getCacheFrames() const{
+        return _cacheFrames;
+    }
+    void setCacheFrames(int frames){
+        _cacheFrames = frames;
+    }
+    size_t getQueueSize() const{
+        return _queue.size();
+    }
+    bool usesJumpPoints() const{
+        return _search.usesJumpPoints();
+    }
+    void setJumpPoints(bool value){
+        _search.setJumpPoints(value);
+    }
+    const HierarchicalGraph& getHierarchy() const{
+        return _hierarchy;
+    }
+};
+
+#endif /* PathService_h */
@@ -0,0 +1,134 @@
+//
+//  SpatialHash.cpp
+//  Heavan
+//
+#include "SpatialHash.h"
+#include "AbstractEnemy.h"
+
+#define DEFAULT_CELL_SIZE 2.0f
+
+using namespace cugl;
+
+SpatialHash::SpatialHash() :
+_cellSize(DEFAULT_CELL_SIZE),
+_maxRadius(0),
+_mask(0){
+    _starts.assign(2, 0);
+}
+
+bool SpatialHash::init(float cellSize){
+    if (cellSize <= 0){
+        return false;
+    }
+    _cellSize = cellSize;
+    clear();
+    return true;
+}
+
+void SpatialHash::clear(){
+    _inserted.clear();
+    _entries.clear();
+    _maxRadius = 0;
+    _mask = 0;
+    _starts.assign(2, 0);
+}
+
+void SpatialHash::insert(const std::shared_ptr<AbstractEnemy>& enemy, Vec2 pos, float radius){
+    _inserted.push_back({enemy, pos, radius, toCell(pos.x), toCell(pos.y)});
+    _maxRadius = std::max(_maxRadius, radius);
+}
+
+void SpatialHash::build(){
+    // Power of two table with at least two buckets per entry keeps chains short
+    Uint32 buckets = 2;
+    while (buckets < 2*_inserted.size()){
+        buckets <<= 1;
+    }
+    _mask = buckets-1;
+    
+    // Counting sort by bucket
+    _starts.assign(buckets+1, 0);
+    _buckets.resize(_inserted.size());
+    for (size_t ii = 0; ii < _inserted.size(); ii++){
+        _buckets[ii] = getBucket(_inserted[ii].col, _inserted[ii].row);
+        _starts[_buckets[ii]+1]++;
+    }
+    for (Uint32 b = 0; b < buckets; b++){
+        _starts[b+1] += _starts[b];
+    }
+    _entries.resize(_inserted.size());
+    std::vector<Uint32> next(_starts.begin(), _starts.end()-1);
+    for (size_t ii = 0; ii < _inserted.size(); ii++){
+        _entries[next[_buckets[ii]]++] = std::move(_inserted[ii]);
+    }
+    _inserted.clear();
+}
+
+template <typename Test>
+void SpatialHash::gather(int minCol, int maxCol, int minRow, int maxRow, const Test& test,
+                         std::vector<const Entry*>& result) const{
+    if (_entries.empty() || minCol > maxCol || minRow > maxRow){
+        return;
+    }
+    long long cells = ((long long)maxCol-minCol+1)*((long long)maxRow-minRow+1);
+    if (cells > (long long)_mask+1){
+        // The query covers more cells than buckets, so a scan is cheaper
+        for (const Entry& entry : _entries){
+            if (entry.col >= minCol && entry.col <= maxCol &&
+                entry.row >= minRow && entry.row <= maxRow && test(entry)){
+                result.push_back(&entry);
+            }
+        }
+        return;
+    }
+    for (int row = minRow; row <= maxRow; row++){
+        for (int col = minCol; col <= maxCol; col++){
+            Uint32 b = getBucket(col, row);
+            for (Uint32 ii = _starts[b]; ii < _starts[b+1]; ii++){
+                const Entry& entry = _entries[ii];
+                // Several cells can share a bucket
+                if (entry.col == col && entry.row == row && test(entry)){
+                    result.push_back(&entry);
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::queryRadius(Vec2 center, float radius, std::vector<const Entry*>& result) const{
+    float reach = radius+_maxRadius;
+    gather(toCell(center.x-reach), toCell(center.x+reach),
+           toCell(center.y-reach), toCell(center.y+reach),
+           [&](const Entry& entry){
+               return isWithin(entry.pos, center, radius+entry.radius);
+           }, result);
+}
+
+void SpatialHash::queryRect(const Rect& rect, std::vector<const Entry*>& result) const{
+    gather(toCell(rect.getMinX()), toCell(rect.getMaxX()),
+           toCell(rect.getMinY()), toCell(rect.getMaxY()),
+           [&](const Entry& entry){
+               return rect.contains(entry.pos);
+           }, result);
+}
+
+void SpatialHash::querySector(Vec2 center, float radius, Vec2 facing, float halfAngle,
+                              std::vector<const Entry*>& result) const{
+    float cosHalf = std::cos(halfAngle);
+    float radius2 = radius*radius;
+    gather(toCell(center.x-radius), toCell(center.x+radius),
+           toCell(center.y-radius), toCell(center.y+radius),
+           [&](const Entry& entry){
+               Vec2 diff = entry.pos-center;
+               float dist2 = diff.lengthSquared();
+               if (dist2 > radius2){
+                   return false;
+               }
+               // dot >= |diff|cos(half), compared without a square root
+               float dot = diff.dot(facing);
+               if (cosHalf >= 0){
+                   return dot >= 0 && dot*dot >= dist2*cosHalf*cosHalf;
+               }
+               return dot >= 0 || dot*dot <= dist2*cosHalf*cosHalf;
+           }, result);
+}
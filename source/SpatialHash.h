@@ -0,0 +1,73 @@
+//
+//  SpatialHash.h
+//  Heavan
+//
+
+#ifndef SpatialHash_h
+#define SpatialHash_h
+#include <cugl/cugl.h>
+#include <vector>
+
+class AbstractEnemy;
+
+// Uniform grid of enemy positions, cleared and rebuilt once per tick.
+// Entries are sorted by cell into one array so a query walks a few
+// contiguous runs. Cells hash into a table sized to the entry count, so
+// the grid is unbounded. Queries are only valid until the next build().
+class SpatialHash{
+public:
+    struct Entry{
+        std::shared_ptr<AbstractEnemy> enemy;
+        cugl::Vec2 pos;
+        float radius;
+        int col;
+        int row;
+    };
+private:
+    float _cellSize;
+    // largest entry radius, used to widen circle queries
+    float _maxRadius;
+    std::vector<Entry> _inserted;
+    // entries sorted by bucket after build()
+    std::vector<Entry> _entries;
+    // _starts[b] .. _starts[b+1] is the range of bucket b in _entries
+    std::vector<Uint32> _starts;
+    std::vector<Uint32> _buckets;
+    Uint32 _mask;
+    
+    Uint32 getBucket(int col, int row) const{
+        return (((Uint32)col*73856093u) ^ ((Uint32)row*19349663u)) & _mask;
+    }
+    int toCell(float coord) const{
+        return (int)std::floor(coord/_cellSize);
+    }
+    template <typename Test>
+    void gather(int minCol, int maxCol, int minRow, int maxRow, const Test& test,
+                std::vector<const Entry*>& result) const;
+public:
+    SpatialHash();
+    
+    // cellSize should be about the size of a typical query
+    bool init(float cellSize);
+    void clear();
+    void insert(const std::shared_ptr<AbstractEnemy>& enemy, cugl::Vec2 pos, float radius);
+    void build();
+    size_t size() const{
+        return _entries.size();
+    }
+    
+    // entries whose bounding circle overlaps the circle
+    void queryRadius(cugl::Vec2 center, float radius, std::vector<const Entry*>& result) const;
+    // entries whose position lies in the rectangle (broad phase for polygons)
+    void queryRect(const cugl::Rect& rect, std::vector<const Entry*>& result) const;
+    // entries whose position lies within halfAngle (radians) of the unit
+    // facing direction and within radius of center
+    void querySector(cugl::Vec2 center, float radius, cugl::Vec2 facing, float halfAngle,
+                     std::vector<const Entry*>& result) const;
+    
+    static bool isWithin(cugl::Vec2 a, cugl::Vec2 b, float distance){
+        return a.distanceSquared(b) < distance*distance;
+    }
+};
+
+#endif /* SpatialHash_h */
@@ -134,9 +134,15 @@ void StaticMeleeEnemy::preUpdate(float dt, OverWorld& overWorld){
 //    CULog("distance %f %d", distance, DISTANCE_CUTOFF);
     if (distance > DISTANCE_CUTOFF){ // too far from origin return
         direction = original_pos - getPosition();
+        bool atHome = direction.lengthSquared() < 1;
+        if (overWorld._isHost && !atHome){
+            // walk back around walls once the path service has a route
+            setGoal(original_pos);
+            followPath(direction);
+        }
         if (overWorld._isHost && _counter >= updateRate){
             _counter = 0;
-            if (direction.lengthSquared() >= 1){
+            if (!atHome){
                 setVX(direction.normalize().x);
                 setVY(direction.normalize().y);
             }else{
@@ -47,6 +47,17 @@ World::World(std::shared_ptr<LevelModel> _level, std::shared_ptr<cugl::AssetMana
             }
         }
     }
+    _rows = (int) boundaryWorld.size();
+    _cols = _rows > 0 ? (int) boundaryWorld[0].size() : 0;
+    _passable.resize(_rows*_cols);
+    for (int i = 0; i < _rows; i++){
+        for (int j = 0; j < _cols; j++){
+            _passable[i*_cols+j] = boundaryWorld.at(i).at(j)->type == PASSABLE;
+            if (!_passable[i*_cols+j]){
+                _walls.push_back(i*_cols+j);
+            }
+        }
+    }
     lowerDecorWorld.resize(_level->getLowerDecorLayers());
     for(int n = 0; n < _level->getLowerDecorLayers(); n++){
         lowerDecorWorld.at(n).resize(originalRows);
@@ -128,29 +139,20 @@ std::shared_ptr<cugl::Texture> World::getBoxFromTileSet(int position, const std:
     return curTile.textureTile->getSubTexture(minS, maxS, minT, maxT);
 }
 
-const bool World::isPassable(int x, int y){
-    
-    // If the coord is outside the bounds of the world, the tile is impassible
-    if(x < 0 || y < 0 || x >= getCols() || y >= getRows()){
-        return false;
+void World::setPassable(int x, int y, bool passable){
+    if(x < 0 || y < 0 || x >= _cols || y >= _rows || isPassable(x, y) == passable){
+        return;
+    }
+    _passable[y*_cols+x] = passable;
+    boundaryWorld.at(y).at(x)->type = passable ? PASSABLE : IMPASSIBLE;
+    _changedTiles.push_back(y*_cols+x);
+}
+
+void World::updateWalls(){
+    for(int cell : _walls){
+        int x = cell % _cols;
+        int y = cell / _cols;
+        const std::shared_ptr<TileInfo>& tile = boundaryWorld.at(y).at(x);
+        setPassable(x, y, tile->isRemoved() || !tile->isEnabled());
     }
-    
-//    for (int i = 0; i < getRows(); ++i) {
-//        for (int j = 0; j < getCols(); ++j) {
-//            CULog("IS PASSABLE: %d", (int) (getBoundaryWorld().at(i).at(j)->type == PASSABLE));
-//        }
-//    }
-    
-    // Iterate over rows
-//    for (const auto &row : getBoundaryWorld()) {
-//        // Iterate over columns
-//        for (std::shared_ptr<TileInfo> elem : row) {
-//            std::cout << elem->type << " ";
-//        }
-//        std::cout << std::endl; // Newline after each row for better formatting
-//    }
-    
-//    std::cout << std::endl;
-    
-    return getBoundaryWorld().at(y).at(x)->type == PASSABLE;
 }
@@ -67,6 +67,14 @@ private:
     std::shared_ptr<cugl::Texture> tile;
     std::shared_ptr<cugl::AssetManager> _assets;
     cugl::Vec2 start;
+    // Flattened boundaryWorld passability (row major), for searches
+    std::vector<Uint8> _passable;
+    int _cols = 0;
+    int _rows = 0;
+    // Every tile (y*cols+x) changed by setPassable, in order
+    std::vector<int> _changedTiles;
+    // Tiles (y*cols+x) that were walls when the level loaded
+    std::vector<int> _walls;
     
 public:
     
@@ -97,17 +105,39 @@ public:
         return upperDecorWorld;
     }
     
-    // Get whether a tile is passible or not
-    const bool isPassable(int x, int y);
+    // Get whether a tile is passible or not (outside the world is impassible)
+    bool isPassable(int x, int y) const{
+        if(x < 0 || y < 0 || x >= _cols || y >= _rows){
+            return false;
+        }
+        return _passable[y*_cols+x];
+    }
+    
+    // Opens or blocks a tile. Path caches catch up through getRevision()
+    void setPassable(int x, int y, bool passable);
+    
+    // Opens the wall tiles whose obstacle was removed from (or disabled in)
+    // the physics world, and blocks them again if it comes back
+    void updateWalls();
+    
+    // The number of tile changes so far
+    Uint32 getRevision() const{
+        return (Uint32) _changedTiles.size();
+    }
+    
+    // The tile (y*cols+x) changed by the given revision (0 is the first change)
+    int getChangedTile(Uint32 revision) const{
+        return _changedTiles[revision];
+    }
     
     // Get the number of rows of tiles in the world
-    int getRows(){
-        return(int) boundaryWorld.size();
+    int getRows() const{
+        return _rows;
     }
     
     // Get the number of columns of tiles in the world
-    int getCols(){
-        return (int) boundaryWorld[0].size();
+    int getCols() const{
+        return _cols;
     }
 };
 
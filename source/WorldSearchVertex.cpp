@@ -25,14 +25,12 @@ bool WorldSearchVertex::IsSameState( WorldSearchVertex &rhs )
 
 size_t WorldSearchVertex::Hash()
 {
-    size_t h1 = std::hash<float>{}(x);
-    size_t h2 = std::hash<float>{}(y);
-    return h1 ^ (h2 << 1);
+    return (size_t)(Uint32)x * 73856093u ^ (size_t)(Uint32)y * 19349663u;
 }
 
 float WorldSearchVertex::GoalDistanceEstimate( WorldSearchVertex &nodeGoal )
 {
-    return abs(x - nodeGoal.x) + abs(y - nodeGoal.y);
+    return GridSearch::octile(x - nodeGoal.x, y - nodeGoal.y);
 }
 
 bool WorldSearchVertex::IsGoal( WorldSearchVertex &nodeGoal )
@@ -47,52 +45,103 @@ bool WorldSearchVertex::IsGoal( WorldSearchVertex &nodeGoal )
     return false;
 }
 
-// This generates the successors to the given Node. It uses a helper function called
-// AddSuccessor to give the successors to the AStar class. The A* specific initialisation
-// is done for each node internally, so here you just set the state information that
-// is specific to the application
-bool WorldSearchVertex::GetSuccessors( AStarSearch<WorldSearchVertex> *astarsearch, WorldSearchVertex *parent_node )
+float WorldSearchVertex::GetCost( WorldSearchVertex &successor )
 {
-    
-    //Create list of all possible next tiles
-    std::list<std::pair<int, int>> adj_list;
-    
-    // Left, right, top, bottom
-    adj_list.push_back(std::make_pair(0, 1));
-    adj_list.push_back(std::make_pair(0, -1));
-    adj_list.push_back(std::make_pair(1, 0));
-    adj_list.push_back(std::make_pair(-1, 0));
-    
-    //Diagonals
-    adj_list.push_back(std::make_pair(-1, -1));
-    adj_list.push_back(std::make_pair(1, 1));
-    adj_list.push_back(std::make_pair(-1, 1));
-    adj_list.push_back(std::make_pair(1, -1));
-    
-    int parent_x = -1;
-    int parent_y = -1;
+    return GridSearch::octile(successor.x - x, successor.y - y);
+}
 
-    if( parent_node )
+#pragma mark AStarSearch Adapter
+void AStarSearch<WorldSearchVertex>::SetStartAndGoalStates( WorldSearchVertex &Start, WorldSearchVertex &Goal )
+{
+    if( m_Search.getWorld() != Start._world )
     {
-        parent_x = parent_node->x;
-        parent_y = parent_node->y;
+        m_Search.init( Start._world );
     }
+    m_Search.setJumpPoints( m_JumpPoints );
+    m_Start = Start;
+    m_Goal = Goal;
+    m_Step._world = Start._world;
+    m_Path.clear();
+    m_Cursor = -1;
+    m_Cost = FLT_MAX;
     
-    WorldSearchVertex NewNode(0, 0, _world);
-    
-    // push each possible move except allowing the search to go backwards
-    for (const auto& diff : adj_list) {
-        NewNode = WorldSearchVertex( x - diff.first, y - diff.second, _world);
-        
-        if(_world->isPassable(NewNode.x, NewNode.y) && !((parent_x == NewNode.x) && (parent_y == NewNode.y))){
-            astarsearch->AddSuccessor( NewNode );
-        }
+    // A failed start is reported by the first SearchStep, as before
+    m_Search.start( Start.x, Start.y, Goal.x, Goal.y );
+    m_State = SEARCH_STATE_SEARCHING;
+}
+
+unsigned int AStarSearch<WorldSearchVertex>::SearchStep()
+{
+    if( m_State != SEARCH_STATE_SEARCHING )
+    {
+        return m_State;
     }
-    
-    return true;
+    switch( m_Search.step() )
+    {
+        case GridSearch::State::SUCCEEDED:
+            m_Path = m_Search.getPath();
+            m_Cost = m_Search.getPathCost();
+            m_State = SEARCH_STATE_SUCCEEDED;
+            break;
+        case GridSearch::State::SEARCHING:
+            break;
+        default:
+            m_State = SEARCH_STATE_FAILED;
+            break;
+    }
+    return m_State;
 }
 
-float WorldSearchVertex::GetCost( WorldSearchVertex &successor )
+WorldSearchVertex *AStarSearch<WorldSearchVertex>::GetSolutionAt( int index )
+{
+    m_Cursor = index;
+    if( index == 0 )
+    {
+        return &m_Start;
+    }
+    if( index == (int)m_Path.size() - 1 )
+    {
+        return &m_Goal;
+    }
+    m_Step.x = m_Path[index] % m_Search.getCols();
+    m_Step.y = m_Path[index] / m_Search.getCols();
+    return &m_Step;
+}
+
+WorldSearchVertex *AStarSearch<WorldSearchVertex>::GetSolutionStart()
+{
+    if( m_State == SEARCH_STATE_NOT_INITIALISED )
+    {
+        return NULL;
+    }
+    m_Cursor = 0;
+    return &m_Start;
+}
+
+WorldSearchVertex *AStarSearch<WorldSearchVertex>::GetSolutionNext()
+{
+    if( m_Cursor < 0 || m_Cursor + 1 >= (int)m_Path.size() )
+    {
+        return NULL;
+    }
+    return GetSolutionAt( m_Cursor + 1 );
+}
+
+WorldSearchVertex *AStarSearch<WorldSearchVertex>::GetSolutionEnd()
+{
+    if( m_State == SEARCH_STATE_NOT_INITIALISED )
+    {
+        return NULL;
+    }
+    m_Cursor = (int)m_Path.size() - 1;
+    return &m_Goal;
+}
+
+WorldSearchVertex *AStarSearch<WorldSearchVertex>::GetSolutionPrev()
 {
-    return 0;
+    if( m_Cursor <= 0 || m_Cursor >= (int)m_Path.size() )
+    {
+        return NULL;
+    }
+    return GetSolutionAt( m_Cursor - 1 );
 }
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include "stlastar.h"
 #include "World.h"
+#include "GridSearch.h"
 
 class WorldSearchVertex{
 private:
@@ -36,15 +37,12 @@ public:
         
     }
     
-    // The heurstic used to determine the distance to the goal
+    // The heurstic used to determine the distance to the goal (octile distance)
     float GoalDistanceEstimate( WorldSearchVertex &nodeGoal );
     
     // Whether this node is the goal
     bool IsGoal( WorldSearchVertex &nodeGoal );
     
-    // Adds the nodes you can move to from this node to the pathfinder
-    bool GetSuccessors( AStarSearch<WorldSearchVertex> *astarsearch, WorldSearchVertex *parent_node );
-    
     //The cost of moving to a successor
     float GetCost( WorldSearchVertex &successor );
     
@@ -55,4 +53,66 @@ public:
     size_t Hash();
 };
 
+// Tile searches do not go through the generic node-based search in
+// stlastar.h. This keeps the AStarSearch interface but runs GridSearch
+// underneath, so no nodes are allocated and the world is only referenced
+// by the start, goal and cursor states.
+template <> class AStarSearch<WorldSearchVertex>
+{
+public:
+    enum
+    {
+        SEARCH_STATE_NOT_INITIALISED,
+        SEARCH_STATE_SEARCHING,
+        SEARCH_STATE_SUCCEEDED,
+        SEARCH_STATE_FAILED,
+        SEARCH_STATE_OUT_OF_MEMORY,
+        SEARCH_STATE_INVALID
+    };
+    
+    AStarSearch() : m_State( SEARCH_STATE_NOT_INITIALISED ), m_Cursor( -1 ), m_Cost( FLT_MAX ), m_JumpPoints( false ) {}
+    // The grid search never runs out of nodes, so the limit is ignored
+    AStarSearch( int /*MaxNodes*/ ) : AStarSearch() {}
+    
+    // Use Jump Point Search for searches started after this call
+    void SetJumpPoints( bool value ) { m_JumpPoints = value; }
+    
+    void CancelSearch() { m_Search.cancel(); }
+    
+    void SetStartAndGoalStates( WorldSearchVertex &Start, WorldSearchVertex &Goal );
+    
+    // Advances search one node expansion
+    unsigned int SearchStep();
+    
+    // Releases the solution path (the search arrays are kept for reuse)
+    void FreeSolutionNodes() { m_Path.clear(); m_Cursor = -1; }
+    
+    WorldSearchVertex *GetSolutionStart();
+    WorldSearchVertex *GetSolutionNext();
+    WorldSearchVertex *GetSolutionEnd();
+    WorldSearchVertex *GetSolutionPrev();
+    
+    // Returns FLT_MAX if goal is not defined or there is no solution
+    float GetSolutionCost() { return m_State == SEARCH_STATE_SUCCEEDED ? m_Cost : FLT_MAX; }
+    
+    int GetStepCount() { return m_Search.getExpansions(); }
+    
+    void EnsureMemoryFreed() {}
+    
+private:
+    WorldSearchVertex *GetSolutionAt( int index );
+    
+    GridSearch m_Search;
+    unsigned int m_State;
+    WorldSearchVertex m_Start;
+    WorldSearchVertex m_Goal;
+    // Returned by the solution iterators that are not at the start or goal
+    WorldSearchVertex m_Step;
+    // Solution tiles (as y*cols+x) and the iterator position in them
+    std::vector<int> m_Path;
+    int m_Cursor;
+    float m_Cost;
+    bool m_JumpPoints;
+};
+
 #endif /* WorldSearchVertex_hpp */
@@ -55,6 +55,8 @@ using namespace std;
 template <class T> class AStarState;
 
 // The AStar search class. UserState is the users state space type
+// Tile searches (WorldSearchVertex) are specialised onto GridSearch in
+// WorldSearchVertex.h, which replaces the node lists below.
 template <class UserState> class AStarSearch
 {
 